@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * State of the rules in configAlerts, kept up to date sample by sample: onSample() goes over
+ * the rules of the sampled sensor only (at most MAX_RULES, no series are looked at), onTick()
+ * over the stale rules once per sample timer tick.
+ *
+ * Above and below compare each sample with the limit. Rising and falling compare the rate
+ * since the start of the rate window (window_s) with the limit, once the window is complete,
+ * and then start the next window from that sample. An active rule clears once the value is
+ * hysteresis on the right side of the limit, so a value hovering around it does not flap.
+ *
+ * Changes in the active state are marked unpublished, for MQTT.
+ */
+class Alerts
+{
+public:
+  struct State {
+    int8_t sensor;                 ///< configSensors.allSensors index, -1 if not (yet) there
+    bool active;
+    uint32_t triggered;            ///< times it went active since the rules were set
+    unsigned long changedMillis;   ///< when active last changed (or the rules were set)
+    float value;                   ///< the last compared with the limit: sample, rate per hour, or seconds since a sample
+    bool hasValue;
+    float windowStartValue;        ///< rising and falling
+    unsigned long windowStartMillis;
+    bool windowStarted;
+    unsigned long lastSampleMillis; ///< stale
+  };
+
+  /** Starts over with the rules in configAlerts, all inactive */
+  void reset()
+  {
+    for (int r = 0; r < ConfigAlerts::MAX_RULES; r++)
+    {
+      _states[r] = {};
+      _states[r].changedMillis = millis();
+      _states[r].lastSampleMillis = millis();
+    }
+    _numActive = 0;
+    _unpublished = (1UL << ConfigAlerts::MAX_RULES) - 1; // rules removed as well
+    resolveSensors();
+  }
+
+  /** Looks the sensors of the rules up again, after sensors have been added */
+  void resolveSensors()
+  {
+    for (int r = 0; r < configAlerts.numRules; r++)
+    {
+      _states[r].sensor = configSensors.find(configAlerts.rules[r].sensor);
+    }
+  }
+
+  /** Evaluates the rules of sensor i with a new sample of it */
+  void onSample(int i, float value)
+  {
+    unsigned long now = millis();
+    for (int r = 0; r < configAlerts.numRules; r++)
+    {
+      State & s = _states[r];
+      if (s.sensor != i) {
+        continue;
+      }
+      AlertRule const & rule = configAlerts.rules[r];
+      switch (rule.kind)
+      {
+        case AlertRule::Kind::Above:
+          s.value = value;
+          s.hasValue = true;
+          set(r, s.active ? value >= rule.limit - rule.hysteresis : value > rule.limit);
+          break;
+        case AlertRule::Kind::Below:
+          s.value = value;
+          s.hasValue = true;
+          set(r, s.active ? value <= rule.limit + rule.hysteresis : value < rule.limit);
+          break;
+        case AlertRule::Kind::Rising:
+        case AlertRule::Kind::Falling:
+          if (!s.windowStarted) {
+            s.windowStarted = true;
+          }
+          else if (now - s.windowStartMillis >= rule.windowS * 1000UL) {
+            s.value = (value - s.windowStartValue) * 3600000.0f / (now - s.windowStartMillis);
+            s.hasValue = true;
+            float rate = rule.kind == AlertRule::Kind::Rising ? s.value : -s.value;
+            set(r, s.active ? rate >= rule.limit - rule.hysteresis : rate > rule.limit);
+          }
+          else {
+            break; // in the window
+          }
+          s.windowStartValue = value;
+          s.windowStartMillis = now;
+          break;
+        case AlertRule::Kind::Stale:
+          s.lastSampleMillis = now;
+          s.value = 0;
+          s.hasValue = true;
+          set(r, false);
+          break;
+      }
+    }
+  }
+
+  /** Evaluates the stale rules, at each sample timer tick */
+  void onTick()
+  {
+    unsigned long now = millis();
+    for (int r = 0; r < configAlerts.numRules; r++)
+    {
+      AlertRule const & rule = configAlerts.rules[r];
+      if (rule.kind == AlertRule::Kind::Stale)
+      {
+        State & s = _states[r];
+        s.value = (now - s.lastSampleMillis) / 1000.0f;
+        s.hasValue = true;
+        if (!s.active && s.value > rule.limit) {
+          set(r, true);
+        }
+      }
+    }
+  }
+
+  State const & state(int r) const { return _states[r]; }
+  int numActive() const { return _numActive; }
+
+  /** Rules (bit per index, those beyond configAlerts.numRules removed) changed since published */
+  uint32_t unpublished() const { return _unpublished; }
+  void setPublished(int r) { _unpublished &= ~(1UL << r); }
+  void setAllUnpublished() { _unpublished = (1UL << ConfigAlerts::MAX_RULES) - 1; }
+
+private:
+  void set(int r, bool active)
+  {
+    State & s = _states[r];
+    if (s.active == active) {
+      return;
+    }
+    s.active = active;
+    s.changedMillis = millis();
+    if (active) {
+      s.triggered++;
+      _numActive++;
+    } else {
+      _numActive--;
+    }
+    _unpublished |= 1UL << r;
+  }
+
+  static_assert(ConfigAlerts::MAX_RULES <= 32, "one bit per rule in _unpublished");
+
+  State _states[ConfigAlerts::MAX_RULES] = {};
+  int _numActive = 0;
+  uint32_t _unpublished = 0;
+} alerts;
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifdef HOST_SIMULATION
+#include <Sim.hpp>
+#endif
+
+/**
+ * Heap usage per request type (and of the sampling tick), reported by /api/diagnostics.
+ *
+ * The host simulation counts every malloc (host/hal/SimHeap.cpp). On the board only the
+ * free heap is known, so there allocations that are freed again before the request is
+ * done do not show up, only the change in free heap does.
+ */
+struct AllocationStats {
+  enum Type {
+    Sensors,
+    Sensor,
+    Readings1h,
+    Readings24h,
+    Config,
+    Static,
+    NotFound,
+    Diagnostics,
+    Update,
+    SampleTick,
+    NUM_TYPES
+  };
+
+  struct Counters {
+    uint32_t count;
+    uint32_t allocations;     ///< total, host simulation only
+    uint32_t lastAllocations; ///< during the most recent one, host simulation only
+    uint32_t bytesAllocated;  ///< total, host simulation only
+    int32_t lastHeapChange;   ///< free heap after - before the most recent one
+    uint32_t minFreeHeap;     ///< lowest free heap seen after one
+  };
+
+  Counters counters[NUM_TYPES] = {};
+
+  static bool countsAllocations() {
+#ifdef HOST_SIMULATION
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static const char* toString(Type t) {
+    switch (t)
+    {
+      case Sensors: return "sensors";
+      case Sensor: return "sensor";
+      case Readings1h: return "readings_1h";
+      case Readings24h: return "readings_24h";
+      case Config: return "config";
+      case Static: return "static";
+      case NotFound: return "not_found";
+      case Diagnostics: return "diagnostics";
+      case Update: return "update";
+      case SampleTick: return "sample_tick";
+      default: return "unknown";
+    }
+  }
+} allocationStats;
+
+/**
+ * Accounts the heap usage from construction to destruction to a request type.
+ * The type may be changed while in scope, for handlers serving several kinds of requests.
+ * Responses produced in several parts count as one request (countRequest false for the later parts).
+ */
+class AllocationScope {
+public:
+  AllocationStats::Type type;
+
+  explicit AllocationScope(AllocationStats::Type t, bool countRequest = true)
+    : type(t), _countRequest(countRequest), _freeHeap(ESP.getFreeHeap())
+  {
+#ifdef HOST_SIMULATION
+    sim::HeapStats heap = sim::heapStats();
+    _allocations = heap.allocations;
+    _bytesAllocated = heap.bytesAllocated;
+#endif
+  }
+
+  ~AllocationScope()
+  {
+    AllocationStats::Counters & c = allocationStats.counters[type];
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (c.count == 0 || freeHeap < c.minFreeHeap) {
+      c.minFreeHeap = freeHeap;
+    }
+    if (_countRequest) {
+      c.count++;
+      c.lastHeapChange = 0;
+#ifdef HOST_SIMULATION
+      c.lastAllocations = 0;
+#endif
+    }
+    c.lastHeapChange += int32_t(freeHeap) - int32_t(_freeHeap);
+#ifdef HOST_SIMULATION
+    sim::HeapStats heap = sim::heapStats();
+    c.lastAllocations += heap.allocations - _allocations;
+    c.allocations += heap.allocations - _allocations;
+    c.bytesAllocated += heap.bytesAllocated - _bytesAllocated;
+#endif
+  }
+
+private:
+  bool _countRequest;
+  uint32_t _freeHeap;
+#ifdef HOST_SIMULATION
+  uint64_t _allocations;
+  uint64_t _bytesAllocated;
+#endif
+};
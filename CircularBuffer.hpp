@@ -1,10 +1,19 @@
 #pragma once
 
+#include <string.h>
+
+/**
+ * Fixed capacity FIFO of N elements. The elements are kept as (at most) two contiguous pieces of the
+ * storage, so copy_out() takes them in bulk, in at most two memcpy calls, instead of element by
+ * element. A power of two N wraps positions with a mask instead of a compare.
+ *
+ * Positions (operator[], copy_out) are not range checked: 0 <= pos < size() is up to the caller.
+ */
 template<class T, int N>
 class CircularBuffer {
 public:
-  CircularBuffer() : _readPos(0), _writePos(0), _size(0) {
-    
+  CircularBuffer() : _readPos(0), _size(0) {
+
   }
   ~CircularBuffer() {
     // NO CODE
@@ -13,69 +22,65 @@ public:
   {
     _size = N;
     _readPos = 0;
-    _writePos = 0;
     for (int i = 0; i < N; i++)
     {
       _data[i] = value;
     }
   }
+  void clear()
+  {
+    _size = 0;
+    _readPos = 0;
+  }
   /** @return false if no more space available */
   bool push_back(const T& value) {
-     if (_size == N) {
-       return false;
-     }
-     _data[_writePos] = value;
-     _writePos = getNextPos(_writePos);
-     _size++;
+    if (_size == N) {
+      return false;
+    }
+    _data[wrap(_readPos + _size)] = value;
+    _size++;
+    return true;
   }
   void pop_front() {
-    if (_size < 1)
-    {
-      _size = 0;
-      return; // decide what to do in this error case
-    }
-    else
+    if (_size > 0)
     {
-      _readPos = getNextPos(_readPos);
+      _readPos = wrap(_readPos + 1);
       _size--;
     }
   }
-  bool push_back_erase_if_full(const T& value) {
-     while (_size >= N) {
-       pop_front();
-     }
-     _data[_writePos] = value;
-     _writePos = getNextPos(_writePos);
-     _size++;
+  /** Overwrites the oldest element if full */
+  void push_back_erase_if_full(const T& value) {
+    _data[wrap(_readPos + _size)] = value;
+    if (_size == N) {
+      _readPos = wrap(_readPos + 1);
+    } else {
+      _size++;
+    }
+  }
+  /** Copies count elements from pos on to out (in at most two copies) */
+  void copy_out(int pos, T* out, int count) const
+  {
+    int from = wrap(_readPos + pos);
+    int n = min(count, N - from);
+    memcpy(out, _data + from, n * sizeof(T));
+    memcpy(out + n, _data, (count - n) * sizeof(T));
   }
   int size() const { return _size; }
-  
+
   T const & operator[](int pos) const
   {
-    if (pos > _size)
-    {
-      static T nullInitialized{};
-      Serial.println("ERROR: pos > size in circular buffer");
-      return nullInitialized; // todo decide what to do in this error case...
-    }
-    else
-    {
-      int offset = _readPos + pos;
-      if (offset >= N)
-        offset -= N;
-      return _data[offset];
-    }
+    return _data[wrap(_readPos + pos)];
   }
 private:
-  int getNextPos(int currentPos)
+  static constexpr bool POWER_OF_TWO = (N & (N - 1)) == 0;
+
+  /** Position in the storage of p, 0 <= p < 2 * N */
+  static int wrap(int p)
   {
-    if ((currentPos + 1) < N)
-      return currentPos + 1;
-    else
-      return 0;
+    return POWER_OF_TWO ? (p & (N - 1)) : (p < N ? p : p - N);
   }
+
   T _data[N];
   int _readPos;
-  int _writePos;
   int _size;
 };
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <math.h>
+
+#include "CircularBuffer.hpp"
+
+/**
+ * A series of evenly spaced readings stored lossily, with swinging door trending: only the points
+ * needed to draw the series as straight lines between them, each reading within deviation of its
+ * line (plus rounding to the stored unit). A reading that does not fit the line from the last point
+ * through the ones since ends the line at the reading before it, which becomes the next point.
+ *
+ * Points are kept with the sequence number of their reading (16 bits, the series spans at most
+ * MAX_SPAN + MAX_GAP readings), so a slowly moving series covers many more readings than N. The oldest
+ * points are dropped as new ones are made; a series noisier than deviation covers fewer.
+ *
+ * The readings in between are worked out as they are asked for: binary search for the line, or
+ * the next one to the last reading asked for, so reading the series in order costs O(1) per reading.
+ */
+template<int N>
+class CompressedSeries {
+public:
+  enum {
+    MAX_SPAN = 32767, ///< readings from the oldest point to the latest point
+    MAX_GAP = 4096,   ///< readings between two points, at most (the series keeps at least two points)
+  };
+
+  /** Starts over, as if count (1 - MAX_GAP) readings of value had been added, each within deviation */
+  void reset(int16_t deviation, int16_t value, int count)
+  {
+    _deviation = deviation;
+    _points.clear();
+    _points.push_back({0, value});
+    _latest = uint16_t(count - 1);
+    _slopeLow = count > 1 ? -float(deviation) / (count - 1) : -INFINITY;
+    _slopeHigh = count > 1 ? float(deviation) / (count - 1) : INFINITY;
+    _cursor = 0;
+  }
+
+  /** Adds the next reading, O(1) */
+  void push(int16_t value)
+  {
+    Point const & last = _points[_points.size() - 1];
+    uint16_t gap = uint16_t(_latest + 1 - last.seq);
+    float low = float(value - _deviation - last.value) / gap;
+    float high = float(value + _deviation - last.value) / gap;
+    if (gap <= MAX_GAP && max(low, _slopeLow) <= min(high, _slopeHigh))
+    {
+      _slopeLow = max(low, _slopeLow);
+      _slopeHigh = min(high, _slopeHigh);
+    }
+    else
+    {
+      // The line so far ends at the previous reading, the new one starts from there
+      float v = last.value + slope() * uint16_t(_latest - last.seq);
+      Point end = {_latest, int16_t(lroundf(v))};
+      if (_points.size() == N) {
+        popOldest();
+      }
+      _points.push_back(end);
+      while (uint16_t(_latest + 1 - _points[0].seq) > MAX_SPAN) {
+        popOldest();
+      }
+      _slopeLow = float(value - _deviation - end.value);
+      _slopeHigh = float(value + _deviation - end.value);
+    }
+    _latest++;
+  }
+
+  /** Readings covered, from the oldest point to the latest reading */
+  int size() const { return uint16_t(_latest - _points[0].seq) + 1; }
+  int numPoints() const { return _points.size(); }
+  int16_t deviation() const { return _deviation; }
+
+  /** Reading i of size() (oldest first), as reconstructed */
+  int16_t operator[](int i) const
+  {
+    uint16_t seq = uint16_t(_points[0].seq + i);
+    // Most often the line of the reading before, or the next one
+    int k = _cursor;
+    if (!(covers(k, seq)) && !(k + 1 < _points.size() && covers(++k, seq)))
+    {
+      int lo = 0;
+      int hi = _points.size() - 1;
+      while (lo < hi)
+      {
+        int mid = (lo + hi + 1) / 2;
+        if (offset(_points[mid].seq) <= offset(seq)) {
+          lo = mid;
+        } else {
+          hi = mid - 1;
+        }
+      }
+      k = lo;
+    }
+    _cursor = k;
+    Point const & p = _points[k];
+    uint16_t dt = uint16_t(seq - p.seq);
+    if (k + 1 == _points.size()) {
+      return dt == 0 ? p.value : int16_t(lroundf(p.value + slope() * dt));
+    }
+    Point const & q = _points[k + 1];
+    return int16_t(lroundf(p.value + float(q.value - p.value) * dt / uint16_t(q.seq - p.seq)));
+  }
+
+private:
+  struct Point {
+    uint16_t seq; ///< of the reading
+    int16_t value;
+  };
+
+  void popOldest()
+  {
+    _points.pop_front();
+    _cursor = _cursor > 0 ? _cursor - 1 : 0;
+  }
+  /** Position relative to the oldest point */
+  uint16_t offset(uint16_t seq) const { return uint16_t(seq - _points[0].seq); }
+  /** @return true if seq is on the line from point k to the next (or the last reading) */
+  bool covers(int k, uint16_t seq) const
+  {
+    return offset(_points[k].seq) <= offset(seq) &&
+           (k + 1 == _points.size() || offset(seq) < offset(_points[k + 1].seq));
+  }
+  /** Of the line from the last point through the readings since, within deviation of all of them */
+  float slope() const
+  {
+    if (isinf(_slopeLow) || isinf(_slopeHigh)) {
+      return 0; // no reading since the point
+    }
+    return (_slopeLow + _slopeHigh) / 2;
+  }
+
+  CircularBuffer<Point, N> _points;
+  uint16_t _latest = 0;     ///< seq of the latest reading
+  int16_t _deviation = 0;
+  float _slopeLow = -INFINITY;  ///< slopes of the lines from the last point that are still within deviation
+  float _slopeHigh = INFINITY;
+  mutable int16_t _cursor = 0; ///< point of the line of the reading last asked for
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+/** An alert on the samples of one sensor, see Alerts.hpp */
+struct AlertRule {
+  enum class Kind : uint8_t {
+    Above,   ///< sample above limit (degrees), clears below limit - hysteresis
+    Below,   ///< sample below limit (degrees), clears above limit + hysteresis
+    Rising,  ///< rising faster than limit (degrees per hour) over windowS, clears below limit - hysteresis
+    Falling, ///< falling faster than limit (degrees per hour) over windowS, clears below limit - hysteresis
+    Stale,   ///< no sample for limit seconds (not sampled, or a probe pulled out), clears with the next one
+  };
+
+  char sensor[17]; ///< id
+  Kind kind;
+  float limit;
+  float hysteresis;
+  uint16_t windowS; ///< Rising and Falling only
+};
+
+const char* toString(AlertRule::Kind k) {
+  switch (k)
+  {
+    case AlertRule::Kind::Above: return "above";
+    case AlertRule::Kind::Below: return "below";
+    case AlertRule::Kind::Rising: return "rising";
+    case AlertRule::Kind::Falling: return "falling";
+    case AlertRule::Kind::Stale: return "stale";
+    default: return "unknown";
+  }
+}
+
+/** Alert rules, {"rules":[{"sensor":<id>, "kind":"above", "limit":80.0, "hysteresis":2.0}, ...]} */
+struct ConfigAlerts
+{
+  enum {
+    MAX_RULES = 8,
+    MIN_WINDOW_S = 60,
+    MAX_WINDOW_S = 3600,
+    DEFAULT_WINDOW_S = 600,
+    MAX_STALE_S = 86400,
+  };
+
+  ConfigAlerts() : numRules(0), _modified(false) { /* no code */ }
+
+  int numRules;
+  AlertRule rules[MAX_RULES];
+
+  bool isModified() const { return _modified; };
+
+  /** Save values to flash */
+  bool save()
+  {
+    File configFile = SPIFFS.open("/config/alerts", "w");
+    if (!configFile) {
+      Serial.println("file open failed");
+      return false;
+    }
+
+    // Written piece by piece, no need to hold the whole file in RAM
+    size_t written = configFile.print(R"EOF({"rules":[)EOF");
+    for (int i = 0; i < numRules; i++)
+    {
+      char buf[128];
+      ruleToString(buf, sizeof(buf), rules[i]);
+      if (i != 0) { written += configFile.print(", "); }
+      written += configFile.print(buf);
+    }
+    written += configFile.println("]}");
+    configFile.close();
+    if (!written) {
+      Serial.println("not written");
+      return false;
+    }
+
+    _modified = false;
+    return true;
+  }
+
+  /** Load values from flash */
+  bool load()
+  {
+    File configFile = SPIFFS.open("/config/alerts", "r");
+    if (!configFile) {
+      Serial.println("not found");
+      return false;
+    }
+
+    size_t size = configFile.size();
+    if (size > 1536) {
+      Serial.println("too large");
+      return false;
+    }
+
+    String buf = configFile.readString();
+    configFile.close();
+
+    if (!patch(buf.c_str())) {
+      Serial.println("malformed?");
+      return false;
+    }
+    _modified = false;
+    return true;
+  }
+
+  /**
+   * Replace all rules with the ones in json input
+   * @return true if validation OK and rules updated. On error, the rules are left as they were
+   */
+  bool patch(char const * jsonString)
+  {
+    const size_t capacity = JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(MAX_RULES) + MAX_RULES * JSON_OBJECT_SIZE(5) + 512;
+    StaticJsonDocument<capacity> root;
+    DeserializationError error = deserializeJson(root, jsonString);
+    if (error || !root["rules"].is<JsonArray>()) {
+      Serial.println("deserial err");
+      return false;
+    }
+
+    JsonArray arr = root["rules"];
+    if (arr.size() > MAX_RULES) {
+      return false;
+    }
+    ConfigAlerts next;
+    for (JsonObject rule : arr)
+    {
+      if (!setRule(next.rules[next.numRules++], rule)) {
+        return false;
+      }
+    }
+    next._modified = true;
+    *this = next;
+    return true;
+  }
+
+  /** Append the json of a rule, as patch() takes it, to buf */
+  static size_t ruleToString(char* buf, size_t size, AlertRule const & rule)
+  {
+    int len = snprintf(buf, size, "{\"sensor\":\"%s\", \"kind\":\"%s\", \"limit\":%.2f, \"hysteresis\":%.2f, \"window_s\":%u}",
+                       rule.sensor, toString(rule.kind), rule.limit, rule.hysteresis, rule.windowS);
+    return min(size_t(len), size - 1);
+  }
+
+private:
+  bool _modified;
+
+  static bool setRule(AlertRule & rule, JsonObject json)
+  {
+    rule = {};
+    char const* id = json["sensor"].as<const char*>();
+    char const* kind = json["kind"].as<const char*>();
+    if (!id || strlen(id) != 16 || !kind || !json["limit"].is<float>()) {
+      return false;
+    }
+    strncpy(rule.sensor, id, sizeof(rule.sensor));
+    int k = 0;
+    for (; k <= int(AlertRule::Kind::Stale) && strcmp(kind, toString(AlertRule::Kind(k))) != 0; k++)
+    {
+    }
+    if (k > int(AlertRule::Kind::Stale)) {
+      return false;
+    }
+    rule.kind = AlertRule::Kind(k);
+    rule.limit = json["limit"].as<float>();
+    rule.hysteresis = json.containsKey("hysteresis") ? json["hysteresis"].as<float>() : 0.0f;
+    rule.windowS = json.containsKey("window_s") ? json["window_s"].as<int>() : 0;
+    if ((json.containsKey("hysteresis") && !json["hysteresis"].is<float>()) || rule.hysteresis < 0 ||
+        (json.containsKey("window_s") && !json["window_s"].is<int>())) {
+      return false;
+    }
+    switch (rule.kind)
+    {
+      case AlertRule::Kind::Rising:
+      case AlertRule::Kind::Falling:
+        if (rule.windowS == 0) {
+          rule.windowS = DEFAULT_WINDOW_S;
+        }
+        return rule.limit > 0 && rule.windowS >= MIN_WINDOW_S && rule.windowS <= MAX_WINDOW_S;
+      case AlertRule::Kind::Stale:
+        rule.hysteresis = 0;
+        rule.windowS = 0;
+        return rule.limit >= 1 && rule.limit <= MAX_STALE_S;
+      default:
+        rule.windowS = 0;
+        return true;
+    }
+  }
+};
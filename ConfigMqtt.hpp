@@ -0,0 +1,221 @@
+#pragma once
+
+/** MQTT broker to publish the samples to (optional, see MqttClient.hpp) */
+struct ConfigMqtt
+{
+  ConfigMqtt() :
+    _enabled(false),
+    _port(1883),
+    _host{"192.168.1.2"},
+    _topic{"tempviewer"},
+    _username{""},
+    _password{""},
+    _modified(false)
+  { /* no code */ }
+
+  bool getEnabled() const { return _enabled; }
+  bool setEnabled(bool enabled) { _modified = true; _enabled = enabled; return true;}
+
+  /** IP address or host name of the broker */
+  const char* getHost() const { return _host; }
+  bool setHost(String const & str) { return setString(str, _host, 1); }
+
+  uint16_t getPort() const { return _port; }
+  bool setPort(int port)
+  {
+    if (port < 1 || port > 65535)
+    {
+      return false;
+    }
+    _port = port;
+    _modified = true;
+    return true;
+  }
+
+  /** Prefix of all topics published to */
+  const char* getTopic() const { return _topic; }
+  bool setTopic(String const & str)
+  {
+    // No wildcards, and no trailing / (it is added when building the topics)
+    if (strchr(str.c_str(), '#') || strchr(str.c_str(), '+') || str.endsWith("/"))
+    {
+      return false;
+    }
+    return setString(str, _topic, 1);
+  }
+
+  /** Empty if the broker does not require a login */
+  const char* getUsername() const { return _username; }
+  bool setUsername(String const & str) { return setString(str, _username, 0); }
+
+  const char* getPassword() const { return _password; }
+  bool setPassword(String const & str) { return setString(str, _password, 0); }
+
+  bool isModified() const { return _modified; };
+
+  /** Save values to flash */
+  bool save()
+  {
+    StaticJsonDocument<512> json;
+    json["enabled"] = int(_enabled);
+    json["host"] = _host;
+    json["port"] = _port;
+    json["topic"] = _topic;
+    json["username"] = _username;
+    json["password"] = _password;
+
+    char response[512] = {};
+    size_t toWrite = serializeJson(json, response, sizeof(response));
+
+    if (!toWrite || toWrite >= sizeof(response))
+    {
+      Serial.println("too much");
+      return false;
+    }
+
+    File configFile = SPIFFS.open("/config/mqtt", "w");
+    if (!configFile) {
+      Serial.println("file open failed");
+      return false;
+    }
+
+    size_t written = configFile.println(response);
+    if (!written) {
+      Serial.println("not written");
+      configFile.close();
+      return false;
+    }
+    configFile.close();
+
+    _modified = false;
+    return true;
+  }
+
+  /** Load values from flash */
+  bool load()
+  {
+    File configFile = SPIFFS.open("/config/mqtt", "r");
+    if (!configFile) {
+      Serial.println("not found");
+      return false;
+    }
+
+    size_t size = configFile.size();
+    if (size > 1024) {
+      Serial.println("too large");
+      return false;
+    }
+
+    String buf = configFile.readString();
+    configFile.close();
+
+    StaticJsonDocument<512> json;
+    DeserializationError error = deserializeJson(json, buf.c_str());
+    if (error) {
+      Serial.println("deserialize fail");
+      return false;
+    }
+    {
+      char const* keys[] = {"enabled", "host", "port", "topic", "username", "password", nullptr};
+      char const** it = keys;
+      while (*it) {
+        if (!json.containsKey(*it)) {
+          Serial.printf("missing key %s", *it);
+          return false;
+        }
+        it++;
+      }
+    }
+
+    ConfigMqtt next;
+    if (next.setEnabled(json["enabled"].as<int>()) &&
+        next.setHost(json["host"].as<const char*>()) &&
+        next.setPort(json["port"].as<int>()) &&
+        next.setTopic(json["topic"].as<const char*>()) &&
+        next.setUsername(json["username"].as<const char*>()) &&
+        next.setPassword(json["password"].as<const char*>()))
+    {
+      next._modified = false;
+      *this = next;
+      return true;
+    }
+    Serial.println("malformed?");
+    return false;
+  }
+
+  /** Update zero or more elements provided in json input
+      @return true if validation OK and data (if any) updated. On error, no fields are updated
+   */
+  bool patch(char const * jsonString)
+  {
+    StaticJsonDocument<512> root;
+    DeserializationError error = deserializeJson(root, jsonString);
+    if (error) {
+      Serial.println("deserial err");
+      return false;
+    }
+
+    char const* stringKeys[] = {"host", "topic", "username", "password", nullptr};
+    for (JsonPair const & kv : root.as<JsonObject>())
+    {
+      bool isString = kv.value().is<char const*>() || kv.value().is<char*>();
+      bool isInt = kv.value().is<int>();
+      bool currentKeyValid = (strcmp(kv.key().c_str(), "enabled") == 0 && isInt) ||
+                             (strcmp(kv.key().c_str(), "port") == 0 && isInt);
+      for (char const** it = stringKeys; *it && !currentKeyValid; it++) {
+        currentKeyValid = strcmp(kv.key().c_str(), *it) == 0 && isString;
+      }
+      if (!currentKeyValid) {
+        Serial.printf("invalid key %s: ", kv.key().c_str());
+        return false;
+      }
+    }
+
+    ConfigMqtt next = *this;
+    if (root.containsKey("enabled") && !next.setEnabled(root["enabled"].as<int>())) { return false; }
+    if (root.containsKey("host") && !next.setHost(root["host"].as<char*>())) { return false; }
+    if (root.containsKey("port") && !next.setPort(root["port"].as<int>())) { return false; }
+    if (root.containsKey("topic") && !next.setTopic(root["topic"].as<char*>())) { return false; }
+    if (root.containsKey("username") && !next.setUsername(root["username"].as<char*>())) { return false; }
+    if (root.containsKey("password") && !next.setPassword(root["password"].as<char*>())) { return false; }
+
+    next._modified = _modified;
+    if (next == *this)
+    {
+      return true;
+    }
+    *this = next;
+    _modified = true;
+    return true;
+  }
+
+  bool operator==(ConfigMqtt const& other) const {
+    return other._enabled == _enabled &&
+           other._port == _port &&
+           strcmp(other._host, _host) == 0 &&
+           strcmp(other._topic, _topic) == 0 &&
+           strcmp(other._username, _username) == 0 &&
+           strcmp(other._password, _password) == 0;
+  }
+
+private:
+  template<size_t N>
+  bool setString(String const & str, char (&dest)[N], unsigned int minLength)
+  {
+    if (str.length() < minLength || str.length() >= N)
+    {
+      return false;
+    }
+    memcpy(dest, str.c_str(), str.length() + 1);
+    _modified = true;
+    return true;
+  }
+
+  bool _enabled;
+  uint16_t _port;
+  char _host[64];
+  char _topic[64];
+  char _username[33];
+  char _password[65];
+  bool _modified;
+};
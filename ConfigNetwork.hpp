@@ -49,7 +49,7 @@ struct ConfigNetwork
     {
       return false;
     }
-    strncpy(_ssid, str.c_str(), sizeof(_ssid));
+    memcpy(_ssid, str.c_str(), str.length() + 1);
     _modified = true;
     return true;
   }
@@ -61,7 +61,7 @@ struct ConfigNetwork
     {
       return false;
     }
-    strncpy(_password, str.c_str(), sizeof(_password));
+    memcpy(_password, str.c_str(), str.length() + 1);
     _modified = true;
     return true;
   }
@@ -274,8 +274,8 @@ struct ConfigNetwork
            other._staticIp == _staticIp &&
            other._staticGateway == _staticGateway &&
            other._staticSubnet == _staticSubnet &&
-           other._ssid == _ssid &&
-           other._password == _password;
+           strcmp(other._ssid, _ssid) == 0 &&
+           strcmp(other._password, _password) == 0;
   }
 
 private:
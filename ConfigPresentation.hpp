@@ -149,7 +149,7 @@ struct ConfigPresentation
     }
     
     ConfigPresentation next;
-    if (json["unit"].as<char*>() != '\0' && next.setPresentationUnit(json["unit"].as<char*>()[0]) &&
+    if (json["unit"].as<char*>() != nullptr && next.setPresentationUnit(json["unit"].as<char*>()[0]) &&
         next.setYMax(json["ymax"].as<float>()) &&
         next.setYMin(json["ymin"].as<float>()) &&
         next.setYIncrement(json["yincrement"].as<float>()))
@@ -195,7 +195,7 @@ struct ConfigPresentation
           break;
         }
 
-        if (keyMatch && isInt || isFloat)
+        if (keyMatch && (isInt || isFloat))
         {
           currentKeyValid = true;
           break;
@@ -2,57 +2,116 @@
 
 #include "Sensor.hpp"
 
+#ifndef MAX_NUM_ALL_SENSORS
+#define MAX_NUM_ALL_SENSORS 10
+#endif
+
 struct ConfigSensors {
-  enum { MAX_NUM_SENSORS = 10 };
+  enum {
+    MAX_NUM_SENSORS = MAX_NUM_ALL_SENSORS,
+    MAX_PERIOD_MS = 3600000,
+    MAX_STATS_WINDOW_S = 3600,
+    MAX_COMPRESSION = 1000, ///< hundredths of a degree
+  };
   int16_t numAllSensors = 0;          // TODO: make this private and add accessors
   Sensor allSensors[MAX_NUM_SENSORS]; // TODO: make this private and create accessors
+  bool tableFull = false;             ///< a OneWire sensor found did not fit (not persisted)
 
+  /**
+   * Update name, active, period_ms, resolution, stats_window_s and/or compression_24h of a sensor from json input
+   * @return true if validation OK and data (if any) updated. On error, no fields are updated
+   */
   bool patchSingleSensor(int sensorIndex, char const * jsonString) {
     // TODO: move in patching from web server code (which was accessing one sensor at a time)
-    const size_t capacity = JSON_OBJECT_SIZE(2) + 200;
+    const size_t capacity = JSON_OBJECT_SIZE(6) + 200;
     StaticJsonDocument<capacity> root;
     DeserializationError error = deserializeJson(root, jsonString);
-    
     if (error)
     {
       Serial.println("Parsing failed!");
-      server.send(400, "text/plain", "ERROR"); // TODO: which status code???
       return false;
     }
-    else 
+
+    Sensor next = allSensors[sensorIndex];
+    if (!patch(next, root.as<JsonObject>())) {
+      return false;
+    }
+    allSensors[sensorIndex] = next;
+    return true;
+  }
+
+  /**
+   * Update several sensors at once from {"sensors":[{"id":"...", <fields as for patchSingleSensor()>}, ...]}
+   * @return true if all changes validated and were made. On error (an unknown id as well), none is made
+   */
+  bool patchSensors(char const * jsonString) {
+    // One sensor at a time, as in restore(): a document for all of them would not fit on the stack of the request handler.
+    // All of them are checked (a first pass over the list) before the first one is changed (a second one)
+    StaticJsonDocument<JSON_OBJECT_SIZE(8) + 200> json;
+    for (int pass = 0; pass < 2; pass++)
     {
-      if (root.containsKey("name"))
-      {
-        strncpy(allSensors[sensorIndex].name, root["name"].as<char*>(), sizeof(allSensors[sensorIndex].name));
-        allSensors[sensorIndex].name[sizeof(allSensors[sensorIndex].name) - 1] = '\0';
-      }
-      if (root.containsKey("active"))
+      TextStream changes(jsonString);
+      bool valid = forEachSensor(changes, json, [&](JsonObject change) {
+        int i = change["id"].is<const char*>() ? find(change["id"].as<const char*>()) : -1;
+        if (i < 0) {
+          return false;
+        }
+        Sensor next = allSensors[i];
+        if (!patch(next, change)) {
+          return false;
+        }
+        if (pass == 1) {
+          allSensors[i] = next;
+        }
+        return true;
+      });
+      if (!valid)
       {
-        allSensors[sensorIndex].active = (root["active"].as<int>() == 0) ? false : true;
+        Serial.println("Parsing failed!");
+        return false;
       }
-
-      
-      return true;
-      // No idea what to do...
     }
+    return true;
   }
-  bool save()
+
+  /** @return index of the sensor with that id (16 hex digits, any case), -1 if there is none */
+  int find(char const * id) const
   {
-    String s = R"EOF({"sensors":[)EOF";
-    for (int i = 0; i < numAllSensors; i++)
+    int low = 0;
+    int high = numAllSensors;
+    while (low < high)
     {
-      if (i != 0) { s += ", "; }
-      s += sensorToString(i);
+      int mid = (low + high) / 2;
+      int cmp = strncasecmp(id, allSensors[_byId[mid]].id, sizeof(allSensors[0].id));
+      if (cmp == 0) {
+        return _byId[mid];
+      }
+      if (cmp < 0) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
     }
-    s += "]}\n";
-    
+    return -1;
+  }
+  bool save()
+  {
     File configFile = SPIFFS.open("/config/sensors", "w");
     if (!configFile) {
       Serial.println("file open failed");
       return false;
     }
 
-    size_t written = configFile.println(s.c_str());
+    // Written piece by piece, no need to hold the whole file in RAM
+    size_t written = configFile.print(R"EOF({"sensors":[)EOF");
+    for (int i = 0; i < numAllSensors; i++)
+    {
+      char buf[200];
+      sensorToString(buf, i);
+      if (i != 0) { written += configFile.print(", "); }
+      written += configFile.print(buf);
+    }
+    written += configFile.println("]}\n");
     if (!written) {
       Serial.println("not written");
       configFile.close();
@@ -68,69 +127,117 @@ struct ConfigSensors {
     // This will be a bit odd, as we populate the detected ones, and then patch them with saved names and "active" flags from flash
     populateAllOneWireSensors();
     populateAllAdcChannels(); // Additionally, we reserve some for adc measurements of NTC resistors.
+    indexIds();
+    _modified = false;
+    return restore();
+  }
 
+  /** Patch the saved name, "active" flag etc onto the sensor with index onlySensor (one found later), or all when -1 */
+  bool restore(int onlySensor = -1) {
     File configFile = SPIFFS.open("/config/sensors", "r");
     if (!configFile) {
       Serial.println("not found");
       return false;
     }
-  
-    size_t size = configFile.size();
-    if (size > 2048) {
-      Serial.println("too large");
-      return false;
-    }
-  
-    String buf = configFile.readString();
+
+    // One sensor at a time straight from the file, so that neither the file nor a document for all
+    // of it has to be on the stack (this runs from the loop, next to the request handlers)
+    int first = onlySensor < 0 ? 0 : onlySensor;
+    int last = onlySensor < 0 ? numAllSensors : onlySensor + 1;
+    const size_t capacity = JSON_OBJECT_SIZE(8) + 200;
+    StaticJsonDocument<capacity> json;
+    bool read = forEachSensor(configFile, json, [&](JsonObject sensor) {
+      char const* keys[] = {"id", "type", "name", "active", nullptr};
+      char const** it = keys;
+      bool configIsComplete = true;
+      while (*it) {
+        if (!sensor.containsKey(*it)) {
+          Serial.printf("missing key sensor[].%s", *it);
+          configIsComplete = false;
+        }
+        it++;
+      }
+      if (!configIsComplete)
+      {
+        // Skip loading "active" flag and "name" for sensors with broken configuration
+        return true;
+      }
+
+      int i = find(sensor["id"].as<const char*>());
+      if (i >= first && i < last)
+      {
+        allSensors[i].active = sensor["active"].as<int>();
+        strncpy(allSensors[i].name, sensor["name"].as<const char*>(), sizeof(allSensors[i].name));
+        // Not in files saved by older versions: those keep the defaults
+        if (sensor.containsKey("period_ms")) { setPeriod(allSensors[i], sensor["period_ms"].as<JsonVariant>()); }
+        if (sensor.containsKey("resolution")) { setResolution(allSensors[i], sensor["resolution"].as<JsonVariant>()); }
+        if (sensor.containsKey("stats_window_s")) { setStatsWindow(allSensors[i], sensor["stats_window_s"].as<JsonVariant>()); }
+        if (sensor.containsKey("compression_24h")) { setCompression(allSensors[i], sensor["compression_24h"].as<JsonVariant>()); }
+      }
+      return true;
+    });
     configFile.close();
-  
-    StaticJsonDocument<2048> json;
-    DeserializationError error = deserializeJson(json, buf.c_str());
-    if (error) {
+    if (!read) {
       Serial.println("deserialize fail");
-      return false;
     }
+    return read;
+  }
 
-    if (json.containsKey("sensors") && json["sensors"].is<JsonArray>())
+  /**
+   * Add a OneWire sensor found on the bus after power on, after the known ones (their indices stay).
+   * When full, the entry of a sensor that is gone and has no settings of its own (hasDefaultSettings())
+   * is reused, so that saving the settings loses nothing.
+   * @return its index, -1 (and tableFull set) if there is no room
+   */
+  int addOneWireSensor(DeviceAddress const & address)
+  {
+    int i = numAllSensors;
+    if (i >= MAX_NUM_SENSORS)
     {
-      JsonArray arr = json["sensors"];
-      for (JsonObject sensor : arr)
+      for (i = 0; i < numAllSensors && (allSensors[i].present || !hasDefaultSettings(allSensors[i])); i++)
       {
-        char const* keys[] = {"id", "type", "name", "active", nullptr};
-        char const** it = keys;
-        bool configIsComplete = true;
-        while (*it) {
-          if (!sensor.containsKey(*it)) {
-            Serial.printf("missing key sensor[].%s", *it);
-            configIsComplete = false;
-          }
-          it++;
-        }
-        if (!configIsComplete)
-        {
-          // Skip loading "active" flag and "name" for sensors with broken configuration
-          continue;
-        }
-
-        for (int i = 0; i < numAllSensors; i++)
-        {
-          if (strncasecmp(sensor["id"].as<const char*>(), allSensors[i].id, sizeof(allSensors[i].id)) == 0) // TODO: should this be case sensitive?
-          {
-            allSensors[i].active = sensor["active"].as<int>();
-            strncpy(allSensors[i].name, sensor["name"].as<const char*>(), sizeof(allSensors[i].name));
-            break;
-          }
-        }
+      }
+      if (i == numAllSensors)
+      {
+        tableFull = true;
+        return -1;
       }
     }
-    _modified = false;
-    return true;
+    int numOneWire = 0;
+    for (int j = 0; j < numAllSensors; j++)
+    {
+      numOneWire += (j != i && allSensors[j].type == Sensor::Type::OneWire) ? 1 : 0;
+    }
+    Sensor & s = allSensors[i];
+    s = {};
+    s.type = Sensor::Type::OneWire;
+    s.index = numOneWire;
+    memcpy(s.deviceAddress, address, sizeof(s.deviceAddress));
+    deviceAddressToString(s.deviceAddress, s.id);
+    snprintf(s.name, sizeof(s.name), "Sensor%d", s.index);
+    if (i == numAllSensors) {
+      numAllSensors++;
+    }
+    indexIds();
+    return i;
+  }
+
+  /** @return true if nothing of the sensor was set by the user: not active, and the name and settings it was added with */
+  static bool hasDefaultSettings(Sensor const & s)
+  {
+    Sensor const defaults;
+    char name[sizeof(s.name)];
+    snprintf(name, sizeof(name), "Sensor%d", s.index);
+    return !s.active && strcmp(s.name, name) == 0 && s.periodMs == defaults.periodMs &&
+           s.resolution == defaults.resolution && s.statsWindowS == defaults.statsWindowS &&
+           s.compression24h == defaults.compression24h;
   }
 
     void populateAllSensors()
     {
         populateAllOneWireSensors();
         populateAllAdcChannels();
+        indexIds();
     }
 
     void populateAllOneWireSensors()
@@ -146,10 +253,15 @@ struct ConfigSensors {
             allSensors[i].index = i;
             memset(allSensors[i].deviceAddress, 0, sizeof(allSensors[i].deviceAddress));
             sensors.getAddress(allSensors[i].deviceAddress, i);
-            strncpy(allSensors[i].id, deviceAddressToString(allSensors[i].deviceAddress).c_str(), sizeof(allSensors[i].id));
+            deviceAddressToString(allSensors[i].deviceAddress, allSensors[i].id);
             snprintf(allSensors[i].name, sizeof(allSensors[i].name), "Sensor%d", allSensors[i].index);
             allSensors[i].type = Sensor::Type::OneWire;
             allSensors[i].active = false;
+            allSensors[i].periodMs = Sensor().periodMs;
+            allSensors[i].resolution = Sensor().resolution;
+            allSensors[i].statsWindowS = Sensor().statsWindowS;
+            allSensors[i].compression24h = Sensor().compression24h;
+            allSensors[i].present = true;
             allSensors[i].lastValue = 0;
         }
     }
@@ -174,7 +286,7 @@ struct ConfigSensors {
         s.type = Sensor::Type::NTC;
         s.index = ntcIndexToAdcChannelMap[i];
         s.active = false;
-        snprintf(s.id, sizeof(s.id), "000000000000000%d", s.index);
+        snprintf(s.id, sizeof(s.id), "%016d", int(s.index));
         snprintf(s.name, sizeof(s.name), "NTC-%d", i);
         s.lastValue = 0;
         numAllSensors++;
@@ -197,21 +309,153 @@ struct ConfigSensors {
     bool isModified() const { return _modified; }
     private:
     bool _modified;
-    String sensorToString(int allSensorIndex)
+    int8_t _byId[MAX_NUM_SENSORS]; ///< allSensors indices sorted by id, for find()
+
+    /** Sorts _byId, after sensors have been added (insertion sort: a handful, mostly in order already) */
+    void indexIds()
     {
-        String id;
-        if (allSensors[allSensorIndex].type == Sensor::Type::OneWire)
+      for (int i = 0; i < numAllSensors; i++)
+      {
+        int j = i;
+        for (; j > 0 && strncasecmp(allSensors[i].id, allSensors[_byId[j - 1]].id, sizeof(allSensors[i].id)) < 0; j--)
         {
-            id = deviceAddressToString(allSensors[allSensorIndex].deviceAddress);
+          _byId[j] = _byId[j - 1];
         }
-        else if (allSensors[allSensorIndex].type == Sensor::Type::NTC)
-        {
-            id = String("000000000000000") + String(allSensors[allSensorIndex].index);
+        _byId[j] = i;
+      }
+    }
+
+    /**
+     * Reads {"sensors":[{...}, {...}]} from in one sensor object at a time (into json), passing each to f
+     * @return false if in is not such a list, or as soon as f returns false
+     */
+    template<class F>
+    static bool forEachSensor(Stream & in, JsonDocument & json, F f)
+    {
+      if (!in.find("\"sensors\"") || !skipTo(in, ':') || !skipTo(in, '[')) {
+        return false;
+      }
+      bool more = !skipTo(in, ']');
+      while (more)
+      {
+        if (deserializeJson(json, in)) {
+          return false;
+        }
+        more = in.findUntil(",", "]");
+        if (!f(json.as<JsonObject>())) {
+          return false;
         }
-        String s = "{\"id\":\"" + id +
-        "\", \"type\":\"" + toString(allSensors[allSensorIndex].type) +
-        "\", \"name\":\"" + allSensors[allSensorIndex].name +
-        "\", \"active\":" + (allSensors[allSensorIndex].active ? "1" : "0") + "}";
-        return s;
+      }
+      return true;
+    }
+
+    /** Skips white space. @return true if c follows (and was read) */
+    static bool skipTo(Stream & in, char c)
+    {
+      while (isspace(in.peek())) {
+        in.read();
+      }
+      if (in.peek() != c) {
+        return false;
+      }
+      in.read();
+      return true;
+    }
+
+    /** A string to read as a Stream (without copying it) */
+    class TextStream : public Stream
+    {
+    public:
+      explicit TextStream(char const * text) : _next(text) { setTimeout(0); }
+      int available() override { return strlen(_next); }
+      int read() override { return *_next ? (unsigned char)*_next++ : -1; }
+      int peek() override { return *_next ? (unsigned char)*_next : -1; }
+      size_t write(uint8_t) override { return 0; }
+    private:
+      char const * _next;
+    };
+
+    /** Applies the fields present in change to sensor. @return false if one is invalid (sensor is then partly changed) */
+    static bool patch(Sensor & sensor, JsonObject change)
+    {
+      if (change.containsKey("name"))
+      {
+        strncpy(sensor.name, change["name"].as<char*>(), sizeof(sensor.name));
+        sensor.name[sizeof(sensor.name) - 1] = '\0';
+      }
+      if (change.containsKey("active"))
+      {
+        sensor.active = (change["active"].as<int>() == 0) ? false : true;
+      }
+      if (change.containsKey("period_ms") && !setPeriod(sensor, change["period_ms"].as<JsonVariant>())) { return false; }
+      if (change.containsKey("resolution") && !setResolution(sensor, change["resolution"].as<JsonVariant>())) { return false; }
+      if (change.containsKey("stats_window_s") && !setStatsWindow(sensor, change["stats_window_s"].as<JsonVariant>())) { return false; }
+      if (change.containsKey("compression_24h") && !setCompression(sensor, change["compression_24h"].as<JsonVariant>())) { return false; }
+      return true;
+    }
+    void sensorToString(char (&buf)[200], int allSensorIndex) const
+    {
+        Sensor const & sensor = allSensors[allSensorIndex];
+        snprintf(buf, sizeof(buf), "{\"id\":\"%s\", \"type\":\"%s\", \"name\":\"%s\", \"active\":%d, \"period_ms\":%lu, \"resolution\":%d, "
+                 "\"stats_window_s\":%u, \"compression_24h\":%.2f}",
+                 sensor.id, toString(sensor.type), sensor.name, sensor.active ? 1 : 0,
+                 (unsigned long)sensor.periodMs, sensor.resolution, sensor.statsWindowS, sensor.compression24h / 100.0f);
+    }
+
+    /** Sampled each whole number of sample timer ticks, at most once an hour */
+    static bool setPeriod(Sensor & sensor, JsonVariant value)
+    {
+      if (!value.is<long>()) {
+        return false;
+      }
+      long ms = value.as<long>();
+      if (ms < long(sample_tick_ms) || ms > MAX_PERIOD_MS || ms % sample_tick_ms != 0) {
+        return false;
+      }
+      sensor.periodMs = ms;
+      return true;
+    }
+
+    /** 9 - 12 bits for a DS18B20 (conversions take 94 - 750 ms), the MCP3208 only does 12 */
+    static bool setResolution(Sensor & sensor, JsonVariant value)
+    {
+      if (!value.is<int>()) {
+        return false;
+      }
+      int bits = value.as<int>();
+      if (sensor.type == Sensor::Type::OneWire ? (bits < 9 || bits > 12) : bits != 12) {
+        return false;
+      }
+      sensor.resolution = bits;
+      return true;
+    }
+
+    /** Whole 1h reading periods, at most an hour (all the 1h readings there are) */
+    static bool setStatsWindow(Sensor & sensor, JsonVariant value)
+    {
+      if (!value.is<long>()) {
+        return false;
+      }
+      long s = value.as<long>();
+      long period = time_between_1h_readings_ms / 1000;
+      if (s < period || s > MAX_STATS_WINDOW_S || s % period != 0) {
+        return false;
+      }
+      sensor.statsWindowS = s;
+      return true;
+    }
+
+    /** Degrees the 24h readings may be off when stored compressed, 0 (stored in full) - 10 */
+    static bool setCompression(Sensor & sensor, JsonVariant value)
+    {
+      if (!value.is<float>()) {
+        return false;
+      }
+      long c = lroundf(value.as<float>() * 100);
+      if (c < 0 || c > MAX_COMPRESSION) {
+        return false;
+      }
+      sensor.compression24h = c;
+      return true;
     }
 } configSensors;
@@ -27,7 +27,7 @@ struct ConfigSoftAP
     {
       return false;
     }
-    strncpy(_ssid, str.c_str(), sizeof(_ssid));
+    memcpy(_ssid, str.c_str(), str.length() + 1);
     _modified = true;
     return true;
   }
@@ -39,7 +39,7 @@ struct ConfigSoftAP
     {
       return false;
     }
-    strncpy(_password, str.c_str(), sizeof(_password));
+    memcpy(_password, str.c_str(), str.length() + 1);
     _modified = true;
     return true;
   }
@@ -146,6 +146,10 @@ struct ConfigSoftAP
   {
     StaticJsonDocument<512> root;
     DeserializationError error = deserializeJson(root, jsonString);
+    if (error) {
+      Serial.println("deserial err");
+      return false;
+    }
     
     char const* keys[] = {"ip", "gateway", "subnet", "ssid", "password", nullptr};
     for (JsonPair const & kv : root.as<JsonObject>())
@@ -187,8 +191,8 @@ struct ConfigSoftAP
     return other._ip == _ip &&
            other._gateway == _gateway &&
            other._subnet == _subnet &&
-           other._ssid == _ssid &&
-           other._password == _password;
+           strcmp(other._ssid, _ssid) == 0 &&
+           strcmp(other._password, _password) == 0;
   }
 
 private:
@@ -0,0 +1,171 @@
+#pragma once
+
+/** SNTP server the wall clock is synchronized with (optional, see WallClock.hpp) */
+struct ConfigTime
+{
+  ConfigTime() :
+    _enabled(false),
+    _server{"pool.ntp.org"},
+    _modified(false)
+  { /* no code */ }
+
+  bool getEnabled() const { return _enabled; }
+  bool setEnabled(bool enabled) { _modified = true; _enabled = enabled; return true;}
+
+  /** IP address or host name, optionally followed by :port (e.g. a local stand-in) */
+  const char* getServer() const { return _server; }
+  bool setServer(String const & str)
+  {
+    int colon = str.indexOf(':');
+    long port = colon > 0 ? atol(str.c_str() + colon + 1) : 1;
+    if (colon == 0 || port < 1 || port > 65535 || strpbrk(str.c_str(), "\"\\ "))
+    {
+      return false;
+    }
+    return setString(str, _server, 1);
+  }
+
+  bool isModified() const { return _modified; };
+
+  /** Save values to flash */
+  bool save()
+  {
+    StaticJsonDocument<256> json;
+    json["enabled"] = int(_enabled);
+    json["server"] = _server;
+
+    char response[256] = {};
+    size_t toWrite = serializeJson(json, response, sizeof(response));
+
+    if (!toWrite || toWrite >= sizeof(response))
+    {
+      Serial.println("too much");
+      return false;
+    }
+
+    File configFile = SPIFFS.open("/config/time", "w");
+    if (!configFile) {
+      Serial.println("file open failed");
+      return false;
+    }
+
+    size_t written = configFile.println(response);
+    if (!written) {
+      Serial.println("not written");
+      configFile.close();
+      return false;
+    }
+    configFile.close();
+
+    _modified = false;
+    return true;
+  }
+
+  /** Load values from flash */
+  bool load()
+  {
+    File configFile = SPIFFS.open("/config/time", "r");
+    if (!configFile) {
+      Serial.println("not found");
+      return false;
+    }
+
+    size_t size = configFile.size();
+    if (size > 1024) {
+      Serial.println("too large");
+      return false;
+    }
+
+    String buf = configFile.readString();
+    configFile.close();
+
+    StaticJsonDocument<256> json;
+    DeserializationError error = deserializeJson(json, buf.c_str());
+    if (error) {
+      Serial.println("deserialize fail");
+      return false;
+    }
+    {
+      char const* keys[] = {"enabled", "server", nullptr};
+      char const** it = keys;
+      while (*it) {
+        if (!json.containsKey(*it)) {
+          Serial.printf("missing key %s", *it);
+          return false;
+        }
+        it++;
+      }
+    }
+
+    ConfigTime next;
+    if (next.setEnabled(json["enabled"].as<int>()) &&
+        next.setServer(json["server"].as<const char*>()))
+    {
+      next._modified = false;
+      *this = next;
+      return true;
+    }
+    Serial.println("malformed?");
+    return false;
+  }
+
+  /** Update zero or more elements provided in json input
+      @return true if validation OK and data (if any) updated. On error, no fields are updated
+   */
+  bool patch(char const * jsonString)
+  {
+    StaticJsonDocument<256> root;
+    DeserializationError error = deserializeJson(root, jsonString);
+    if (error) {
+      Serial.println("deserial err");
+      return false;
+    }
+
+    for (JsonPair const & kv : root.as<JsonObject>())
+    {
+      bool isString = kv.value().is<char const*>() || kv.value().is<char*>();
+      bool isInt = kv.value().is<int>();
+      bool currentKeyValid = (strcmp(kv.key().c_str(), "enabled") == 0 && isInt) ||
+                             (strcmp(kv.key().c_str(), "server") == 0 && isString);
+      if (!currentKeyValid) {
+        Serial.printf("invalid key %s: ", kv.key().c_str());
+        return false;
+      }
+    }
+
+    ConfigTime next = *this;
+    if (root.containsKey("enabled") && !next.setEnabled(root["enabled"].as<int>())) { return false; }
+    if (root.containsKey("server") && !next.setServer(root["server"].as<char*>())) { return false; }
+
+    next._modified = _modified;
+    if (next == *this)
+    {
+      return true;
+    }
+    *this = next;
+    _modified = true;
+    return true;
+  }
+
+  bool operator==(ConfigTime const& other) const {
+    return other._enabled == _enabled &&
+           strcmp(other._server, _server) == 0;
+  }
+
+private:
+  template<size_t N>
+  bool setString(String const & str, char (&dest)[N], unsigned int minLength)
+  {
+    if (str.length() < minLength || str.length() >= N)
+    {
+      return false;
+    }
+    memcpy(dest, str.c_str(), str.length() + 1);
+    _modified = true;
+    return true;
+  }
+
+  bool _enabled;
+  char _server[64];
+  bool _modified;
+};
@@ -0,0 +1,546 @@
+#pragma once
+
+#include <string.h>
+
+/**
+ * Streaming gzip (RFC 1952) encoder for generated responses, with a small fixed window.
+ *
+ * The input is taken piece by piece from a generator, written straight into the window, and
+ * compressed into one deflate block (RFC 1951) per piece. Matches are found through one hash
+ * table entry per 3 byte prefix (the latest position with it, no chains), within the last
+ * WINDOW_SIZE to 2 * WINDOW_SIZE bytes. Each piece is parsed twice: once to count the symbols and
+ * build Huffman codes for them, once to write them, with those codes or the fixed ones (RFC 1951
+ * 3.2.6), whichever comes out shorter. Readings ("20.34,20.36,...") are mostly digits, which
+ * the codes built for them take about half the bits of the fixed ones for.
+ *
+ * About 3 kB per encoder, statically: the window and the hash table. The tables used while a
+ * piece is compressed (some 5 kB) are shared by all encoders. Nothing is allocated.
+ */
+class GzipEncoder {
+public:
+  enum {
+    WINDOW_SIZE = 1024,
+    HASH_BITS = 9,
+    OVERHEAD = 32, ///< output on top of 9 bits per byte of input, at most: gzip header, trailer and bits pending
+  };
+
+  /** Output room needed to compress count bytes of input in one go (see compress()) */
+  static constexpr size_t outputSize(size_t count) { return count + count / 8 + 1 + OVERHEAD; }
+
+  /** Starts a new stream */
+  void begin()
+  {
+    _state = HEADER;
+    _end = 0;
+    _bits = 0;
+    _numBits = 0;
+    _crc = 0xffffffff;
+    _inputSize = 0;
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+      _head[i] = EMPTY;
+    }
+  }
+
+  /**
+   * Writes the next part of the compressed stream to out: generate(char* buf, size_t size) is
+   * called for input until some output is due (buf has room for count bytes, count <= WINDOW_SIZE,
+   * if size >= outputSize(count)). It returns the bytes written to buf, 0 at the end, after which
+   * the stream is closed.
+   * @return bytes written to out (at most size), 0 once the stream is complete
+   */
+  template<class Generate>
+  size_t compress(uint8_t* out, size_t size, Generate generate)
+  {
+    _out = out;
+    _outLength = 0;
+    if (_state == HEADER)
+    {
+      static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff}; // deflate, no name, no time, unknown OS
+      memcpy(out, header, sizeof(header));
+      _outLength = sizeof(header);
+      _state = DATA;
+    }
+    size_t headerLength = _outLength;
+    while (_state == DATA && _outLength == headerLength)
+    {
+      if (sizeof(_buf) - _end < WINDOW_SIZE) {
+        slide();
+      }
+      size_t room = min(sizeof(_buf) - _end, maxInput(size)); // the header is part of OVERHEAD
+      size_t n = generate(reinterpret_cast<char*>(_buf + _end), room);
+      if (n == 0)
+      {
+        finish();
+        break;
+      }
+      updateCrc(_buf + _end, n);
+      _inputSize += n;
+      size_t start = _end;
+      _end += n;
+      encodeBlock(start);
+    }
+    return _outLength;
+  }
+
+private:
+  enum State : uint8_t { HEADER, DATA, DONE };
+  enum {
+    MIN_MATCH = 3,
+    MAX_MATCH = 258,
+    EMPTY = 0xffff,
+    NUM_LITERAL_CODES = 288,  ///< literals, end of block, lengths (the last two only make up the fixed code)
+    NUM_DISTANCE_CODES = 30,
+    NUM_LENGTH_CODES = 19,    ///< of the code lengths
+    MAX_CODE_LENGTH = 15,
+    MAX_LENGTH_CODE_LENGTH = 7,
+  };
+
+  /** What a block is written with, built while it is compressed (shared, one block at a time) */
+  struct Codes {
+    uint16_t literalCount[NUM_LITERAL_CODES];
+    uint16_t distanceCount[NUM_DISTANCE_CODES];
+    uint8_t literalLength[NUM_LITERAL_CODES];
+    uint8_t distanceLength[NUM_DISTANCE_CODES];
+    uint16_t literalCode[NUM_LITERAL_CODES]; ///< bit reversed, ready for putBits()
+    uint16_t distanceCode[NUM_DISTANCE_CODES];
+    uint16_t lengthCount[NUM_LENGTH_CODES];
+    uint8_t lengthLength[NUM_LENGTH_CODES];
+    uint16_t lengthCode[NUM_LENGTH_CODES];
+    uint8_t lengths[NUM_LITERAL_CODES + NUM_DISTANCE_CODES]; ///< of the literal and distance codes, as sent
+    uint8_t runs[NUM_LITERAL_CODES + NUM_DISTANCE_CODES];    ///< lengths, run length encoded (code lengths 0 - 18)
+    uint8_t runExtra[NUM_LITERAL_CODES + NUM_DISTANCE_CODES];
+    int numRuns;
+    struct Symbol { uint16_t count; uint16_t symbol; } sorted[NUM_LITERAL_CODES];
+    uint16_t head[1 << HASH_BITS]; ///< the hash table before the first pass over the block
+  };
+
+  static Codes & codes()
+  {
+    static Codes c;
+    return c;
+  }
+
+  /** Input that compresses into size bytes of output, in the worst case (all literals, 9 bits each) */
+  static size_t maxInput(size_t size) { return size > OVERHEAD ? (size - OVERHEAD) * 8 / 9 : 0; }
+
+  /** Keeps the last WINDOW_SIZE bytes of input, at the start of the window */
+  void slide()
+  {
+    uint16_t shift = uint16_t(_end - WINDOW_SIZE);
+    memmove(_buf, _buf + shift, WINDOW_SIZE);
+    _end = WINDOW_SIZE;
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+      _head[i] = (_head[i] != EMPTY && _head[i] >= shift) ? uint16_t(_head[i] - shift) : uint16_t(EMPTY);
+    }
+  }
+
+  uint16_t hash(size_t p) const
+  {
+    uint32_t v = _buf[p] | (uint32_t(_buf[p + 1]) << 8) | (uint32_t(_buf[p + 2]) << 16);
+    return uint16_t((v * 2654435761u) >> (32 - HASH_BITS));
+  }
+
+  /** Compresses the input from start on into a block (matches may reach back into what is before) */
+  void encodeBlock(size_t start)
+  {
+    Codes & c = codes();
+    memcpy(c.head, _head, sizeof(_head));
+    memset(c.literalCount, 0, sizeof(c.literalCount));
+    memset(c.distanceCount, 0, sizeof(c.distanceCount));
+    parse(start, false);
+    c.literalCount[256] = 1; // end of block
+
+    buildLengths(c.literalCount, NUM_LITERAL_CODES, MAX_CODE_LENGTH, c.literalLength);
+    buildLengths(c.distanceCount, NUM_DISTANCE_CODES, MAX_CODE_LENGTH, c.distanceLength);
+    int numLiteralCodes = NUM_LITERAL_CODES;
+    while (numLiteralCodes > 257 && c.literalLength[numLiteralCodes - 1] == 0) {
+      numLiteralCodes--;
+    }
+    int numDistanceCodes = NUM_DISTANCE_CODES;
+    while (numDistanceCodes > 1 && c.distanceLength[numDistanceCodes - 1] == 0) {
+      numDistanceCodes--;
+    }
+    encodeLengths(numLiteralCodes, numDistanceCodes);
+    buildLengths(c.lengthCount, NUM_LENGTH_CODES, MAX_LENGTH_CODE_LENGTH, c.lengthLength);
+    static const uint8_t lengthOrder[NUM_LENGTH_CODES] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    int numLengthCodes = NUM_LENGTH_CODES;
+    while (numLengthCodes > 4 && c.lengthLength[lengthOrder[numLengthCodes - 1]] == 0) {
+      numLengthCodes--;
+    }
+
+    // Bits of the block either way, but for the extra bits of lengths and distances (the same)
+    uint32_t fixedBits = 0;
+    uint32_t dynamicBits = 5 + 5 + 4 + 3 * numLengthCodes;
+    for (int i = 0; i < NUM_LITERAL_CODES; i++) {
+      fixedBits += c.literalCount[i] * fixedLiteralLength(i);
+      dynamicBits += c.literalCount[i] * c.literalLength[i];
+    }
+    for (int i = 0; i < NUM_DISTANCE_CODES; i++) {
+      fixedBits += c.distanceCount[i] * 5;
+      dynamicBits += c.distanceCount[i] * c.distanceLength[i];
+    }
+    for (int i = 0; i < NUM_LENGTH_CODES; i++) {
+      dynamicBits += c.lengthCount[i] * (c.lengthLength[i] + (i == 16 ? 2 : i == 17 ? 3 : i == 18 ? 7 : 0));
+    }
+
+    putBits(0, 1); // not the last block (that is an empty one, see finish())
+    if (dynamicBits < fixedBits)
+    {
+      putBits(2, 2);
+      putBits(numLiteralCodes - 257, 5);
+      putBits(numDistanceCodes - 1, 5);
+      putBits(numLengthCodes - 4, 4);
+      for (int i = 0; i < numLengthCodes; i++) {
+        putBits(c.lengthLength[lengthOrder[i]], 3);
+      }
+      buildCodes(c.lengthLength, NUM_LENGTH_CODES, c.lengthCode);
+      for (int i = 0; i < c.numRuns; i++)
+      {
+        uint8_t r = c.runs[i];
+        putBits(c.lengthCode[r], c.lengthLength[r]);
+        if (r >= 16) {
+          putBits(c.runExtra[i], r == 16 ? 2 : r == 17 ? 3 : 7);
+        }
+      }
+    }
+    else
+    {
+      putBits(1, 2);
+      useFixedCodes();
+    }
+    buildCodes(c.literalLength, NUM_LITERAL_CODES, c.literalCode);
+    buildCodes(c.distanceLength, NUM_DISTANCE_CODES, c.distanceCode);
+
+    memcpy(_head, c.head, sizeof(_head));
+    parse(start, true);
+    putBits(c.literalCode[256], c.literalLength[256]);
+  }
+
+  /** Finds the literals and matches from start on: counts them in codes(), or writes them with its codes */
+  void parse(size_t start, bool write)
+  {
+    Codes & c = codes();
+    size_t candidate = 0;
+    size_t length = findMatch(start, candidate);
+    for (size_t p = start; p < _end; )
+    {
+      if (length >= MIN_MATCH)
+      {
+        // A longer match from the next byte on makes this one a literal
+        size_t nextCandidate = 0;
+        size_t nextLength = findMatch(p + 1, nextCandidate);
+        if (nextLength <= length)
+        {
+          putMatch(length, p - candidate, write);
+          for (size_t q = p + 2; q < p + length && q + MIN_MATCH <= _end; q++) {
+            _head[hash(q)] = uint16_t(q);
+          }
+          p += length;
+          length = findMatch(p, candidate);
+          continue;
+        }
+        length = nextLength;
+        candidate = nextCandidate;
+      }
+      else
+      {
+        length = findMatch(p + 1, candidate);
+      }
+      if (write) {
+        putBits(c.literalCode[_buf[p]], c.literalLength[_buf[p]]);
+      } else {
+        c.literalCount[_buf[p]]++;
+      }
+      p++;
+    }
+  }
+
+  /** @return length of the match for the input from p on (0 if none), entering p into the hash table */
+  size_t findMatch(size_t p, size_t & candidate)
+  {
+    if (p + MIN_MATCH > _end) {
+      return 0;
+    }
+    uint16_t h = hash(p);
+    candidate = _head[h];
+    _head[h] = uint16_t(p);
+    if (candidate == EMPTY) {
+      return 0;
+    }
+    size_t limit = min(size_t(MAX_MATCH), _end - p);
+    size_t length = 0;
+    while (length < limit && _buf[candidate + length] == _buf[p + length]) {
+      length++;
+    }
+    return length;
+  }
+
+  void putMatch(size_t length, size_t distance, bool write)
+  {
+    static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                              257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                              8193, 12289, 16385, 24577};
+    Codes & c = codes();
+    int l = 28;
+    while (lengthBase[l] > length) {
+      l--;
+    }
+    int d = 29;
+    while (distanceBase[d] > distance) {
+      d--;
+    }
+    if (!write)
+    {
+      c.literalCount[257 + l]++;
+      c.distanceCount[d]++;
+      return;
+    }
+    putBits(c.literalCode[257 + l], c.literalLength[257 + l]);
+    putBits(length - lengthBase[l], lengthExtra[l]);
+    putBits(c.distanceCode[d], c.distanceLength[d]);
+    putBits(distance - distanceBase[d], d < 4 ? 0 : d / 2 - 1);
+  }
+
+  static int fixedLiteralLength(int symbol) { return symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8; }
+
+  static void useFixedCodes()
+  {
+    Codes & c = codes();
+    for (int i = 0; i < NUM_LITERAL_CODES; i++) {
+      c.literalLength[i] = fixedLiteralLength(i);
+    }
+    memset(c.distanceLength, 5, sizeof(c.distanceLength));
+  }
+
+  /**
+   * Huffman code lengths (at most maxLength) for symbols counted count times, 0 for those not
+   * counted. There are at least two codes (a single one would not make a complete code).
+   */
+  static void buildLengths(uint16_t const * count, int numSymbols, int maxLength, uint8_t* length)
+  {
+    Codes::Symbol* a = codes().sorted;
+    int n = 0;
+    for (int i = 0; i < numSymbols; i++) {
+      if (count[i] > 0) {
+        a[n++] = {count[i], uint16_t(i)};
+      }
+    }
+    for (int i = 0; n < 2; i++) {
+      if (count[i] == 0) {
+        a[n++] = {1, uint16_t(i)};
+      }
+    }
+    // Least counted first (insertion sort, there are a few dozen of them)
+    for (int i = 1; i < n; i++)
+    {
+      Codes::Symbol s = a[i];
+      int j = i;
+      for (; j > 0 && a[j - 1].count > s.count; j--) {
+        a[j] = a[j - 1];
+      }
+      a[j] = s;
+    }
+
+    // In place (Moffat and Katajainen): the counts become the parents of the tree nodes, their depths, then the code lengths
+    a[0].count += a[1].count;
+    int root = 0;
+    int leaf = 2;
+    for (int next = 1; next < n - 1; next++)
+    {
+      if (leaf >= n || a[root].count < a[leaf].count) {
+        a[next].count = a[root].count;
+        a[root++].count = uint16_t(next);
+      } else {
+        a[next].count = a[leaf++].count;
+      }
+      if (leaf >= n || (root < next && a[root].count < a[leaf].count)) {
+        a[next].count += a[root].count;
+        a[root++].count = uint16_t(next);
+      } else {
+        a[next].count += a[leaf++].count;
+      }
+    }
+    a[n - 2].count = 0;
+    for (int next = n - 3; next >= 0; next--) {
+      a[next].count = a[a[next].count].count + 1;
+    }
+    int available = 1;
+    int used = 0;
+    int depth = 0;
+    root = n - 2;
+    int next = n - 1;
+    while (available > 0)
+    {
+      while (root >= 0 && a[root].count == depth) {
+        used++;
+        root--;
+      }
+      while (available > used) {
+        a[next--].count = uint16_t(depth);
+        available--;
+      }
+      available = 2 * used;
+      depth++;
+      used = 0;
+    }
+
+    // Longer codes than maxLength are made maxLength, then others longer until the code is complete again
+    int numCodes[MAX_CODE_LENGTH + 1] = {};
+    for (int i = 0; i < n; i++) {
+      numCodes[min(int(a[i].count), maxLength)]++;
+    }
+    uint32_t total = 0;
+    for (int i = 1; i <= maxLength; i++) {
+      total += uint32_t(numCodes[i]) << (maxLength - i);
+    }
+    while (total > (1u << maxLength))
+    {
+      numCodes[maxLength]--;
+      for (int i = maxLength - 1; i > 0; i--) {
+        if (numCodes[i] > 0) {
+          numCodes[i]--;
+          numCodes[i + 1] += 2;
+          break;
+        }
+      }
+      total--;
+    }
+
+    memset(length, 0, numSymbols);
+    int j = 0;
+    for (int l = maxLength; l > 0; l--) {
+      for (int k = numCodes[l]; k > 0; k--) {
+        length[a[j++].symbol] = uint8_t(l);
+      }
+    }
+  }
+
+  /** Canonical codes of the lengths (RFC 1951 3.2.2), bit reversed: Huffman codes go most significant bit first */
+  static void buildCodes(uint8_t const * length, int numSymbols, uint16_t* code)
+  {
+    uint16_t next[MAX_CODE_LENGTH + 1] = {};
+    uint16_t numCodes[MAX_CODE_LENGTH + 1] = {};
+    for (int i = 0; i < numSymbols; i++) {
+      numCodes[length[i]]++;
+    }
+    numCodes[0] = 0;
+    for (int l = 1; l <= MAX_CODE_LENGTH; l++) {
+      next[l] = uint16_t((next[l - 1] + numCodes[l - 1]) << 1);
+    }
+    for (int i = 0; i < numSymbols; i++)
+    {
+      uint16_t v = next[length[i]]++;
+      uint16_t reversed = 0;
+      for (int b = 0; b < length[i]; b++) {
+        reversed = uint16_t((reversed << 1) | ((v >> b) & 1));
+      }
+      code[i] = reversed;
+    }
+  }
+
+  /** Run length encodes the code lengths (RFC 1951 3.2.7) into codes().runs, counting the symbols */
+  static void encodeLengths(int numLiteralCodes, int numDistanceCodes)
+  {
+    Codes & c = codes();
+    int n = numLiteralCodes + numDistanceCodes;
+    memcpy(c.lengths, c.literalLength, numLiteralCodes);
+    memcpy(c.lengths + numLiteralCodes, c.distanceLength, numDistanceCodes);
+    memset(c.lengthCount, 0, sizeof(c.lengthCount));
+    c.numRuns = 0;
+    auto put = [&c](uint8_t symbol, uint8_t extra) {
+      c.runs[c.numRuns] = symbol;
+      c.runExtra[c.numRuns++] = extra;
+      c.lengthCount[symbol]++;
+    };
+    for (int i = 0; i < n; )
+    {
+      uint8_t l = c.lengths[i];
+      int run = 1;
+      while (i + run < n && c.lengths[i + run] == l) {
+        run++;
+      }
+      i += run;
+      if (l == 0)
+      {
+        for (; run >= 11; run -= min(run, 138)) {
+          put(18, uint8_t(min(run, 138) - 11));
+        }
+        if (run >= 3) {
+          put(17, uint8_t(run - 3));
+          run = 0;
+        }
+      }
+      else
+      {
+        put(l, 0);
+        run--;
+        for (; run >= 3; run -= min(run, 6)) {
+          put(16, uint8_t(min(run, 6) - 3));
+        }
+      }
+      for (; run > 0; run--) {
+        put(l, 0);
+      }
+    }
+  }
+
+  /** Ends the deflate stream with an empty last block, then the gzip trailer */
+  void finish()
+  {
+    putBits(1, 1); // last block
+    putBits(1, 2); // fixed codes
+    putBits(0, 7); // end of block
+    if (_numBits > 0) {
+      putBits(0, 8 - _numBits);
+    }
+    uint32_t trailer[2] = {_crc ^ 0xffffffff, _inputSize};
+    for (uint32_t v : trailer) {
+      for (int i = 0; i < 4; i++) {
+        _out[_outLength++] = uint8_t(v >> (8 * i));
+      }
+    }
+    _state = DONE;
+  }
+
+  void putBits(uint32_t value, int count)
+  {
+    _bits |= value << _numBits;
+    _numBits += count;
+    while (_numBits >= 8)
+    {
+      _out[_outLength++] = uint8_t(_bits);
+      _bits >>= 8;
+      _numBits -= 8;
+    }
+  }
+
+  void updateCrc(uint8_t const * data, size_t length)
+  {
+    static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+    uint32_t crc = _crc;
+    for (size_t i = 0; i < length; i++)
+    {
+      crc ^= data[i];
+      crc = (crc >> 4) ^ table[crc & 15];
+      crc = (crc >> 4) ^ table[crc & 15];
+    }
+    _crc = crc;
+  }
+
+  uint8_t _buf[2 * WINDOW_SIZE]; ///< input, the window behind the new part
+  uint16_t _head[1 << HASH_BITS]; ///< latest position of each 3 byte prefix hash
+  size_t _end = 0;                ///< of the input in _buf
+  uint32_t _bits = 0;             ///< not yet written, _numBits of them
+  int _numBits = 0;
+  uint32_t _crc = 0xffffffff;
+  uint32_t _inputSize = 0;
+  State _state = DONE;
+  uint8_t* _out = nullptr;        ///< while compress() runs
+  size_t _outLength = 0;
+};
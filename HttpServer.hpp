@@ -0,0 +1,1020 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h> // HTTPMethod, CONTENT_LENGTH_UNKNOWN
+#include <FS.h>
+
+#include "GzipEncoder.hpp"
+
+/**
+ * HTTP/1.1 server for several concurrent clients, polled from loop().
+ *
+ * ESP8266WebServer serves one connection at a time and blocks until the whole response
+ * is written, so one slow client downloading the 24h readings stalls every other client
+ * and the next sample. This server keeps up to MAX_CONNECTIONS connections open
+ * (keep-alive), and only writes as much as the TCP stack takes without blocking. Each
+ * connection has a bounded send buffer; files and generated responses are produced
+ * piece by piece as the client drains it, so a slow client only slows down itself.
+ *
+ * Handlers use the request / response interface of ESP8266WebServer (uri(), arg(),
+ * send(), streamFile(), ...). A response passed to send() that does not fit into the
+ * send buffer is written out blocking, as ESP8266WebServer would; large responses
+ * should be generated with sendGenerated() instead.
+ *
+ * Request bodies have to fit into the receive buffer, except for routes added with
+ * onUpload(): their POST bodies are passed to an upload handler piece by piece as they
+ * arrive (see Upload), so firmware images can be written to flash without holding them.
+ *
+ * Generated responses, and those passed to send() of at least MIN_COMPRESSED_LENGTH, are
+ * gzip compressed on the fly for clients that accept it (Accept-Encoding), as long as one
+ * of the MAX_GZIP_STREAMS encoders is free; otherwise they go out as they are.
+ *
+ * All buffers are allocated statically, serving requests does not use the heap.
+ */
+class HttpServer
+{
+public:
+  enum {
+    MAX_CONNECTIONS = 3,       ///< some 3.3 kB of RAM each (the receive and send buffers)
+    MAX_ROUTES = 24,
+    MAX_ARGS = 8,
+    RECEIVE_BUFFER_SIZE = 1536,
+    SEND_BUFFER_SIZE = 1536,
+    MAX_EXTRA_HEADERS_SIZE = 256,
+    MAX_GZIP_STREAMS = 1,      ///< responses compressed at a time (a GzipEncoder each, some 3 kB)
+    MIN_COMPRESSED_LENGTH = 512, ///< shorter responses passed to send() are not worth compressing
+    MIN_GENERATOR_ROOM = 256,  ///< space a generator gets at least
+    IDLE_TIMEOUT_MS = 5000,    ///< keep-alive connections without a request are closed after this
+    REQUEST_TIMEOUT_MS = 5000, ///< for receiving a complete request
+    SEND_TIMEOUT_MS = 20000,   ///< without progress sending, before the client is dropped
+  };
+
+  typedef void (*THandlerFunction)();
+
+  /** Per connection state of a generated response (see sendGenerated()) */
+  struct StreamState {
+    alignas(4) uint8_t data[16];
+
+    template<typename T>
+    T & as() {
+      static_assert(sizeof(T) <= sizeof(data), "stream state too large");
+      return *reinterpret_cast<T*>(data);
+    }
+  };
+
+  /**
+   * Produces the next part of a generated response.
+   * @return number of bytes written to buf (at most size, and size is at least MIN_GENERATOR_ROOM),
+   *         0 when the response is complete
+   */
+  typedef size_t (*TGenerator)(char* buf, size_t size, StreamState & state);
+
+  /**
+   * A POST body streamed to an upload handler (see onUpload()).
+   *
+   * The handler is called with START once the headers are in (request headers, arguments
+   * and authenticate() are only available then), with WRITE for each piece of the body,
+   * and with END when all of it (Content-Length) has arrived, after which the route's
+   * handler sends the response. ABORTED replaces END if the client goes away first.
+   *
+   * An upload handler that sends a response at START rejects the upload: the body is read
+   * and dropped (no more calls), then that response is sent and the connection closed.
+   */
+  struct Upload {
+    enum Status { START, WRITE, END, ABORTED };
+    Status status;
+    size_t totalSize;    ///< Content-Length of the body
+    size_t received;     ///< bytes of the body before data
+    const uint8_t* data; ///< WRITE only
+    size_t length;
+  };
+
+  typedef void (*TUploadHandler)(Upload const & upload);
+
+  explicit HttpServer(uint16_t port) : _server(port) {}
+
+  void begin()
+  {
+    _uri.reserve(64);
+    _server.begin();
+    _server.setNoDelay(true);
+  }
+
+  void on(const char* uri, THandlerFunction fn) { addRoute(uri, fn, nullptr, false); }
+
+  /** As on(), with POST bodies streamed to upload (any size) rather than collected in the receive buffer */
+  void onUpload(const char* uri, THandlerFunction fn, TUploadHandler upload) { addRoute(uri, fn, upload, false); }
+
+  /** As on(), for every path starting with prefix (e.g. "/api/sensors/" for /api/sensors/<id>) that no other route matches exactly */
+  void onPrefix(const char* prefix, THandlerFunction fn) { addRoute(prefix, fn, nullptr, true); }
+
+  void onNotFound(THandlerFunction fn) { _notFoundHandler = fn; }
+
+  /** Accept new connections, read requests, run handlers and move responses along. Never blocks. */
+  void handleClients()
+  {
+    acceptNewClients();
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+      Connection & c = _connections[i];
+      if (c.state == Connection::READING) {
+        receive(c);
+      }
+      if (c.state == Connection::RECEIVING_BODY) {
+        receiveBody(c);
+      }
+      if (c.state == Connection::SENDING) {
+        transmit(c);
+      }
+    }
+  }
+
+  /** @return true while a response is being sent or an upload received (the caller might want to poll more often) */
+  bool isBusy() const
+  {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+      if (_connections[i].state == Connection::SENDING || _connections[i].state == Connection::RECEIVING_BODY) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int numConnections() const
+  {
+    int n = 0;
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+      n += _connections[i].state != Connection::FREE;
+    }
+    return n;
+  }
+
+  // Request, valid while a handler runs
+
+  String const & uri() const { return _uri; }
+  HTTPMethod method() const { return _method; }
+  int args() const { return _numArgs; }
+  String argName(int i) const { return (i >= 0 && i < _numArgs) ? String(_args[i].name) : String(); }
+  String arg(int i) const { return (i >= 0 && i < _numArgs) ? String(_args[i].value) : String(); }
+
+  /** "plain" is the request body (as with ESP8266WebServer) */
+  String arg(const char* name) const
+  {
+    const char* value = argPtr(name);
+    return String(value ? value : "");
+  }
+
+  bool hasArg(const char* name) const { return argPtr(name) != nullptr; }
+
+  /** @return value of a query argument or, for "plain", the request body, nullptr if not present */
+  const char* argPtr(const char* name) const
+  {
+    if (strcmp(name, "plain") == 0) {
+      return _body;
+    }
+    for (int i = 0; i < _numArgs; i++) {
+      if (strcmp(_args[i].name, name) == 0) {
+        return _args[i].value;
+      }
+    }
+    return nullptr;
+  }
+
+  /** Value of a request header (case insensitive name), empty if not present */
+  String header(const char* name) const
+  {
+    char value[128];
+    return headerValue(name, value, sizeof(value)) ? String(value) : String();
+  }
+
+  bool hasHeader(const char* name) const
+  {
+    char value[1];
+    return headerValue(name, value, sizeof(value));
+  }
+
+  /** @return true if the client takes gzip compressed responses (Accept-Encoding) */
+  bool acceptsGzip() const
+  {
+    char value[96];
+    if (!headerValue("Accept-Encoding", value, sizeof(value))) {
+      return false;
+    }
+    for (char* coding = strtok(value, ","); coding; coding = strtok(nullptr, ","))
+    {
+      while (*coding == ' ') {
+        coding++;
+      }
+      if (strncasecmp(coding, "gzip", 4) != 0 || (coding[4] != '\0' && coding[4] != ';' && coding[4] != ' ')) {
+        continue;
+      }
+      const char* q = strstr(coding, "q=");
+      return !q || strtod(q + 2, nullptr) > 0;
+    }
+    return false;
+  }
+
+  /** @return true if the request carries HTTP basic authentication with these credentials */
+  bool authenticate(const char* username, const char* password) const
+  {
+    char value[128];
+    if (!headerValue("Authorization", value, sizeof(value)) || strncasecmp(value, "Basic ", 6) != 0) {
+      return false;
+    }
+    char credentials[100];
+    int n = snprintf(credentials, sizeof(credentials), "%s:%s", username, password);
+    if (n < 0 || size_t(n) >= sizeof(credentials)) {
+      return false;
+    }
+    char expected[sizeof(value)];
+    if (!base64Encode(reinterpret_cast<const uint8_t*>(credentials), n, expected, sizeof(expected))) {
+      return false;
+    }
+    // Compare all of it, whatever matches, to not tell by the response time how much did
+    const char* given = value + 6;
+    size_t length = strlen(expected);
+    uint8_t difference = strlen(given) != length;
+    for (size_t i = 0; i < length; i++) {
+      difference |= uint8_t(given[i] ^ expected[i]);
+      if (given[i] == '\0') {
+        break;
+      }
+    }
+    return difference == 0;
+  }
+
+  /** Respond 401, asking for HTTP basic authentication */
+  void requestAuthentication(const char* realm)
+  {
+    char value[64];
+    snprintf(value, sizeof(value), "Basic realm=\"%s\"", realm);
+    sendHeader("WWW-Authenticate", value);
+    send(401, "text/plain", "Authentication required\n");
+  }
+
+  // Response
+
+  void setContentLength(size_t contentLength) { _contentLength = contentLength; }
+
+  void sendHeader(const char* name, const char* value)
+  {
+    size_t len = strlen(_extraHeaders);
+    snprintf(_extraHeaders + len, sizeof(_extraHeaders) - len, "%s: %s\r\n", name, value);
+  }
+
+  void send(int code, const char* contentType, const String & content) { send(code, contentType, content.c_str(), content.length()); }
+  void send(int code, const char* contentType, const char* content) { send(code, contentType, content, strlen(content)); }
+
+  void send(int code, const char* contentType, const char* content, size_t length)
+  {
+    if (!_current) {
+      return;
+    }
+    if (_contentLength == CONTENT_LENGTH_NOT_SET && length >= MIN_COMPRESSED_LENGTH && acceptsGzip())
+    {
+      GzipEncoder* gzip = acquireGzip();
+      if (gzip)
+      {
+        sendHeader("Content-Encoding", "gzip");
+        sendHeader("Vary", "Accept-Encoding");
+        sendResponseHeader(*_current, code, contentType, CONTENT_LENGTH_UNKNOWN);
+        uint8_t out[GzipEncoder::outputSize(MIN_GENERATOR_ROOM)];
+        size_t n;
+        while ((n = gzip->compress(out, sizeof(out), [&](char* buf, size_t size) {
+                  size = min(size, length);
+                  memcpy(buf, content, size);
+                  content += size;
+                  length -= size;
+                  return size;
+                })) > 0) {
+          sendContent(reinterpret_cast<const char*>(out), n);
+        }
+        sendContent("", 0);
+        releaseGzip(gzip);
+        return;
+      }
+    }
+    if (_contentLength == CONTENT_LENGTH_UNKNOWN) {
+      sendResponseHeader(*_current, code, contentType, CONTENT_LENGTH_UNKNOWN);
+      if (length) {
+        sendContent(content, length);
+      }
+      return;
+    }
+    sendResponseHeader(*_current, code, contentType, _contentLength == CONTENT_LENGTH_NOT_SET ? length : _contentLength);
+    queue(*_current, content, length);
+  }
+
+  /** Send a chunk of a response started with setContentLength(CONTENT_LENGTH_UNKNOWN). Empty content ends it. */
+  void sendContent(const String & content) { sendContent(content.c_str(), content.length()); }
+
+  void sendContent(const char* content, size_t length)
+  {
+    if (!_current || !_current->chunked) {
+      if (_current) {
+        queue(*_current, content, length);
+      }
+      return;
+    }
+    char head[12];
+    int n = snprintf(head, sizeof(head), "%x\r\n", (unsigned)length);
+    queue(*_current, head, n);
+    queue(*_current, content, length);
+    queue(*_current, "\r\n", 2);
+    if (length == 0) {
+      _current->chunked = false; // that was the last one
+    }
+  }
+
+  /** Send a file, read as the client takes it. The file is closed when done. */
+  size_t streamFile(File & file, const char* contentType)
+  {
+    if (!_current) {
+      return 0;
+    }
+    size_t size = file.size();
+    sendResponseHeader(*_current, 200, contentType, size);
+    _current->file = file;
+    return size;
+  }
+
+  /**
+   * Send a response (chunked) produced by generator as the client takes it. The generator
+   * is called with the state given here until it returns 0.
+   */
+  void sendGenerated(int code, const char* contentType, TGenerator generator, StreamState const & state)
+  {
+    if (!_current) {
+      return;
+    }
+    if (acceptsGzip() && (_current->gzip = acquireGzip()) != nullptr)
+    {
+      sendHeader("Content-Encoding", "gzip");
+      sendHeader("Vary", "Accept-Encoding");
+    }
+    sendResponseHeader(*_current, code, contentType, CONTENT_LENGTH_UNKNOWN);
+    _current->chunked = false; // chunks are framed in transmit()
+    _current->generator = generator;
+    _current->streamState = state;
+  }
+
+private:
+  struct Route {
+    const char* uri;
+    THandlerFunction fn;
+    TUploadHandler upload;
+    bool prefix; ///< matches the paths starting with uri
+  };
+
+  struct Arg {
+    const char* name;
+    const char* value;
+  };
+
+  struct Connection {
+    enum State { FREE, READING, RECEIVING_BODY, SENDING };
+    State state = FREE;
+    WiFiClient client;
+    unsigned long lastActivity = 0;
+
+    char rx[RECEIVE_BUFFER_SIZE];
+    size_t rxLength = 0;
+    size_t requestLength = 0; ///< bytes of rx taken by the request being served
+
+    char tx[SEND_BUFFER_SIZE];
+    size_t txStart = 0;
+    size_t txEnd = 0;
+
+    bool keepAlive = false;
+    bool idle = false; ///< kept alive after a response, waiting for the next request
+    bool responseStarted = false;
+    bool chunked = false;
+    File file;
+    TGenerator generator = nullptr;
+    StreamState streamState;
+    GzipEncoder* gzip = nullptr; ///< compressing what generator produces
+
+    // Upload being received (RECEIVING_BODY)
+    Route const* uploadRoute = nullptr;
+    size_t bodyReceived = 0;
+    size_t bodyLength = 0;
+    bool uploadRejected = false; ///< the body is dropped, the response is waiting in tx
+  };
+
+  void acceptNewClients()
+  {
+    while (_server.hasClient()) {
+      Connection* slot = nullptr;
+      Connection* oldestIdle = nullptr;
+      for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        Connection & c = _connections[i];
+        if (c.state == Connection::FREE) {
+          slot = &c;
+          break;
+        }
+        if (c.state == Connection::READING && c.idle && c.rxLength == 0 &&
+            (!oldestIdle || (long)(c.lastActivity - oldestIdle->lastActivity) < 0)) {
+          oldestIdle = &c;
+        }
+      }
+      if (!slot && oldestIdle) {
+        // Make room for the new client rather than keeping an idle keep-alive connection
+        closeConnection(*oldestIdle);
+        slot = oldestIdle;
+      }
+      if (!slot) {
+        return; // stays in the backlog until a connection is done
+      }
+      slot->client = _server.available();
+      if (!slot->client) {
+        return;
+      }
+      slot->state = Connection::READING;
+      slot->idle = false;
+      slot->rxLength = 0;
+      slot->lastActivity = millis();
+    }
+  }
+
+  void closeConnection(Connection & c)
+  {
+    if (c.state == Connection::RECEIVING_BODY && !c.uploadRejected) {
+      Upload upload = {Upload::ABORTED, c.bodyLength, c.bodyReceived, nullptr, 0};
+      c.uploadRoute->upload(upload);
+    }
+    c.uploadRoute = nullptr;
+    c.client.stop();
+    if (c.file) {
+      c.file.close();
+    }
+    c.file = File();
+    c.generator = nullptr;
+    releaseGzip(c.gzip);
+    c.gzip = nullptr;
+    c.state = Connection::FREE;
+    c.rxLength = 0;
+    c.txStart = c.txEnd = 0;
+  }
+
+  void receive(Connection & c)
+  {
+    int available = c.client.available();
+    if (available > 0 && c.rxLength < sizeof(c.rx)) {
+      int n = c.client.read(reinterpret_cast<uint8_t*>(c.rx + c.rxLength), sizeof(c.rx) - c.rxLength);
+      if (n > 0) {
+        c.rxLength += n;
+        c.idle = false;
+        c.lastActivity = millis();
+      }
+    }
+    else if (!c.client.connected()) {
+      closeConnection(c);
+      return;
+    }
+
+    if (c.rxLength > 0) {
+      processRequest(c);
+    }
+    else if (millis() - c.lastActivity > IDLE_TIMEOUT_MS) {
+      closeConnection(c);
+    }
+  }
+
+  /** Serve the request in c.rx if it is complete */
+  void processRequest(Connection & c)
+  {
+    char* headerEnd = findHeaderEnd(c.rx, c.rxLength);
+    if (!headerEnd) {
+      if (c.rxLength == sizeof(c.rx)) {
+        sendErrorAndClose(c, 431, "Request header too large");
+      } else if (millis() - c.lastActivity > REQUEST_TIMEOUT_MS) {
+        closeConnection(c);
+      }
+      return;
+    }
+    size_t headerLength = headerEnd + 4 - c.rx;
+    char* lineEnd = (char*)memchr(c.rx, '\r', headerLength);
+    _headers = lineEnd + 2;
+    _headersEnd = headerEnd;
+
+    // The request stays untouched until the body is in too (it is parsed in place)
+    size_t contentLength = 0;
+    char value[16];
+    bool hasContentLength = headerValue("Content-Length", value, sizeof(value));
+    if (hasContentLength) {
+      contentLength = strtoul(value, nullptr, 10);
+    }
+    Route const* uploadRoute = findUploadRoute(c.rx, lineEnd);
+    if (uploadRoute) {
+      if (!hasContentLength) {
+        sendErrorAndClose(c, 411, "Content-Length required");
+        return;
+      }
+    }
+    else if (headerLength + contentLength + 1 > sizeof(c.rx)) {
+      sendErrorAndClose(c, 413, "Request too large");
+      return;
+    }
+    if (!uploadRoute && c.rxLength < headerLength + contentLength) {
+      if (millis() - c.lastActivity > REQUEST_TIMEOUT_MS) {
+        closeConnection(c);
+      }
+      return; // wait for the rest of the body
+    }
+
+    // Request line
+    char* method = c.rx;
+    char* uri = (char*)memchr(method, ' ', headerLength);
+    char* version = uri ? (char*)memchr(uri + 1, ' ', headerEnd - uri - 1) : nullptr;
+    if (!uri || !version || version > lineEnd) {
+      sendErrorAndClose(c, 400, "Bad request");
+      return;
+    }
+    *uri++ = '\0';
+    *version++ = '\0';
+    *lineEnd = '\0';
+
+    c.keepAlive = strcmp(version, "HTTP/1.1") == 0;
+    if (headerValue("Connection", value, sizeof(value))) {
+      if (strcasecmp(value, "close") == 0) {
+        c.keepAlive = false;
+      } else if (strcasecmp(value, "keep-alive") == 0) {
+        c.keepAlive = true;
+      }
+    }
+
+    if (uploadRoute) {
+      startUpload(c, *uploadRoute, method, uri, headerLength, contentLength);
+      return;
+    }
+
+    // The body is terminated in place, the byte after it (start of a pipelined request) restored afterwards
+    c.requestLength = headerLength + contentLength;
+    char savedByte = c.rx[c.requestLength];
+    c.rx[c.requestLength] = '\0';
+    _body = contentLength > 0 ? c.rx + headerLength : nullptr;
+
+    parseTarget(method, uri);
+    dispatch(c);
+
+    c.rx[c.requestLength] = savedByte;
+    _headers = _headersEnd = nullptr;
+    _body = nullptr;
+    _numArgs = 0;
+  }
+
+  void parseTarget(const char* method, char* uri)
+  {
+    _method = parseMethod(method);
+    _numArgs = 0;
+    char* query = strchr(uri, '?');
+    if (query) {
+      *query++ = '\0';
+      parseArguments(query);
+    }
+    urlDecode(uri);
+    _uri = uri;
+  }
+
+  void addRoute(const char* uri, THandlerFunction fn, TUploadHandler upload, bool prefix)
+  {
+    if (_numRoutes < MAX_ROUTES) {
+      _routes[_numRoutes++] = {uri, fn, upload, prefix};
+    } else {
+      Serial.println("ERROR: too many routes");
+    }
+  }
+
+  /** Route with an upload handler for a "POST <path>[?query] ..." request line, without modifying it */
+  Route const* findUploadRoute(const char* requestLine, const char* lineEnd) const
+  {
+    if (strncmp(requestLine, "POST ", 5) != 0) {
+      return nullptr;
+    }
+    const char* path = requestLine + 5;
+    size_t length = 0;
+    while (path + length < lineEnd && path[length] != ' ' && path[length] != '?') {
+      length++;
+    }
+    for (int i = 0; i < _numRoutes; i++) {
+      if (_routes[i].upload && strncmp(_routes[i].uri, path, length) == 0 && _routes[i].uri[length] == '\0') {
+        return &_routes[i];
+      }
+    }
+    return nullptr;
+  }
+
+  /** Sets up the response state, handlers may send from here on */
+  void beginResponse(Connection & c)
+  {
+    _current = &c;
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+    _extraHeaders[0] = '\0';
+    c.responseStarted = false;
+    c.chunked = false;
+  }
+
+  void startUpload(Connection & c, Route const & route, const char* method, char* uri, size_t headerLength, size_t contentLength)
+  {
+    parseTarget(method, uri);
+    c.keepAlive = false; // the upload is what the connection was opened for
+    c.uploadRoute = &route;
+    c.bodyReceived = 0;
+    c.bodyLength = contentLength;
+    c.requestLength = 0;
+
+    beginResponse(c);
+    Upload upload = {Upload::START, contentLength, 0, nullptr, 0};
+    route.upload(upload);
+    c.uploadRejected = c.responseStarted;
+    _current = nullptr;
+    _headers = _headersEnd = nullptr;
+    _numArgs = 0;
+
+    // What arrived with the headers is the start of the body
+    c.rxLength -= headerLength;
+    memmove(c.rx, c.rx + headerLength, c.rxLength);
+    c.state = Connection::RECEIVING_BODY;
+    receiveBody(c);
+  }
+
+  /** Passes what has arrived of an upload body to the upload handler, and finishes the request when all is in */
+  void receiveBody(Connection & c)
+  {
+    size_t remaining = c.bodyLength - c.bodyReceived;
+    if (c.rxLength < remaining && c.rxLength < sizeof(c.rx)) {
+      int available = c.client.available();
+      if (available > 0) {
+        int n = c.client.read(reinterpret_cast<uint8_t*>(c.rx + c.rxLength), min(sizeof(c.rx) - c.rxLength, remaining - c.rxLength));
+        if (n > 0) {
+          c.rxLength += n;
+          c.lastActivity = millis();
+        }
+      }
+      else if (!c.client.connected() || millis() - c.lastActivity > REQUEST_TIMEOUT_MS) {
+        closeConnection(c);
+        return;
+      }
+    }
+
+    size_t n = min(c.rxLength, remaining);
+    if (n > 0) {
+      if (!c.uploadRejected) {
+        Upload upload = {Upload::WRITE, c.bodyLength, c.bodyReceived, reinterpret_cast<const uint8_t*>(c.rx), n};
+        c.uploadRoute->upload(upload);
+      }
+      c.bodyReceived += n;
+      c.rxLength -= n;
+      memmove(c.rx, c.rx + n, c.rxLength);
+    }
+    if (c.bodyReceived < c.bodyLength) {
+      return;
+    }
+
+    Route const & route = *c.uploadRoute;
+    c.uploadRoute = nullptr;
+    c.state = Connection::SENDING;
+    if (c.uploadRejected) {
+      return; // the response is waiting in tx
+    }
+    Upload upload = {Upload::END, c.bodyLength, c.bodyReceived, nullptr, 0};
+    route.upload(upload);
+    dispatch(c, route.fn);
+  }
+
+  void dispatch(Connection & c)
+  {
+    THandlerFunction fn = nullptr;
+    for (int i = 0; i < _numRoutes && !fn; i++) {
+      if (!_routes[i].prefix && strcmp(_routes[i].uri, _uri.c_str()) == 0) {
+        fn = _routes[i].fn;
+      }
+    }
+    for (int i = 0; i < _numRoutes && !fn; i++) {
+      if (_routes[i].prefix && strncmp(_routes[i].uri, _uri.c_str(), strlen(_routes[i].uri)) == 0) {
+        fn = _routes[i].fn;
+      }
+    }
+    dispatch(c, fn ? fn : _notFoundHandler);
+  }
+
+  void dispatch(Connection & c, THandlerFunction fn)
+  {
+    beginResponse(c);
+    c.state = Connection::SENDING;
+    if (fn) {
+      fn();
+    }
+    if (!c.responseStarted) {
+      send(500, "text/plain", "No response");
+    }
+    if (c.chunked) {
+      sendContent("", 0); // handler did not end the chunked response
+    }
+    _current = nullptr;
+    c.lastActivity = millis();
+  }
+
+  void transmit(Connection & c)
+  {
+    // Fill the send buffer
+    size_t room = sizeof(c.tx) - c.txEnd;
+    if (c.file && room > 0) {
+      size_t n = c.file.read(reinterpret_cast<uint8_t*>(c.tx + c.txEnd), room);
+      c.txEnd += n;
+      if (n == 0 || !c.file.available()) {
+        c.file.close();
+        c.file = File();
+      }
+    }
+    else if (c.generator && room >= (c.gzip ? GzipEncoder::outputSize(MIN_GENERATOR_ROOM) : MIN_GENERATOR_ROOM) + 8) {
+      // Chunk framing around what the generator produces: 4 hex digits + CRLF, data, CRLF
+      char* chunk = c.tx + c.txEnd;
+      size_t n;
+      if (c.gzip) {
+        n = c.gzip->compress(reinterpret_cast<uint8_t*>(chunk + 6), room - 8, [&c](char* buf, size_t size) {
+          return c.generator(buf, size, c.streamState);
+        });
+      } else {
+        n = c.generator(chunk + 6, room - 8, c.streamState);
+      }
+      if (n > 0) {
+        char head[7];
+        snprintf(head, sizeof(head), "%04x\r\n", (unsigned)n);
+        memcpy(chunk, head, 6);
+        chunk[6 + n] = '\r';
+        chunk[7 + n] = '\n';
+        c.txEnd += n + 8;
+      } else {
+        memcpy(chunk, "0\r\n\r\n", 5);
+        c.txEnd += 5;
+        c.generator = nullptr;
+        releaseGzip(c.gzip);
+        c.gzip = nullptr;
+      }
+    }
+
+    // Hand as much to the TCP stack as it takes without blocking
+    if (c.txEnd > c.txStart) {
+      int canWrite = c.client.availableForWrite();
+      if (canWrite > 0) {
+        size_t n = c.client.write(reinterpret_cast<const uint8_t*>(c.tx + c.txStart), min(size_t(canWrite), c.txEnd - c.txStart));
+        if (n > 0) {
+          c.txStart += n;
+          c.lastActivity = millis();
+        }
+      }
+      if (c.txStart == c.txEnd) {
+        c.txStart = c.txEnd = 0;
+      } else if (c.txStart > 0 && (c.file || c.generator)) {
+        memmove(c.tx, c.tx + c.txStart, c.txEnd - c.txStart);
+        c.txEnd -= c.txStart;
+        c.txStart = 0;
+      }
+    }
+
+    if (!c.client.connected() || millis() - c.lastActivity > SEND_TIMEOUT_MS) {
+      closeConnection(c);
+      return;
+    }
+
+    if (c.txEnd == 0 && !c.file && !c.generator) {
+      // Response complete
+      if (!c.keepAlive) {
+        closeConnection(c);
+        return;
+      }
+      c.rxLength -= c.requestLength;
+      memmove(c.rx, c.rx + c.requestLength, c.rxLength);
+      c.requestLength = 0;
+      c.state = Connection::READING;
+      c.idle = true;
+      c.lastActivity = millis();
+      if (c.rxLength > 0) {
+        processRequest(c); // pipelined
+      }
+    }
+  }
+
+  void sendResponseHeader(Connection & c, int code, const char* contentType, size_t contentLength)
+  {
+    if (c.responseStarted) {
+      return;
+    }
+    c.responseStarted = true;
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n", code, statusText(code),
+                     contentType ? contentType : "text/html");
+    if (contentLength == CONTENT_LENGTH_UNKNOWN) {
+      c.chunked = true;
+      n += snprintf(head + n, sizeof(head) - n, "Transfer-Encoding: chunked\r\n");
+    } else {
+      n += snprintf(head + n, sizeof(head) - n, "Content-Length: %u\r\n", (unsigned)contentLength);
+    }
+    queue(c, head, n);
+    queue(c, _extraHeaders, strlen(_extraHeaders));
+    const char* connection = c.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    queue(c, connection, strlen(connection));
+  }
+
+  /** @return a free encoder, begun, or nullptr if all are in use */
+  GzipEncoder* acquireGzip()
+  {
+    for (int i = 0; i < MAX_GZIP_STREAMS; i++) {
+      if (!_gzipInUse[i]) {
+        _gzipInUse[i] = true;
+        _gzip[i].begin();
+        return &_gzip[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void releaseGzip(GzipEncoder* gzip)
+  {
+    if (gzip) {
+      _gzipInUse[gzip - _gzip] = false;
+    }
+  }
+
+  /** Append to the send buffer, writing out blocking what does not fit */
+  void queue(Connection & c, const char* data, size_t length)
+  {
+    if (length <= sizeof(c.tx) - c.txEnd) {
+      memcpy(c.tx + c.txEnd, data, length);
+      c.txEnd += length;
+      return;
+    }
+    c.client.write(reinterpret_cast<const uint8_t*>(c.tx + c.txStart), c.txEnd - c.txStart);
+    c.txStart = c.txEnd = 0;
+    if (length <= sizeof(c.tx)) {
+      memcpy(c.tx, data, length);
+      c.txEnd = length;
+    } else {
+      c.client.write(reinterpret_cast<const uint8_t*>(data), length);
+    }
+  }
+
+  void sendErrorAndClose(Connection & c, int code, const char* message)
+  {
+    _current = &c;
+    c.state = Connection::SENDING;
+    c.keepAlive = false;
+    c.responseStarted = false;
+    c.requestLength = c.rxLength;
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+    _extraHeaders[0] = '\0';
+    send(code, "text/plain", message);
+    _current = nullptr;
+  }
+
+  /** Copies the value of header name into value (truncated to size). @return false if not present */
+  bool headerValue(const char* name, char* value, size_t size) const
+  {
+    size_t nameLength = strlen(name);
+    for (const char* line = _headers; line && line < _headersEnd; ) {
+      const char* end = (const char*)memchr(line, '\r', _headersEnd - line);
+      if (!end) {
+        end = _headersEnd;
+      }
+      if (size_t(end - line) > nameLength && line[nameLength] == ':' && strncasecmp(line, name, nameLength) == 0) {
+        const char* v = line + nameLength + 1;
+        while (v < end && *v == ' ') {
+          v++;
+        }
+        size_t n = min(size_t(end - v), size - 1);
+        memcpy(value, v, n);
+        value[n] = '\0';
+        return true;
+      }
+      line = end + 2;
+    }
+    return false;
+  }
+
+  void parseArguments(char* query)
+  {
+    while (*query && _numArgs < MAX_ARGS) {
+      char* next = strchr(query, '&');
+      if (next) {
+        *next++ = '\0';
+      }
+      char* value = strchr(query, '=');
+      if (value) {
+        *value++ = '\0';
+        urlDecode(value);
+      }
+      urlDecode(query);
+      _args[_numArgs].name = query;
+      _args[_numArgs].value = value ? value : query + strlen(query);
+      _numArgs++;
+      if (!next) {
+        break;
+      }
+      query = next;
+    }
+  }
+
+  static void urlDecode(char* s)
+  {
+    char* out = s;
+    for (char* in = s; *in; in++) {
+      if (*in == '+') {
+        *out++ = ' ';
+      } else if (*in == '%' && isxdigit(in[1]) && isxdigit(in[2])) {
+        char hex[3] = {in[1], in[2], 0};
+        *out++ = char(strtol(hex, nullptr, 16));
+        in += 2;
+      } else {
+        *out++ = *in;
+      }
+    }
+    *out = '\0';
+  }
+
+  /** @return false if out (with terminating zero) does not fit */
+  static bool base64Encode(const uint8_t* in, size_t length, char* out, size_t size)
+  {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    if ((length + 2) / 3 * 4 + 1 > size) {
+      return false;
+    }
+    for (size_t i = 0; i < length; i += 3) {
+      uint32_t v = uint32_t(in[i]) << 16;
+      if (i + 1 < length) v |= uint32_t(in[i + 1]) << 8;
+      if (i + 2 < length) v |= in[i + 2];
+      *out++ = alphabet[(v >> 18) & 63];
+      *out++ = alphabet[(v >> 12) & 63];
+      *out++ = i + 1 < length ? alphabet[(v >> 6) & 63] : '=';
+      *out++ = i + 2 < length ? alphabet[v & 63] : '=';
+    }
+    *out = '\0';
+    return true;
+  }
+
+  static char* findHeaderEnd(char* buf, size_t length)
+  {
+    for (size_t i = 0; i + 3 < length; i++) {
+      if (buf[i] == '\r' && buf[i + 1] == '\n' && buf[i + 2] == '\r' && buf[i + 3] == '\n') {
+        return buf + i;
+      }
+    }
+    return nullptr;
+  }
+
+  static HTTPMethod parseMethod(const char* method)
+  {
+    if (strcmp(method, "GET") == 0) return HTTP_GET;
+    if (strcmp(method, "HEAD") == 0) return HTTP_HEAD;
+    if (strcmp(method, "POST") == 0) return HTTP_POST;
+    if (strcmp(method, "PUT") == 0) return HTTP_PUT;
+    if (strcmp(method, "PATCH") == 0) return HTTP_PATCH;
+    if (strcmp(method, "DELETE") == 0) return HTTP_DELETE;
+    if (strcmp(method, "OPTIONS") == 0) return HTTP_OPTIONS;
+    return HTTP_ANY;
+  }
+
+  static const char* statusText(int code)
+  {
+    switch (code)
+    {
+      case 200: return "OK";
+      case 202: return "Accepted";
+      case 204: return "No Content";
+      case 400: return "Bad Request";
+      case 401: return "Unauthorized";
+      case 403: return "Forbidden";
+      case 404: return "Not Found";
+      case 405: return "Method Not Allowed";
+      case 409: return "Conflict";
+      case 411: return "Length Required";
+      case 413: return "Payload Too Large";
+      case 429: return "Too Many Requests";
+      case 431: return "Request Header Fields Too Large";
+      case 500: return "Internal Server Error";
+      case 503: return "Service Unavailable";
+      default: return "";
+    }
+  }
+
+  WiFiServer _server;
+  Connection _connections[MAX_CONNECTIONS];
+  Route _routes[MAX_ROUTES];
+  int _numRoutes = 0;
+  THandlerFunction _notFoundHandler = nullptr;
+
+  // The request being served
+  Connection* _current = nullptr;
+  String _uri;
+  HTTPMethod _method = HTTP_ANY;
+  Arg _args[MAX_ARGS];
+  int _numArgs = 0;
+  const char* _body = nullptr;
+  const char* _headers = nullptr;
+  const char* _headersEnd = nullptr;
+
+  size_t _contentLength = CONTENT_LENGTH_NOT_SET;
+  char _extraHeaders[MAX_EXTRA_HEADERS_SIZE] = {};
+
+  GzipEncoder _gzip[MAX_GZIP_STREAMS];
+  bool _gzipInUse[MAX_GZIP_STREAMS] = {};
+};
@@ -21,7 +21,8 @@ public:
         digitalWrite(MCP3208_CLK,LOW);
     }
 
-    int read(int channel)
+    /** Called from the sample timer interrupt (SampleTimer.hpp), so it and all it calls must be in IRAM / ROM (os_delay_us) */
+    IRAM_ATTR int read(int channel)
     {
         int adcvalue = 0;
         byte commandbits = B11000000; //command bits - start, mode, chn (3), dont care (3)
@@ -41,11 +42,11 @@ public:
         }
 
         digitalWrite(MCP3208_CLK, HIGH);    //ignores 2 null bits
-        delayMicroseconds(1);
+        os_delay_us(1);
         digitalWrite(MCP3208_CLK, LOW);
-        delayMicroseconds(1);
+        os_delay_us(1);
         digitalWrite(MCP3208_CLK, HIGH);
-        delayMicroseconds(1);
+        os_delay_us(1);
         digitalWrite(MCP3208_CLK, LOW);
 
         //read bits from adc
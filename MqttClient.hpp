@@ -0,0 +1,419 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+
+/**
+ * Minimal MQTT 3.1.1 client, publishing only (QoS 0), polled from loop().
+ *
+ * publish() only appends the packet to a send buffer; flush() hands everything queued
+ * since the last flush to the TCP stack at once, so the samples of one tick go out
+ * together (in one segment when they fit). Nothing is waited for: the CONNACK and
+ * PINGRESP are picked up by loop(), and when the broker can not be reached new attempts
+ * are made with exponential backoff. While not connected, publishes are dropped (QoS 0).
+ *
+ * The only blocking parts are the TCP connect, bounded by CONNECT_TIMEOUT_MS and done at
+ * most once per backoff period, and the DNS lookup if the broker is given by name, bounded
+ * by DNS_TIMEOUT_MS. The address is looked up once, and again only when attempts fail
+ * at the longest backoff (the broker may have moved).
+ *
+ * All buffers are allocated statically.
+ */
+class MqttClient
+{
+public:
+  enum {
+    SEND_BUFFER_SIZE = 1460,         ///< one TCP segment
+    DNS_TIMEOUT_MS = 1000,
+    CONNECT_TIMEOUT_MS = 250,        ///< a broker on the local network answers within milliseconds
+    CONNACK_TIMEOUT_MS = 5000,
+    KEEP_ALIVE_S = 60,
+    MIN_BACKOFF_MS = 1000,
+    MAX_BACKOFF_MS = 64000,
+  };
+
+  enum State { DISABLED, DISCONNECTED, WAIT_CONNACK, CONNECTED };
+
+  struct Stats {
+    uint32_t connects;   ///< sessions established
+    uint32_t failures;   ///< failed connection attempts and lost connections
+    uint32_t published;  ///< publishes handed to the TCP stack
+    uint32_t dropped;    ///< publishes dropped, not connected or no room in the send buffer
+  };
+
+  /**
+   * Connect (again) to a broker, or stop publishing if host is nullptr.
+   * The strings must stay valid while in use. The will message is published retained
+   * by the broker when the connection is lost.
+   */
+  void configure(const char* host, uint16_t port, const char* clientId, const char* username,
+                 const char* password, const char* willTopic, const char* willMessage)
+  {
+    disconnect();
+    _host = host;
+    _resolved = false;
+    _port = port;
+    _clientId = clientId;
+    _username = username;
+    _password = password;
+    _willTopic = willTopic;
+    _willMessage = willMessage;
+    _state = host ? DISCONNECTED : DISABLED;
+    _backoffMs = 0;
+    _lastAttemptMillis = millis();
+  }
+
+  State state() const { return _state; }
+  bool connected() const { return _state == CONNECTED; }
+  Stats const & stats() const { return _stats; }
+
+  /**
+   * Connection handling, call from loop().
+   * @return true once after a session has been established (time to publish retained state)
+   */
+  bool loop()
+  {
+    switch (_state)
+    {
+      case DISABLED:
+        return false;
+
+      case DISCONNECTED:
+        if (millis() - _lastAttemptMillis >= _backoffMs) {
+          connect();
+        }
+        return false;
+
+      case WAIT_CONNACK:
+      case CONNECTED:
+        if (!_client.connected()) {
+          connectionLost();
+          return false;
+        }
+        {
+          bool sessionStarted = receive();
+          if (_state == WAIT_CONNACK && millis() - _lastAttemptMillis >= CONNACK_TIMEOUT_MS) {
+            connectionLost();
+            return false;
+          }
+          if (_state == CONNECTED) {
+            keepAlive();
+            transmit();
+          }
+          return sessionStarted;
+        }
+    }
+    return false;
+  }
+
+  /**
+   * Queues a QoS 0 publish, sent by the next flush().
+   * @return false if dropped (not connected, or no room left in the send buffer)
+   */
+  bool publish(const char* topic, const char* payload, bool retain = false)
+  {
+    if (_state != CONNECTED) {
+      _stats.dropped++;
+      return false;
+    }
+    size_t topicLength = strlen(topic);
+    size_t payloadLength = strlen(payload);
+    size_t remaining = 2 + topicLength + payloadLength;
+    if (topicLength > 0xffff || _txEnd + 1 + remainingLengthSize(remaining) + remaining > sizeof(_tx)) {
+      _stats.dropped++;
+      return false;
+    }
+    _tx[_txEnd++] = 0x30 | (retain ? 0x01 : 0x00);
+    putRemainingLength(remaining);
+    putString(topic, topicLength);
+    memcpy(_tx + _txEnd, payload, payloadLength);
+    _txEnd += payloadLength;
+    _numQueued++;
+    return true;
+  }
+
+  /** @return true if a publish of topic and payload fits in the send buffer now */
+  bool hasRoomFor(const char* topic, const char* payload) const
+  {
+    size_t remaining = 2 + strlen(topic) + strlen(payload);
+    return _txEnd + 1 + remainingLengthSize(remaining) + remaining <= sizeof(_tx);
+  }
+
+  /** Hands what was published since the last flush to the TCP stack (what does not fit is sent by loop()) */
+  void flush()
+  {
+    if (_state != CONNECTED) {
+      return;
+    }
+    _stats.published += _numQueued;
+    _numQueued = 0;
+    transmit();
+  }
+
+  void disconnect()
+  {
+    if (_state == CONNECTED) {
+      static const uint8_t packet[] = {0xe0, 0x00};
+      _client.write(packet, sizeof(packet));
+    }
+    _client.stop();
+    resetBuffers();
+    if (_state != DISABLED) {
+      _state = DISCONNECTED;
+    }
+  }
+
+  static const char* toString(State s)
+  {
+    switch (s)
+    {
+      case DISABLED: return "disabled";
+      case DISCONNECTED: return "disconnected";
+      case WAIT_CONNACK: return "connecting";
+      case CONNECTED: return "connected";
+      default: return "unknown";
+    }
+  }
+
+private:
+  void connect()
+  {
+    _lastAttemptMillis = millis();
+    resetBuffers();
+    if (!_resolved) {
+      if (!_address.fromString(_host) && !WiFi.hostByName(_host, _address, DNS_TIMEOUT_MS)) {
+        connectionLost();
+        return;
+      }
+      _resolved = true;
+    }
+    _client.setTimeout(CONNECT_TIMEOUT_MS);
+    if (!_client.connect(_address, _port)) {
+      if (_backoffMs >= MAX_BACKOFF_MS) {
+        _resolved = false;
+      }
+      connectionLost();
+      return;
+    }
+    _client.setNoDelay(true);
+
+    // CONNECT, clean session
+    bool hasUsername = _username && _username[0];
+    bool hasPassword = hasUsername && _password && _password[0];
+    size_t remaining = 10 + 2 + strlen(_clientId) + 2 + strlen(_willTopic) + 2 + strlen(_willMessage) +
+                       (hasUsername ? 2 + strlen(_username) : 0) + (hasPassword ? 2 + strlen(_password) : 0);
+    if (1 + remainingLengthSize(remaining) + remaining > sizeof(_tx)) {
+      connectionLost();
+      return;
+    }
+    uint8_t flags = 0x02 /* clean session */ | 0x04 /* will */ | 0x20 /* will retain */ |
+                    (hasUsername ? 0x80 : 0x00) | (hasPassword ? 0x40 : 0x00);
+    _tx[_txEnd++] = 0x10;
+    putRemainingLength(remaining);
+    putString("MQTT", 4);
+    _tx[_txEnd++] = 4; // protocol level 3.1.1
+    _tx[_txEnd++] = flags;
+    _tx[_txEnd++] = KEEP_ALIVE_S >> 8;
+    _tx[_txEnd++] = KEEP_ALIVE_S & 0xff;
+    putString(_clientId, strlen(_clientId));
+    putString(_willTopic, strlen(_willTopic));
+    putString(_willMessage, strlen(_willMessage));
+    if (hasUsername) {
+      putString(_username, strlen(_username));
+    }
+    if (hasPassword) {
+      putString(_password, strlen(_password));
+    }
+    transmit();
+    _state = WAIT_CONNACK;
+  }
+
+  void connectionLost()
+  {
+    _stats.failures++;
+    _client.stop();
+    resetBuffers();
+    _state = DISCONNECTED;
+    _lastAttemptMillis = millis();
+    _backoffMs = _backoffMs ? _backoffMs * 2 : MIN_BACKOFF_MS;
+    if (_backoffMs > MAX_BACKOFF_MS) {
+      _backoffMs = MAX_BACKOFF_MS;
+    }
+  }
+
+  /**
+   * Reads the packets from the broker (CONNACK and PINGRESP are all that is expected, anything else is skipped).
+   * @return true if a CONNACK accepting the connection was received
+   */
+  bool receive()
+  {
+    bool sessionStarted = false;
+    while (_client.available() > 0)
+    {
+      if (_rxSkip > 0) {
+        uint8_t discard[32];
+        int n = _client.read(discard, _rxSkip < sizeof(discard) ? _rxSkip : sizeof(discard));
+        if (n <= 0) {
+          break;
+        }
+        _rxSkip -= n;
+        continue;
+      }
+
+      int c = _client.read();
+      if (c < 0) {
+        break;
+      }
+      _rx[_rxLength++] = c;
+
+      if (_rxHeaderLength == 0) {
+        // Fixed header: type, then the remaining length in 1 - 4 bytes
+        if (_rxLength < 2 || (c & 0x80)) {
+          if (_rxLength == 5) {
+            connectionLost(); // malformed remaining length
+            return false;
+          }
+          continue;
+        }
+        uint32_t remaining = 0;
+        for (int i = _rxLength - 1; i >= 1; i--) {
+          remaining = (remaining << 7) | (_rx[i] & 0x7f);
+        }
+        _pingOutstanding = false; // any packet shows the broker is alive
+        if ((_rx[0] >> 4) == 2 && remaining == 2) {
+          _rxHeaderLength = _rxLength; // CONNACK, wait for its 2 bytes
+        } else {
+          _rxSkip = remaining;
+          _rxLength = 0;
+        }
+        continue;
+      }
+      if (_rxLength < _rxHeaderLength + 2) {
+        continue;
+      }
+
+      // CONNACK: session present flag, return code
+      uint8_t returnCode = _rx[_rxHeaderLength + 1];
+      _rxLength = 0;
+      _rxHeaderLength = 0;
+      if (returnCode != 0) {
+        connectionLost(); // refused, bad credentials etc.
+        return false;
+      }
+      if (_state == WAIT_CONNACK) {
+        _state = CONNECTED;
+        _stats.connects++;
+        _backoffMs = 0;
+        _lastSentMillis = millis();
+        sessionStarted = true;
+      }
+    }
+    return sessionStarted;
+  }
+
+  /** PINGREQ when idle for half the keep alive, and give up when there is no answer within the keep alive */
+  void keepAlive()
+  {
+    unsigned long now = millis();
+    if (_pingOutstanding) {
+      if (now - _pingMillis >= KEEP_ALIVE_S * 1000UL) {
+        connectionLost();
+      }
+      return;
+    }
+    if (now - _lastSentMillis >= KEEP_ALIVE_S * 500UL && _txEnd + 2 <= sizeof(_tx)) {
+      _tx[_txEnd++] = 0xc0;
+      _tx[_txEnd++] = 0x00;
+      _pingOutstanding = true;
+      _pingMillis = now;
+    }
+  }
+
+  /** Writes as much of the send buffer as the TCP stack takes right away */
+  void transmit()
+  {
+    if (_txStart == _txEnd) {
+      return;
+    }
+    int room = _client.availableForWrite();
+    size_t n = _txEnd - _txStart;
+    if (room <= 0) {
+      return;
+    }
+    if (n > size_t(room)) {
+      n = room;
+    }
+    size_t written = _client.write(_tx + _txStart, n);
+    _txStart += written;
+    if (written > 0) {
+      _lastSentMillis = millis();
+    }
+    if (_txStart == _txEnd) {
+      _txStart = _txEnd = 0;
+    } else if (_txStart > 0) {
+      memmove(_tx, _tx + _txStart, _txEnd - _txStart);
+      _txEnd -= _txStart;
+      _txStart = 0;
+    }
+  }
+
+  static size_t remainingLengthSize(size_t length)
+  {
+    return length < 128 ? 1 : (length < 16384 ? 2 : 3);
+  }
+
+  void putRemainingLength(size_t length)
+  {
+    do {
+      uint8_t b = length & 0x7f;
+      length >>= 7;
+      _tx[_txEnd++] = b | (length ? 0x80 : 0x00);
+    } while (length);
+  }
+
+  void putString(const char* s, size_t length)
+  {
+    _tx[_txEnd++] = length >> 8;
+    _tx[_txEnd++] = length & 0xff;
+    memcpy(_tx + _txEnd, s, length);
+    _txEnd += length;
+  }
+
+  void resetBuffers()
+  {
+    _txStart = _txEnd = 0;
+    _rxLength = 0;
+    _rxHeaderLength = 0;
+    _rxSkip = 0;
+    _numQueued = 0;
+    _pingOutstanding = false;
+  }
+
+  WiFiClient _client;
+  State _state = DISABLED;
+  const char* _host = nullptr;
+  IPAddress _address;    ///< of _host ...
+  bool _resolved = false; ///< ... once looked up
+  uint16_t _port = 0;
+  const char* _clientId = "";
+  const char* _username = "";
+  const char* _password = "";
+  const char* _willTopic = "";
+  const char* _willMessage = "";
+
+  unsigned long _lastAttemptMillis = 0;
+  unsigned long _backoffMs = 0;
+  unsigned long _lastSentMillis = 0;
+  unsigned long _pingMillis = 0;
+  bool _pingOutstanding = false;
+
+  uint8_t _tx[SEND_BUFFER_SIZE];
+  size_t _txStart = 0;
+  size_t _txEnd = 0;
+  uint32_t _numQueued = 0;
+  uint8_t _rx[7];
+  uint8_t _rxLength = 0;
+  uint8_t _rxHeaderLength = 0; ///< of the packet being received, once complete
+  uint32_t _rxSkip = 0;
+
+  Stats _stats = {};
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+/**
+ * Rediscovery of the DS18B20s on the 1-Wire bus while running, so probes can be plugged in
+ * (or back in) and pulled out without a restart.
+ *
+ * A ROM search finds one device per OneWire::search() call (some 15 ms on the bus), so update()
+ * takes one step per call, from loop(), between the temperature conversions. A pass over the
+ * bus is started every PASS_INTERVAL_MS; once it is complete the devices found are available
+ * (found()) until the next one completes.
+ */
+class OneWireDiscovery
+{
+public:
+  enum {
+    PASS_INTERVAL_MS = 10000, ///< from the start of one pass to the start of the next
+    MAX_DEVICES = 16,         ///< more on the bus are not reported
+  };
+
+  /**
+   * Takes the next search step, if a pass is running or due.
+   * @return true when a pass has just been completed
+   */
+  bool update()
+  {
+    if (!_searching)
+    {
+      if (_passes != 0 && millis() - _passStartMillis < PASS_INTERVAL_MS) {
+        return false;
+      }
+      _searching = true;
+      _passStartMillis = millis();
+      _numSearching = 0;
+      oneWire.reset_search();
+    }
+
+    DeviceAddress address;
+    if (oneWire.search(address))
+    {
+      // Skip corrupted reads and devices that are no thermometers, and any repeated
+      if (sensors.validAddress(address) && sensors.validFamily(address) && _numSearching < MAX_DEVICES &&
+          !contains(_searchingDevices, _numSearching, address)) {
+        memcpy(_searchingDevices[_numSearching++], address, sizeof(DeviceAddress));
+      }
+      return false;
+    }
+
+    // Search done: publish the result
+    memcpy(_devices, _searchingDevices, sizeof(DeviceAddress) * _numSearching);
+    _numDevices = _numSearching;
+    _searching = false;
+    _passes++;
+    return true;
+  }
+
+  /** Devices found by the last complete pass */
+  int numFound() const { return _numDevices; }
+  DeviceAddress const & found(int i) const { return _devices[i]; }
+  bool isFound(DeviceAddress const & address) const { return contains(_devices, _numDevices, address); }
+
+  uint32_t passes() const { return _passes; }
+
+private:
+  static bool contains(DeviceAddress const * devices, int n, DeviceAddress const & address)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      if (memcmp(devices[i], address, sizeof(DeviceAddress)) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool _searching = false;
+  uint32_t _passes = 0;
+  unsigned long _passStartMillis = 0;
+  int _numSearching = 0;
+  int _numDevices = 0;
+  DeviceAddress _searchingDevices[MAX_DEVICES];
+  DeviceAddress _devices[MAX_DEVICES];
+} oneWireDiscovery;
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <Updater.h>
+
+/**
+ * Firmware / SPIFFS image update over HTTP (POST /api/update, see handleUpdateUpload()).
+ *
+ * The image is written to flash piece by piece as it arrives, never held in RAM. The
+ * core's Updater writes the sketch into the free space after the running one, checks the
+ * MD5 at the end, and only then marks it to be copied over at the next boot, so a broken
+ * or interrupted upload leaves the running firmware in place. A SPIFFS image is written
+ * straight over the file system, which is unmounted meanwhile and mounted again if the
+ * upload fails: as it was if nothing had been written yet, else an interrupted image has
+ * to be uploaded again before the web pages and settings are back.
+ *
+ * Sampling and the web server keep running during the upload. After a successful one
+ * the unit restarts, once the response has been sent.
+ */
+class OtaUpdate
+{
+public:
+  enum State { IDLE, RECEIVING, DONE, FAILED };
+  enum Target { FIRMWARE, SPIFFS_IMAGE };
+  enum {
+    RESTART_DELAY_MS = 500, ///< after the response to the upload, before restarting
+  };
+
+  State state() const { return _state; }
+  Target target() const { return _target; }
+  size_t size() const { return _size; }
+  size_t written() const { return _written; }
+  const char* error() const { return _error; }
+
+  /** milliseconds spent receiving (so far, or in total when done) */
+  unsigned long elapsed() const { return (_state == RECEIVING ? millis() : _endMillis) - _startMillis; }
+
+  unsigned long bytesPerSecond() const
+  {
+    unsigned long ms = elapsed();
+    return ms > 0 ? (unsigned long)(uint64_t(_written) * 1000 / ms) : 0;
+  }
+
+  /**
+   * Starts writing an image of size bytes with the given MD5 (32 hex digits).
+   * @return false if one is being received already, or (with error() telling why) if it can not be written
+   */
+  bool begin(Target target, size_t size, const char* md5)
+  {
+    if (_state == RECEIVING) {
+      return false; // the running one goes on
+    }
+    _state = RECEIVING;
+    _target = target;
+    _size = size;
+    _written = 0;
+    _error[0] = '\0';
+    _startMillis = _endMillis = millis();
+
+    if (strlen(md5) != 32 || strspn(md5, "0123456789abcdefABCDEF") != 32) {
+      fail("md5 must be 32 hex digits");
+      return false;
+    }
+    size_t room = target == FIRMWARE ? (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000 : size;
+    if (size == 0 || size > room) {
+      fail("image size does not fit");
+      return false;
+    }
+    if (!Update.begin(size, target == FIRMWARE ? U_FLASH : U_SPIFFS)) {
+      failWithUpdateError();
+      Update.clearError();
+      return false;
+    }
+    if (target == SPIFFS_IMAGE) {
+      SPIFFS.end(); // nothing else may write to it from here on
+      _unmounted = true;
+    }
+    Update.setMD5(md5);
+    return true;
+  }
+
+  /** Writes the next piece of the image. On errors the update is aborted, later pieces are ignored */
+  void write(const uint8_t* data, size_t length)
+  {
+    if (_state != RECEIVING) {
+      return;
+    }
+    if (Update.write(const_cast<uint8_t*>(data), length) != length) {
+      failWithUpdateError();
+      drop();
+      return;
+    }
+    _written += length;
+  }
+
+  /** All of the image has arrived: verify it. @return true if it is used after the restart */
+  bool end()
+  {
+    if (_state != RECEIVING) {
+      return false;
+    }
+    if (!Update.end()) {
+      failWithUpdateError();
+      Update.clearError();
+      return false;
+    }
+    _state = DONE;
+    _endMillis = millis();
+    return true;
+  }
+
+  /** The upload broke off */
+  void abort()
+  {
+    if (_state == RECEIVING) {
+      drop();
+      fail("upload aborted");
+    }
+  }
+
+  /** @return true once a successful update has had its response sent (call when the server is idle) */
+  bool restartDue() const
+  {
+    return _state == DONE && millis() - _endMillis >= RESTART_DELAY_MS;
+  }
+
+  static const char* toString(State s)
+  {
+    switch (s)
+    {
+      case IDLE: return "idle";
+      case RECEIVING: return "receiving";
+      case DONE: return "done";
+      case FAILED: return "failed";
+      default: return "unknown";
+    }
+  }
+
+  static const char* toString(Target t) { return t == FIRMWARE ? "firmware" : "spiffs"; }
+
+private:
+  void fail(const char* message)
+  {
+    strncpy(_error, message, sizeof(_error) - 1);
+    _error[sizeof(_error) - 1] = '\0';
+    _state = FAILED;
+    _endMillis = millis();
+    remount();
+  }
+
+  void failWithUpdateError()
+  {
+    switch (Update.getError())
+    {
+      case UPDATE_ERROR_SPACE: fail("image does not fit"); break;
+      case UPDATE_ERROR_SIZE: fail("image size wrong"); break;
+      case UPDATE_ERROR_MD5: fail("md5 mismatch"); break;
+      case UPDATE_ERROR_MAGIC_BYTE: fail("not a firmware image"); break;
+      case UPDATE_ERROR_WRITE:
+      case UPDATE_ERROR_ERASE: fail("flash write failed"); break;
+      default:
+        char message[32];
+        snprintf(message, sizeof(message), "update error %u", Update.getError());
+        fail(message);
+        break;
+    }
+  }
+
+  /** Ends a running Updater without using the image (with an error set, or the MD5 not matching a partial image) */
+  void drop()
+  {
+    Update.end(true);
+    Update.clearError();
+    remount();
+  }
+
+  /** Mounts the file system again after a SPIFFS image was not taken */
+  void remount()
+  {
+    if (_unmounted) {
+      SPIFFS.begin();
+      _unmounted = false;
+    }
+  }
+
+  State _state = IDLE;
+  Target _target = FIRMWARE;
+  bool _unmounted = false; ///< the file system, for the SPIFFS image being written
+  size_t _size = 0;
+  size_t _written = 0;
+  unsigned long _startMillis = 0;
+  unsigned long _endMillis = 0;
+  char _error[40] = {};
+} otaUpdate;
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <math.h>
+
+/**
+ * Statistics over the last values appended to a series (a sliding window of up to N of them),
+ * kept up to date value by value, so asking costs nothing and appending costs O(sqrt(N)) at most.
+ *
+ * The sums (of the values, their squares, and weighted by position for the slope) are kept
+ * exactly, in integers, so they do not drift however long it runs. Minimum and maximum are kept
+ * as values. When the one leaving the window was one of them (every time in a rising or falling
+ * series), they are worked out again from the minimum and maximum of each block of BLOCK values
+ * appended, and from the values of the oldest block still in the window (read from the series
+ * itself): some 2 sqrt(N) steps, and 4 bytes per block besides the series.
+ *
+ * The value leaving the window is taken from the series itself: push() has to be called before
+ * the value is appended to it (while the leaving one is still in there), and the window must not
+ * be longer than the series.
+ */
+template<class T, int N>
+class RollingStats {
+  static constexpr int isqrt(int n, int r = 1) { return (r + 1) * (r + 1) > n ? r : isqrt(n, r + 1); }
+
+public:
+  enum {
+    BLOCK = isqrt(N),                   ///< values per block
+    NUM_BLOCKS = (N + BLOCK - 1) / BLOCK, ///< blocks in a window of N, the oldest one not counted
+  };
+
+  /**
+   * Starts over, with the last count values of series.
+   * @param window values the statistics are over (1 - N)
+   */
+  template<class Series>
+  void reset(Series const & series, int window, int count)
+  {
+    _window = window < 1 ? 1 : (window > N ? N : window);
+    _count = 0;
+    _sum = 0;
+    _sumSquares = 0;
+    _sumWeighted = 0;
+    _position = 0;
+    count = min(count, min(_window, series.size()));
+    for (int i = series.size() - count; i < series.size(); i++)
+    {
+      add(series[i]);
+    }
+  }
+
+  /** Takes value into account, called right before it is appended to series */
+  template<class Series>
+  void push(Series const & series, T value)
+  {
+    if (_count == _window) {
+      remove(series, series[series.size() - _window]);
+    }
+    add(value);
+  }
+
+  int window() const { return _window; }
+  int count() const { return _count; }  ///< values in the window so far
+  T minimum() const { return _min; } ///< only if count() != 0
+  T maximum() const { return _max; } ///< only if count() != 0
+  float mean() const { return float(_sum) / _count; }
+  float stddev() const
+  {
+    // (n sum(x^2) - sum(x)^2) / n^2, exact up to the division
+    int64_t n = _count;
+    return sqrtf(float(n * _sumSquares - _sum * _sum) / float(n * n));
+  }
+  /** Least squares slope, per value (0 with fewer than two) */
+  float slope() const
+  {
+    int64_t n = _count;
+    if (n < 2) {
+      return 0;
+    }
+    int64_t sumPositions = n * (n - 1) / 2;
+    return float(n * _sumWeighted - sumPositions * _sum) / float(n * n * (n * n - 1) / 12);
+  }
+
+private:
+  /** The newest value, at position _count */
+  void add(T value)
+  {
+    _sum += value;
+    _sumSquares += int64_t(value) * value;
+    _sumWeighted += int64_t(_count) * value;
+    if (_count == 0 || value < _min) {
+      _min = value;
+    }
+    if (_count == 0 || value > _max) {
+      _max = value;
+    }
+    Block & block = _blocks[_position / BLOCK % NUM_BLOCKS];
+    if (_position % BLOCK == 0) {
+      block.minimum = block.maximum = value;
+    } else {
+      block.minimum = min(block.minimum, value);
+      block.maximum = max(block.maximum, value);
+    }
+    _position = (_position + 1) % (BLOCK * NUM_BLOCKS);
+    _count++;
+  }
+
+  /** The oldest value, at position 0: the others move one position closer */
+  template<class Series>
+  void remove(Series const & series, T value)
+  {
+    _sum -= value;
+    _sumSquares -= int64_t(value) * value;
+    _sumWeighted -= _sum;
+    _count--;
+    if (_count != 0 && (value == _min || value == _max))
+    {
+      // The part of the oldest block left in the window, from the series, then whole blocks
+      int oldest = (_position - _count + BLOCK * NUM_BLOCKS) % (BLOCK * NUM_BLOCKS);
+      int inOldest = min(_count, BLOCK - oldest % BLOCK);
+      int first = series.size() - _count;
+      _min = _max = series[first];
+      for (int i = first + 1; i < first + inOldest; i++)
+      {
+        _min = min(_min, series[i]);
+        _max = max(_max, series[i]);
+      }
+      for (int b = oldest / BLOCK + 1, left = _count - inOldest; left > 0; b++, left -= BLOCK)
+      {
+        Block const & block = _blocks[b % NUM_BLOCKS];
+        _min = min(_min, block.minimum);
+        _max = max(_max, block.maximum);
+      }
+    }
+  }
+
+  /** Minimum and maximum of BLOCK values appended one after the other (so far, for the newest) */
+  struct Block {
+    T minimum;
+    T maximum;
+  };
+
+  int _window = N;
+  int _count = 0;
+  int64_t _sum = 0;
+  int64_t _sumSquares = 0;
+  int64_t _sumWeighted = 0; ///< sum of value * position in the window, the oldest at 0
+  T _min = 0;
+  T _max = 0;
+  int _position = 0;        ///< of the next value, counted from the first block
+  Block _blocks[NUM_BLOCKS] = {};
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "SpscQueue.hpp"
+
+/**
+ * Sample capture on a hardware timer, decoupled from loop().
+ *
+ * timer1 interrupts every sample period (in loop mode, so the period does not drift with how
+ * late the interrupt is served). The interrupt converts the NTC channels of the MCP3208 and
+ * queues them with the time of capture; loop() drains the queue (pop()) when it gets around
+ * to it, and does the slow parts (OneWire conversion, storing, MQTT) there. So a long HTTP
+ * response or OneWire conversion delays when a sample is stored, but not when it is taken.
+ *
+ * Only the interrupt may talk to the MCP3208 once begin() has been called. timer1 is also used
+ * by the core's waveform generator (analogWrite(), tone(), Servo), which this sketch does not use.
+ */
+class SampleTimer
+{
+public:
+  enum {
+    NUM_CHANNELS = 8,  ///< of the MCP3208
+    QUEUE_LENGTH = 16, ///< ticks loop() may fall behind before ticks are dropped
+    MAX_PERIOD_MS = 26000, ///< timer1 counts 23 bits at 312.5 kHz
+  };
+
+  /** One timer period: raw conversions of the NTC channels, and when they were made */
+  struct Tick {
+    uint32_t sequence;          ///< ticks since begin(); a gap means ticks were dropped
+    uint32_t capturedMicros;    ///< micros() when the conversions were made
+    uint16_t adc[NUM_CHANNELS]; ///< raw conversion, for the channels in the mask given to begin()
+  };
+
+  struct Stats {
+    uint32_t ticks;        ///< taken by loop()
+    uint32_t dropped;      ///< lost, loop() did not drain the queue in time
+    uint32_t lastJitterUs; ///< deviation of the time between the last two ticks from the period
+    uint32_t maxJitterUs;
+    uint64_t sumJitterUs;
+    uint32_t numJitter;    ///< tick pairs measured (consecutive, without drops in between)
+    uint32_t maxLatencyMs; ///< longest time from capture until loop() took the tick
+    uint32_t maxQueued;    ///< most ticks waiting at once
+  };
+
+  /**
+   * Takes the first tick right away, then one each periodMs (at most MAX_PERIOD_MS).
+   * @param channelMask the MCP3208 channels to convert, bit n for channel n
+   */
+  void begin(uint32_t periodMs, uint8_t channelMask)
+  {
+    _periodMs = periodMs;
+    _channelMask = channelMask;
+    capture();
+    timer1_isr_init();
+    timer1_attachInterrupt(onTimer);
+    timer1_enable(TIM_DIV256, TIM_EDGE, TIM_LOOP);
+    timer1_write(periodMs * 625 / 2); // 80 MHz / 256 = 312.5 ticks per ms
+  }
+
+  /** @return true if a tick is waiting for loop() */
+  bool pending() const { return !_queue.empty(); }
+
+  /** Takes the oldest waiting tick (loop() side), and measures its timing. @return false if none */
+  bool pop(Tick & tick)
+  {
+    uint32_t queued = _queue.size();
+    if (!_queue.pop(tick)) {
+      return false;
+    }
+    _stats.maxQueued = max(_stats.maxQueued, queued);
+    if (_stats.ticks != 0) {
+      uint32_t missed = tick.sequence - _previous.sequence - 1;
+      _stats.dropped += missed;
+      if (missed == 0) {
+        int32_t deviation = int32_t(tick.capturedMicros - _previous.capturedMicros - _periodMs * 1000);
+        _stats.lastJitterUs = deviation < 0 ? -deviation : deviation;
+        _stats.maxJitterUs = max(_stats.maxJitterUs, _stats.lastJitterUs);
+        _stats.sumJitterUs += _stats.lastJitterUs;
+        _stats.numJitter++;
+      }
+    }
+    _stats.maxLatencyMs = max(_stats.maxLatencyMs, uint32_t(micros() - tick.capturedMicros) / 1000);
+    _stats.ticks++;
+    _previous = tick;
+    return true;
+  }
+
+  uint32_t periodMs() const { return _periodMs; }
+  uint32_t queued() const { return _queue.size(); }
+  Stats const & stats() const { return _stats; }
+  uint32_t meanJitterUs() const { return _stats.numJitter ? uint32_t(_stats.sumJitterUs / _stats.numJitter) : 0; }
+
+private:
+  static void onTimer();
+
+  /** In the interrupt (or in begin(), before it is enabled) */
+  IRAM_ATTR void capture()
+  {
+    Tick tick;
+    tick.sequence = _sequence++;
+    tick.capturedMicros = micros();
+    uint8_t mask = _channelMask;
+    for (int channel = 0; channel < NUM_CHANNELS; channel++)
+    {
+      tick.adc[channel] = (mask & (1 << channel)) ? mcp3208.read(channel) : 0;
+    }
+    _queue.push(tick); // when full, the tick is lost: its sequence number shows the gap
+  }
+
+  SpscQueue<Tick, QUEUE_LENGTH> _queue;
+  uint32_t _sequence = 0; ///< only touched by capture()
+  uint32_t _periodMs = 0;
+  uint8_t _channelMask = 0;
+  Tick _previous = {};
+  Stats _stats = {};
+} sampleTimer;
+
+IRAM_ATTR void SampleTimer::onTimer()
+{
+  sampleTimer.capture();
+}
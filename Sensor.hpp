@@ -21,12 +21,17 @@ struct Sensor {
   char id[17];
   char name[17];
   bool active;
+  uint32_t periodMs;  ///< time between samples, a multiple of the sample timer tick
+  uint8_t resolution; ///< bits, 9 - 12 for a DS18B20 (set on the sensor), 12 for the MCP3208
+  uint16_t statsWindowS; ///< the rolling statistics are over the 1h readings of this long
+  uint16_t compression24h; ///< the 24h readings are stored within this many hundredths of a degree (CompressedSeries), 0: in full
+  bool present;    ///< on the bus (OneWire sensors come and go), not persisted
   float lastValue; ///< not persisted
-  Sensor() : type{}, index(0), deviceAddress{}, id{}, name{}, active(false), lastValue{}
+  Sensor() : type{}, index(0), deviceAddress{}, id{}, name{}, active(false), periodMs(10000), resolution(12), statsWindowS(3600), compression24h(0), present(true), lastValue{}
   { /* no code */ }
 };
 
-String toString(Sensor::Type t) {
+const char* toString(Sensor::Type t) {
   switch (t)
   {
     case Sensor::Type::NTC:
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+
+/**
+ * Fixed size queue between one producer (an interrupt) and one consumer (loop()), without locks
+ * and without disabling interrupts: only the producer moves the head and only the consumer the
+ * tail. N must be a power of two; the free running positions wrap around through the mask.
+ *
+ * push() may run in an interrupt, so it is kept in IRAM (as is everything it calls).
+ */
+template<class T, uint32_t N>
+class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+public:
+  /** Producer side. @return false (and counts an overrun) if the consumer has not made room */
+  IRAM_ATTR bool push(const T& value)
+  {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == N) {
+      _overruns = _overruns + 1;
+      return false;
+    }
+    _data[head & (N - 1)] = value;
+    _head.store(head + 1, std::memory_order_release); // publishes the element written above
+    return true;
+  }
+
+  /** Consumer side. @return false if empty */
+  bool pop(T& value)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (_head.load(std::memory_order_acquire) == tail) {
+      return false;
+    }
+    value = _data[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release); // the element may be overwritten from now on
+    return true;
+  }
+
+  bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed); }
+  uint32_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed); }
+  static constexpr uint32_t capacity() { return N; }
+
+  /** pushes that found the queue full since start */
+  uint32_t overruns() const { return _overruns; }
+
+private:
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+  volatile uint32_t _overruns = 0;
+  T _data[N];
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "CircularBuffer.hpp"
+
+/**
+ * Wall-clock times of a series of readings made every periodS seconds, without a timestamp per
+ * reading: a few anchors (reading number, Unix time) and the period in between. An anchor is
+ * only added when the clock gets set, or moves away from the period (a correction of the clock
+ * by SNTP), so N of them go a long way. Readings before the oldest anchor are dated back from it.
+ *
+ * Reading numbers count the readings since boot (they may be negative for times before the first
+ * one). Anchors are kept in order of both reading and time, so either is found by binary search:
+ * a clock set back re-dates the readings before.
+ */
+template<int N>
+class TimeIndex {
+public:
+  struct Anchor {
+    int32_t reading;
+    uint32_t time;
+  };
+
+  explicit TimeIndex(uint32_t periodS) : _periodS(periodS) {}
+
+  uint32_t periodS() const { return _periodS; }
+  /** No time known for any reading */
+  bool empty() const { return _anchors.size() == 0; }
+  CircularBuffer<Anchor, N> const & anchors() const { return _anchors; }
+
+  /** Reading was made at time now: anchors it, unless the index dates it within toleranceS already */
+  void update(int32_t reading, uint32_t now, uint32_t toleranceS)
+  {
+    if (!empty())
+    {
+      int32_t off = int32_t(now - timeOf(reading));
+      if (off >= -int32_t(toleranceS) && off <= int32_t(toleranceS)) {
+        return;
+      }
+      if (int32_t(now - timeOf(reading - 1)) <= 0) {
+        _anchors.clear();
+      }
+    }
+    _anchors.push_back_erase_if_full({reading, now});
+  }
+
+  /** @return Unix time of reading (the index must not be empty) */
+  uint32_t timeOf(int32_t reading) const
+  {
+    Anchor const & a = _anchors[lastAnchor([reading](Anchor const & x) { return x.reading <= reading; })];
+    return a.time + uint32_t(reading - a.reading) * _periodS;
+  }
+
+  /** @return number of the last reading made at or before time (the index must not be empty) */
+  int32_t lastReadingAt(uint32_t time) const
+  {
+    int i = lastAnchor([time](Anchor const & x) { return int32_t(time - x.time) >= 0; });
+    Anchor const & a = _anchors[i];
+    int32_t d = int32_t(time - a.time);
+    int32_t reading = a.reading + (d >= 0 ? d / int32_t(_periodS) : -((-d + int32_t(_periodS) - 1) / int32_t(_periodS)));
+    if (i + 1 < _anchors.size()) {
+      reading = min(reading, _anchors[i + 1].reading - 1); // the clock jumped ahead at the next anchor
+    }
+    return reading;
+  }
+
+private:
+  /** @return the last anchor notAfter holds for (they are in order), the first one if none */
+  template<class NotAfter>
+  int lastAnchor(NotAfter notAfter) const
+  {
+    int lo = 0;
+    int hi = _anchors.size();
+    while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (notAfter(_anchors[mid])) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo > 0 ? lo - 1 : 0;
+  }
+
+  CircularBuffer<Anchor, N> _anchors;
+  uint32_t _periodS;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+/**
+ * Wall-clock time (Unix seconds, UTC), from an SNTP server or set by a browser, polled from loop().
+ *
+ * The time is kept as the millis() at which a whole second started, so reading it costs nothing
+ * and it runs on between synchronizations. SNTP requests are sent every POLL_INTERVAL_MS once
+ * synchronized (every RETRY_INTERVAL_MS until then); nothing is waited for, the reply is picked
+ * up by loop(). Half the round trip is added to the server's time.
+ *
+ * The only blocking part is the DNS lookup if the server is given by name, at most once per request.
+ */
+class WallClock
+{
+public:
+  enum {
+    NTP_PORT = 123,
+    NTP_PACKET_SIZE = 48,
+    POLL_INTERVAL_MS = 3600000UL,
+    RETRY_INTERVAL_MS = 15000,
+    RESPONSE_TIMEOUT_MS = 2000,
+  };
+
+  /** Where the time came from. A browser can not override SNTP while it keeps the clock synchronized */
+  enum Source : uint8_t { NONE, BROWSER, SNTP };
+
+  struct Stats {
+    uint32_t syncs;    ///< SNTP replies taken
+    uint32_t failures; ///< SNTP requests not answered (in time), or answered with garbage
+  };
+
+  /** Seconds between 1900 (NTP era 0) and 1970 (Unix) */
+  static constexpr uint32_t NTP_TO_UNIX_S = 2208988800UL;
+  /** Times before this (2020-01-01) are not plausible, e.g. an unset browser or server clock */
+  static constexpr uint32_t MIN_VALID_TIME = 1577836800UL;
+
+  /**
+   * Synchronize with server ("host" or "host:port", the string must stay valid while in use),
+   * or stop using SNTP if nullptr. The time already set is kept.
+   */
+  void configure(const char* server)
+  {
+    _udp.stop();
+    _server = server;
+    _waiting = false;
+    _requestMillis = millis() - RETRY_INTERVAL_MS; // right away
+  }
+
+  bool isSet() const { return _source != NONE; }
+  Source source() const { return _source; }
+  Stats const & stats() const { return _stats; }
+
+  /** @return Unix seconds now, 0 if not set */
+  uint32_t now() const
+  {
+    return isSet() ? _seconds + (millis() - _secondMillis) / 1000 : 0;
+  }
+
+  /** @return milliseconds since the time was last set or synchronized */
+  unsigned long sinceSetMs() const { return millis() - _setMillis; }
+
+  /**
+   * Sets the time from a browser.
+   * @return false if implausible, or SNTP keeps the clock synchronized
+   */
+  bool setFromBrowser(uint32_t unixSeconds)
+  {
+    if (unixSeconds < MIN_VALID_TIME || (_source == SNTP && _server && sinceSetMs() < 2 * POLL_INTERVAL_MS)) {
+      return false;
+    }
+    set(unixSeconds, 0, BROWSER);
+    return true;
+  }
+
+  /** SNTP handling, call from loop() */
+  void loop()
+  {
+    // Folding the elapsed whole seconds in, so that millis() wrapping (49 days) does not matter
+    if (isSet() && millis() - _secondMillis >= 86400000UL) {
+      uint32_t elapsed = (millis() - _secondMillis) / 1000;
+      _seconds += elapsed;
+      _secondMillis += elapsed * 1000;
+    }
+    if (!_server) {
+      return;
+    }
+    if (_waiting)
+    {
+      if (_udp.parsePacket() >= NTP_PACKET_SIZE) {
+        receive();
+      } else if (millis() - _requestMillis >= RESPONSE_TIMEOUT_MS) {
+        _waiting = false;
+        _stats.failures++;
+      }
+      return;
+    }
+    unsigned long interval = _source == SNTP ? POLL_INTERVAL_MS : RETRY_INTERVAL_MS;
+    if (millis() - _requestMillis >= interval) {
+      request();
+    }
+  }
+
+  static const char* toString(Source source)
+  {
+    switch (source)
+    {
+      case NONE: return "none";
+      case BROWSER: return "browser";
+      case SNTP: return "sntp";
+    }
+    return "?";
+  }
+
+private:
+  void set(uint32_t seconds, unsigned long fractionMs, Source source)
+  {
+    _seconds = seconds;
+    _secondMillis = millis() - fractionMs;
+    _setMillis = millis();
+    _source = source;
+  }
+
+  void request()
+  {
+    _requestMillis = millis();
+    char host[64];
+    uint16_t port = NTP_PORT;
+    const char* colon = strchr(_server, ':');
+    size_t hostLength = colon ? size_t(colon - _server) : strlen(_server);
+    if (hostLength >= sizeof(host) || (colon && (port = atoi(colon + 1)) == 0)) {
+      _stats.failures++;
+      return;
+    }
+    memcpy(host, _server, hostLength);
+    host[hostLength] = '\0';
+
+    // SNTPv4 client request (RFC 4330). The transmit timestamp is only a nonce, echoed back as originate timestamp
+    uint8_t packet[NTP_PACKET_SIZE] = {};
+    packet[0] = (4 << 3) | 3; // version 4, mode 3 (client)
+    _nonce = (uint32_t(micros()) << 8) ^ _requestMillis;
+    writeU32(packet + 44, _nonce);
+    while (_udp.parsePacket() > 0) {
+      // late replies to earlier requests
+    }
+    if (!_udp.beginPacket(host, port) || _udp.write(packet, sizeof(packet)) != sizeof(packet) || !_udp.endPacket()) {
+      _stats.failures++;
+      return;
+    }
+    _waiting = true;
+  }
+
+  void receive()
+  {
+    _waiting = false;
+    uint8_t packet[NTP_PACKET_SIZE];
+    _udp.read(packet, sizeof(packet));
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t stratum = packet[1];
+    uint32_t seconds = readU32(packet + 40);
+    if (mode != 4 || stratum == 0 || readU32(packet + 28) != _nonce || seconds - NTP_TO_UNIX_S < MIN_VALID_TIME) {
+      _stats.failures++; // not a server reply, kiss-o'-death, not to our request, or unsynchronized server
+      return;
+    }
+    unsigned long fractionMs = (uint64_t(readU32(packet + 44)) * 1000) >> 32;
+    unsigned long halfRoundTripMs = (millis() - _requestMillis) / 2;
+    set(seconds - NTP_TO_UNIX_S, fractionMs + halfRoundTripMs, SNTP);
+    _stats.syncs++;
+  }
+
+  static uint32_t readU32(uint8_t const* p)
+  {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+  }
+  static void writeU32(uint8_t* p, uint32_t v)
+  {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+  }
+
+  WiFiUDP _udp;
+  const char* _server = nullptr;
+  bool _waiting = false;         ///< for the reply to the last request
+  uint32_t _nonce = 0;
+  unsigned long _requestMillis = 0;
+  uint32_t _seconds = 0;         ///< Unix time ...
+  unsigned long _secondMillis = 0; ///< ... at this millis()
+  unsigned long _setMillis = 0;
+  Source _source = NONE;
+  Stats _stats = {};
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+/**
+ * Asynchronous scan for WiFi networks, served by /api/wifi/scan.
+ *
+ * A scan takes a couple of seconds, so it is started with WiFi.scanNetworks(async) and
+ * collected from loop() (update()) when done. The result is copied out of the SDK, which
+ * frees its scan memory right away, and kept until the next scan. Scans are rate limited,
+ * as the radio leaves the soft AP channel while scanning.
+ */
+class WifiScan
+{
+public:
+  enum State { IDLE, SCANNING, DONE, FAILED };
+  enum {
+    MAX_NETWORKS = 16,
+    MIN_RESCAN_INTERVAL_MS = 15000,  ///< rescans requested more often are ignored
+    MAX_RESULT_AGE_MS = 300000,      ///< older results are refreshed when asked for
+  };
+
+  struct Network {
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t encryption; ///< ENC_TYPE_*
+  };
+
+  State state() const { return _state; }
+  bool hasResult() const { return _hasResult; }
+  int numNetworks() const { return _numNetworks; }
+  Network const & network(int i) const { return _networks[i]; }
+
+  /** milliseconds since the cached result was collected */
+  unsigned long resultAge() const { return millis() - _resultMillis; }
+
+  /**
+   * Starts a scan unless one is running or one was started less than MIN_RESCAN_INTERVAL_MS ago.
+   * @return true if a scan is running when returning
+   */
+  bool start()
+  {
+    if (_state == SCANNING) {
+      return true;
+    }
+    if (_started && millis() - _startMillis < MIN_RESCAN_INTERVAL_MS) {
+      return false;
+    }
+    _started = true;
+    _startMillis = millis();
+    int8_t result = WiFi.scanNetworks(true /* async */);
+    _state = (result == WIFI_SCAN_FAILED) ? FAILED : SCANNING;
+    return _state == SCANNING;
+  }
+
+  /** Starts a scan if there is no result, or it is older than MAX_RESULT_AGE_MS (rate limited as start()) */
+  void startIfStale()
+  {
+    if (!_hasResult || resultAge() >= MAX_RESULT_AGE_MS) {
+      start();
+    }
+  }
+
+  /** Collects the result of a running scan once it is done, call from loop() */
+  void update()
+  {
+    if (_state != SCANNING) {
+      return;
+    }
+    int8_t n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) {
+      return;
+    }
+    if (n < 0) {
+      _state = FAILED;
+      return;
+    }
+
+    _numNetworks = 0;
+    for (int i = 0; i < n; i++) {
+      if (WiFi.isHidden(i)) {
+        continue;
+      }
+      addNetwork(WiFi.SSID(i).c_str(), WiFi.RSSI(i), WiFi.channel(i), WiFi.encryptionType(i));
+    }
+    WiFi.scanDelete();
+
+    _hasResult = true;
+    _resultMillis = millis();
+    _state = DONE;
+  }
+
+  static const char* toString(State s)
+  {
+    switch (s)
+    {
+      case IDLE: return "idle";
+      case SCANNING: return "scanning";
+      case DONE: return "done";
+      case FAILED: return "failed";
+      default: return "unknown";
+    }
+  }
+
+  static const char* encryptionToString(uint8_t encryption)
+  {
+    switch (encryption)
+    {
+      case ENC_TYPE_NONE: return "open";
+      case ENC_TYPE_WEP: return "wep";
+      case ENC_TYPE_TKIP: return "wpa";
+      case ENC_TYPE_CCMP: return "wpa2";
+      case ENC_TYPE_AUTO: return "wpa/wpa2";
+      default: return "unknown";
+    }
+  }
+
+private:
+  /** Keeps the strongest access point of each SSID, sorted strongest first, and the MAX_NETWORKS strongest SSIDs */
+  void addNetwork(const char* ssid, int32_t rssi, int32_t channel, uint8_t encryption)
+  {
+    int i = 0;
+    while (i < _numNetworks && strncmp(_networks[i].ssid, ssid, sizeof(_networks[i].ssid) - 1) != 0) {
+      i++;
+    }
+    if (i < _numNetworks) {
+      if (_networks[i].rssi >= rssi) {
+        return;
+      }
+      // Stronger access point of an SSID already seen: take it out and insert it again below
+      memmove(&_networks[i], &_networks[i + 1], (_numNetworks - i - 1) * sizeof(Network));
+      _numNetworks--;
+    }
+
+    int pos = _numNetworks;
+    while (pos > 0 && _networks[pos - 1].rssi < rssi) {
+      pos--;
+    }
+    if (pos >= MAX_NETWORKS) {
+      return;
+    }
+    int numToMove = (_numNetworks < MAX_NETWORKS ? _numNetworks : MAX_NETWORKS - 1) - pos;
+    memmove(&_networks[pos + 1], &_networks[pos], numToMove * sizeof(Network));
+    if (_numNetworks < MAX_NETWORKS) {
+      _numNetworks++;
+    }
+
+    Network & net = _networks[pos];
+    strncpy(net.ssid, ssid, sizeof(net.ssid) - 1);
+    net.ssid[sizeof(net.ssid) - 1] = '\0';
+    net.rssi = rssi < -128 ? -128 : (rssi > 0 ? 0 : rssi);
+    net.channel = channel;
+    net.encryption = encryption;
+  }
+
+  State _state = IDLE;
+  bool _started = false;
+  bool _hasResult = false;
+  unsigned long _startMillis = 0;
+  unsigned long _resultMillis = 0;
+  int _numNetworks = 0;
+  Network _networks[MAX_NETWORKS];
+} wifiScan;
@@ -0,0 +1,217 @@
+#include "Collector.hpp"
+
+#include "HttpGet.hpp"
+#include "Json.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+int64_t nowMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+std::string Collector::seriesName(std::string const &sensorId) const
+{
+  return _options.tier == "1h" ? sensorId : sensorId + "_" + _options.tier;
+}
+
+bool Collector::loadState(Device const &device, State &state) const
+{
+  std::ifstream in(_store.devicePath(device.name) + "/state_" + _options.tier);
+  unsigned long long samples;
+  long long newest;
+  long long boot;
+  int unitClock;
+  if (!(in >> samples >> newest >> boot >> unitClock)) {
+    return false;
+  }
+  state.samplesSinceBoot = samples;
+  state.newestMs = newest;
+  state.bootMs = boot;
+  state.unitClock = unitClock != 0;
+  return true;
+}
+
+void Collector::saveState(Device const &device, State const &state) const
+{
+  std::string path = _store.devicePath(device.name) + "/state_" + _options.tier;
+  {
+    std::ofstream out(path + ".tmp");
+    out << state.samplesSinceBoot << " " << state.newestMs << " " << state.bootMs << " " << int(state.unitClock) << "\n";
+  }
+  std::rename((path + ".tmp").c_str(), path.c_str());
+}
+
+namespace {
+
+/** Number member of an object, false if missing or not a number */
+bool getNumber(json::Value const &object, char const *key, double &number)
+{
+  json::Value const *v = object.get(key);
+  if (!v || v->type != json::Value::Number) {
+    return false;
+  }
+  number = v->number;
+  return true;
+}
+
+struct Anchor {
+  int64_t position;
+  int64_t timeS;
+};
+
+/** time_anchors of a response, ordered by position (empty while the unit does not know the time) */
+bool getAnchors(json::Value const &root, std::vector<Anchor> &anchors)
+{
+  json::Value const *list = root.get("time_anchors");
+  if (!list) {
+    return true;
+  }
+  if (list->type != json::Value::Array) {
+    return false;
+  }
+  for (json::Value const &a : list->array) {
+    if (a.type != json::Value::Array || a.array.size() != 2 || a.array[0].type != json::Value::Number ||
+        a.array[1].type != json::Value::Number || (!anchors.empty() && a.array[0].number <= anchors.back().position)) {
+      return false;
+    }
+    anchors.push_back({int64_t(a.array[0].number), int64_t(a.array[1].number)});
+  }
+  return true;
+}
+
+} // namespace
+
+bool Collector::collect(Device const &device, size_t &appended, std::string &error)
+{
+  appended = 0;
+  State previous;
+  bool loaded = loadState(device, previous);
+
+  // Only the readings since the newest one stored, if that was dated by the unit's clock;
+  // while the unit does not know the time, all it keeps
+  std::string path = "/api/readings?tier=" + _options.tier;
+  if (loaded && previous.unitClock) {
+    path += "&from=" + std::to_string(previous.newestMs / 1000 + 1);
+  }
+  HttpResponse response;
+  if (!httpGet(device.host, device.port, path, _options.timeoutMs, response, error)) {
+    return false;
+  }
+  if (response.status == 503 &&
+      !httpGet(device.host, device.port, "/api/readings/" + _options.tier, _options.timeoutMs, response, error)) {
+    return false;
+  }
+  int64_t fetchMs = nowMs();
+  if (response.status != 200) {
+    error = "HTTP status " + std::to_string(response.status);
+    return false;
+  }
+  json::Value root;
+  if (!json::parse(response.body, root, error)) {
+    error = "response: " + error;
+    return false;
+  }
+  json::Value const *sensors = root.get("sensors");
+  if (!sensors || sensors->type != json::Value::Array) {
+    error = "response: no sensors";
+    return false;
+  }
+  if (sensors->array.empty()) {
+    return true; // nothing served, and no sample count either
+  }
+  double count;
+  double firstReading;
+  double unitPeriodS;
+  std::vector<Anchor> anchors;
+  if (!getNumber(root, "samples_since_boot", count) || count < 0 || !getNumber(root, "first_reading", firstReading) ||
+      !getNumber(root, "period_s", unitPeriodS) || !getAnchors(root, anchors)) {
+    error = "response: no samples_since_boot, first_reading, period_s or time_anchors";
+    return false;
+  }
+  uint64_t samplesSinceBoot = uint64_t(count);
+
+  int64_t periodMs = int64_t(_options.periodS * 1000);
+  int64_t bootMs = fetchMs - int64_t(samplesSinceBoot) * periodMs; // as if the newest reading was made just now
+  bool continuing = loaded && samplesSinceBoot >= previous.samplesSinceBoot &&
+                    bootMs - previous.bootMs <= REBOOT_PERIODS * periodMs;
+  if (continuing && bootMs - previous.bootMs <= periodMs && previous.bootMs - bootMs <= periodMs) {
+    bootMs = previous.bootMs;
+  }
+  State next = {samplesSinceBoot, continuing ? previous.newestMs : 0, bootMs, continuing && previous.unitClock};
+
+  std::vector<int64_t> times;
+  std::vector<float> values;
+  for (json::Value const &sensor : sensors->array) {
+    json::Value const *id = sensor.get("id");
+    json::Value const *readings = sensor.get("readings");
+    double servedFrom;
+    if (!id || id->type != json::Value::String || !readings || readings->type != json::Value::Array ||
+        !getNumber(sensor, "served_from", servedFrom)) {
+      error = "response: malformed sensor";
+      return false;
+    }
+    // Reading numbers from on which they are new, and real
+    int64_t from = std::max(int64_t(servedFrom), int64_t(0));
+    if (continuing) {
+      from = std::max(from, int64_t(previous.samplesSinceBoot));
+    }
+
+    times.clear();
+    values.clear();
+    size_t anchor = 0;
+    for (size_t i = 0; i < readings->array.size(); i++) {
+      int64_t n = int64_t(firstReading) + int64_t(i);
+      if (n < from) {
+        continue;
+      }
+      json::Value const &v = readings->array[i];
+      if (v.type != json::Value::Number) {
+        error = "response: malformed reading";
+        return false;
+      }
+      int64_t t;
+      if (anchors.empty()) {
+        t = bootMs + (n + 1) * periodMs;
+      } else {
+        while (anchor + 1 < anchors.size() && anchors[anchor + 1].position <= int64_t(i)) {
+          anchor++;
+        }
+        t = (anchors[anchor].timeS + (int64_t(i) - anchors[anchor].position) * int64_t(unitPeriodS)) * 1000;
+      }
+      if (!times.empty() && t <= times.back()) {
+        continue; // the unit's clock was set back
+      }
+      times.push_back(t);
+      values.push_back(float(v.number));
+    }
+
+    std::string name = seriesName(id->string);
+    Series *series = _store.series(device.name, name, error);
+    if (!series) {
+      return false;
+    }
+    long n = series->append(times.data(), values.data(), times.size(), error);
+    if (n < 0) {
+      return false;
+    }
+    appended += size_t(n);
+    if (!times.empty() && times.back() > next.newestMs) {
+      next.newestMs = times.back();
+      next.unitClock = !anchors.empty();
+    }
+    json::Value const *sensorName = sensor.get("name");
+    if (sensorName && sensorName->type == json::Value::String) {
+      _store.setSensorName(device.name, name, sensorName->string);
+    }
+  }
+  saveState(device, next);
+  return true;
+}
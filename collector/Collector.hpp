@@ -0,0 +1,72 @@
+#pragma once
+
+// Fetches the readings of the units and appends the new ones to a SeriesStore.
+
+#include "SeriesStore.hpp"
+
+#include <stdint.h>
+#include <string>
+
+struct Device {
+  std::string name; ///< directory in the store
+  std::string host;
+  uint16_t port = 80;
+};
+
+/**
+ * The units serve the last hour (or day) of readings, numbered by the samples taken since boot
+ * ("first_reading" of the response, "samples_since_boot" past the last one). Each reading is
+ * stored once, by its number:
+ *
+ * - once a unit knows the time, its "time_anchors" date the readings, and only those made
+ *   after the newest one stored are fetched (/api/readings?from=)
+ * - otherwise the readings are dated from the boot time, estimated at the first fetch as the
+ *   time of the fetch less samples_since_boot periods, reading n at boot + (n + 1) periods.
+ *   The estimate is kept while fetches agree with it within a period, so the readings stay a
+ *   period apart; it is moved when the unit's clock drifted further, and taken as a reboot
+ *   (the count starts over) when it moves ahead by more than REBOOT_PERIODS
+ *
+ * Readings from before a sensor was served ("served_from") or before boot are placeholders
+ * and are skipped.
+ */
+class Collector
+{
+public:
+  struct Options {
+    std::string tier = "1h";  ///< "1h" (a sample every 10 s) or "24h" (every minute)
+    double periodS = 10;      ///< seconds between samples of the tier (dating without the unit's clock)
+    int timeoutMs = 5000;
+  };
+
+  Collector(SeriesStore &store, Options options) : _store(store), _options(std::move(options)) {}
+
+  /**
+   * Fetches the readings of one unit and stores the new samples; may run for different
+   * devices in parallel.
+   * @param appended number of samples stored (all sensors)
+   * @return false on errors (described in error)
+   */
+  bool collect(Device const &device, size_t &appended, std::string &error);
+
+  /** Series name of a sensor in the tier collected */
+  std::string seriesName(std::string const &sensorId) const;
+
+private:
+  enum { REBOOT_PERIODS = 10 };
+
+  struct State {
+    uint64_t samplesSinceBoot = 0; ///< readings numbered below were stored
+    int64_t newestMs = 0;          ///< time of the newest reading stored
+    int64_t bootMs = 0;            ///< estimated, reading n was made at bootMs + (n + 1) periods
+    bool unitClock = false;        ///< newestMs is a time of the unit's clock (time anchors)
+  };
+
+  bool loadState(Device const &device, State &state) const;
+  void saveState(Device const &device, State const &state) const;
+
+  SeriesStore &_store;
+  Options _options;
+};
+
+/** Wall clock, ms since the epoch */
+int64_t nowMs();
@@ -0,0 +1,183 @@
+#pragma once
+
+// Append-only array of fixed size elements in a memory-mapped file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+/**
+ * The file starts with a 64 byte header (magic, element size, number of elements),
+ * followed by the elements. The mapping grows by doubling the file, so appending is
+ * amortized O(1) and reading is plain memory access.
+ *
+ * The element count is updated after the elements are written, so a reader mapping
+ * the file while it is appended to sees a consistent prefix.
+ */
+template<typename T>
+class ColumnFile
+{
+  static_assert(std::is_trivially_copyable<T>::value, "elements are stored as raw bytes");
+
+public:
+  ColumnFile() = default;
+  ColumnFile(ColumnFile const &) = delete;
+  ColumnFile &operator=(ColumnFile const &) = delete;
+  ~ColumnFile() { close(); }
+
+  /** Opens path, creating it if writable and missing. @return false on errors (described in error) */
+  bool open(std::string const &path, bool writable, std::string &error)
+  {
+    close();
+    _writable = writable;
+    _fd = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC), 0644);
+    if (_fd < 0) {
+      error = path + ": " + strerror(errno);
+      return false;
+    }
+    struct stat st;
+    fstat(_fd, &st);
+    size_t fileSize = size_t(st.st_size);
+    if (fileSize == 0 && writable) {
+      fileSize = INITIAL_SIZE;
+      if (ftruncate(_fd, off_t(fileSize)) != 0) {
+        error = path + ": " + strerror(errno);
+        close();
+        return false;
+      }
+      if (!map(fileSize, error)) {
+        return false;
+      }
+      memcpy(header().magic, MAGIC, sizeof(header().magic));
+      header().elementSize = sizeof(T);
+      header().count = 0;
+      return true;
+    }
+    if (fileSize < sizeof(Header) || !map(fileSize, error)) {
+      if (error.empty()) {
+        error = path + ": truncated";
+      }
+      close();
+      return false;
+    }
+    if (memcmp(header().magic, MAGIC, sizeof(header().magic)) != 0 || header().elementSize != sizeof(T)) {
+      error = path + ": not a column file of this type";
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (_map) {
+      munmap(_map, _mappedSize);
+      _map = nullptr;
+      _mappedSize = 0;
+    }
+    if (_fd >= 0) {
+      ::close(_fd);
+      _fd = -1;
+    }
+  }
+
+  bool isOpen() const { return _map != nullptr; }
+
+  /** Number of elements (for a reader: at most what its mapping covers, the writer may have grown the file since) */
+  size_t size() const
+  {
+    if (!_map) {
+      return 0;
+    }
+    size_t count = size_t(countRef().load(std::memory_order_acquire));
+    size_t mapped = (_mappedSize - sizeof(Header)) / sizeof(T);
+    return count < mapped ? count : mapped;
+  }
+  T const *data() const { return reinterpret_cast<T const *>(_map + sizeof(Header)); }
+  T const &operator[](size_t i) const { return data()[i]; }
+  T const &back() const { return data()[size() - 1]; }
+
+  bool append(T const *values, size_t n, std::string &error)
+  {
+    size_t count = size();
+    size_t needed = sizeof(Header) + (count + n) * sizeof(T);
+    if (needed > _mappedSize) {
+      size_t newSize = _mappedSize * 2;
+      while (newSize < needed) {
+        newSize *= 2;
+      }
+      munmap(_map, _mappedSize);
+      _map = nullptr;
+      if (ftruncate(_fd, off_t(newSize)) != 0) {
+        error = std::string("growing column file: ") + strerror(errno);
+        map(_mappedSize, error);
+        return false;
+      }
+      if (!map(newSize, error)) {
+        return false;
+      }
+    }
+    memcpy(_map + sizeof(Header) + count * sizeof(T), values, n * sizeof(T));
+    countRef().store(count + n, std::memory_order_release);
+    return true;
+  }
+
+  /** Drops the elements from n on (the file keeps its size) */
+  void truncate(size_t n)
+  {
+    if (n < size()) {
+      countRef().store(n, std::memory_order_release);
+    }
+  }
+
+  /** Flush to disk (the kernel does that by itself eventually) */
+  void sync()
+  {
+    if (_map) {
+      msync(_map, _mappedSize, MS_ASYNC);
+    }
+  }
+
+private:
+  static constexpr char MAGIC[8] = {'T', 'V', 'C', 'O', 'L', '0', '0', '1'};
+  static const size_t INITIAL_SIZE = 16384;
+
+  struct Header {
+    char magic[8];
+    uint32_t elementSize;
+    uint32_t reserved0;
+    uint64_t count;
+    uint64_t reserved[5];
+  };
+  static_assert(sizeof(Header) == 64, "header layout");
+
+  Header &header() { return *reinterpret_cast<Header *>(_map); }
+  std::atomic<uint64_t> &countRef() const
+  {
+    return *reinterpret_cast<std::atomic<uint64_t> *>(&reinterpret_cast<Header *>(_map)->count);
+  }
+
+  bool map(size_t size, std::string &error)
+  {
+    void *p = mmap(nullptr, size, _writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED) {
+      error = std::string("mmap: ") + strerror(errno);
+      return false;
+    }
+    _map = static_cast<uint8_t *>(p);
+    _mappedSize = size;
+    return true;
+  }
+
+  int _fd = -1;
+  bool _writable = false;
+  uint8_t *_map = nullptr;
+  size_t _mappedSize = 0;
+};
@@ -0,0 +1,181 @@
+#include "HttpGet.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+namespace {
+
+class Socket
+{
+public:
+  ~Socket() { if (fd >= 0) ::close(fd); }
+  int fd = -1;
+};
+
+bool connectWithTimeout(std::string const &host, uint16_t port, int timeoutMs, Socket &s, std::string &error)
+{
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = nullptr;
+  int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+  if (rc != 0 || !result) {
+    error = "resolving " + host + ": " + gai_strerror(rc);
+    return false;
+  }
+  s.fd = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  rc = ::connect(s.fd, result->ai_addr, result->ai_addrlen);
+  freeaddrinfo(result);
+  if (rc != 0 && errno != EINPROGRESS) {
+    error = std::string("connect: ") + strerror(errno);
+    return false;
+  }
+  if (rc != 0) {
+    struct pollfd p = {s.fd, POLLOUT, 0};
+    if (poll(&p, 1, timeoutMs) != 1) {
+      error = "connect: timeout";
+      return false;
+    }
+    int soError = 0;
+    socklen_t length = sizeof(soError);
+    getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &soError, &length);
+    if (soError != 0) {
+      error = std::string("connect: ") + strerror(soError);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool sendAll(Socket &s, std::string const &data, int timeoutMs, std::string &error)
+{
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(s.fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += size_t(n);
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      error = std::string("send: ") + strerror(errno);
+      return false;
+    }
+    struct pollfd p = {s.fd, POLLOUT, 0};
+    if (poll(&p, 1, timeoutMs) != 1) {
+      error = "send: timeout";
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Everything the server sends until it closes the connection */
+bool receiveAll(Socket &s, int timeoutMs, std::string &data, std::string &error)
+{
+  char buf[16384];
+  while (true) {
+    ssize_t n = recv(s.fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      data.append(buf, size_t(n));
+      continue;
+    }
+    if (n == 0) {
+      return true;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      error = std::string("recv: ") + strerror(errno);
+      return false;
+    }
+    struct pollfd p = {s.fd, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) != 1) {
+      error = "recv: timeout";
+      return false;
+    }
+  }
+}
+
+bool decodeChunked(std::string const &in, size_t pos, std::string &out, std::string &error)
+{
+  while (true) {
+    size_t lineEnd = in.find("\r\n", pos);
+    if (lineEnd == std::string::npos) {
+      error = "truncated chunk header";
+      return false;
+    }
+    size_t length = strtoul(in.c_str() + pos, nullptr, 16);
+    pos = lineEnd + 2;
+    if (length == 0) {
+      return true;
+    }
+    if (pos + length + 2 > in.size()) {
+      error = "truncated chunk";
+      return false;
+    }
+    out.append(in, pos, length);
+    pos += length + 2;
+  }
+}
+
+/** Value of header name (lower case) in the response head, empty if missing */
+std::string headerValue(std::string const &head, const char *name)
+{
+  size_t pos = 0;
+  while ((pos = head.find("\r\n", pos)) != std::string::npos) {
+    pos += 2;
+    size_t colon = head.find(':', pos);
+    size_t end = head.find("\r\n", pos);
+    if (colon == std::string::npos || colon > end) {
+      continue;
+    }
+    if (strncasecmp(head.c_str() + pos, name, colon - pos) == 0 && strlen(name) == colon - pos) {
+      size_t start = head.find_first_not_of(" \t", colon + 1);
+      return head.substr(start, end - start);
+    }
+  }
+  return std::string();
+}
+
+} // namespace
+
+bool httpGet(std::string const &host, uint16_t port, std::string const &path, int timeoutMs,
+             HttpResponse &response, std::string &error)
+{
+  Socket s;
+  if (!connectWithTimeout(host, port, timeoutMs, s, error)) {
+    return false;
+  }
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+  std::string raw;
+  if (!sendAll(s, request, timeoutMs, error) || !receiveAll(s, timeoutMs, raw, error)) {
+    return false;
+  }
+
+  size_t headEnd = raw.find("\r\n\r\n");
+  if (headEnd == std::string::npos || raw.compare(0, 5, "HTTP/") != 0) {
+    error = "malformed response";
+    return false;
+  }
+  std::string head = raw.substr(0, headEnd + 2);
+  size_t space = head.find(' ');
+  response.status = space == std::string::npos ? 0 : atoi(head.c_str() + space + 1);
+  response.body.clear();
+
+  std::string encoding = headerValue(head, "transfer-encoding");
+  if (strncasecmp(encoding.c_str(), "chunked", 7) == 0) {
+    return decodeChunked(raw, headEnd + 4, response.body, error);
+  }
+  response.body = raw.substr(headEnd + 4);
+  std::string contentLength = headerValue(head, "content-length");
+  if (!contentLength.empty() && response.body.size() != size_t(atoll(contentLength.c_str()))) {
+    error = "truncated body";
+    return false;
+  }
+  return true;
+}
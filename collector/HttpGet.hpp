@@ -0,0 +1,19 @@
+#pragma once
+
+// Blocking HTTP/1.1 GET, one request per connection.
+
+#include <stdint.h>
+#include <string>
+
+struct HttpResponse {
+  int status = 0;
+  std::string body; ///< with any chunked transfer encoding removed
+};
+
+/**
+ * GET http://host:port/path
+ * @param timeoutMs for connecting, and for each wait for more data from the server
+ * @return false on connection or protocol errors (described in error); any HTTP status is a success
+ */
+bool httpGet(std::string const &host, uint16_t port, std::string const &path, int timeoutMs,
+             HttpResponse &response, std::string &error);
@@ -0,0 +1,232 @@
+#include "Json.hpp"
+
+#include <cctype>
+#include <cstdlib>
+
+namespace json {
+
+Value const *Value::get(std::string_view key) const
+{
+  for (auto const &member : object) {
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+
+namespace {
+
+class Parser
+{
+public:
+  explicit Parser(std::string_view text) : _text(text) {}
+
+  bool parseDocument(Value &out)
+  {
+    if (!parseValue(out, 0)) {
+      return false;
+    }
+    skipWhitespace();
+    return _pos == _text.size() || fail("trailing characters");
+  }
+
+  std::string error;
+
+private:
+  static const int MAX_DEPTH = 64;
+
+  bool fail(const char *what)
+  {
+    error = std::string(what) + " at offset " + std::to_string(_pos);
+    return false;
+  }
+
+  void skipWhitespace()
+  {
+    while (_pos < _text.size() &&
+           (_text[_pos] == ' ' || _text[_pos] == '\t' || _text[_pos] == '\n' || _text[_pos] == '\r')) {
+      _pos++;
+    }
+  }
+
+  bool literal(std::string_view word)
+  {
+    if (_text.substr(_pos, word.size()) != word) {
+      return fail("invalid literal");
+    }
+    _pos += word.size();
+    return true;
+  }
+
+  bool parseValue(Value &out, int depth)
+  {
+    if (depth > MAX_DEPTH) {
+      return fail("nested too deep");
+    }
+    skipWhitespace();
+    if (_pos >= _text.size()) {
+      return fail("unexpected end");
+    }
+    switch (_text[_pos]) {
+      case '{': return parseObject(out, depth);
+      case '[': return parseArray(out, depth);
+      case '"': out.type = Value::String; return parseString(out.string);
+      case 't': out.type = Value::Bool; out.boolean = true; return literal("true");
+      case 'f': out.type = Value::Bool; out.boolean = false; return literal("false");
+      case 'n': out.type = Value::Null; return literal("null");
+      default: return parseNumber(out);
+    }
+  }
+
+  bool parseNumber(Value &out)
+  {
+    // strtod accepts more than JSON does (hex, inf, leading +), which does no harm here
+    std::string token;
+    while (_pos < _text.size() && (isdigit(_text[_pos]) || _text[_pos] == '-' || _text[_pos] == '+' ||
+                                   _text[_pos] == '.' || _text[_pos] == 'e' || _text[_pos] == 'E')) {
+      token += _text[_pos++];
+    }
+    char *end = nullptr;
+    out.type = Value::Number;
+    out.number = strtod(token.c_str(), &end);
+    if (token.empty() || *end != '\0') {
+      return fail("invalid number");
+    }
+    return true;
+  }
+
+  bool parseString(std::string &out)
+  {
+    _pos++; // "
+    out.clear();
+    while (_pos < _text.size()) {
+      char c = _text[_pos++];
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (_pos >= _text.size()) {
+        break;
+      }
+      c = _text[_pos++];
+      switch (c) {
+        case '"': case '\\': case '/': out += c; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+          if (_pos + 4 > _text.size()) {
+            return fail("invalid escape");
+          }
+          unsigned code = std::strtoul(std::string(_text.substr(_pos, 4)).c_str(), nullptr, 16);
+          _pos += 4;
+          // UTF-8, surrogate pairs are not combined (they do not occur in the API)
+          if (code < 0x80) {
+            out += char(code);
+          } else if (code < 0x800) {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+          } else {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+          }
+          break;
+        }
+        default: return fail("invalid escape");
+      }
+    }
+    return fail("unterminated string");
+  }
+
+  bool parseArray(Value &out, int depth)
+  {
+    _pos++; // [
+    out.type = Value::Array;
+    skipWhitespace();
+    if (_pos < _text.size() && _text[_pos] == ']') {
+      _pos++;
+      return true;
+    }
+    while (true) {
+      out.array.emplace_back();
+      if (!parseValue(out.array.back(), depth + 1)) {
+        return false;
+      }
+      skipWhitespace();
+      if (_pos >= _text.size()) {
+        return fail("unterminated array");
+      }
+      char c = _text[_pos++];
+      if (c == ']') {
+        return true;
+      }
+      if (c != ',') {
+        return fail("expected , or ]");
+      }
+    }
+  }
+
+  bool parseObject(Value &out, int depth)
+  {
+    _pos++; // {
+    out.type = Value::Object;
+    skipWhitespace();
+    if (_pos < _text.size() && _text[_pos] == '}') {
+      _pos++;
+      return true;
+    }
+    while (true) {
+      skipWhitespace();
+      if (_pos >= _text.size() || _text[_pos] != '"') {
+        return fail("expected member name");
+      }
+      out.object.emplace_back();
+      if (!parseString(out.object.back().first)) {
+        return false;
+      }
+      skipWhitespace();
+      if (_pos >= _text.size() || _text[_pos++] != ':') {
+        return fail("expected :");
+      }
+      if (!parseValue(out.object.back().second, depth + 1)) {
+        return false;
+      }
+      skipWhitespace();
+      if (_pos >= _text.size()) {
+        return fail("unterminated object");
+      }
+      char c = _text[_pos++];
+      if (c == '}') {
+        return true;
+      }
+      if (c != ',') {
+        return fail("expected , or }");
+      }
+    }
+  }
+
+  std::string_view _text;
+  size_t _pos = 0;
+};
+
+} // namespace
+
+bool parse(std::string_view text, Value &out, std::string &error)
+{
+  Parser parser(text);
+  out = Value();
+  if (!parser.parseDocument(out)) {
+    error = parser.error;
+    return false;
+  }
+  return true;
+}
+
+} // namespace json
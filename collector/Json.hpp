@@ -0,0 +1,32 @@
+#pragma once
+
+// Small JSON reader, enough for the responses of the units' API.
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace json {
+
+struct Value {
+  enum Type { Null, Bool, Number, String, Array, Object };
+
+  Type type = Null;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<Value> array;
+  std::vector<std::pair<std::string, Value>> object;
+
+  /** Member of an object, nullptr if missing (or not an object) */
+  Value const *get(std::string_view key) const;
+};
+
+/**
+ * Parses text as one JSON value.
+ * @return false on a syntax error, with error describing it
+ */
+bool parse(std::string_view text, Value &out, std::string &error);
+
+} // namespace json
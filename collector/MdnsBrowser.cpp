@@ -0,0 +1,218 @@
+#include "MdnsBrowser.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+
+namespace {
+
+const uint16_t TYPE_A = 1;
+const uint16_t TYPE_PTR = 12;
+const uint16_t TYPE_SRV = 33;
+
+int64_t monotonicMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** Reads a (possibly compressed) name at pos as "label.label.label", @return false if malformed */
+bool readName(const uint8_t *msg, size_t length, size_t &pos, std::string &name)
+{
+  name.clear();
+  size_t p = pos;
+  bool jumped = false;
+  for (int hops = 0; hops < 16; ) {
+    if (p >= length) {
+      return false;
+    }
+    uint8_t n = msg[p];
+    if (n == 0) {
+      if (!jumped) {
+        pos = p + 1;
+      }
+      return true;
+    }
+    if ((n & 0xc0) == 0xc0) {
+      if (p + 1 >= length) {
+        return false;
+      }
+      if (!jumped) {
+        pos = p + 2;
+      }
+      p = ((n & 0x3f) << 8) | msg[p + 1];
+      jumped = true;
+      hops++;
+      continue;
+    }
+    if (p + 1 + n > length) {
+      return false;
+    }
+    if (!name.empty()) {
+      name += '.';
+    }
+    name.append(reinterpret_cast<const char *>(msg + p + 1), n);
+    p += 1 + n;
+  }
+  return false;
+}
+
+std::string lower(std::string s)
+{
+  for (char &c : s) {
+    c = char(tolower(c));
+  }
+  return s;
+}
+
+/** What the answers so far say, keys in lower case */
+struct Records {
+  std::vector<std::string> instances;                           ///< PTR targets, as received
+  std::map<std::string, std::pair<std::string, uint16_t>> srv; ///< instance -> host, port
+  std::map<std::string, std::string> a;                        ///< host -> address
+  std::map<std::string, std::string> source;                   ///< instance -> address the answer came from
+};
+
+void parseResponse(const uint8_t *msg, size_t length, std::string const &serviceType, std::string const &from,
+                   Records &records)
+{
+  if (length < 12 || !(msg[2] & 0x80)) {
+    return;
+  }
+  int numQuestions = (msg[4] << 8) | msg[5];
+  int numRecords = ((msg[6] << 8) | msg[7]) + ((msg[8] << 8) | msg[9]) + ((msg[10] << 8) | msg[11]);
+  size_t pos = 12;
+  std::string name, target;
+  for (int i = 0; i < numQuestions; i++) {
+    if (!readName(msg, length, pos, name) || pos + 4 > length) {
+      return;
+    }
+    pos += 4;
+  }
+  for (int i = 0; i < numRecords; i++) {
+    if (!readName(msg, length, pos, name) || pos + 10 > length) {
+      return;
+    }
+    uint16_t type = (msg[pos] << 8) | msg[pos + 1];
+    uint16_t dataLength = (msg[pos + 8] << 8) | msg[pos + 9];
+    pos += 10;
+    size_t dataPos = pos;
+    if (pos + dataLength > length) {
+      return;
+    }
+    pos += dataLength;
+    name = lower(name);
+
+    if (type == TYPE_PTR && name == serviceType) {
+      if (readName(msg, length, dataPos, target)) {
+        records.instances.push_back(target);
+        records.source[lower(target)] = from;
+      }
+    } else if (type == TYPE_SRV && dataLength >= 6) {
+      uint16_t port = (msg[dataPos + 4] << 8) | msg[dataPos + 5];
+      dataPos += 6;
+      if (readName(msg, length, dataPos, target)) {
+        records.srv[name] = {lower(target), port};
+      }
+    } else if (type == TYPE_A && dataLength == 4) {
+      char address[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, msg + dataPos, address, sizeof(address));
+      records.a[name] = address;
+    }
+  }
+}
+
+void appendName(std::vector<uint8_t> &out, std::string const &dotted)
+{
+  size_t start = 0;
+  while (start < dotted.size()) {
+    size_t end = dotted.find('.', start);
+    if (end == std::string::npos) {
+      end = dotted.size();
+    }
+    out.push_back(uint8_t(end - start));
+    out.insert(out.end(), dotted.begin() + start, dotted.begin() + end);
+    start = end + 1;
+  }
+  out.push_back(0);
+}
+
+} // namespace
+
+bool browseMdns(std::string const &serviceType, int timeoutMs, std::vector<MdnsService> &services,
+                std::string &error)
+{
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  unsigned char ttl = 255;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+  uint16_t id = uint16_t(monotonicMs());
+  std::vector<uint8_t> query = {uint8_t(id >> 8), uint8_t(id & 0xff), 0, 0, 0, 1, 0, 0, 0, 0, 0, 0};
+  appendName(query, serviceType);
+  query.insert(query.end(), {0, TYPE_PTR, 0, 1});
+
+  struct sockaddr_in group = {};
+  group.sin_family = AF_INET;
+  group.sin_port = htons(5353);
+  inet_aton("224.0.0.251", &group.sin_addr);
+  if (sendto(fd, query.data(), query.size(), 0, reinterpret_cast<struct sockaddr *>(&group), sizeof(group)) < 0) {
+    error = std::string("sending mDNS query: ") + strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  Records records;
+  std::string type = lower(serviceType);
+  int64_t deadline = monotonicMs() + timeoutMs;
+  int64_t now;
+  while ((now = monotonicMs()) < deadline) {
+    struct pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, int(deadline - now)) != 1) {
+      continue;
+    }
+    uint8_t buf[9000];
+    struct sockaddr_in from = {};
+    socklen_t fromLength = sizeof(from);
+    ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<struct sockaddr *>(&from), &fromLength);
+    if (n > 0) {
+      char address[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &from.sin_addr, address, sizeof(address));
+      parseResponse(buf, size_t(n), type, address, records);
+    }
+  }
+  close(fd);
+
+  services.clear();
+  for (std::string const &instance : records.instances) {
+    auto srv = records.srv.find(lower(instance));
+    if (srv == records.srv.end()) {
+      continue;
+    }
+    MdnsService s;
+    s.instance = instance.substr(0, instance.size() - type.size() - 1);
+    s.port = srv->second.second;
+    auto a = records.a.find(srv->second.first);
+    s.address = a != records.a.end() ? a->second : records.source[lower(instance)];
+    bool duplicate = false;
+    for (MdnsService const &other : services) {
+      duplicate |= other.instance == s.instance && other.address == s.address && other.port == s.port;
+    }
+    if (!duplicate) {
+      services.push_back(s);
+    }
+  }
+  return true;
+}
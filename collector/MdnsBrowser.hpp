@@ -0,0 +1,23 @@
+#pragma once
+
+// DNS-SD over mDNS: finds the instances of a service type on the local network.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct MdnsService {
+  std::string instance; ///< e.g. "TestAP" (of "TestAP._http._tcp.local")
+  std::string address;  ///< IPv4, dotted
+  uint16_t port = 0;
+};
+
+/**
+ * Asks for the instances of serviceType (e.g. "_http._tcp.local") and collects the answers
+ * for timeoutMs. The query is sent from an ephemeral port ("legacy unicast", RFC 6762
+ * section 6.7), so the responders answer directly, and no mDNS daemon running on this
+ * machine is disturbed.
+ * @return false if the query could not be sent (error describes why)
+ */
+bool browseMdns(std::string const &serviceType, int timeoutMs, std::vector<MdnsService> &services,
+                std::string &error);
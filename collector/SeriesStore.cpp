@@ -0,0 +1,157 @@
+#include "SeriesStore.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+bool Series::open(std::string const &basePath, bool writable, std::string &error)
+{
+  if (!_time.open(basePath + ".time", writable, error) || !_value.open(basePath + ".value", writable, error) ||
+      !_index.open(basePath + ".index", writable, error)) {
+    return false;
+  }
+  // A crash between the appends of the columns leaves the value and index columns ahead of the time column
+  if (_value.size() < _time.size()) {
+    error = basePath + ": columns differ in length";
+    return false;
+  }
+  if (writable) {
+    _value.truncate(_time.size());
+    size_t numEntries = (_time.size() + INDEX_STRIDE - 1) / INDEX_STRIDE;
+    _index.truncate(numEntries);
+  }
+  return true;
+}
+
+long Series::append(int64_t const *timesMs, float const *values, size_t n, std::string &error)
+{
+  size_t first = 0;
+  if (size() > 0) {
+    int64_t last = _time.back();
+    while (first < n && timesMs[first] <= last) {
+      first++;
+    }
+  }
+  size_t count = n - first;
+  if (count == 0) {
+    return 0;
+  }
+  for (size_t i = first + 1; i < n; i++) {
+    if (timesMs[i] <= timesMs[i - 1]) {
+      error = "sample times not increasing";
+      return -1;
+    }
+  }
+
+  // Values first: the time column decides what readers see, the index follows it
+  size_t row = size();
+  if (!_value.append(values + first, count, error) || !_time.append(timesMs + first, count, error)) {
+    return -1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if ((row + i) % INDEX_STRIDE == 0) {
+      IndexEntry entry = {timesMs[first + i], uint64_t(row + i)};
+      if (!_index.append(&entry, 1, error)) {
+        return -1;
+      }
+    }
+  }
+  return long(count);
+}
+
+size_t Series::lowerBound(int64_t t) const
+{
+  size_t n = size();
+  size_t numEntries = _index.size();
+  // Block from the index: the last entry with time < t (entries cover rows [row, row + INDEX_STRIDE))
+  IndexEntry const *entries = _index.data();
+  IndexEntry const *it = std::lower_bound(entries, entries + numEntries, t,
+                                          [](IndexEntry const &e, int64_t v) { return e.timeMs < v; });
+  size_t blockStart = it == entries ? 0 : size_t((it - 1)->row);
+  size_t blockEnd = it == entries + numEntries ? n : std::min(n, size_t(it->row));
+  int64_t const *times = _time.data();
+  return size_t(std::lower_bound(times + blockStart, times + blockEnd, t) - times);
+}
+
+std::pair<size_t, size_t> Series::range(int64_t fromMs, int64_t toMs) const
+{
+  if (size() == 0 || fromMs >= toMs) {
+    return {0, 0};
+  }
+  return {lowerBound(fromMs), lowerBound(toMs)};
+}
+
+void Series::sync()
+{
+  _time.sync();
+  _value.sync();
+  _index.sync();
+}
+
+Series *SeriesStore::series(std::string const &device, std::string const &sensor, std::string &error)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto key = std::make_pair(device, sensor);
+  auto it = _series.find(key);
+  if (it != _series.end()) {
+    return it->second.get();
+  }
+  if (_writable) {
+    std::error_code ec;
+    std::filesystem::create_directories(devicePath(device), ec);
+  }
+  auto s = std::make_unique<Series>();
+  if (!s->open(devicePath(device) + "/" + sensor, _writable, error)) {
+    return nullptr;
+  }
+  return (_series[key] = std::move(s)).get();
+}
+
+std::vector<SeriesStore::SeriesId> SeriesStore::list() const
+{
+  std::vector<SeriesId> result;
+  std::error_code ec;
+  for (auto const &deviceDir : std::filesystem::directory_iterator(_root, ec)) {
+    if (!deviceDir.is_directory()) {
+      continue;
+    }
+    for (auto const &file : std::filesystem::directory_iterator(deviceDir.path(), ec)) {
+      if (file.path().extension() == ".time") {
+        result.push_back({deviceDir.path().filename().string(), file.path().stem().string()});
+      }
+    }
+  }
+  std::sort(result.begin(), result.end(), [](SeriesId const &a, SeriesId const &b) {
+    return a.device != b.device ? a.device < b.device : a.sensor < b.sensor;
+  });
+  return result;
+}
+
+std::string SeriesStore::sensorName(std::string const &device, std::string const &sensor) const
+{
+  std::ifstream in(devicePath(device) + "/" + sensor + ".name");
+  std::string name;
+  std::getline(in, name);
+  return name;
+}
+
+void SeriesStore::setSensorName(std::string const &device, std::string const &sensor, std::string const &name)
+{
+  if (sensorName(device, sensor) != name) {
+    std::ofstream(devicePath(device) + "/" + sensor + ".name") << name << "\n";
+  }
+}
+
+std::string SeriesStore::sanitize(std::string const &name)
+{
+  std::string result = name;
+  for (char &c : result) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '_' && c != '-') {
+      c = '_';
+    }
+  }
+  if (result.empty() || result[0] == '.') {
+    result.insert(result.begin(), '_');
+  }
+  return result;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// Time series of the sensors of all units, one directory per unit:
+//
+//   <root>/<device>/<sensor id>.time    sample times, int64 ms since the epoch (ColumnFile)
+//   <root>/<device>/<sensor id>.value   sample values, float degrees Celsius (ColumnFile)
+//   <root>/<device>/<sensor id>.index   (time, row) of every INDEX_STRIDE-th row (ColumnFile)
+//   <root>/<device>/<sensor id>.name    name of the sensor, as last seen
+//   <root>/<device>/state               where collecting left off (see Collector.cpp)
+
+#include "ColumnFile.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Series
+{
+public:
+  static const size_t INDEX_STRIDE = 512;
+
+  struct IndexEntry {
+    int64_t timeMs;
+    uint64_t row;
+  };
+
+  bool open(std::string const &basePath, bool writable, std::string &error);
+
+  size_t size() const { return _time.size(); }
+  int64_t timeMs(size_t row) const { return _time[row]; }
+  float value(size_t row) const { return _value[row]; }
+
+  /**
+   * Appends the samples later than the last one stored (times must increase), the rest is skipped.
+   * @return number of samples appended, -1 on errors
+   */
+  long append(int64_t const *timesMs, float const *values, size_t n, std::string &error);
+
+  /** Rows [first, last) with fromMs <= time < toMs, found through the index in O(log n) */
+  std::pair<size_t, size_t> range(int64_t fromMs, int64_t toMs) const;
+
+  void sync();
+
+private:
+  /** First row with time >= t */
+  size_t lowerBound(int64_t t) const;
+
+  ColumnFile<int64_t> _time;
+  ColumnFile<float> _value;
+  ColumnFile<IndexEntry> _index;
+};
+
+class SeriesStore
+{
+public:
+  explicit SeriesStore(std::string root, bool writable) : _root(std::move(root)), _writable(writable) {}
+
+  std::string const &root() const { return _root; }
+
+  /**
+   * The series of a sensor of a device, opened on first use (and created if writable).
+   * Thread safe; different series may be used from different threads.
+   * @return nullptr on errors (described in error)
+   */
+  Series *series(std::string const &device, std::string const &sensor, std::string &error);
+
+  struct SeriesId {
+    std::string device;
+    std::string sensor;
+  };
+
+  /** All series in the store, sorted */
+  std::vector<SeriesId> list() const;
+
+  /** Name last seen for a sensor, or "" */
+  std::string sensorName(std::string const &device, std::string const &sensor) const;
+  void setSensorName(std::string const &device, std::string const &sensor, std::string const &name);
+
+  std::string devicePath(std::string const &device) const { return _root + "/" + device; }
+
+  /** Directory name for a device name (anything but [A-Za-z0-9._-] replaced) */
+  static std::string sanitize(std::string const &name);
+
+private:
+  std::string _root;
+  bool _writable;
+  mutable std::mutex _mutex;
+  std::map<std::pair<std::string, std::string>, std::unique_ptr<Series>> _series;
+};
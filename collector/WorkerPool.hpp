@@ -0,0 +1,87 @@
+#pragma once
+
+// Fixed number of threads running queued jobs.
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Bounds how many units are talked to at once: submit() queues a job, one of the
+ * workers runs it, wait() returns when all jobs submitted so far are done.
+ */
+class WorkerPool
+{
+public:
+  explicit WorkerPool(unsigned numWorkers)
+  {
+    if (numWorkers == 0) {
+      numWorkers = 1;
+    }
+    for (unsigned i = 0; i < numWorkers; i++) {
+      _threads.emplace_back([this] { run(); });
+    }
+  }
+
+  WorkerPool(WorkerPool const &) = delete;
+  WorkerPool &operator=(WorkerPool const &) = delete;
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stopping = true;
+    }
+    _jobAvailable.notify_all();
+    for (std::thread &t : _threads) {
+      t.join();
+    }
+  }
+
+  void submit(std::function<void()> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _jobs.push_back(std::move(job));
+      _unfinished++;
+    }
+    _jobAvailable.notify_one();
+  }
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _allDone.wait(lock, [this] { return _unfinished == 0; });
+  }
+
+private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _jobAvailable.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+      if (_jobs.empty()) {
+        return; // stopping
+      }
+      std::function<void()> job = std::move(_jobs.front());
+      _jobs.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+      if (--_unfinished == 0) {
+        _allDone.notify_all();
+      }
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _jobAvailable;
+  std::condition_variable _allDone;
+  std::deque<std::function<void()>> _jobs;
+  size_t _unfinished = 0;
+  bool _stopping = false;
+  std::vector<std::thread> _threads;
+};
@@ -0,0 +1,385 @@
+// tempcollector: collects the readings of a fleet of units into a local time series store.
+//
+//   tempcollector collect --data DIR [--device [NAME=]HOST[:PORT]]... [--mdns] [--workers N]
+//                         [--interval S] [--tier 1h|24h] [--period S] [--timeout MS] [--once]
+//   tempcollector query --data DIR [--from T] [--to T] [--device NAME] [--sensor ID]
+//   tempcollector list --data DIR
+//
+// Times for query are seconds since the epoch, ISO 8601 UTC (2024-05-01T12:00:00Z, optionally with .mmm), "now", or
+// relative to now (-2h, -30m, -1d). query writes CSV (time,device,sensor,name,value) sorted by time.
+
+#include "Collector.hpp"
+#include "MdnsBrowser.hpp"
+#include "SeriesStore.hpp"
+#include "WorkerPool.hpp"
+
+#include <signal.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> stopRequested(false);
+
+void onSignal(int) { stopRequested = true; }
+
+int usage()
+{
+  fprintf(stderr,
+          "usage: tempcollector collect --data DIR [--device [NAME=]HOST[:PORT]]... [--mdns] [--workers N]\n"
+          "                             [--interval S] [--tier 1h|24h] [--period S] [--timeout MS] [--once]\n"
+          "       tempcollector query --data DIR [--from T] [--to T] [--device NAME] [--sensor ID]\n"
+          "       tempcollector list --data DIR\n");
+  return 2;
+}
+
+/** Options as name -> values, for "--name value" and flags ("--name", value "") */
+typedef std::map<std::string, std::vector<std::string>> Args;
+
+bool parseArgs(int argc, char **argv, std::vector<std::string> const &flags, Args &args)
+{
+  for (int i = 2; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) != 0) {
+      fprintf(stderr, "unexpected argument %s\n", argv[i]);
+      return false;
+    }
+    std::string name = argv[i] + 2;
+    bool isFlag = false;
+    for (std::string const &f : flags) {
+      isFlag = isFlag || f == name;
+    }
+    if (isFlag) {
+      args[name].push_back("");
+    } else if (i + 1 < argc) {
+      args[name].push_back(argv[++i]);
+    } else {
+      fprintf(stderr, "missing value for --%s\n", name.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string arg(Args const &args, std::string const &name, std::string const &fallback = "")
+{
+  auto it = args.find(name);
+  return it == args.end() ? fallback : it->second.back();
+}
+
+/** @see the header comment; @return false if malformed */
+bool parseTime(std::string const &s, int64_t &ms)
+{
+  if (s == "now") {
+    ms = nowMs();
+    return true;
+  }
+  char *end = nullptr;
+  if (!s.empty() && (s[0] == '-' || s[0] == '+')) {
+    double n = strtod(s.c_str(), &end);
+    double unit = 0;
+    switch (*end) {
+      case 's': unit = 1; break;
+      case 'm': unit = 60; break;
+      case 'h': unit = 3600; break;
+      case 'd': unit = 86400; break;
+    }
+    if (end == s.c_str() || unit == 0 || end[1] != '\0') {
+      return false;
+    }
+    ms = nowMs() + int64_t(n * unit * 1000);
+    return true;
+  }
+  struct tm tm = {};
+  end = strptime(s.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+  if (!end) {
+    end = strptime(s.c_str(), "%Y-%m-%d", &tm);
+  }
+  int64_t fraction = 0;
+  if (end && *end == '.') { // milliseconds, as written by query
+    int digits = 0;
+    for (end++; isdigit(static_cast<unsigned char>(*end)); end++, digits++) {
+      if (digits < 3) {
+        fraction = fraction * 10 + (*end - '0');
+      }
+    }
+    for (; digits < 3; digits++) {
+      fraction *= 10;
+    }
+  }
+  if (end && (*end == '\0' || strcmp(end, "Z") == 0)) {
+    ms = int64_t(timegm(&tm)) * 1000 + fraction;
+    return true;
+  }
+  double seconds = strtod(s.c_str(), &end);
+  if (end != s.c_str() && *end == '\0') {
+    ms = int64_t(seconds * 1000);
+    return true;
+  }
+  return false;
+}
+
+/** ISO 8601 UTC with milliseconds */
+void formatTime(int64_t ms, char (&buf)[32])
+{
+  time_t seconds = time_t(ms / 1000);
+  struct tm tm;
+  gmtime_r(&seconds, &tm);
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(buf + n, sizeof(buf) - n, ".%03dZ", int(ms % 1000));
+}
+
+/** [NAME=]HOST[:PORT] */
+bool parseDevice(std::string const &s, Device &device)
+{
+  std::string address = s;
+  size_t eq = s.find('=');
+  if (eq != std::string::npos) {
+    device.name = SeriesStore::sanitize(s.substr(0, eq));
+    address = s.substr(eq + 1);
+  }
+  size_t colon = address.rfind(':');
+  device.host = address.substr(0, colon);
+  device.port = 80;
+  if (colon != std::string::npos) {
+    int port = atoi(address.c_str() + colon + 1);
+    if (port < 1 || port > 65535) {
+      return false;
+    }
+    device.port = uint16_t(port);
+  }
+  if (eq == std::string::npos) {
+    device.name = SeriesStore::sanitize(device.host + "_" + std::to_string(device.port));
+  }
+  return !device.host.empty();
+}
+
+int collect(Args const &args)
+{
+  std::vector<Device> staticDevices;
+  if (args.count("device")) {
+    for (std::string const &s : args.at("device")) {
+      Device device;
+      if (!parseDevice(s, device)) {
+        fprintf(stderr, "malformed device %s\n", s.c_str());
+        return 2;
+      }
+      staticDevices.push_back(device);
+    }
+  }
+  bool useMdns = args.count("mdns") != 0;
+  if (staticDevices.empty() && !useMdns) {
+    fprintf(stderr, "no devices: give --device or --mdns\n");
+    return 2;
+  }
+
+  Collector::Options options;
+  options.tier = arg(args, "tier", "1h");
+  if (options.tier != "1h" && options.tier != "24h") {
+    fprintf(stderr, "--tier is 1h or 24h\n");
+    return 2;
+  }
+  options.periodS = atof(arg(args, "period", options.tier == "1h" ? "10" : "60").c_str());
+  options.timeoutMs = atoi(arg(args, "timeout", "5000").c_str());
+  double intervalS = atof(arg(args, "interval", "60").c_str());
+  int numWorkers = atoi(arg(args, "workers", "4").c_str());
+  bool once = args.count("once") != 0;
+  if (options.periodS <= 0 || options.timeoutMs <= 0 || intervalS <= 0 || numWorkers <= 0) {
+    fprintf(stderr, "--period, --timeout, --interval and --workers must be positive\n");
+    return 2;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  SeriesStore store(arg(args, "data"), true);
+  Collector collector(store, options);
+  WorkerPool pool(static_cast<unsigned>(numWorkers));
+  std::vector<Device> discovered;
+  auto lastBrowse = std::chrono::steady_clock::time_point();
+  const auto browseInterval = std::chrono::seconds(60);
+
+  int failures = 0;
+  while (!stopRequested) {
+    auto roundStart = std::chrono::steady_clock::now();
+    if (useMdns && (discovered.empty() || roundStart - lastBrowse >= browseInterval)) {
+      std::vector<MdnsService> services;
+      std::string error;
+      if (browseMdns("_http._tcp.local", 2000, services, error)) {
+        discovered.clear();
+        for (MdnsService const &s : services) {
+          discovered.push_back({SeriesStore::sanitize(s.instance), s.address, s.port});
+        }
+      } else {
+        fprintf(stderr, "mdns: %s\n", error.c_str());
+      }
+      lastBrowse = roundStart;
+    }
+
+    std::vector<Device> devices = staticDevices;
+    devices.insert(devices.end(), discovered.begin(), discovered.end());
+    std::vector<std::string> results(devices.size());
+    std::atomic<int> roundFailures(0);
+    for (size_t i = 0; i < devices.size(); i++) {
+      pool.submit([&, i] {
+        size_t appended = 0;
+        std::string error;
+        if (collector.collect(devices[i], appended, error)) {
+          results[i] = "+" + std::to_string(appended);
+        } else {
+          results[i] = "error: " + error;
+          roundFailures++;
+        }
+      });
+    }
+    pool.wait();
+    for (size_t i = 0; i < devices.size(); i++) {
+      printf("%s (%s:%u): %s\n", devices[i].name.c_str(), devices[i].host.c_str(), devices[i].port,
+             results[i].c_str());
+    }
+    fflush(stdout);
+    failures = roundFailures;
+
+    if (once) {
+      break;
+    }
+    auto next = roundStart + std::chrono::milliseconds(int64_t(intervalS * 1000));
+    while (!stopRequested && std::chrono::steady_clock::now() < next) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+struct Cursor {
+  Series const *series;
+  size_t row;
+  size_t end;
+  std::string const *device;
+  std::string const *sensor;
+  std::string name;
+};
+
+int query(Args const &args)
+{
+  int64_t fromMs = 0;
+  int64_t toMs = INT64_MAX;
+  if ((args.count("from") && !parseTime(arg(args, "from"), fromMs)) ||
+      (args.count("to") && !parseTime(arg(args, "to"), toMs))) {
+    fprintf(stderr, "malformed time\n");
+    return 2;
+  }
+  std::string deviceFilter = arg(args, "device");
+  std::string sensorFilter = arg(args, "sensor");
+
+  SeriesStore store(arg(args, "data"), false);
+  std::vector<SeriesStore::SeriesId> ids = store.list();
+  std::vector<Cursor> cursors;
+  for (SeriesStore::SeriesId const &id : ids) {
+    if ((!deviceFilter.empty() && id.device != deviceFilter) || (!sensorFilter.empty() && id.sensor != sensorFilter)) {
+      continue;
+    }
+    std::string error;
+    Series *series = store.series(id.device, id.sensor, error);
+    if (!series) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    std::pair<size_t, size_t> rows = series->range(fromMs, toMs);
+    if (rows.first < rows.second) {
+      cursors.push_back({series, rows.first, rows.second, &id.device, &id.sensor,
+                         store.sensorName(id.device, id.sensor)});
+    }
+  }
+
+  // Merge the series by time
+  auto later = [&](size_t a, size_t b) {
+    return cursors[a].series->timeMs(cursors[a].row) > cursors[b].series->timeMs(cursors[b].row);
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+  for (size_t i = 0; i < cursors.size(); i++) {
+    heap.push(i);
+  }
+  printf("time,device,sensor,name,value\n");
+  char timeBuf[32];
+  while (!heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    Cursor &c = cursors[i];
+    formatTime(c.series->timeMs(c.row), timeBuf);
+    std::string name = c.name;
+    if (name.find_first_of(",\"") != std::string::npos) {
+      for (size_t p = name.find('"'); p != std::string::npos; p = name.find('"', p + 2)) {
+        name.insert(p, 1, '"');
+      }
+      name = "\"" + name + "\"";
+    }
+    printf("%s,%s,%s,%s,%.2f\n", timeBuf, c.device->c_str(), c.sensor->c_str(), name.c_str(),
+           double(c.series->value(c.row)));
+    if (++c.row < c.end) {
+      heap.push(i);
+    }
+  }
+  return 0;
+}
+
+int list(Args const &args)
+{
+  SeriesStore store(arg(args, "data"), false);
+  printf("device,sensor,name,samples,first,last\n");
+  for (SeriesStore::SeriesId const &id : store.list()) {
+    std::string error;
+    Series *series = store.series(id.device, id.sensor, error);
+    if (!series) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    char first[32] = "";
+    char last[32] = "";
+    if (series->size() > 0) {
+      formatTime(series->timeMs(0), first);
+      formatTime(series->timeMs(series->size() - 1), last);
+    }
+    printf("%s,%s,%s,%zu,%s,%s\n", id.device.c_str(), id.sensor.c_str(),
+           store.sensorName(id.device, id.sensor).c_str(), series->size(), first, last);
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    return usage();
+  }
+  std::string command = argv[1];
+  Args args;
+  if (!parseArgs(argc, argv, {"mdns", "once"}, args)) {
+    return usage();
+  }
+  if (arg(args, "data").empty()) {
+    fprintf(stderr, "--data is required\n");
+    return usage();
+  }
+  if (command == "collect") {
+    return collect(args);
+  }
+  if (command == "query") {
+    return query(args);
+  }
+  if (command == "list") {
+    return list(args);
+  }
+  return usage();
+}
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+
+import csv
+import datetime
+import io
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+import unittest
+import requests
+
+ip = os.getenv("TARGET_IP")
+collector = os.getenv("COLLECTOR")
+
+# The simulation runs with SIM_TIME_SCALE=100: a sample every 0.1 s
+PERIOD = "0.1"
+
+
+def run(*args):
+    return subprocess.run([collector] + list(args), capture_output=True, text=True, timeout=60)
+
+
+class Collector(unittest.TestCase):
+    def setUp(self):
+        self.data = tempfile.mkdtemp(prefix="tempcollector")
+
+    def tearDown(self):
+        shutil.rmtree(self.data)
+
+    def collect(self, *args):
+        r = run("collect", "--data", self.data, "--period", PERIOD, "--once", *args)
+        self.assertEqual(0, r.returncode, r.stdout + r.stderr)
+        return r.stdout
+
+    def query(self, *args):
+        r = run("query", "--data", self.data, *args)
+        self.assertEqual(0, r.returncode, r.stderr)
+        rows = list(csv.reader(io.StringIO(r.stdout)))
+        self.assertEqual(["time", "device", "sensor", "name", "value"], rows[0])
+        return rows[1:]
+
+    def samples_since_boot(self):
+        return requests.get("http://%s/api/readings/1h" % ip).json()["samples_since_boot"]
+
+    def times_of(self, rows, sensor):
+        return [datetime.datetime.strptime(r[0], "%Y-%m-%dT%H:%M:%S.%fZ").replace(tzinfo=datetime.timezone.utc).timestamp()
+                for r in rows if r[2] == sensor]
+
+    def test_incremental_collection(self):
+        sensors = requests.get("http://%s/api/readings/1h" % ip).json()["sensors"]
+        ids = set(s["id"] for s in sensors)
+
+        before = self.samples_since_boot()
+        out = self.collect("--device", "unit=" + ip)
+        after = self.samples_since_boot()
+        self.assertIn("unit (", out)
+        rows = self.query()
+        counts = {i: sum(1 for r in rows if r[2] == i) for i in ids}
+        for n in counts.values():
+            self.assertTrue(min(before, 360) <= n <= min(after, 360), (before, after, n))
+
+        # Only the samples taken in between are added
+        time.sleep(1)
+        before = self.samples_since_boot()
+        self.collect("--device", "unit=" + ip)
+        after = self.samples_since_boot()
+        rows = self.query()
+        for i in ids:
+            series = [r for r in rows if r[2] == i]
+            self.assertTrue(min(before, 360) <= len(series) <= after)
+            self.assertTrue(len(series) > counts[i])
+            times = [r[0] for r in series]
+            self.assertEqual(sorted(set(times)), times)
+            self.assertTrue(all(r[1] == "unit" for r in series))
+        names = dict((s["id"], s["name"]) for s in sensors)
+        self.assertTrue(all(r[3] == names[r[2]] for r in rows))
+
+        # Merged by time, and range queries return the matching subset
+        self.assertEqual(sorted(r[0] for r in rows), [r[0] for r in rows])
+        middle = rows[len(rows) // 2][0]
+        newer = self.query("--from", middle)
+        self.assertEqual([r for r in rows if r[0] >= middle], newer)
+        older = self.query("--to", middle, "--sensor", sensors[0]["id"])
+        self.assertEqual([r for r in rows if r[0] < middle and r[2] == sensors[0]["id"]], older)
+        self.assertEqual([], self.query("--from", "-1d", "--to", "-23h"))
+
+    def test_parallel_devices(self):
+        # The same unit under several names, fetched by two workers
+        devices = []
+        for n in range(5):
+            devices += ["--device", "unit%d=%s" % (n, ip)]
+        out = self.collect("--workers", "2", *devices)
+        self.assertEqual(5, out.count(": +"), out)
+        r = run("list", "--data", self.data)
+        self.assertEqual(0, r.returncode)
+        self.assertEqual(set("unit%d" % n for n in range(5)),
+                         set(row[0] for row in list(csv.reader(io.StringIO(r.stdout)))[1:]))
+
+    def test_placeholders_skipped(self):
+        # A sensor served from now on: the readings before it are not its own
+        sensors = requests.get("http://%s/api/sensors" % ip).json()["sensors"]
+        sensor = next(s["id"] for s in sensors if not s["active"])
+        r = requests.patch("http://%s/api/sensors/%s" % (ip, sensor), json={"active": 1})
+        self.assertEqual(200, r.status_code)
+        try:
+            served = next(s for s in requests.get("http://%s/api/readings/1h" % ip).json()["sensors"]
+                          if s["id"] == sensor)
+            time.sleep(0.5)
+            self.collect("--device", "unit=" + ip)
+            after = self.samples_since_boot()
+            n = len(self.times_of(self.query(), sensor))
+            self.assertTrue(1 <= n <= after - served["served_from"], (n, after, served["served_from"]))
+        finally:
+            requests.patch("http://%s/api/sensors/%s" % (ip, sensor), json={"active": 0})
+
+    def test_unreachable_device(self):
+        r = run("collect", "--data", self.data, "--once", "--timeout", "500", "--device", "127.0.0.1:1")
+        self.assertEqual(1, r.returncode)
+        self.assertIn("error", r.stdout)
+
+    def test_mdns_discovery(self):
+        out = self.collect("--mdns")
+        port = ip.partition(":")[2]
+        self.assertIn("TestAP (127.0.0.1:%s): +" % port, out)
+        self.assertTrue(os.path.isdir(os.path.join(self.data, "TestAP")))
+
+    def test_wall_clock_dating(self):
+        # Runs last: the unit keeps the time set here
+        if requests.get("http://%s/api/time" % ip).json()["now"] is None:
+            r = requests.post("http://%s/api/time" % ip, json={"now": 1800000000})
+            self.assertEqual(200, r.status_code)
+        deadline = time.monotonic() + 10
+        while requests.get("http://%s/api/readings?tier=1h" % ip).status_code != 200:  # until a reading is dated
+            self.assertTrue(time.monotonic() < deadline)
+            time.sleep(0.05)
+        period = requests.get("http://%s/api/readings?tier=1h" % ip).json()["period_s"]
+
+        # Dated by the unit, one period apart, also across fetches (the second one only takes the new readings)
+        self.collect("--device", "unit=" + ip)
+        sensor = requests.get("http://%s/api/readings/1h" % ip).json()["sensors"][0]["id"]
+        first = self.times_of(self.query(), sensor)
+        time.sleep(0.5)
+        self.collect("--device", "unit=" + ip)
+        times = self.times_of(self.query(), sensor)
+        self.assertTrue(len(times) > len(first))
+        self.assertEqual(first, times[:len(first)])
+        self.assertTrue(all(b - a == period for a, b in zip(times, times[1:])))
+        now = requests.get("http://%s/api/time" % ip).json()["now"]
+        self.assertTrue(now - 2 * period <= times[-1] <= now, (times[-1], now))
+
+
+if __name__ == "__main__":
+    unittest.main()
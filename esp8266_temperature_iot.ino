@@ -28,7 +28,6 @@
 // https://tttapa.github.io/ESP8266/Chap11%20-%20SPIFFS.html
 //https://github.com/pellepl/spiffs/wiki/FAQ
 
-// TODO: FW update in web interface
 // TODO: split program up (include .h and .cpp-files into the sketch, but edit elsewhere?)
 // TODO: Should we do something when an interface disconnects / reconnects: https://arduino-esp8266.readthedocs.io/en/latest/esp8266wifi/generic-class.html
 // TODO: warn if softAP and network overlaps (web server only serves on one interface in that case)
@@ -42,13 +41,21 @@
 #include <ArduinoJson.h>
 #include <FS.h>
 #include <Wire.h>
+#include <new>
 
 #include "CircularBuffer.hpp"
+#include "RollingStats.hpp"
+#include "CompressedSeries.hpp"
+#include "HttpServer.hpp"
 #include "Mcp3208.hpp"
 
+const unsigned long sample_tick_ms = 1000UL; // sample timer period, the sensors' sample periods are multiples of it
 const unsigned long time_between_1h_readings_ms = 10000UL; // 1000 ms seemed stable
 #define NUM_SAMPLES_AVERAGED_FOR_24H_SAMPLE 6
 const unsigned long time_between_24h_readings_ms = 60000UL;
+static_assert(time_between_1h_readings_ms % sample_tick_ms == 0, "1h readings are made every n:th sample timer tick");
+static_assert(time_between_24h_readings_ms % time_between_1h_readings_ms == 0, "24h readings are made every n:th 1h reading");
+const int readings_per_hour = 3600000UL / time_between_1h_readings_ms;
 
 const int externalLED = 5; // (labeld D1 on PCB)
 
@@ -109,42 +116,142 @@ ConfigNetwork configNetwork;
 #include "ConfigPresentation.hpp"
 ConfigPresentation configPresentation;
 
+#include "ConfigMqtt.hpp"
+ConfigMqtt configMqtt;
+
+#include "ConfigAlerts.hpp"
+ConfigAlerts configAlerts;
+
+#include "ConfigTime.hpp"
+ConfigTime configTime;
+
 bool serveFromSpiffs(String const & uri, const char* contenttype="text/html");
-String deviceAddressToString(DeviceAddress const & da);
+void deviceAddressToString(DeviceAddress const & da, char (&str)[17]);
 void stringToDeviceAddress(DeviceAddress da, String const & id);
-String sensorToString(int allSensorIndex);
+void sensorToString(String & s, int allSensorIndex);
+void populateServedSensors();
+bool addServedSensor(int allSensorIndex);
+void updateServedSensors();
+void mergeOneWireSensors();
+void applySensorResolution(int allSensorIndex);
+void mqttConfigure();
+void wallClockConfigure();
+void mqttPublishAlerts();
+void showAlerts();
+float ntcAdcToCelsius(int adc_in);
 
 
-ESP8266WebServer server(80);
+HttpServer server(80);
 
 #include "Sensor.hpp"
 #include "ConfigSensors.hpp"
+#include "AllocationStats.hpp"
+#include "WifiScan.hpp"
+#include "MqttClient.hpp"
+#include "OtaUpdate.hpp"
+#include "SampleTimer.hpp"
+#include "OneWireDiscovery.hpp"
+#include "Alerts.hpp"
+#include "WallClock.hpp"
+#include "TimeIndex.hpp"
+
+MqttClient mqtt;
+WallClock wallClock;
+bool mqttStatePending = false; ///< sensor state to (re)publish, retained
+int mqttStateNext = 0;         ///< next sensor of the state being published
 
 
 struct ServedSensor {
-  int allSensorsIndex;
+  enum { NUM_READINGS_1H = 360, NUM_READINGS_24H = 1440 };
+  int allSensorsIndex = -1;     ///< -1 while the entry is free
+  uint32_t firstReading_1h = 0; ///< num_samples_since_boot_1h when it started to be served
+  uint32_t firstReading_24h = 0; ///< num_samples_since_boot_24h when its 24h readings (last) started over
 //  inline float const getReading_1h(int index) const { return vtof(_readings_1h[index]); }
 //  inline float const getReading_24h(int index) const { return vtof(_readings_24h[index]); }
-  inline String const getReading_1h(int index) const { return vtos(_readings_1h[index]); }
   inline int16_t const getReading_1h_raw(int index) const { return _readings_1h[index]; }
-  inline String const getReading_24h(int index) const { return vtos(_readings_24h[index]); }
+  /**
+   * Reading index of getNumReadings_24h(), oldest first. Reconstructed if they are stored compressed,
+   * those before the oldest one retained (a noisy sensor) repeat it
+   */
+  inline int16_t const getReading_24h_raw(int index) const
+  {
+    if (_compressed_24h) {
+      return _readings_24h.compressed[max(0, _readings_24h.compressed.size() - NUM_READINGS_24H + index)];
+    }
+    return _readings_24h.plain[index];
+  }
+  /** Copies count readings from index on, as contiguous pieces of the buffer */
+  inline void copyReadings_1h_raw(int index, int16_t* out, int count) const { _readings_1h.copy_out(index, out, count); }
+  /** As copyReadings_1h_raw(), reconstructed one by one if the 24h readings are stored compressed */
+  inline void copyReadings_24h_raw(int index, int16_t* out, int count) const
+  {
+    if (_compressed_24h) {
+      for (int i = 0; i < count; i++) {
+        out[i] = getReading_24h_raw(index + i);
+      }
+      return;
+    }
+    _readings_24h.plain.copy_out(index, out, count);
+  }
 
-  inline void addReading_1h(float value) { _readings_1h.push_back_erase_if_full(ftov(value)); }
-  inline void addReading_24h(float value) { _readings_24h.push_back_erase_if_full(ftov(value)); }
-  inline void addReading_24h_raw(int16_t raw) { _readings_24h.push_back_erase_if_full(raw); }
+  inline void addReading_1h(float value) { addReading_1h_raw(ftov(value)); }
+  inline void addReading_24h(float value) { addReading_24h_raw(ftov(value)); }
+  inline void addReading_24h_raw(int16_t raw)
+  {
+    if (_compressed_24h) {
+      _readings_24h.compressed.push(raw);
+    } else {
+      _readings_24h.plain.push_back_erase_if_full(raw);
+    }
+  }
 
   inline int getNumReadings_1h() const { return _readings_1h.size(); }
-  inline int getNumReadings_24h() const { return _readings_24h.size(); }
+  inline int getNumReadings_24h() const { return _compressed_24h ? NUM_READINGS_24H : _readings_24h.plain.size(); }
+  /** 24h readings there are: more than served when stored compressed, and the sensor is quiet */
+  inline int getNumRetained_24h() const { return _compressed_24h ? _readings_24h.compressed.size() : _readings_24h.plain.size(); }
+  /** Degrees (hundredths) the 24h readings may be off, stored compressed; 0 if they are stored in full */
+  inline int16_t getCompression_24h() const { return _compressed_24h ? _readings_24h.compressed.deviation() : 0; }
 
   inline void fill_1h(float val) { _readings_1h.fill(ftov(val)); }
-  inline void fill_24h(float val) { _readings_24h.fill(ftov(val)); }
-private:
-  int16_t ftov(float v) const {
+  /** All 24h readings val, stored in full, or compressed within deviation (hundredths of a degree) */
+  inline void fill_24h(float val, int16_t deviation = 0)
+  {
+    if (deviation != 0) {
+      new (&_readings_24h.compressed) CompressedSeries<NUM_READINGS_24H / 2>();
+      _readings_24h.compressed.reset(deviation, ftov(val), NUM_READINGS_24H);
+    } else {
+      new (&_readings_24h.plain) CircularBuffer<int16_t, NUM_READINGS_24H>();
+      _readings_24h.plain.fill(ftov(val));
+    }
+    _compressed_24h = deviation != 0;
+  }
+
+  /** Adds a sample towards the next 1h reading */
+  inline void addSample(float value) { _slotSum += ftov(value); _slotCount++; }
+  /**
+   * Adds the average of the samples since the last call as 1h reading, or repeats the last
+   * reading if there were none (the sensor is sampled less often than the 1h readings are made).
+   */
+  inline void closeSlot_1h()
+  {
+    addReading_1h_raw(_slotCount ? int16_t(_slotSum / _slotCount) : _readings_1h[_readings_1h.size() - 1]);
+    clearSlot_1h();
+  }
+
+  /** Rolling statistics of the last 1h readings (of at most the last numReadings), over windowS seconds */
+  inline void resetStats_1h(int windowS, int numReadings)
+  {
+    _stats_1h.reset(_readings_1h, windowS * 1000L / time_between_1h_readings_ms, numReadings);
+  }
+  inline RollingStats<int16_t, 360> const & getStats_1h() const { return _stats_1h; }
+  inline void clearSlot_1h() { _slotSum = 0; _slotCount = 0; }
+
+  static int16_t ftov(float v) {
     return int16_t(v * 100);
     //return int16_t(v * 16);
   }
-  String vtos(int16_t v) const {
-    char real_buff[12];
+  /** Format a stored value with two decimals into real_buff (no heap allocation) */
+  static char* vtos(int16_t v, char (&real_buff)[12]) {
     int end = snprintf(real_buff, sizeof(real_buff), "%d", v);
     char* buff = real_buff;
     if (buff[0] == '-') {
@@ -166,24 +273,81 @@ private:
 
     return real_buff;
   }
-//  float vtof(int16_t v) const {
-//    return v * 0.0625f;
-//  }
+  static float vtof(float v) {
+    return v / 100;
+  }
+
+private:
+  inline void addReading_1h_raw(int16_t raw)
+  {
+    _stats_1h.push(_readings_1h, raw);
+    _readings_1h.push_back_erase_if_full(raw);
+  }
 
-  CircularBuffer<int16_t, 360> _readings_1h;
-  CircularBuffer<int16_t, 1440> _readings_24h;
+  CircularBuffer<int16_t, NUM_READINGS_1H> _readings_1h;
+  RollingStats<int16_t, 360> _stats_1h;
+  /** The 24h readings, in full or (about the same memory) as points of a CompressedSeries */
+  union Readings24h {
+    CircularBuffer<int16_t, NUM_READINGS_24H> plain;
+    CompressedSeries<NUM_READINGS_24H / 2> compressed;
+    Readings24h() : plain() {}
+    ~Readings24h() {}
+  } _readings_24h;
+  bool _compressed_24h = false;
+  int32_t _slotSum = 0;
+  uint16_t _slotCount = 0;
 };
 
+static_assert(ConfigSensors::MAX_STATS_WINDOW_S * 1000UL / time_between_1h_readings_ms <= 360, "the rolling statistics are over the 1h readings");
+
 String scratchpad;
 
 uint32_t num_samples_since_boot_1h = 0;
 uint32_t num_samples_since_boot_24h = 0;
-const int16_t maxNumServedSensors = 6;
-int16_t numServedSensors = 0;
-ServedSensor servedSensors[maxNumServedSensors] = {{}, {}, {}, {}, {}, {}}; // internal compiler error if only '= {};'
+/** Wall-clock times of the readings (numbered by num_samples_since_boot_*), once the clock is set */
+TimeIndex<8> timeIndex_1h(time_between_1h_readings_ms / 1000);
+TimeIndex<8> timeIndex_24h(time_between_24h_readings_ms / 1000);
+const uint32_t time_index_tolerance_s = 2; ///< the clock may move this far from the readings before they are anchored again
+#ifndef MAX_NUM_SERVED_SENSORS
+#define MAX_NUM_SERVED_SENSORS 6
+#endif
+const int16_t maxNumServedSensors = MAX_NUM_SERVED_SENSORS;
+int16_t numServedSensors = 0; ///< entries of servedSensors in use
+/**
+ * The readings of the active sensors (the first maxNumServedSensors of them). A pool: the entry of a
+ * sensor deactivated is free for the next one activated, the others stay where they are.
+ */
+ServedSensor servedSensors[maxNumServedSensors]; // internal compiler error if '= {};'
+
+/** @return the servedSensors entry of sensor allSensorsIndex, -1 if it is not served */
+int findServedSensor(int allSensorsIndex)
+{
+  for (int j = 0; j < maxNumServedSensors; j++)
+  {
+    if (servedSensors[j].allSensorsIndex == allSensorsIndex) {
+      return j;
+    }
+  }
+  return -1;
+}
+
+/** @return the servedSensors entry of the first sensor served from allSensorsIndex on (in configSensors order), -1 if none */
+int nextServedSensor(int allSensorsIndex)
+{
+  int next = -1;
+  for (int j = 0; j < maxNumServedSensors; j++)
+  {
+    int i = servedSensors[j].allSensorsIndex;
+    if (i >= allSensorsIndex && (next < 0 || i < servedSensors[next].allSensorsIndex)) {
+      next = j;
+    }
+  }
+  return next;
+}
 
 void handleSettings()
 {
+  AllocationScope scope(AllocationStats::Static);
   // When running tests against main.html requiring a web server on the other end
   // one could run this in the source folder:
   // python3 -m http.server --bind 127.0.0.1
@@ -199,6 +363,7 @@ void handleSettings()
 
 void handleRoot()
 {
+  AllocationScope scope(AllocationStats::Static);
   // When running tests against main.html requiring a web server on the other end
   // one could run this in the source folder:
   // python3 -m http.server --bind 127.0.0.1
@@ -212,10 +377,16 @@ void handleRoot()
 }
 
 
-String getSensorStart(int allSensorsIndex) {
-  Sensor const & sensor = configSensors.allSensors[allSensorsIndex];
-  String s = "{\"id\":\"" + String(sensor.id) + "\", \"type\":\"" + toString(sensor.type) + "\", \"name\":\"" + String(sensor.name) + "\", \"readings\":[";
-  return s;
+/**
+ * Write the start of the readings of served sensor j (up to the opening bracket of the values) to buf,
+ * @return its length. "served_from" is the number of its first real reading, those before are placeholders
+ */
+size_t getSensorStart(char* buf, size_t size, int j, bool serve24h) {
+  Sensor const & sensor = configSensors.allSensors[servedSensors[j].allSensorsIndex];
+  int len = snprintf(buf, size, "{\"id\":\"%s\", \"type\":\"%s\", \"name\":\"%s\", \"served_from\":%lu, \"readings\":[",
+                     sensor.id, toString(sensor.type), sensor.name,
+                     (unsigned long)(serve24h ? servedSensors[j].firstReading_24h : servedSensors[j].firstReading_1h));
+  return min(size_t(len), size - 1);
 }
 
 
@@ -227,17 +398,17 @@ bool serveFromSpiffs(String const & uri, const char* contenttype)
     return false;
   }
 
-  String path = "/html";
-  if (!uri.startsWith("/")) {
-    path += "/";
+  char path[64];
+  int len = snprintf(path, sizeof(path), "/html%s%s", uri[0] == '/' ? "" : "/", uri.c_str());
+  if (len >= int(sizeof(path)))
+  {
+    return false;
   }
-  path += uri;
 
   if (SPIFFS.exists(path))
   {
     File file = SPIFFS.open(path, "r");
-    size_t sent = server.streamFile(file, contenttype);
-    file.close();
+    server.streamFile(file, contenttype); // closed by the server once sent
     return true;
   }
   
@@ -293,6 +464,7 @@ void returnConfigReplaceField(const char* location, const char* fieldToReplace,
 
 void handlePresentation()
 {
+  AllocationScope scope(AllocationStats::Config);
   if (server.method() == HTTP_GET)
   {
     returnConfigReplaceField("/config/presentation", nullptr, nullptr);
@@ -322,6 +494,7 @@ void handlePresentation()
 
 void handleWifiSoftAP()
 {
+  AllocationScope scope(AllocationStats::Config);
   if (server.method() == HTTP_GET)
   {
     returnConfigReplaceField("/config/wifi/softap", "password", "********");
@@ -351,6 +524,7 @@ void handleWifiSoftAP()
 
 void handleWifiNetwork()
 {
+  AllocationScope scope(AllocationStats::Config);
   if (server.method() == HTTP_GET)
   {
     returnConfigReplaceField("/config/wifi/network", "password", "********");
@@ -378,8 +552,229 @@ void handleWifiNetwork()
   }
 }
 
+void handleWifiScan()
+{
+  AllocationScope scope(AllocationStats::Config);
+  if (server.method() != HTTP_GET)
+  {
+    sendError("only HTTP_GET supported");
+    return;
+  }
+
+  if (server.hasArg("rescan"))
+  {
+    wifiScan.start(); // ignored if the last scan was started too recently
+  }
+  else
+  {
+    wifiScan.startIfStale();
+  }
+
+  const size_t capacity = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(WifiScan::MAX_NETWORKS) +
+                          WifiScan::MAX_NETWORKS * JSON_OBJECT_SIZE(4);
+  StaticJsonDocument<capacity> json;
+  json["state"] = WifiScan::toString(wifiScan.state());
+  if (wifiScan.hasResult())
+  {
+    json["age_s"] = wifiScan.resultAge() / 1000;
+  }
+  JsonArray networks = json.createNestedArray("networks");
+  for (int i = 0; i < wifiScan.numNetworks(); i++)
+  {
+    WifiScan::Network const & n = wifiScan.network(i);
+    JsonObject network = networks.createNestedObject();
+    network["ssid"] = n.ssid;
+    network["rssi"] = n.rssi;
+    network["channel"] = n.channel;
+    network["encryption"] = WifiScan::encryptionToString(n.encryption);
+  }
+
+  String & s = scratchpad;
+  s = "";
+  serializeJson(json, s);
+  if (!wifiScan.hasResult() && wifiScan.state() == WifiScan::SCANNING)
+  {
+    // Nothing to show yet, come back when the scan should be done
+    server.sendHeader("Retry-After", "3");
+    server.send(202, "application/javascript", s);
+  }
+  else
+  {
+    server.send(200, "application/javascript", s);
+  }
+}
+
+void sendUpdateStatus(int code)
+{
+  char buf[256];
+  snprintf(buf, sizeof(buf), "{\"state\":\"%s\", \"target\":\"%s\", \"size\":%lu, \"written\":%lu, "
+           "\"elapsed_ms\":%lu, \"bytes_per_s\":%lu, \"error\":\"%s\", \"restarting\":%d}\n",
+           OtaUpdate::toString(otaUpdate.state()), OtaUpdate::toString(otaUpdate.target()),
+           (unsigned long)otaUpdate.size(), (unsigned long)otaUpdate.written(), otaUpdate.elapsed(),
+           otaUpdate.bytesPerSecond(), otaUpdate.error(), otaUpdate.state() == OtaUpdate::DONE ? 1 : 0);
+  server.send(code, "application/javascript", buf);
+}
+
+/**
+ * Body of POST /api/update?target=firmware|spiffs&md5=<md5 of the image>, the image itself,
+ * written to flash as it arrives (see OtaUpdate.hpp). HTTP basic authentication as "admin"
+ * with the soft AP password.
+ */
+void handleUpdateUpload(HttpServer::Upload const & upload)
+{
+  AllocationScope scope(AllocationStats::Update, upload.status == HttpServer::Upload::START);
+  switch (upload.status)
+  {
+    case HttpServer::Upload::START:
+    {
+      if (configSoftAP.getPassword()[0] == '\0')
+      {
+        server.send(403, "text/plain", "Updates need a soft AP password\n");
+        return;
+      }
+      if (!server.authenticate("admin", configSoftAP.getPassword()))
+      {
+        server.requestAuthentication("tempviewer");
+        return;
+      }
+      if (otaUpdate.state() == OtaUpdate::RECEIVING)
+      {
+        server.send(409, "text/plain", "Update already running\n");
+        return;
+      }
+      String const target = server.arg("target");
+      if (target != "" && target != "firmware" && target != "spiffs")
+      {
+        sendError("target must be firmware or spiffs");
+        return;
+      }
+      if (!otaUpdate.begin(target == "spiffs" ? OtaUpdate::SPIFFS_IMAGE : OtaUpdate::FIRMWARE,
+                           upload.totalSize, server.arg("md5").c_str()))
+      {
+        sendUpdateStatus(400);
+      }
+      break;
+    }
+    case HttpServer::Upload::WRITE:
+      otaUpdate.write(upload.data, upload.length);
+      break;
+    case HttpServer::Upload::END:
+      otaUpdate.end();
+      break;
+    case HttpServer::Upload::ABORTED:
+      otaUpdate.abort();
+      break;
+  }
+}
+
+/** GET: state and progress of the update being received (or the last one). POST: see handleUpdateUpload() */
+void handleUpdate()
+{
+  AllocationScope scope(AllocationStats::Update, false);
+  if (server.method() == HTTP_GET)
+  {
+    sendUpdateStatus(200);
+  }
+  else if (server.method() == HTTP_POST)
+  {
+    sendUpdateStatus(otaUpdate.state() == OtaUpdate::DONE ? 200 : 400);
+  }
+  else
+  {
+    sendError("???");
+  }
+}
+
+void handleMqtt()
+{
+  AllocationScope scope(AllocationStats::Config);
+  if (server.method() == HTTP_GET)
+  {
+    returnConfigReplaceField("/config/mqtt", "password", "********");
+  }
+  else if (server.method() == HTTP_PATCH && server.hasArg("plain"))
+  {
+    String const json = server.arg("plain");
+
+    bool ok = configMqtt.patch(json.c_str());
+    if (ok && configMqtt.isModified()) {
+      ok = configMqtt.save();
+      mqttConfigure();
+    }
+    if (ok)
+    {
+      server.send(200, "text/plain", "OK");
+    }
+    else
+    {
+      server.send(400, "text/plain", "ERROR"); // TODO: which status code???
+    }
+  }
+  else
+  {
+    sendError("???");
+  }
+}
+
+/** The alert rules, each with its state. A PATCH replaces all rules (and starts over with their state) */
+void handleAlerts()
+{
+  AllocationScope scope(AllocationStats::Config);
+  if (server.method() == HTTP_GET)
+  {
+    String & s = scratchpad;
+    s = R"EOF({"rules":[)EOF";
+    char buf[128];
+    unsigned long now = millis();
+    for (int r = 0; r < configAlerts.numRules; r++)
+    {
+      Alerts::State const & state = alerts.state(r);
+      if (r != 0) { s += ", "; }
+      size_t len = ConfigAlerts::ruleToString(buf, sizeof(buf), configAlerts.rules[r]);
+      buf[len - 1] = '\0'; // the closing brace, continued below
+      s += buf;
+      snprintf(buf, sizeof(buf), ", \"active\":%d, \"triggered\":%lu, \"since_ms\":%lu, ",
+               state.active ? 1 : 0, (unsigned long)state.triggered, now - state.changedMillis);
+      s += buf;
+      if (state.hasValue) {
+        snprintf(buf, sizeof(buf), "\"value\":%.2f}", state.value);
+      } else {
+        snprintf(buf, sizeof(buf), "\"value\":null}");
+      }
+      s += buf;
+    }
+    snprintf(buf, sizeof(buf), "], \"num_active\":%d, \"max_rules\":%d}", alerts.numActive(), (int)ConfigAlerts::MAX_RULES);
+    s += buf;
+    server.send(200, "application/javascript", s);
+  }
+  else if (server.method() == HTTP_PATCH && server.hasArg("plain"))
+  {
+    String const json = server.arg("plain");
+
+    bool ok = configAlerts.patch(json.c_str());
+    if (ok) {
+      ok = configAlerts.save();
+      alerts.reset();
+      showAlerts();
+    }
+    if (ok)
+    {
+      server.send(200, "text/plain", "OK");
+    }
+    else
+    {
+      server.send(400, "text/plain", "ERROR");
+    }
+  }
+  else
+  {
+    sendError("???");
+  }
+}
+
 void handlePersist()
 {
+  AllocationScope scope(AllocationStats::Config);
   if (server.method() == HTTP_GET)
   {
     // TODO: keep track of unsaved changes
@@ -424,59 +819,18 @@ void handlePersist()
 
 void handleNotFound()
 {
-  if (server.uri().startsWith("/api/sensors/"))
-  {
-    String id = server.uri().substring(13);
-    if (id.length() == 16)
-    {
-      //DeviceAddress da;
-      //stringToDeviceAddress(da, id);
-      for (int i = 0; i < configSensors.numAllSensors; i++)
-      {
-        if (strncasecmp(id.c_str(), configSensors.allSensors[i].id, 16) == 0) // TODO: should this be case sensitive?
-        {
-          if (server.method() == HTTP_GET)
-          {
-            String s = sensorToString(i);
-            server.send(200, "application/javascript", s);
-            return;
-          }
-          else if (server.method() == HTTP_PATCH && server.hasArg("plain"))
-          {
-            String const json = server.arg("plain");
-
-            bool wasActive = configSensors.allSensors[i].active;
-            bool ok = configSensors.patchSingleSensor(i, json.c_str());
-
-            if (wasActive ^ configSensors.allSensors[i].active)
-            {
-              populateServedSensors();
-            }
-
-            if (ok)
-            {
-              server.send(200, "text/plain", "OK");
-              return;
-            }
-            else
-            {
-              Serial.println("Parsing failed!");
-              server.send(400, "text/plain", "ERROR"); // TODO: which status code???
-              return;
-            }
-          }
-        }
-      }
-    }
-  }
-  else if (serveFromSpiffs(server.uri()))
+  AllocationScope scope(AllocationStats::NotFound);
+  String const & uri = server.uri();
+  if (strncmp(uri.c_str(), "/api/", 5) != 0 && serveFromSpiffs(uri)) // nothing below /api/ is a file
   {
+    scope.type = AllocationStats::Static;
     return; // all went well
   }
   
-  String message = "File Not Found\n\n";
+  String & message = scratchpad;
+  message = "File Not Found\n\n";
   message += "URI: ";
-  message += server.uri();
+  message += uri;
   message += "\nMethod: HTTP_";
   switch(server.method())
   {
@@ -494,7 +848,11 @@ void handleNotFound()
   message += "\n";
 
   for (uint8_t i = 0; i < server.args(); i++) {
-    message += " " + server.argName(i) + ": " + server.arg(i) + "\n";
+    message += " ";
+    message += server.argName(i);
+    message += ": ";
+    message += server.arg(i);
+    message += "\n";
   }
 
   server.send(404, "text/plain", message);
@@ -502,86 +860,445 @@ void handleNotFound()
   Serial.write(message.c_str());
 }
 
-String sensorToString(int allSensorIndex) // TODO: unite with the one in configsensors
+/**
+ * Append the json description of a sensor to s (no heap allocation as long as s has room), with
+ * the rolling statistics of its 1h readings if it is served (null if not, or there are none yet)
+ */
+void sensorToString(String & s, int allSensorIndex) // TODO: unite with the one in configsensors
 {
-  String id;
-  if (configSensors.allSensors[allSensorIndex].type == Sensor::Type::OneWire)
+  Sensor const & sensor = configSensors.allSensors[allSensorIndex];
+  char buf[240];
+  int j = findServedSensor(allSensorIndex);
+  snprintf(buf, sizeof(buf), "{\"id\":\"%s\", \"type\":\"%s\", \"name\":\"%s\", \"active\":%d, \"present\":%d, "
+           "\"period_ms\":%lu, \"resolution\":%d, \"stats_window_s\":%u, \"compression_24h\":%.2f, \"retained_24h\":%d, "
+           "\"lastValue\":%.2f, ",
+           sensor.id, toString(sensor.type), sensor.name, sensor.active ? 1 : 0, sensor.present ? 1 : 0,
+           (unsigned long)sensor.periodMs, sensor.resolution, sensor.statsWindowS, sensor.compression24h / 100.0f,
+           j < 0 ? 0 : servedSensors[j].getNumRetained_24h(), sensor.lastValue);
+  s += buf;
+  if (j < 0 || servedSensors[j].getStats_1h().count() == 0)
   {
-      id = deviceAddressToString(configSensors.allSensors[allSensorIndex].deviceAddress);
+    s += "\"stats\":null}";
+    return;
   }
-  else if (configSensors.allSensors[allSensorIndex].type == Sensor::Type::NTC)
+  RollingStats<int16_t, 360> const & stats = servedSensors[j].getStats_1h();
+  snprintf(buf, sizeof(buf), "\"stats\":{\"count\":%d, \"min\":%.2f, \"max\":%.2f, \"mean\":%.2f, \"stddev\":%.2f, "
+           "\"rate_per_h\":%.2f}}",
+           stats.count(), ServedSensor::vtof(stats.minimum()), ServedSensor::vtof(stats.maximum()),
+           ServedSensor::vtof(stats.mean()), ServedSensor::vtof(stats.stddev()),
+           ServedSensor::vtof(stats.slope() * readings_per_hour));
+  s += buf;
+}
+
+/**
+ * After sensor settings have been changed: serve the active ones, restart the statistics and 24h series
+ * changed, set resolutions, republish the MQTT state
+ */
+void applySensorChanges()
+{
+  updateServedSensors();
+  for (int j = 0; j < maxNumServedSensors; j++)
+  {
+    ServedSensor & ss = servedSensors[j];
+    if (ss.allSensorsIndex >= 0 &&
+        ss.getStats_1h().window() * time_between_1h_readings_ms != configSensors.allSensors[ss.allSensorsIndex].statsWindowS * 1000UL) {
+      ss.resetStats_1h(configSensors.allSensors[ss.allSensorsIndex].statsWindowS, num_samples_since_boot_1h - ss.firstReading_1h);
+    }
+    if (ss.allSensorsIndex >= 0 && ss.getCompression_24h() != configSensors.allSensors[ss.allSensorsIndex].compression24h) {
+      ss.fill_24h(0.0f, configSensors.allSensors[ss.allSensorsIndex].compression24h); // starts over
+      ss.firstReading_24h = num_samples_since_boot_24h;
+    }
+  }
+  for (int i = 0; i < configSensors.numAllSensors; i++)
   {
-      id = String("000000000000000") + String(configSensors.allSensors[allSensorIndex].index);
+    applySensorResolution(i);
   }
-  String s = "{\"id\":\"" + id +  "\", \"type\":\"" + toString(configSensors.allSensors[allSensorIndex].type) +
-  "\", \"name\":\"" + configSensors.allSensors[allSensorIndex].name +
-  "\", \"active\":" + (configSensors.allSensors[allSensorIndex].active ? "1" : "0") +
-  ", \"lastValue\":" + String(configSensors.allSensors[allSensorIndex].lastValue, 2) + "}";
-  // TODO: update when we have persistent name storage
-  return s;
+  mqttStatePending = true;
+  mqttStateNext = 0;
 }
 
 void handleSensors()
 {
-  String s = R"EOF({"sensors":[)EOF";
+  AllocationScope scope(AllocationStats::Sensors);
+  if (server.method() == HTTP_PATCH && server.hasArg("plain"))
+  {
+    String const json = server.arg("plain");
+    if (!configSensors.patchSensors(json.c_str()))
+    {
+      server.send(400, "text/plain", "ERROR");
+      return;
+    }
+    applySensorChanges();
+    server.send(200, "text/plain", "OK");
+    return;
+  }
+  String & s = scratchpad;
+  s = R"EOF({"sensors":[)EOF";
   for (int i = 0; i < configSensors.numAllSensors; i++)
   {
     if (i != 0) { s += ", "; }
-    s += sensorToString(i);
+    sensorToString(s, i);
   }
   s += "], \"max_num_active\":";
-  s += String(maxNumServedSensors);
-  s += + "}\n";
+  s += maxNumServedSensors;
+  s += ", \"table_full\":";
+  s += configSensors.tableFull ? 1 : 0;
+  s += "}\n";
   server.send(200, "application/javascript", s);
 }
 
-void handleSensors_1h_or_24h(bool serve_24h_instead_of_1h = false)
+/** Position in a readings response, kept by the server between the parts of it (see generateReadings()) */
+struct ReadingsStream {
+  enum Phase : uint8_t { OPEN, SENSOR_START, READINGS, SENSOR_END, CLOSE, TIME_ANCHORS, DONE };
+  Phase phase;
+  bool serve24h;
+  int16_t nextSensor;  ///< configSensors.allSensors index the next served sensor is looked for from
+  int16_t served;      ///< servedSensors entry being sent
+  int16_t reading;     ///< next reading to send (TIME_ANCHORS: of the last anchor sent)
+  int16_t first;       ///< readings sent, first to end (exclusive) of those there were when the response started
+  int16_t end;
+  uint32_t numSamples; ///< samples since boot when the response started
+};
+
+/** Readings kept of a tier (the first one is number numSamples - numReadings(serve24h)) */
+int numReadings(bool serve24h)
+{
+  return serve24h ? ServedSensor::NUM_READINGS_24H : ServedSensor::NUM_READINGS_1H;
+}
+
+/**
+ * Produces the next part of a readings response (HttpServer::TGenerator), as much as fits into buf.
+ * Samples taken while the response is sent shift the buffers; the response stays with the
+ * readings as they were when it started. Sensors activated meanwhile are included if their turn
+ * has not passed yet, one deactivated while its readings are sent ends short.
+ *
+ * The times of the readings sent follow as anchors [position in the readings, Unix time], a reading
+ * without one of its own was made period_s after the one before.
+ */
+size_t generateReadings(char* buf, size_t size, HttpServer::StreamState & state)
+{
+  ReadingsStream & rs = state.as<ReadingsStream>();
+  AllocationScope scope(rs.serve24h ? AllocationStats::Readings24h : AllocationStats::Readings1h, false);
+  size_t len = 0;
+  while (rs.phase != ReadingsStream::DONE && len + 128 <= size) // room for the longest piece (sensor start)
+  {
+    switch (rs.phase)
+    {
+      case ReadingsStream::OPEN:
+        len += snprintf(buf + len, size - len, R"rawliteral({"sensors":[)rawliteral");
+        rs.phase = ReadingsStream::SENSOR_START;
+        break;
+      case ReadingsStream::SENSOR_START:
+      {
+        int j = nextServedSensor(rs.nextSensor);
+        if (j < 0)
+        {
+          rs.phase = ReadingsStream::CLOSE;
+          break;
+        }
+        if (rs.nextSensor != 0) {
+          len += snprintf(buf + len, size - len, ", ");
+        }
+        len += getSensorStart(buf + len, size - len, j, rs.serve24h);
+        rs.served = j;
+        rs.nextSensor = servedSensors[j].allSensorsIndex + 1;
+        rs.reading = rs.first;
+        rs.phase = ReadingsStream::READINGS;
+        break;
+      }
+      case ReadingsStream::READINGS:
+      {
+        ServedSensor const & ss = servedSensors[rs.served];
+        if (ss.allSensorsIndex != rs.nextSensor - 1)
+        {
+          rs.phase = ReadingsStream::SENSOR_END; // no longer served
+          break;
+        }
+        int N = rs.serve24h ? ss.getNumReadings_24h() : ss.getNumReadings_1h();
+        int end = min(int(rs.end), N);
+        int32_t shift = int32_t((rs.serve24h ? num_samples_since_boot_24h : num_samples_since_boot_1h) - rs.numSamples);
+        char val[12];
+        int16_t raw[32]; // the next readings, copied in bulk
+        int numRaw = 0;
+        int nextRaw = 0;
+        while (rs.reading < end && len + 16 <= size)
+        {
+          if (rs.reading != rs.first) {
+            buf[len++] = ',';
+          }
+          if (nextRaw == numRaw)
+          {
+            // Those before the oldest one (the readings moved on since the stream started) repeat it
+            int i = max(0, min(N - 1, int(rs.reading - shift)));
+            numRaw = rs.reading < shift ? 1 : min(int(sizeof(raw) / sizeof(raw[0])), end - rs.reading);
+            if (rs.serve24h) {
+              ss.copyReadings_24h_raw(i, raw, numRaw);
+            } else {
+              ss.copyReadings_1h_raw(i, raw, numRaw);
+            }
+            nextRaw = 0;
+          }
+          char const * v = ServedSensor::vtos(raw[nextRaw++], val);
+          size_t n = strlen(v);
+          memcpy(buf + len, v, n);
+          len += n;
+          rs.reading++;
+        }
+        if (rs.reading >= end) {
+          rs.phase = ReadingsStream::SENSOR_END;
+        }
+        break;
+      }
+      case ReadingsStream::SENSOR_END:
+        len += snprintf(buf + len, size - len, "]}\n"); // sensor end
+        rs.phase = ReadingsStream::SENSOR_START;
+        break;
+      case ReadingsStream::CLOSE:
+      {
+        TimeIndex<8> const & index = rs.serve24h ? timeIndex_24h : timeIndex_1h;
+        len += snprintf(buf + len, size - len, "], \"samples_since_boot\":%lu, \"first_reading\":%ld, \"period_s\":%lu, \"time_anchors\":[",
+                        (unsigned long)rs.numSamples, long(int32_t(rs.numSamples) - numReadings(rs.serve24h) + rs.first),
+                        (unsigned long)index.periodS());
+        rs.reading = rs.first - 1;
+        rs.phase = ReadingsStream::TIME_ANCHORS;
+        break;
+      }
+      case ReadingsStream::TIME_ANCHORS:
+      {
+        // The first reading sent, then those the clock was set or corrected at (after the response started: none)
+        TimeIndex<8> const & index = rs.serve24h ? timeIndex_24h : timeIndex_1h;
+        int32_t oldest = int32_t(rs.numSamples) - numReadings(rs.serve24h);
+        int pos = -1;
+        if (!index.empty() && rs.first < rs.end)
+        {
+          if (rs.reading < rs.first) {
+            pos = rs.first;
+          }
+          for (int a = 0; pos < 0 && a < index.anchors().size(); a++)
+          {
+            int32_t p = index.anchors()[a].reading - oldest;
+            if (p > rs.reading && p < rs.end) {
+              pos = p;
+            }
+          }
+        }
+        if (pos < 0)
+        {
+          len += snprintf(buf + len, size - len, "]}\n"); // end of everything
+          rs.phase = ReadingsStream::DONE;
+          break;
+        }
+        len += snprintf(buf + len, size - len, "%s[%d,%lu]", pos != rs.first ? ", " : "", pos - rs.first,
+                        (unsigned long)index.timeOf(oldest + pos));
+        rs.reading = pos;
+        break;
+      }
+      case ReadingsStream::DONE:
+        break;
+    }
+  }
+  return len;
+}
+
+/** /api/sensors/<id> */
+void handleSensor()
 {
-  String numSamples(serve_24h_instead_of_1h ? num_samples_since_boot_24h : num_samples_since_boot_1h);
+  AllocationScope scope(AllocationStats::Sensor);
+  int i = configSensors.find(server.uri().c_str() + strlen("/api/sensors/"));
+  if (i < 0)
+  {
+    server.send(404, "text/plain", "No such sensor");
+    return;
+  }
+  if (server.method() == HTTP_PATCH && server.hasArg("plain"))
+  {
+    String const json = server.arg("plain");
+    if (!configSensors.patchSingleSensor(i, json.c_str()))
+    {
+      server.send(400, "text/plain", "ERROR"); // TODO: which status code???
+      return;
+    }
+    applySensorChanges();
+    server.send(200, "text/plain", "OK");
+    return;
+  }
   String & s = scratchpad;
-  s = R"rawliteral({"sensors":[)rawliteral";
+  s = "";
+  sensorToString(s, i);
+  server.send(200, "application/javascript", s);
+}
+
+void handleSensors_1h_or_24h(bool serve_24h_instead_of_1h = false)
+{
+  AllocationScope scope(serve_24h_instead_of_1h ? AllocationStats::Readings24h : AllocationStats::Readings1h);
   if (numServedSensors == 0)
   {
-    s += "]}\n"; // end of everything
-    server.send(200, "application/javascript", s);
+    server.send(200, "application/javascript", "{\"sensors\":[]}\n");
     return;
   }
 
-  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  // The response is produced in parts by generateReadings() as the client takes it
+  HttpServer::StreamState state;
+  ReadingsStream & rs = state.as<ReadingsStream>();
+  rs = {};
+  rs.serve24h = serve_24h_instead_of_1h;
+  rs.end = numReadings(serve_24h_instead_of_1h);
+  rs.numSamples = serve_24h_instead_of_1h ? num_samples_since_boot_24h : num_samples_since_boot_1h;
+  server.sendGenerated(200, "application/javascript", generateReadings, state);
+}
+
+/** Parses a Unix time query argument into t (left as it is if the argument is not there) */
+bool timeArg(const char* name, uint32_t & t)
+{
+  const char* value = server.argPtr(name);
+  if (!value) {
+    return true;
+  }
+  char* end = nullptr;
+  unsigned long v = strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || value[0] == '-') {
+    return false;
+  }
+  t = v;
+  return true;
+}
 
-  for (int k = 0; k < numServedSensors; k++)
+/**
+ * /api/readings?from=&to=[&tier=1h|24h]: the readings made from ... to (Unix seconds, both
+ * optional and inclusive), found by binary search of the time anchors. Without a tier, of the 1h
+ * readings if they go back far enough, else of the 24h ones. Only the readings kept are served.
+ */
+void handleReadingsRange()
+{
+  uint32_t from = 0;
+  uint32_t to = UINT32_MAX;
+  const char* tier = server.argPtr("tier");
+  if (!timeArg("from", from) || !timeArg("to", to) || from > to ||
+      (tier && strcmp(tier, "1h") != 0 && strcmp(tier, "24h") != 0))
   {
-    if (k != 0) { s += ", "; }
-    int N = serve_24h_instead_of_1h ? servedSensors[k].getNumReadings_24h() : servedSensors[k].getNumReadings_1h();
-    s += getSensorStart(servedSensors[k].allSensorsIndex);
-    for (int i = 0; i < N; i++)
-    {
-      if (i != 0) {
-        s += ",";
-      }
-      //String val(serve_24h_instead_of_1h ? servedSensors[k].getReading_24h(i) : servedSensors[k].getReading_1h(i), 2);
-      String val(serve_24h_instead_of_1h ? servedSensors[k].getReading_24h(i) : servedSensors[k].getReading_1h(i));
-      s += val;
+    server.send(400, "text/plain", "ERROR");
+    return;
+  }
+  int32_t oldest_1h = max(int32_t(num_samples_since_boot_1h) - numReadings(false), int32_t(0));
+  bool serve24h = tier ? strcmp(tier, "24h") == 0 :
+                  !timeIndex_24h.empty() && (timeIndex_1h.empty() || timeIndex_1h.timeOf(oldest_1h) > from);
+  AllocationScope scope(serve24h ? AllocationStats::Readings24h : AllocationStats::Readings1h);
+  TimeIndex<8> const & index = serve24h ? timeIndex_24h : timeIndex_1h;
+  if (index.empty())
+  {
+    server.send(503, "text/plain", "ERROR: time not set");
+    return;
+  }
+
+  HttpServer::StreamState state;
+  ReadingsStream & rs = state.as<ReadingsStream>();
+  rs = {};
+  rs.serve24h = serve24h;
+  rs.numSamples = serve24h ? num_samples_since_boot_24h : num_samples_since_boot_1h;
+  int N = numReadings(serve24h);
+  int32_t oldest = max(int32_t(rs.numSamples) - N, int32_t(0)); // (those before boot are the first one repeated)
+  int32_t newest = int32_t(rs.numSamples) - 1;
+  int32_t first = from <= index.timeOf(oldest) ? oldest : index.lastReadingAt(from - 1) + 1;
+  int32_t last = to >= index.timeOf(newest) ? newest : index.lastReadingAt(to);
+  rs.first = max(0, min(N, int(first - (int32_t(rs.numSamples) - N))));
+  rs.end = max(int(rs.first), min(N, int(last + 1 - (int32_t(rs.numSamples) - N))));
+  server.sendGenerated(200, "application/javascript", generateReadings, state);
+}
+
+/** The wall clock, and the SNTP server it is synchronized with. A POST of {"now":<Unix seconds>} sets it from a browser */
+void handleTime()
+{
+  AllocationScope scope(AllocationStats::Config);
+  if (server.method() == HTTP_GET)
+  {
+    char now[24] = "null";
+    char sinceSet[24] = "null";
+    if (wallClock.isSet()) {
+      snprintf(now, sizeof(now), "%lu", (unsigned long)wallClock.now());
+      snprintf(sinceSet, sizeof(sinceSet), "%lu", (unsigned long)(wallClock.sinceSetMs() / 1000));
     }
-    s += "]}\n"; // sensor end
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"enabled\":%d, \"server\":\"%s\", \"now\":%s, \"source\":\"%s\", \"since_set_s\":%s, "
+             "\"syncs\":%lu, \"failures\":%lu}\n",
+             configTime.getEnabled() ? 1 : 0, configTime.getServer(), now, WallClock::toString(wallClock.source()), sinceSet,
+             (unsigned long)wallClock.stats().syncs, (unsigned long)wallClock.stats().failures);
+    server.send(200, "application/javascript", buf);
+  }
+  else if (server.method() == HTTP_PATCH && server.hasArg("plain"))
+  {
+    String const json = server.arg("plain");
 
-    if (k == numServedSensors - 1)
+    bool ok = configTime.patch(json.c_str());
+    if (ok && configTime.isModified()) {
+      ok = configTime.save();
+      wallClockConfigure();
+    }
+    if (ok)
     {
-      s += "], \"samples_since_boot\":" + numSamples + "}\n"; // end of everything
+      server.send(200, "text/plain", "OK");
     }
-
-    if (k == 0)
+    else
+    {
+      server.send(400, "text/plain", "ERROR");
+    }
+  }
+  else if (server.method() == HTTP_POST && server.hasArg("plain"))
+  {
+    StaticJsonDocument<64> json;
+    if (deserializeJson(json, server.argPtr("plain")) || json.as<JsonObject>().size() != 1 || !json["now"].is<unsigned long>() ||
+        json["now"].as<unsigned long>() < WallClock::MIN_VALID_TIME)
     {
-      server.send(200, "application/javascript", s);
+      server.send(400, "text/plain", "ERROR");
+    }
+    else if (!wallClock.setFromBrowser(json["now"].as<unsigned long>()))
+    {
+      server.send(409, "text/plain", "ERROR: synchronized by SNTP");
     }
     else
     {
-      server.sendContent(s);
+      server.send(200, "text/plain", "OK");
     }
+  }
+  else
+  {
+    sendError("???");
+  }
+}
 
-    s = "";
+void handleDiagnostics()
+{
+  AllocationScope scope(AllocationStats::Diagnostics);
+  String & s = scratchpad;
+  char buf[200];
+  snprintf(buf, sizeof(buf), "{\"free_heap\":%lu, \"allocation_counting\":%d, \"requests\":{",
+           (unsigned long)ESP.getFreeHeap(), AllocationStats::countsAllocations() ? 1 : 0);
+  s = buf;
+  for (int t = 0; t < AllocationStats::NUM_TYPES; t++)
+  {
+    AllocationStats::Counters const & c = allocationStats.counters[t];
+    snprintf(buf, sizeof(buf), "%s\"%s\":{\"count\":%lu, \"allocations\":%lu, \"last_allocations\":%lu, "
+             "\"bytes_allocated\":%lu, \"last_heap_change\":%ld, \"min_free_heap\":%lu}",
+             t != 0 ? ", " : "", AllocationStats::toString(AllocationStats::Type(t)),
+             (unsigned long)c.count, (unsigned long)c.allocations, (unsigned long)c.lastAllocations,
+             (unsigned long)c.bytesAllocated, (long)c.lastHeapChange, (unsigned long)c.minFreeHeap);
+    s += buf;
   }
-  server.sendContent(""); // To signal no more content
+  MqttClient::Stats const & m = mqtt.stats();
+  snprintf(buf, sizeof(buf), "}, \"mqtt\":{\"state\":\"%s\", \"connects\":%lu, \"failures\":%lu, "
+           "\"published\":%lu, \"dropped\":%lu}",
+           MqttClient::toString(mqtt.state()), (unsigned long)m.connects, (unsigned long)m.failures,
+           (unsigned long)m.published, (unsigned long)m.dropped);
+  s += buf;
+  SampleTimer::Stats const & st = sampleTimer.stats();
+  snprintf(buf, sizeof(buf), ", \"sampling\":{\"period_ms\":%lu, \"ticks\":%lu, \"dropped\":%lu, \"queued\":%lu, "
+           "\"max_queued\":%lu, \"max_latency_ms\":%lu, ",
+           (unsigned long)sampleTimer.periodMs(), (unsigned long)st.ticks, (unsigned long)st.dropped,
+           (unsigned long)sampleTimer.queued(), (unsigned long)st.maxQueued, (unsigned long)st.maxLatencyMs);
+  s += buf;
+  snprintf(buf, sizeof(buf), "\"jitter_us\":{\"last\":%lu, \"mean\":%lu, \"max\":%lu}}}\n",
+           (unsigned long)st.lastJitterUs, (unsigned long)sampleTimer.meanJitterUs(), (unsigned long)st.maxJitterUs);
+  s += buf;
+  server.send(200, "application/javascript", s);
 }
 
 void handleSensors_1h()
@@ -598,7 +1315,7 @@ void handleSensors_24h()
 
 void setup()
 {
-  scratchpad.reserve(4300);
+  scratchpad.reserve(2048); // sensor list, error messages and diagnostics (readings are generated in parts)
   pinMode(externalLED, OUTPUT);
   digitalWrite(externalLED, 0);
   //Wire.begin(I2C_SDA, I2C_SCL); // join i2c bus (address optional for master)
@@ -640,6 +1357,21 @@ void setup()
   Serial.println( presentationLoadSuccess ? "Ready" : "Failed!");
   Serial.flush();
 
+  Serial.print("Loading MQTT config from flash ... ");
+  bool mqttLoadSuccess = configMqtt.load();
+  Serial.println( mqttLoadSuccess ? "Ready" : "Failed!");
+  Serial.flush();
+
+  Serial.print("Loading alert rules from flash ... ");
+  bool alertsLoadSuccess = configAlerts.load();
+  Serial.println( alertsLoadSuccess ? "Ready" : "Failed!");
+  Serial.flush();
+
+  Serial.print("Loading time config from flash ... ");
+  bool timeLoadSuccess = configTime.load();
+  Serial.println( timeLoadSuccess ? "Ready" : "Failed!");
+  Serial.flush();
+
   // TODO: connect to wifi network etc...
   if (configNetwork.getEnabled())
   {
@@ -666,7 +1398,7 @@ void setup()
     if (networkConfigSuccess)
     {
       Serial.printf("Connecting to \"%s\" ... ", configNetwork.getSsid());
-      bool tmp = WiFi.begin(configNetwork.getSsid(), configNetwork.getPassword());
+      WiFi.begin(configNetwork.getSsid(), configNetwork.getPassword());
       delay(50); // TODO: here since other people had it... ()
       switch(WiFi.waitForConnectResult())
       {
@@ -715,11 +1447,19 @@ void setup()
   server.on("/api/presentation", handlePresentation);
   server.on("/api/sensors", handleSensors);
   server.on("/api/sensors/", handleSensors);
+  server.onPrefix("/api/sensors/", handleSensor);
   server.on("/api/readings/1h", handleSensors_1h);
   server.on("/api/readings/24h", handleSensors_24h);
+  server.on("/api/readings", handleReadingsRange);
+  server.on("/api/time", handleTime);
   server.on("/api/wifi/softap", handleWifiSoftAP);
   server.on("/api/wifi/network", handleWifiNetwork);
+  server.on("/api/wifi/scan", handleWifiScan);
+  server.on("/api/mqtt", handleMqtt);
+  server.on("/api/alerts", handleAlerts);
+  server.onUpload("/api/update", handleUpdate, handleUpdateUpload);
   server.on("/api/persist", handlePersist);
+  server.on("/api/diagnostics", handleDiagnostics);
   server.onNotFound(handleNotFound);
   server.begin();
   Serial.print("Server listening on: softAP:");
@@ -732,6 +1472,7 @@ void setup()
 
   Serial.print("Starting temperature sensor monitoring... ");
   sensors.begin(); // TODO: do we have a return status??
+  sensors.setWaitForConversion(false); // the sampling collects the values when done (see readSensors())
   Serial.print(sensors.getDeviceCount());
   Serial.println(" devices found:");
 
@@ -758,8 +1499,10 @@ void setup()
   {
     DeviceAddress da = {};
     sensors.getAddress(da, i);
+    char id[17];
+    deviceAddressToString(da, id);
     Serial.print("    0x");
-    Serial.print(deviceAddressToString(da));
+    Serial.print(id);
     Serial.println( i == sensorIndex ? " <-- will be used":"");
   }
   
@@ -777,43 +1520,278 @@ void setup()
 
   Serial.print("Loading saved sensor configurations ... ");
   Serial.println(configSensors.load() ? "Ready":"Failed!");
+  for (int i = 0; i < configSensors.numAllSensors; i++)
+  {
+    applySensorResolution(i);
+  }
 
   populateServedSensors();
+  alerts.reset();
+
+  mqttConfigure();
+  wallClockConfigure();
 
   digitalWrite(externalLED, HIGH);
 }
 
+/** (Re)start synchronizing the wall clock with the SNTP server in configTime, or stop if disabled */
+void wallClockConfigure()
+{
+  wallClock.configure(configTime.getEnabled() ? configTime.getServer() : nullptr);
+}
+
+/** (Re)connect to the MQTT broker in configMqtt, or stop publishing if disabled */
+void mqttConfigure()
+{
+  static char clientId[24];
+  static char willTopic[72]; // topic is at most 63 characters
+  snprintf(clientId, sizeof(clientId), "tempviewer-%06x", (unsigned)ESP.getChipId());
+  snprintf(willTopic, sizeof(willTopic), "%s/status", configMqtt.getTopic());
+  if (configMqtt.getEnabled())
+  {
+    mqtt.configure(configMqtt.getHost(), configMqtt.getPort(), clientId, configMqtt.getUsername(),
+                   configMqtt.getPassword(), willTopic, "offline");
+  }
+  else
+  {
+    mqtt.configure(nullptr, 0, clientId, "", "", willTopic, "offline");
+  }
+}
+
+/**
+ * Publishes (retained) that the unit is online and the name, type, active and present state of each sensor,
+ * as many as fit in the send buffer each time, until all are out.
+ */
+void mqttPublishState()
+{
+  char topic[128];
+  char payload[128];
+  if (mqttStateNext == 0)
+  {
+    snprintf(topic, sizeof(topic), "%s/status", configMqtt.getTopic());
+    if (!mqtt.hasRoomFor(topic, "online")) {
+      return;
+    }
+    mqtt.publish(topic, "online", true);
+  }
+  for (; mqttStateNext < configSensors.numAllSensors; mqttStateNext++)
+  {
+    Sensor const & sensor = configSensors.allSensors[mqttStateNext];
+    snprintf(topic, sizeof(topic), "%s/sensors/%s/state", configMqtt.getTopic(), sensor.id);
+    snprintf(payload, sizeof(payload), "{\"name\":\"%s\", \"type\":\"%s\", \"active\":%d, \"present\":%d}",
+             sensor.name, toString(sensor.type), sensor.active ? 1 : 0, sensor.present ? 1 : 0);
+    if (!mqtt.hasRoomFor(topic, payload)) {
+      mqtt.flush();
+      return; // the rest when there is room again
+    }
+    mqtt.publish(topic, payload, true);
+  }
+  mqtt.flush();
+  mqttStatePending = false;
+  mqttStateNext = 0;
+}
+
+/**
+ * Publishes (retained) the state of the alert rules changed since last time, as many as fit in the
+ * send buffer each time. Rules removed are cleared (an empty retained message).
+ */
+void mqttPublishAlerts()
+{
+  char topic[96];
+  char payload[160];
+  for (int r = 0; r < ConfigAlerts::MAX_RULES; r++)
+  {
+    if (!(alerts.unpublished() & (1UL << r))) {
+      continue;
+    }
+    snprintf(topic, sizeof(topic), "%s/alerts/%d", configMqtt.getTopic(), r);
+    payload[0] = '\0';
+    if (r < configAlerts.numRules)
+    {
+      AlertRule const & rule = configAlerts.rules[r];
+      Alerts::State const & state = alerts.state(r);
+      snprintf(payload, sizeof(payload), "{\"sensor\":\"%s\", \"kind\":\"%s\", \"limit\":%.2f, \"active\":%d, \"value\":%.2f}",
+               rule.sensor, toString(rule.kind), rule.limit, state.active ? 1 : 0, state.value);
+    }
+    if (!mqtt.hasRoomFor(topic, payload)) {
+      break; // the rest when there is room again
+    }
+    mqtt.publish(topic, payload, true);
+    alerts.setPublished(r);
+  }
+  mqtt.flush();
+}
+
+/** The external LED is lit while any alert is active (and blinks as the readings are made) */
+void showAlerts()
+{
+  digitalWrite(externalLED, alerts.numActive() != 0 ? LOW : HIGH);
+}
+
+uint32_t mqttSampledSensors = 0; ///< one bit per sensor sampled since the last mqttPublishSamples()
+
+/**
+ * Publishes the samples just taken of the active sensors, all in one flush. Called at the end of each
+ * sample timer tick (NTC) and OneWire conversion, so that every sample goes out, whatever the period.
+ */
+void mqttPublishSamples()
+{
+  uint32_t sampled = mqttSampledSensors;
+  mqttSampledSensors = 0;
+  if (!mqtt.connected())
+  {
+    return;
+  }
+  char topic[128];
+  char payload[16];
+  for (int i = 0; i < configSensors.numAllSensors; i++)
+  {
+    Sensor const & sensor = configSensors.allSensors[i];
+    if (!sensor.active || !(sampled & (1UL << i)))
+    {
+      continue;
+    }
+    snprintf(topic, sizeof(topic), "%s/sensors/%s/temperature", configMqtt.getTopic(), sensor.id);
+    snprintf(payload, sizeof(payload), "%.2f", sensor.lastValue);
+    mqtt.publish(topic, payload);
+  }
+  mqtt.flush();
+}
+
+/** At start: serve the first sensors selected as active (but not too many) */
 void populateServedSensors()
 {
-  // Serve the first sensors selected as active (but not too many)
+  for (int j = 0; j < maxNumServedSensors; j++)
+  {
+    servedSensors[j].allSensorsIndex = -1;
+  }
   numServedSensors = 0;
-  num_samples_since_boot_1h = 0;
-  num_samples_since_boot_24h = 0;
   for(int i = 0; i < configSensors.numAllSensors; i++)
   {
-    Sensor & cs = configSensors.allSensors[i];
-    if (cs.active && numServedSensors < maxNumServedSensors)
+    if (configSensors.allSensors[i].active) {
+      addServedSensor(i);
+    }
+  }
+}
+
+/** Serves sensor i as well, from empty readings on, if there is a free entry. @return false if not */
+bool addServedSensor(int i)
+{
+  int j = findServedSensor(-1);
+  if (j < 0) {
+    return false;
+  }
+  ServedSensor & ss = servedSensors[j];
+  ss.fill_1h(0.0f);
+  ss.fill_24h(0.0f, configSensors.allSensors[i].compression24h);
+  ss.clearSlot_1h();
+  ss.firstReading_1h = num_samples_since_boot_1h;
+  ss.firstReading_24h = num_samples_since_boot_24h;
+  ss.resetStats_1h(configSensors.allSensors[i].statsWindowS, 0);
+  ss.allSensorsIndex = i;
+  numServedSensors++;
+  return true;
+}
+
+/**
+ * Serves the sensors as their active flags say now, in one go: the entries of those deactivated are
+ * freed first, then go to those activated (and to active ones that did not fit so far). The series
+ * of the others, and the sample counts, go on as they are.
+ */
+void updateServedSensors()
+{
+  for (int j = 0; j < maxNumServedSensors; j++)
+  {
+    int i = servedSensors[j].allSensorsIndex;
+    if (i >= 0 && !configSensors.allSensors[i].active)
     {
-      servedSensors[numServedSensors].fill_1h(0.0f);
-      servedSensors[numServedSensors].fill_24h(0.0f);
-      servedSensors[numServedSensors++].allSensorsIndex = i;
+      servedSensors[j].allSensorsIndex = -1;
+      numServedSensors--;
+    }
+  }
+  for (int i = 0; i < configSensors.numAllSensors && numServedSensors < maxNumServedSensors; i++)
+  {
+    if (configSensors.allSensors[i].active && findServedSensor(i) < 0) {
+      addServedSensor(i);
     }
   }
 }
 
-String deviceAddressToString(DeviceAddress const & da)
+/** @return the configSensors.allSensors index of the OneWire sensor with that address, or -1 */
+int findOneWireSensor(DeviceAddress const & address)
 {
-  String s;
-  for (int j = 0; j < 8; j++)
+  for (int i = 0; i < configSensors.numAllSensors; i++)
+  {
+    Sensor const & sensor = configSensors.allSensors[i];
+    if (sensor.type == Sensor::Type::OneWire && memcmp(sensor.deviceAddress, address, sizeof(DeviceAddress)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Brings the OneWire sensors in line with the devices found by the last discovery pass: marks
+ * those gone (and back) and adds new ones, with their settings from config/sensors if they have
+ * been seen before. The series served so far are kept as they are; a sensor gone keeps its last
+ * value until it is back.
+ */
+void mergeOneWireSensors()
+{
+  bool changed = false;
+  for (int i = 0; i < configSensors.numAllSensors; i++)
   {
-    String add(da[j], HEX);
-    if (add.length() == 1)
+    Sensor & sensor = configSensors.allSensors[i];
+    bool present = sensor.type != Sensor::Type::OneWire || oneWireDiscovery.isFound(sensor.deviceAddress);
+    if (present != sensor.present)
     {
-      s += "0";
+      sensor.present = present;
+      Serial.printf("%s %s\n", sensor.id, present ? "connected" : "disconnected");
+      if (present) {
+        applySensorResolution(i); // in case it was set elsewhere meanwhile
+      }
+      changed = true;
+    }
+  }
+  bool wasFull = configSensors.tableFull;
+  configSensors.tableFull = false;
+  for (int j = 0; j < oneWireDiscovery.numFound(); j++)
+  {
+    DeviceAddress const & address = oneWireDiscovery.found(j);
+    if (findOneWireSensor(address) >= 0) {
+      continue;
+    }
+    int i = configSensors.addOneWireSensor(address);
+    if (i < 0) {
+      if (!wasFull) {
+        Serial.println("ERROR: sensor table full, probe left out");
+      }
+      break;
     }
-    s += add;
+    configSensors.restore(i);
+    applySensorResolution(i);
+    Serial.printf("%s added\n", configSensors.allSensors[i].id);
+    changed = true;
+  }
+  if (changed)
+  {
+    updateServedSensors();
+    alerts.resolveSensors();
+    mqttStatePending = true;
+    mqttStateNext = 0;
   }
-  return s;
+}
+
+/** Format a 1-Wire ROM address as 16 lower case hex digits */
+void deviceAddressToString(DeviceAddress const & da, char (&str)[17])
+{
+  static const char hex[] = "0123456789abcdef";
+  for (int j = 0; j < 8; j++)
+  {
+    str[2 * j] = hex[da[j] >> 4];
+    str[2 * j + 1] = hex[da[j] & 0xf];
+  }
+  str[16] = '\0';
 }
 
 void stringToDeviceAddress(DeviceAddress da, String const & id)
@@ -828,124 +1806,265 @@ void stringToDeviceAddress(DeviceAddress da, String const & id)
 }
 
 
-void readSensors(bool shouldRead1h, bool shouldRead24h)
+/**
+ * OneWire conversion for the sensors due at a sample timer tick. All sensors on the bus convert
+ * at once (one broadcast); the values of those due are collected when the slowest of them is
+ * done, at its resolution. NTC samples of the ticks meanwhile are stored as usual.
+ */
+struct OneWireConversion {
+  uint32_t due;              ///< bit per configSensors.allSensors index, in the running conversion
+  uint32_t next;             ///< due while one was running: converted right after it
+  unsigned long startMillis;
+  uint16_t waitMs;
+} oneWireConversion = {};
+static_assert(ConfigSensors::MAX_NUM_SENSORS <= 32, "one bit per sensor in OneWireConversion");
+
+uint32_t nextSlotSequence = 0; ///< sample timer tick at which the next 1h reading is made
+bool slotClosePending = false; ///< the 1h reading waits for the running OneWire conversion
+bool slotClose24h = false;     ///< ... and is a 24h one as well
+
+/** Stores a sample of sensor i: as its last value, and towards the next reading if it is served */
+void storeSample(int i, float temperatureCelcius)
+{
+  configSensors.allSensors[i].lastValue = temperatureCelcius;
+  mqttSampledSensors |= 1UL << i;
+  alerts.onSample(i, temperatureCelcius);
+  int j = findServedSensor(i);
+  if (j >= 0) {
+    servedSensors[j].addSample(temperatureCelcius);
+  }
+}
+
+void startOneWireConversion(uint32_t due)
 {
-  //TODO: should this be done even if no OneWire sensors?
-  sensors.requestTemperatures();
+  uint8_t bits = 9;
+  for (int i = 0; i < configSensors.numAllSensors; i++)
+  {
+    if (due & (1UL << i)) {
+      bits = max(bits, configSensors.allSensors[i].resolution);
+    }
+  }
+  sensors.requestTemperatures(); // returns right away, see setWaitForConversion() in setup()
+  oneWireConversion.due = due;
+  oneWireConversion.startMillis = millis();
+  oneWireConversion.waitMs = sensors.millisToWaitForConversion(bits);
+}
+
+/**
+ * Makes the next 1h reading of the served sensors from the samples since the last one, and
+ * when make24h, the next 24h reading from the last 1h ones.
+ */
+void closeSlots(bool make24h)
+{
+  for (int j = 0; j < maxNumServedSensors; j++)
+  {
+    if (servedSensors[j].allSensorsIndex < 0) {
+      continue;
+    }
+    servedSensors[j].closeSlot_1h();
+    if (make24h) {
+      // Use average from the more common 1h reading to reduce noise (those since it is served)
+      int numReadings = servedSensors[j].getNumReadings_1h();
+      int numAvg = num_samples_since_boot_1h - servedSensors[j].firstReading_1h + 1;
+      if (numAvg > NUM_SAMPLES_AVERAGED_FOR_24H_SAMPLE) {
+        numAvg = NUM_SAMPLES_AVERAGED_FOR_24H_SAMPLE;
+      }
+      int16_t last[NUM_SAMPLES_AVERAGED_FOR_24H_SAMPLE];
+      servedSensors[j].copyReadings_1h_raw(numReadings - numAvg, last, numAvg);
+      int32_t sum = 0;
+      for (int i = 0; i < numAvg; i++) {
+        sum += last[i];
+      }
+      servedSensors[j].addReading_24h_raw(sum / numAvg);
+    }
+  }
+  if (wallClock.isSet())
+  {
+    uint32_t now = wallClock.now();
+    timeIndex_1h.update(int32_t(num_samples_since_boot_1h), now, time_index_tolerance_s);
+    if (make24h) { timeIndex_24h.update(int32_t(num_samples_since_boot_24h), now, time_index_tolerance_s); }
+  }
+  num_samples_since_boot_1h++;
+  if (make24h) { num_samples_since_boot_24h++; }
 
   for (int16_t i = 0; i < configSensors.numAllSensors; i++)
   {
-    float temperatureCelcius = -1;
-    switch (configSensors.allSensors[i].type)
+    Serial.print(configSensors.allSensors[i].lastValue);
+    Serial.print(" ");
+  }
+  Serial.println();
+  showAlerts();
+}
+
+/**
+ * Takes the samples of the sensors due at a sample timer tick: the NTC values from its
+ * conversions, and starts a conversion for the OneWire sensors. Every 1h reading period the
+ * readings are made, once the OneWire values of the tick are in.
+ */
+void readSensors(SampleTimer::Tick const & tick)
+{
+  AllocationScope scope(AllocationStats::SampleTick);
+  alerts.onTick();
+  uint32_t oneWireDue = 0;
+  for (int16_t i = 0; i < configSensors.numAllSensors; i++)
+  {
+    Sensor const & sensor = configSensors.allSensors[i];
+    if (tick.sequence % (sensor.periodMs / sample_tick_ms) != 0) {
+      continue;
+    }
+    switch (sensor.type)
     {
       case Sensor::Type::OneWire:
-        temperatureCelcius = sensors.getTempC(configSensors.allSensors[i].deviceAddress);
+        if (sensor.present) {
+          oneWireDue |= 1UL << i;
+        }
         break;
       case Sensor::Type::NTC:
-        //temperatureCelcius = readAnalogSensor(configSensors.allSensors[i].index);
-        temperatureCelcius = readMcp3208Sensor(configSensors.allSensors[i].index);
+        storeSample(i, ntcAdcToCelsius(tick.adc[sensor.index]));
         break;
       default:
         printf("Unknown sensor type\n");
         break;
     }
-    configSensors.allSensors[i].lastValue = temperatureCelcius;
-    Serial.print(temperatureCelcius);
+  }
+  if (oneWireDue != 0)
+  {
+    if (oneWireConversion.due != 0) {
+      oneWireConversion.next |= oneWireDue;
+    } else {
+      startOneWireConversion(oneWireDue);
+    }
+  }
+
+  // Counting dropped ticks as well, to stay in step with time
+  if (tick.sequence >= nextSlotSequence)
+  {
+    uint32_t slot = tick.sequence - tick.sequence % (time_between_1h_readings_ms / sample_tick_ms);
+    nextSlotSequence = slot + time_between_1h_readings_ms / sample_tick_ms;
+    slotClose24h = slot % (time_between_24h_readings_ms / sample_tick_ms) == 0;
+    digitalWrite(externalLED, LOW);
+    if (oneWireConversion.due != 0) {
+      slotClosePending = true;
+    } else {
+      closeSlots(slotClose24h);
+    }
+  }
+  mqttPublishSamples();
+}
 
-    // If this sensor should be served, serve it
-    for (int j = 0; j < numServedSensors; j++)
+/** Collects the values of a finished OneWire conversion (and makes the readings waiting for them) */
+void updateOneWireConversion()
+{
+  if (oneWireConversion.due == 0 || millis() - oneWireConversion.startMillis < oneWireConversion.waitMs) {
+    return;
+  }
+  AllocationScope scope(AllocationStats::SampleTick, false);
+  for (int16_t i = 0; i < configSensors.numAllSensors; i++)
+  {
+    if (oneWireConversion.due & (1UL << i))
     {
-      if (servedSensors[j].allSensorsIndex == i)
-      {
-        if (shouldRead1h) {
-          servedSensors[j].addReading_1h(temperatureCelcius);
-        }
-        if (shouldRead24h) {
-          // Use average from the more common 1h reading to reduce noise
-          int numReadings = servedSensors[j].getNumReadings_1h();
-          int numAvg = num_samples_since_boot_1h + 1;
-          if (numAvg > NUM_SAMPLES_AVERAGED_FOR_24H_SAMPLE) {
-            numAvg = NUM_SAMPLES_AVERAGED_FOR_24H_SAMPLE;
-          }
-          int32_t sum = 0;
-          for (int i = 0; i < numAvg; i++) {
-            sum += servedSensors[j].getReading_1h_raw(numReadings - 1 - i);
-          }
-          servedSensors[j].addReading_24h_raw(sum / numAvg);
-        }
+      float temperatureCelcius = sensors.getTempC(configSensors.allSensors[i].deviceAddress);
+      if (temperatureCelcius != DEVICE_DISCONNECTED_C) { // pulled out since the last discovery pass
+        storeSample(i, temperatureCelcius);
       }
     }
-    Serial.print(" ");
   }
-  Serial.println();
-  if (shouldRead1h) { num_samples_since_boot_1h++; }
-  if (shouldRead24h) { num_samples_since_boot_24h++; }
+  mqttPublishSamples();
+  oneWireConversion.due = 0;
+  if (oneWireConversion.next != 0)
+  {
+    startOneWireConversion(oneWireConversion.next);
+    oneWireConversion.next = 0;
+  }
+  else if (slotClosePending)
+  {
+    slotClosePending = false;
+    closeSlots(slotClose24h);
+  }
 }
 
-float readMcp3208Sensor(int analogChannel)
+/** Sets the resolution of a DS18B20 as configured, if it is not already (it is kept in the sensor's EEPROM) */
+void applySensorResolution(int i)
+{
+  Sensor const & sensor = configSensors.allSensors[i];
+  if (sensor.type == Sensor::Type::OneWire && sensor.present && sensors.getResolution(sensor.deviceAddress) != sensor.resolution) {
+    sensors.setResolution(sensor.deviceAddress, sensor.resolution);
+  }
+}
+
+/** Convert a MCP3208 reading of a 10k NTC (with a 10k resistor to Vref) to degrees Celsius */
+float ntcAdcToCelsius(int adc_in)
 {
-  // READ ADC AND CONVERT TO TEMPERATURE
-  int adc_in = mcp3208.read(analogChannel);
   float res = 10e3/(4096.0f / adc_in - 1);
   const float B = 3950;
   const float R0 = 10000; // NTC resistor, 10k @ 25 deg C
   const float T0 = 273.15 + 25;
 
-  float temp = B / log(res / (R0*expf(-B/T0))) - 273.15;
-
-// Serial.printf("MCP3208 %d: raw=%d, res=%5.1f Ohm, temp=%2.2f C\n", analogChannel, adc_in, res, temp);
-
-  return temp;
+  return B / log(res / (R0*expf(-B/T0))) - 273.15;
 }
 
 void loop()
 {
   Serial.println("loop()");
 
-  readSensors(true, true);
-
-  bool shouldRead1h = false;
-  bool shouldRead24h = false;
-
-  unsigned long startMillis_1h = millis();
-  unsigned long startMillis_24h = startMillis_1h; // TODO: clean this up?
+  // Samples are taken by the timer interrupt, the first one right away, and stored here as the loop gets to them
+  uint8_t ntcChannels = 0;
+  for (int i = 0; i < configSensors.numAllSensors; i++)
+  {
+    if (configSensors.allSensors[i].type == Sensor::Type::NTC) {
+      ntcChannels |= 1 << configSensors.allSensors[i].index;
+    }
+  }
+  sampleTimer.begin(sample_tick_ms, ntcChannels);
 
   while (true)
   {
     //Serial.printf("Stations connected = %d\n", WiFi.softAPgetStationNum());
     //delay(3000);
-  
-    // While busy waiting for next reading - handle web requests
+
+    // Ticks after one making the readings wait until it is done: their samples go towards the next ones
+    SampleTimer::Tick tick;
+    while (!slotClosePending && sampleTimer.pop(tick))
+    {
+      readSensors(tick);
+    }
+    if (!slotClosePending) {
+      showAlerts(); // (the OneWire samples of a tick are in by the next one)
+    }
+
+    // While waiting for the next sample - handle web requests
     do
     {
       MDNS.update(); // NOTE are some bugs in : https://github.com/esp8266/Arduino/issues/4790
-      server.handleClient();
-      delay(20); // TODO: is this needed??
+      server.handleClients();
+      wifiScan.update();
+      updateOneWireConversion();
+      // Searching the bus between conversions, one device per round
+      if (oneWireConversion.due == 0 && oneWireDiscovery.update()) {
+        mergeOneWireSensors();
+      }
+      if (mqtt.loop()) {
+        mqttStatePending = true; // new session
+        mqttStateNext = 0;
+        alerts.setAllUnpublished();
+      }
+      if (mqttStatePending && mqtt.connected()) {
+        mqttPublishState();
+      }
+      if (alerts.unpublished() != 0 && !mqttStatePending && mqtt.connected()) {
+        mqttPublishAlerts();
+      }
+      wallClock.loop();
+      if (otaUpdate.restartDue() && !server.isBusy()) {
+        Serial.println("Restarting with the update");
+        ESP.restart();
+      }
+      // Poll more often while responses are being sent (or uploads received), each round only moves what lwIP has room for / has
+      delay(server.isBusy() ? 2 : 20); // TODO: is this needed??
       //            Working combination is 500ms / reading + 10ms here. (ap most often there)
       //            Non-working combination is 500ms / reading + 1ms here (ap disapperas)
       //            Working rock stable: 1000ms / 20ms
-      shouldRead1h = (millis() - startMillis_1h) >= time_between_1h_readings_ms;
-      shouldRead24h = (millis() - startMillis_24h) >= time_between_24h_readings_ms;
     }
-    while (! (shouldRead1h || shouldRead24h));
-
-    if (shouldRead1h)
-    {
-        digitalWrite(externalLED, LOW);
-    }   
-    readSensors(shouldRead1h, shouldRead24h);
-
-    if (shouldRead1h) {
-      startMillis_1h += time_between_1h_readings_ms;
-      shouldRead1h = false;
-      digitalWrite(externalLED, HIGH);
-    }
-
-    if (shouldRead24h) {
-      startMillis_24h += time_between_24h_readings_ms;
-      shouldRead24h = false;
-    }
-
-
+    while (slotClosePending || !sampleTimer.pending());
   }
 }
@@ -0,0 +1,348 @@
+// Microbenchmarks of the data path: sample storage, value formatting and the
+// JSON serialization of sensors and readings, built against the host stand-ins.
+//
+//   make -C host bench                    run all benchmarks
+//   make -C host bench FILTER=readings    only those with "readings" in the name
+//
+// Reports wall time, heap operations (malloc/calloc/realloc) and requested heap
+// bytes per operation. Heap numbers come from the hooks in hal/SimHeap.cpp, and
+// the String stand-in grows its buffer the same way the ESP8266 core does, so
+// allocation counts carry over to the target even though timings do not.
+
+#include "../hal/Sim.hpp"
+
+#include "../../esp8266_temperature_iot.ino"
+
+#include <chrono>
+
+namespace {
+
+const char *s_filter = nullptr;
+
+template<typename T>
+inline void doNotOptimize(T const &value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/** Run op(i) for i = 0, 1, ... long enough to get a stable measurement, and report the averages */
+template<typename F>
+void benchmark(const char *name, F &&op)
+{
+  if (s_filter && !strstr(name, s_filter)) {
+    return;
+  }
+
+  using clock = std::chrono::steady_clock;
+  uint64_t iterations = 1;
+  while (true) {
+    sim::HeapStats before = sim::heapStats();
+    clock::time_point start = clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      op(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    sim::HeapStats after = sim::heapStats();
+
+    if (ns >= 200e6 || iterations >= (1ULL << 32)) {
+      printf("%-44s %12.1f ns/op %9.2f allocs/op %10.1f bytes/op\n", name, ns / iterations,
+             double(after.allocations - before.allocations) / iterations,
+             double(after.bytesAllocated - before.bytesAllocated) / iterations);
+      fflush(stdout);
+      return;
+    }
+    iterations = (ns < 1e6) ? iterations * 10 : uint64_t(iterations * 250e6 / ns) + 1;
+  }
+}
+
+/** Something that looks like an evening in the boiler room, in degrees Celsius */
+float sampleValue(uint64_t i)
+{
+  return 20.0f + 60.0f * float((i * 7919) % 1000) / 1000.0f - (i % 5 == 0 ? 25.0f : 0.0f);
+}
+
+void setupSensors()
+{
+  configSensors.numAllSensors = 0;
+  for (int i = 0; i < maxNumServedSensors; i++) {
+    Sensor &s = configSensors.allSensors[configSensors.numAllSensors++];
+    s = {};
+    if (i % 2 == 0) {
+      s.type = Sensor::Type::OneWire;
+      s.index = i;
+      uint8_t address[8] = {0x28, 0xff, 0xba, 0xa4, 0x64, 0x14, 0x03, uint8_t(i)};
+      memcpy(s.deviceAddress, address, sizeof(address));
+      deviceAddressToString(s.deviceAddress, s.id);
+    } else {
+      s.type = Sensor::Type::NTC;
+      s.index = i;
+      snprintf(s.id, sizeof(s.id), "%016d", i);
+    }
+    snprintf(s.name, sizeof(s.name), "Sensor%d", i);
+    s.active = true;
+    s.lastValue = sampleValue(i);
+  }
+
+  numServedSensors = maxNumServedSensors;
+  for (int k = 0; k < numServedSensors; k++) {
+    servedSensors[k].allSensorsIndex = k;
+    servedSensors[k].fill_1h(0.0f);
+    servedSensors[k].fill_24h(0.0f);
+    for (int i = 0; i < 1440; i++) {
+      servedSensors[k].addReading_1h(sampleValue(i + k));
+      servedSensors[k].addReading_24h(sampleValue(i + k));
+    }
+  }
+  num_samples_since_boot_1h = 1440;
+  num_samples_since_boot_24h = 1440;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc > 1) {
+    s_filter = argv[1];
+  }
+  scratchpad.reserve(2048); // as in setup()
+  setupSensors();
+
+  {
+    CircularBuffer<int16_t, 360> buffer;
+    buffer.fill(0);
+    benchmark("CircularBuffer<360>::push_back_erase_if_full", [&](uint64_t i) {
+      buffer.push_back_erase_if_full(int16_t(i));
+      doNotOptimize(buffer);
+    });
+    benchmark("CircularBuffer<360>::operator[] (x360)", [&](uint64_t) {
+      int32_t sum = 0;
+      for (int j = 0; j < buffer.size(); j++) {
+        sum += buffer[j];
+      }
+      doNotOptimize(sum);
+    });
+  }
+  {
+    // Rising: the reading leaving the window is always the minimum
+    CircularBuffer<int16_t, 360> buffer;
+    RollingStats<int16_t, 360> stats;
+    buffer.fill(0);
+    stats.reset(buffer, 360, 360);
+    benchmark("RollingStats<360>::push (rising)", [&](uint64_t i) {
+      stats.push(buffer, int16_t(i % 30000));
+      buffer.push_back_erase_if_full(int16_t(i % 30000));
+      doNotOptimize(stats);
+    });
+    benchmark("RollingStats<360>::push (noisy)", [&](uint64_t i) {
+      int16_t value = ServedSensor::ftov(sampleValue(i));
+      stats.push(buffer, value);
+      buffer.push_back_erase_if_full(value);
+      doNotOptimize(stats);
+    });
+  }
+  {
+    CircularBuffer<int16_t, 512> buffer;
+    buffer.fill(0);
+    benchmark("CircularBuffer<512>::operator[] (x512)", [&](uint64_t i) {
+      buffer.push_back_erase_if_full(int16_t(i));
+      int32_t sum = 0;
+      for (int j = 0; j < buffer.size(); j++) {
+        sum += buffer[j];
+      }
+      doNotOptimize(sum);
+    });
+  }
+  {
+    CircularBuffer<int16_t, 1440> buffer;
+    buffer.fill(0);
+    benchmark("CircularBuffer<1440>::push_back_erase_if_full", [&](uint64_t i) {
+      buffer.push_back_erase_if_full(int16_t(i));
+      doNotOptimize(buffer);
+    });
+    benchmark("CircularBuffer<1440>::operator[] (x1440)", [&](uint64_t) {
+      int32_t sum = 0;
+      for (int j = 0; j < buffer.size(); j++) {
+        sum += buffer[j];
+      }
+      doNotOptimize(sum);
+    });
+    benchmark("CircularBuffer<1440>::copy_out (x1440)", [&](uint64_t i) {
+      static int16_t out[1440];
+      buffer.push_back_erase_if_full(int16_t(i));
+      buffer.copy_out(0, out, buffer.size());
+      doNotOptimize(out);
+    });
+  }
+
+  benchmark("ServedSensor::ftov", [](uint64_t i) {
+    doNotOptimize(ServedSensor::ftov(sampleValue(i)));
+  });
+  benchmark("ServedSensor::vtos", [](uint64_t i) {
+    char buf[12];
+    doNotOptimize(ServedSensor::vtos(ServedSensor::ftov(sampleValue(i)), buf));
+  });
+  benchmark("ntcAdcToCelsius", [](uint64_t i) {
+    doNotOptimize(ntcAdcToCelsius(100 + int(i % 3900)));
+  });
+  benchmark("deviceAddressToString", [](uint64_t i) {
+    char id[17];
+    deviceAddressToString(configSensors.allSensors[0].deviceAddress, id);
+    doNotOptimize(id);
+  });
+  benchmark("sensorToString (OneWire)", [](uint64_t) {
+    String & s = scratchpad;
+    s = "";
+    sensorToString(s, 0);
+    doNotOptimize(s.c_str());
+  });
+  benchmark("sensorToString (NTC)", [](uint64_t) {
+    String & s = scratchpad;
+    s = "";
+    sensorToString(s, 1);
+    doNotOptimize(s.c_str());
+  });
+  benchmark("handleSensors", [](uint64_t) {
+    handleSensors();
+  });
+  {
+    // A full set of rules, all on the sampled sensor: the most a sample costs
+    configAlerts.numRules = ConfigAlerts::MAX_RULES;
+    for (int r = 0; r < ConfigAlerts::MAX_RULES; r++) {
+      AlertRule & rule = configAlerts.rules[r];
+      strcpy(rule.sensor, configSensors.allSensors[0].id);
+      rule.kind = AlertRule::Kind(r % 5);
+      rule.limit = 20;
+      rule.hysteresis = 1;
+      rule.windowS = ConfigAlerts::MIN_WINDOW_S;
+    }
+    alerts.reset();
+    benchmark("Alerts::onSample (8 rules)", [](uint64_t i) {
+      alerts.onSample(0, sampleValue(i));
+      doNotOptimize(alerts);
+    });
+    configAlerts.numRules = 0;
+    alerts.reset();
+  }
+  {
+    // A full time index: the clock corrected at every 100th reading (what a range query looks up at both ends)
+    TimeIndex<8> index(10);
+    for (int a = 0; a < 8; a++) {
+      index.update(a * 100, 1700000000UL + a * 1003, 2);
+    }
+    benchmark("TimeIndex<8>::lastReadingAt", [&](uint64_t i) {
+      doNotOptimize(index.lastReadingAt(1700000000UL + i % 8000));
+    });
+    benchmark("TimeIndex<8>::timeOf", [&](uint64_t i) {
+      doNotOptimize(index.timeOf(int32_t(i % 800)));
+    });
+  }
+
+  const int sensorCounts[] = {1, 2, 4, 6, 8, 12};
+  for (bool serve_24h : {false, true}) {
+    for (int n : sensorCounts) {
+      if (n > maxNumServedSensors) {
+        continue;
+      }
+      char name[64];
+      snprintf(name, sizeof(name), "readings/%s, %2d sensors x %4d samples", serve_24h ? "24h" : "1h ",
+               n, serve_24h ? 1440 : 360);
+      for (int k = 0; k < maxNumServedSensors; k++) {
+        servedSensors[k].allSensorsIndex = k < n ? k : -1;
+      }
+      numServedSensors = n;
+      benchmark(name, [&](uint64_t) {
+        // What the server does to send the response: generate it in send buffer sized parts
+        HttpServer::StreamState state;
+        ReadingsStream & rs = state.as<ReadingsStream>();
+        rs = {};
+        rs.serve24h = serve_24h;
+        rs.end = numReadings(serve_24h);
+        rs.numSamples = serve_24h ? num_samples_since_boot_24h : num_samples_since_boot_1h;
+        char buf[HttpServer::SEND_BUFFER_SIZE - 8];
+        while (generateReadings(buf, sizeof(buf), state) > 0) {
+          doNotOptimize(buf);
+        }
+      });
+    }
+  }
+  // The same, gzip compressed on the way out as for a client that accepts it (6 sensors, as on the board):
+  // the readings above (noisy, the worst case), and 24h ones of a slow drift with some noise
+  struct { bool serve24h; bool smooth; } const gzipCases[] = {{false, false}, {true, false}, {true, true}};
+  for (auto gzipCase : gzipCases) {
+    const int n = min(6, int(maxNumServedSensors));
+    for (int k = 0; k < maxNumServedSensors; k++) {
+      servedSensors[k].allSensorsIndex = k < n ? k : -1;
+      if (gzipCase.smooth) {
+        for (int i = 0; i < 1440; i++) {
+          servedSensors[k].addReading_24h(20.0f + 3.0f * sinf((i + 100 * k) / 200.0f) + 0.03f * ((i * 7919) % 3));
+        }
+      }
+    }
+    numServedSensors = n;
+    static GzipEncoder gzip;
+    auto generate = [&](size_t & plainSize) {
+      HttpServer::StreamState state;
+      ReadingsStream & rs = state.as<ReadingsStream>();
+      rs = {};
+      rs.serve24h = gzipCase.serve24h;
+      rs.end = numReadings(gzipCase.serve24h);
+      rs.numSamples = gzipCase.serve24h ? num_samples_since_boot_24h : num_samples_since_boot_1h;
+      gzip.begin();
+      uint8_t buf[HttpServer::SEND_BUFFER_SIZE - 8];
+      size_t size = 0;
+      size_t len;
+      while ((len = gzip.compress(buf, sizeof(buf), [&](char* in, size_t room) {
+                size_t m = generateReadings(in, room, state);
+                plainSize += m;
+                return m;
+              })) > 0) {
+        doNotOptimize(buf);
+        size += len;
+      }
+      return size;
+    };
+    size_t plainSize = 0;
+    size_t gzipSize = generate(plainSize);
+    char name[64];
+    snprintf(name, sizeof(name), "readings/%s gzip, %d %s %5u->%5u B", gzipCase.serve24h ? "24h" : "1h ",
+             n, gzipCase.smooth ? "smooth " : "sensors", unsigned(plainSize), unsigned(gzipSize));
+    benchmark(name, [&](uint64_t) {
+      size_t ignored = 0;
+      doNotOptimize(generate(ignored));
+    });
+  }
+  {
+    // The 24h readings stored compressed (a slowly rising series): adding one, and serving them reconstructed
+    for (int k = 0; k < maxNumServedSensors; k++) {
+      servedSensors[k].allSensorsIndex = k;
+      servedSensors[k].fill_24h(0.0f, 10);
+      for (int i = 0; i < 1440; i++) {
+        servedSensors[k].addReading_24h(20.0f + i / 500.0f + (i % 7 == 0 ? 0.05f : 0.0f));
+      }
+    }
+    numServedSensors = maxNumServedSensors;
+    benchmark("ServedSensor::addReading_24h (compressed)", [](uint64_t i) {
+      servedSensors[0].addReading_24h(20.0f + (i % 1000) / 500.0f);
+    });
+    char name[64];
+    snprintf(name, sizeof(name), "readings/24h, %2d sensors x %4d compressed", maxNumServedSensors, 1440);
+    benchmark(name, [&](uint64_t) {
+      HttpServer::StreamState state;
+      ReadingsStream & rs = state.as<ReadingsStream>();
+      rs = {};
+      rs.serve24h = true;
+      rs.end = numReadings(true);
+      rs.numSamples = num_samples_since_boot_24h;
+      char buf[HttpServer::SEND_BUFFER_SIZE - 8];
+      while (generateReadings(buf, sizeof(buf), state) > 0) {
+        doNotOptimize(buf);
+      }
+    });
+  }
+  for (int k = 0; k < maxNumServedSensors; k++) {
+    servedSensors[k].allSensorsIndex = k;
+  }
+  numServedSensors = maxNumServedSensors;
+
+  return 0;
+}
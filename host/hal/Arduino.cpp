@@ -0,0 +1,187 @@
+#include "Arduino.h"
+#include "Sim.hpp"
+#include "SimTrace.hpp"
+
+#include "../../Mcp3208.hpp"
+
+#include <time.h>
+
+static uint64_t s_virtual_us = 0;
+static double s_time_scale = 1.0;
+
+namespace sim {
+
+void setTimeScale(double scale)
+{
+  s_time_scale = scale;
+}
+
+uint64_t virtualMicros()
+{
+  return s_virtual_us;
+}
+
+void advance(uint64_t us)
+{
+  s_virtual_us += us;
+  if (s_time_scale > 0) {
+    uint64_t real_ns = uint64_t(us * 1000 / s_time_scale);
+    struct timespec ts = {time_t(real_ns / 1000000000ULL), long(real_ns % 1000000000ULL)};
+    nanosleep(&ts, nullptr);
+  }
+}
+
+} // namespace sim
+
+unsigned long millis()
+{
+  return (unsigned long)(s_virtual_us / 1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)s_virtual_us;
+}
+
+static struct {
+  timercallback callback;
+  bool enabled;
+  bool reload;
+  uint8_t divider;
+  uint64_t periodUs;
+  uint64_t dueUs;    ///< virtual time of the next interrupt
+} s_timer1;
+
+/** Advances virtual time to end, running the timer interrupts due on the way, at their time */
+static void runUntil(uint64_t end, bool sleep)
+{
+  while (s_timer1.enabled && s_timer1.callback && s_timer1.dueUs <= end)
+  {
+    if (s_timer1.dueUs > s_virtual_us) {
+      if (sleep) {
+        sim::advance(s_timer1.dueUs - s_virtual_us);
+      } else {
+        s_virtual_us = s_timer1.dueUs;
+      }
+    }
+    s_timer1.dueUs += s_timer1.periodUs;
+    s_timer1.enabled = s_timer1.reload;
+    s_timer1.callback();
+  }
+  if (end > s_virtual_us) {
+    if (sleep) {
+      sim::advance(end - s_virtual_us);
+    } else {
+      s_virtual_us = end;
+    }
+  }
+}
+
+void delay(unsigned long ms)
+{
+  runUntil(s_virtual_us + uint64_t(ms) * 1000, true);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  // Too short to be worth sleeping for. Busy waiting on the board, the timer interrupt still fires
+  // (1-Wire searches wait some 13 ms in all)
+  runUntil(s_virtual_us + us, false);
+}
+
+void yield()
+{
+}
+
+void timer1_isr_init()
+{
+}
+
+void timer1_attachInterrupt(timercallback userFunc)
+{
+  s_timer1.callback = userFunc;
+}
+
+void timer1_detachInterrupt()
+{
+  s_timer1.callback = nullptr;
+  s_timer1.enabled = false;
+}
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload)
+{
+  (void)int_type;
+  s_timer1.divider = divider;
+  s_timer1.reload = reload == TIM_LOOP;
+  s_timer1.enabled = true;
+}
+
+void timer1_disable()
+{
+  s_timer1.enabled = false;
+}
+
+void timer1_write(uint32_t ticks)
+{
+  uint64_t halfNsPerTick = s_timer1.divider == TIM_DIV256 ? 6400 : s_timer1.divider == TIM_DIV16 ? 400 : 25;
+  s_timer1.periodUs = std::max<uint64_t>(1, ticks * halfNsPerTick / 2000);
+  s_timer1.dueUs = s_virtual_us + s_timer1.periodUs;
+}
+
+// GPIO, with a MCP3208 attached to the bit banged SPI pins (see Mcp3208.hpp)
+
+static uint8_t s_pins[17];
+
+static struct {
+  bool selected;
+  int clocks;       ///< rising clock edges since chip select
+  uint8_t command;  ///< start, single/diff, D2, D1, D0
+  uint16_t value;   ///< conversion result shifted out MSB first
+} s_mcp3208;
+
+static uint16_t sampleAdc(int channel)
+{
+  char name[8];
+  snprintf(name, sizeof(name), "adc%d", channel);
+  float code = 2048; // 10k NTC at 25 deg C
+  sim::trace().value(name, millis(), code);
+  return uint16_t(std::min(std::max(code, 0.0f), 4095.0f));
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin >= sizeof(s_pins)) {
+    return;
+  }
+  uint8_t previous = s_pins[pin];
+  s_pins[pin] = val ? HIGH : LOW;
+
+  if (pin == MCP3208_nCS) {
+    s_mcp3208.selected = (val == LOW);
+    s_mcp3208.clocks = 0;
+    s_mcp3208.command = 0;
+  } else if (pin == MCP3208_CLK && s_mcp3208.selected && previous == LOW && val != LOW) {
+    s_mcp3208.clocks++;
+    if (s_mcp3208.clocks <= 5) {
+      s_mcp3208.command = (s_mcp3208.command << 1) | s_pins[MCP3208_DOUT];
+      if (s_mcp3208.clocks == 5) {
+        s_mcp3208.value = sampleAdc(s_mcp3208.command & 0x7);
+      }
+    }
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (pin == MCP3208_DIN && s_mcp3208.selected && s_mcp3208.clocks >= 7 && s_mcp3208.clocks < 19) {
+    // 5 command bits and 2 null bits have been clocked, then B11 .. B0 follow
+    return (s_mcp3208.value >> (18 - s_mcp3208.clocks)) & 1;
+  }
+  return pin < sizeof(s_pins) ? s_pins[pin] : LOW;
+}
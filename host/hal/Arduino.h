@@ -0,0 +1,97 @@
+#pragma once
+
+// Minimal stand-in for the ESP8266 Arduino core, used by the host simulation build.
+// Only what the sketch (and ArduinoJson) actually needs is provided.
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT  0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// binary.h (only the constants used in this project)
+#define B11000000 192
+
+// pgmspace.h - flash and RAM are the same thing on the host
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s) FPSTR(PSTR(s))
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t *>(addr))
+#define pgm_read_word(addr) (*reinterpret_cast<const uint16_t *>(addr))
+#define pgm_read_dword(addr) (*reinterpret_cast<const uint32_t *>(addr))
+#define pgm_read_ptr(addr) (*reinterpret_cast<void * const *>(addr))
+#define pgm_read_float(addr) (*reinterpret_cast<const float *>(addr))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// Interrupt handlers and what they call are placed in IRAM on the target
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+inline void os_delay_us(unsigned int us) { delayMicroseconds(us); }
+
+// timer1 (core_esp8266_timer.cpp). The simulation runs its handler from delay() when it is due,
+// with the virtual time set to when it fires.
+#define TIM_DIV1   0 // 80 MHz
+#define TIM_DIV16  1 // 5 MHz
+#define TIM_DIV256 3 // 312.5 kHz
+#define TIM_EDGE   0
+#define TIM_LEVEL  1
+#define TIM_SINGLE 0
+#define TIM_LOOP   1
+typedef void (*timercallback)(void);
+void timer1_isr_init();
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_detachInterrupt();
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable();
+void timer1_write(uint32_t ticks);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
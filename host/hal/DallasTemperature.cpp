@@ -0,0 +1,109 @@
+#include "DallasTemperature.h"
+#include "SimTrace.hpp"
+
+static void idToAddress(std::string const &id, uint8_t *address)
+{
+  for (int i = 0; i < 8; i++) {
+    char hex[3] = {id[2 * i], id[2 * i + 1], 0};
+    address[i] = uint8_t(strtoul(hex, nullptr, 16));
+  }
+}
+
+static void addressToId(const uint8_t *address, char (&id)[17])
+{
+  for (int i = 0; i < 8; i++) {
+    snprintf(&id[2 * i], 3, "%02x", address[i]);
+  }
+}
+
+void DallasTemperature::begin()
+{
+  _devices = uint8_t(sim::trace().oneWireIds(millis()).size());
+}
+
+bool DallasTemperature::getAddress(uint8_t *deviceAddress, uint8_t index)
+{
+  std::vector<std::string> ids = sim::trace().oneWireIds(millis());
+  if (index >= ids.size()) {
+    return false;
+  }
+  idToAddress(ids[index], deviceAddress);
+  return true;
+}
+
+bool DallasTemperature::isConnected(const uint8_t *deviceAddress)
+{
+  float dummy;
+  char id[17];
+  addressToId(deviceAddress, id);
+  return sim::trace().value(id, millis(), dummy);
+}
+
+static uint64_t addressKey(const uint8_t *address)
+{
+  uint64_t key;
+  memcpy(&key, address, sizeof(key));
+  return key;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *deviceAddress, uint8_t resolution, bool skipGlobalBitResolutionCalculation)
+{
+  if (!isConnected(deviceAddress)) {
+    return false;
+  }
+  resolution = std::min<uint8_t>(std::max<uint8_t>(resolution, 9), 12);
+  _deviceResolution[addressKey(deviceAddress)] = resolution;
+  if (!skipGlobalBitResolutionCalculation) {
+    _resolution = 9;
+    for (auto const &r : _deviceResolution) {
+      _resolution = std::max(_resolution, r.second);
+    }
+    if (_deviceResolution.size() < _devices) {
+      _resolution = 12; // the ones never set
+    }
+  }
+  return true;
+}
+
+uint8_t DallasTemperature::getResolution(const uint8_t *deviceAddress)
+{
+  auto it = _deviceResolution.find(addressKey(deviceAddress));
+  return it != _deviceResolution.end() ? it->second : 12;
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t resolution)
+{
+  switch (resolution) {
+    case 9: return 94;
+    case 10: return 188;
+    case 11: return 375;
+    default: return 750;
+  }
+}
+
+void DallasTemperature::requestTemperatures()
+{
+  _conversionStart = millis();
+  if (_waitForConversion && _devices > 0) {
+    delay(millisToWaitForConversion(_resolution));
+  }
+}
+
+bool DallasTemperature::isConversionComplete()
+{
+  return millis() - _conversionStart >= (unsigned long)millisToWaitForConversion(_resolution);
+}
+
+float DallasTemperature::getTempC(const uint8_t *deviceAddress)
+{
+  float celsius;
+  char id[17];
+  addressToId(deviceAddress, id);
+  if (!sim::trace().value(id, millis(), celsius)) {
+    return DEVICE_DISCONNECTED_C;
+  }
+  // The DS18B20 reports in steps of 1/16 degree at 12 bit resolution, 1/2 at 9 bits
+  int bits = getResolution(deviceAddress);
+  float step = 1.0f / (1 << (bits - 8));
+  return roundf(celsius / step) * step;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <OneWire.h>
+
+#include <map>
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+
+/** DallasTemperature stand-in, reading DS18B20 temperatures from the trace. */
+class DallasTemperature
+{
+public:
+  DallasTemperature(OneWire *oneWire) : _wire(oneWire), _devices(0), _waitForConversion(true), _resolution(12) {}
+
+  void begin();
+  uint8_t getDeviceCount() { return _devices; }
+  bool getAddress(uint8_t *deviceAddress, uint8_t index);
+  bool isConnected(const uint8_t *deviceAddress);
+  bool validAddress(const uint8_t *deviceAddress) { return OneWire::crc8(deviceAddress, 7) == deviceAddress[7]; }
+  /** DS18S20, DS1822, DS18B20, DS1825, MAX31850 */
+  bool validFamily(const uint8_t *deviceAddress)
+  {
+    return deviceAddress[0] == 0x10 || deviceAddress[0] == 0x22 || deviceAddress[0] == 0x28 ||
+           deviceAddress[0] == 0x3B || deviceAddress[0] == 0x42;
+  }
+
+  void setResolution(uint8_t resolution) { _resolution = resolution; }
+  uint8_t getResolution() { return _resolution; }
+  /** Per device (kept by the device, 12 bits unless set), the global one becomes the highest set */
+  bool setResolution(const uint8_t *deviceAddress, uint8_t resolution, bool skipGlobalBitResolutionCalculation = false);
+  uint8_t getResolution(const uint8_t *deviceAddress);
+  void setWaitForConversion(bool wait) { _waitForConversion = wait; }
+  bool getWaitForConversion() { return _waitForConversion; }
+  int16_t millisToWaitForConversion(uint8_t resolution);
+
+  /** Like on real hardware, this blocks (in virtual time) for the conversion unless told otherwise */
+  void requestTemperatures();
+  bool isConversionComplete();
+  float getTempC(const uint8_t *deviceAddress);
+
+private:
+  OneWire *_wire;
+  uint8_t _devices;
+  bool _waitForConversion;
+  uint8_t _resolution;
+  unsigned long _conversionStart;
+  std::map<uint64_t, uint8_t> _deviceResolution; ///< by address, those that have been set
+};
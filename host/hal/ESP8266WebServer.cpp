@@ -0,0 +1,368 @@
+#include "ESP8266WebServer.h"
+#include "Sim.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const String emptyString;
+
+static const char *statusText(int code)
+{
+  switch (code) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+static String urlDecode(const String &text)
+{
+  String decoded;
+  for (unsigned int i = 0; i < text.length(); i++) {
+    char c = text[i];
+    if (c == '+') {
+      c = ' ';
+    } else if (c == '%' && i + 2 < text.length()) {
+      char hex[3] = {text[i + 1], text[i + 2], 0};
+      c = char(strtol(hex, nullptr, 16));
+      i += 2;
+    }
+    decoded += c;
+  }
+  return decoded;
+}
+
+ESP8266WebServer::ESP8266WebServer(int port)
+  : _listenFd(-1), _clientFd(-1), _currentMethod(HTTP_ANY), _contentLength(CONTENT_LENGTH_NOT_SET), _chunked(false)
+{
+  (void)port; // see sim::httpPort()
+}
+
+ESP8266WebServer::~ESP8266WebServer()
+{
+  close();
+}
+
+void ESP8266WebServer::begin()
+{
+  _listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(sim::httpPort());
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(_listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(_listenFd, 8) != 0) {
+    perror("sim: web server bind/listen");
+    exit(1);
+  }
+}
+
+void ESP8266WebServer::close()
+{
+  if (_listenFd >= 0) {
+    ::close(_listenFd);
+    _listenFd = -1;
+  }
+}
+
+void ESP8266WebServer::on(const String &uri, HTTPMethod method, THandlerFunction fn)
+{
+  _routes.push_back(Route{uri, method, fn});
+}
+
+void ESP8266WebServer::handleClient()
+{
+  if (_listenFd < 0) {
+    return;
+  }
+  _clientFd = accept4(_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (_clientFd < 0) {
+    return;
+  }
+
+  struct timeval timeout = {2, 0};
+  setsockopt(_clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(_clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  // TCP_SND_BUF of the lwIP build used by the ESP8266 core, so that a slow reader blocks the server as on the board
+  int sendBuffer = 2 * 1460;
+  setsockopt(_clientFd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+
+  if (parseRequest()) {
+    _responseHeaders = "";
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+    _chunked = false;
+
+    bool handled = false;
+    for (Route const &route : _routes) {
+      if (route.uri == _currentUri && (route.method == HTTP_ANY || route.method == _currentMethod)) {
+        route.fn();
+        handled = true;
+        break;
+      }
+    }
+    if (!handled) {
+      if (_notFoundHandler) {
+        _notFoundHandler();
+      } else {
+        send(404, "text/plain", String("Not found: ") + _currentUri);
+      }
+    }
+    if (_chunked) {
+      sendContent("", 0);
+    }
+  }
+
+  ::close(_clientFd);
+  _clientFd = -1;
+}
+
+bool ESP8266WebServer::parseRequest()
+{
+  String request;
+  char buf[512];
+  int headerEnd;
+  while ((headerEnd = request.indexOf("\r\n\r\n")) < 0) {
+    ssize_t n = recv(_clientFd, buf, sizeof(buf), 0);
+    if (n <= 0 || request.length() > 8192) {
+      return false;
+    }
+    request.concat(buf, n);
+  }
+
+  int firstSpace = request.indexOf(' ');
+  int secondSpace = request.indexOf(' ', firstSpace + 1);
+  int firstLineEnd = request.indexOf("\r\n");
+  if (firstSpace < 0 || secondSpace < 0 || secondSpace > firstLineEnd) {
+    return false;
+  }
+  String methodStr = request.substring(0, firstSpace);
+  String url = request.substring(firstSpace + 1, secondSpace);
+
+  _currentMethod = HTTP_ANY;
+  if (methodStr == "GET") {
+    _currentMethod = HTTP_GET;
+  } else if (methodStr == "HEAD") {
+    _currentMethod = HTTP_HEAD;
+  } else if (methodStr == "POST") {
+    _currentMethod = HTTP_POST;
+  } else if (methodStr == "PUT") {
+    _currentMethod = HTTP_PUT;
+  } else if (methodStr == "PATCH") {
+    _currentMethod = HTTP_PATCH;
+  } else if (methodStr == "DELETE") {
+    _currentMethod = HTTP_DELETE;
+  } else if (methodStr == "OPTIONS") {
+    _currentMethod = HTTP_OPTIONS;
+  }
+
+  _currentArgs.clear();
+  _currentHeaders.clear();
+  int query = url.indexOf('?');
+  if (query >= 0) {
+    _currentUri = url.substring(0, query);
+    parseArguments(url.substring(query + 1));
+  } else {
+    _currentUri = url;
+  }
+
+  size_t contentLength = 0;
+  bool isForm = false;
+  int lineStart = firstLineEnd + 2;
+  while (lineStart < headerEnd) {
+    int lineEnd = request.indexOf("\r\n", lineStart);
+    String line = request.substring(lineStart, lineEnd);
+    int colon = line.indexOf(':');
+    if (colon > 0) {
+      String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      value.trim();
+      if (name.equalsIgnoreCase("Content-Length")) {
+        contentLength = value.toInt();
+      } else if (name.equalsIgnoreCase("Content-Type") && value.startsWith("application/x-www-form-urlencoded")) {
+        isForm = true;
+      }
+      _currentHeaders.push_back(RequestArgument{name, value});
+    }
+    lineStart = lineEnd + 2;
+  }
+
+  String body = request.substring(headerEnd + 4);
+  while (body.length() < contentLength) {
+    ssize_t n = recv(_clientFd, buf, std::min(sizeof(buf), contentLength - body.length()), 0);
+    if (n <= 0) {
+      return false;
+    }
+    body.concat(buf, n);
+  }
+  if (contentLength > 0) {
+    if (isForm) {
+      parseArguments(body);
+    }
+    _currentArgs.push_back(RequestArgument{"plain", body});
+  }
+  return true;
+}
+
+void ESP8266WebServer::parseArguments(const String &data)
+{
+  unsigned int pos = 0;
+  while (pos < data.length()) {
+    int end = data.indexOf('&', pos);
+    if (end < 0) {
+      end = data.length();
+    }
+    String pair = data.substring(pos, end);
+    int equals = pair.indexOf('=');
+    if (equals >= 0) {
+      _currentArgs.push_back(RequestArgument{urlDecode(pair.substring(0, equals)), urlDecode(pair.substring(equals + 1))});
+    } else if (pair.length() > 0) {
+      _currentArgs.push_back(RequestArgument{urlDecode(pair), String()});
+    }
+    pos = end + 1;
+  }
+}
+
+const String &ESP8266WebServer::arg(const String &name) const
+{
+  for (RequestArgument const &a : _currentArgs) {
+    if (a.key == name) {
+      return a.value;
+    }
+  }
+  return emptyString;
+}
+
+const String &ESP8266WebServer::arg(int i) const
+{
+  return (i >= 0 && i < args()) ? _currentArgs[i].value : emptyString;
+}
+
+const String &ESP8266WebServer::argName(int i) const
+{
+  return (i >= 0 && i < args()) ? _currentArgs[i].key : emptyString;
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const
+{
+  for (RequestArgument const &a : _currentArgs) {
+    if (a.key == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const String &ESP8266WebServer::header(const String &name) const
+{
+  for (RequestArgument const &h : _currentHeaders) {
+    if (h.key.equalsIgnoreCase(name)) {
+      return h.value;
+    }
+  }
+  return emptyString;
+}
+
+bool ESP8266WebServer::hasHeader(const String &name) const
+{
+  for (RequestArgument const &h : _currentHeaders) {
+    if (h.key.equalsIgnoreCase(name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ESP8266WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+  String line = name + ": " + value + "\r\n";
+  if (first) {
+    _responseHeaders = line + _responseHeaders;
+  } else {
+    _responseHeaders += line;
+  }
+}
+
+void ESP8266WebServer::sendHeaders(int code, const char *content_type, size_t contentLength)
+{
+  char head[256];
+  int len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n", code, statusText(code),
+                     content_type ? content_type : "text/html");
+  if (_contentLength == CONTENT_LENGTH_UNKNOWN) {
+    _chunked = true;
+    len += snprintf(head + len, sizeof(head) - len, "Transfer-Encoding: chunked\r\n");
+  } else {
+    len += snprintf(head + len, sizeof(head) - len, "Content-Length: %zu\r\n",
+                    _contentLength == CONTENT_LENGTH_NOT_SET ? contentLength : _contentLength);
+  }
+  writeToClient(head, len);
+  writeToClient(_responseHeaders.c_str(), _responseHeaders.length());
+  writeToClient("Connection: close\r\n\r\n", 21);
+}
+
+void ESP8266WebServer::send(int code, const char *content_type, const String &content)
+{
+  sendHeaders(code, content_type, content.length());
+  if (content.length()) {
+    sendContent(content);
+  }
+}
+
+void ESP8266WebServer::send_P(int code, PGM_P content_type, PGM_P content)
+{
+  size_t length = strlen(content);
+  sendHeaders(code, content_type, length);
+  sendContent(content, length);
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t length)
+{
+  if (_chunked) {
+    char size[12];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", length);
+    writeToClient(size, n);
+    writeToClient(content, length);
+    writeToClient("\r\n", 2);
+    if (length == 0) {
+      _chunked = false; // that was the last chunk
+    }
+  } else {
+    writeToClient(content, length);
+  }
+}
+
+bool ESP8266WebServer::writeToClient(const void *data, size_t length)
+{
+  const char *p = static_cast<const char *>(data);
+  while (length > 0 && _clientFd >= 0) {
+    ssize_t n = ::send(_clientFd, p, length, MSG_NOSIGNAL);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    length -= n;
+  }
+  return _clientFd >= 0;
+}
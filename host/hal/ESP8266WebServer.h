@@ -0,0 +1,101 @@
+#pragma once
+
+// ESP8266WebServer stand-in serving plain HTTP/1.1 on a local TCP socket.
+// Like the original, one connection is handled at a time from handleClient(),
+// and the connection is closed after each response.
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <vector>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  ESP8266WebServer(int port = 80);
+  ~ESP8266WebServer();
+
+  void begin();
+  void handleClient();
+  void close();
+  void stop() { close(); }
+
+  void on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+  void on(const String &uri, HTTPMethod method, THandlerFunction fn);
+  void onNotFound(THandlerFunction fn) { _notFoundHandler = fn; }
+
+  const String &uri() const { return _currentUri; }
+  HTTPMethod method() const { return _currentMethod; }
+  const String &arg(const String &name) const;
+  const String &arg(int i) const;
+  const String &argName(int i) const;
+  int args() const { return int(_currentArgs.size()); }
+  bool hasArg(const String &name) const;
+  const String &header(const String &name) const;
+  bool hasHeader(const String &name) const;
+
+  void send(int code, const char *content_type = nullptr, const String &content = String(""));
+  void send(int code, char *content_type, const String &content) { send(code, (const char *)content_type, content); }
+  void send(int code, const String &content_type, const String &content) { send(code, content_type.c_str(), content); }
+  void send_P(int code, PGM_P content_type, PGM_P content);
+  void setContentLength(size_t contentLength) { _contentLength = contentLength; }
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *content, size_t length);
+  void sendContent_P(PGM_P content) { sendContent(content, strlen(content)); }
+
+  template<typename T>
+  size_t streamFile(T &file, const String &contentType)
+  {
+    setContentLength(file.size());
+    send(200, contentType, String(""));
+    uint8_t buf[1460];
+    size_t sent = 0;
+    size_t n;
+    while ((n = file.read(buf, sizeof(buf))) > 0) {
+      if (!writeToClient(buf, n)) {
+        break;
+      }
+      sent += n;
+    }
+    return sent;
+  }
+
+private:
+  struct RequestArgument {
+    String key;
+    String value;
+  };
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+  };
+
+  bool parseRequest();
+  void parseArguments(const String &data);
+  void sendHeaders(int code, const char *content_type, size_t contentLength);
+  bool writeToClient(const void *data, size_t length);
+
+  int _listenFd;
+  int _clientFd;
+
+  std::vector<Route> _routes;
+  THandlerFunction _notFoundHandler;
+
+  String _currentUri;
+  HTTPMethod _currentMethod;
+  std::vector<RequestArgument> _currentArgs;
+  std::vector<RequestArgument> _currentHeaders;
+
+  String _responseHeaders;
+  size_t _contentLength;
+  bool _chunked;
+};
@@ -0,0 +1,105 @@
+#include "ESP8266WiFi.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+
+ESP8266WiFiClass WiFi;
+
+namespace {
+
+const unsigned long SCAN_DURATION_MS = 2100;
+
+struct ScannedNetwork {
+  const char *ssid;
+  int32_t rssi;
+  int32_t channel;
+  uint8_t encryption;
+  bool hidden;
+};
+
+// A second access point of HouseNetwork, a hidden network and an SSID that needs escaping in json
+const ScannedNetwork s_networks[] = {
+  {"HouseNetwork", -58, 6, ENC_TYPE_CCMP, false},
+  {"Neighbour 5G-ext", -81, 11, ENC_TYPE_AUTO, false},
+  {"HouseNetwork", -71, 1, ENC_TYPE_CCMP, false},
+  {"", -66, 6, ENC_TYPE_CCMP, true},
+  {"Cafe \"Open\" WiFi", -87, 1, ENC_TYPE_NONE, false},
+  {"Boiler room", -49, 6, ENC_TYPE_TKIP, false},
+};
+
+const int s_numNetworks = sizeof(s_networks) / sizeof(s_networks[0]);
+
+} // namespace
+
+int8_t ESP8266WiFiClass::scanNetworks(bool async, bool show_hidden)
+{
+  (void)show_hidden;
+  _scanRunning = true;
+  _scanDone = false;
+  _scanStartMillis = millis();
+  if (!async) {
+    delay(SCAN_DURATION_MS);
+    return scanComplete();
+  }
+  return WIFI_SCAN_RUNNING;
+}
+
+int8_t ESP8266WiFiClass::scanComplete()
+{
+  if (_scanRunning && millis() - _scanStartMillis >= SCAN_DURATION_MS) {
+    _scanRunning = false;
+    _scanDone = true;
+  }
+  if (_scanRunning) {
+    return WIFI_SCAN_RUNNING;
+  }
+  return _scanDone ? s_numNetworks : WIFI_SCAN_FAILED;
+}
+
+void ESP8266WiFiClass::scanDelete()
+{
+  _scanDone = false;
+}
+
+String ESP8266WiFiClass::SSID(uint8_t networkItem)
+{
+  return (_scanDone && networkItem < s_numNetworks) ? String(s_networks[networkItem].ssid) : String();
+}
+
+int32_t ESP8266WiFiClass::RSSI(uint8_t networkItem)
+{
+  return (_scanDone && networkItem < s_numNetworks) ? s_networks[networkItem].rssi : 0;
+}
+
+int32_t ESP8266WiFiClass::channel(uint8_t networkItem)
+{
+  return (_scanDone && networkItem < s_numNetworks) ? s_networks[networkItem].channel : 0;
+}
+
+uint8_t ESP8266WiFiClass::encryptionType(uint8_t networkItem)
+{
+  return (_scanDone && networkItem < s_numNetworks) ? s_networks[networkItem].encryption : -1;
+}
+
+bool ESP8266WiFiClass::isHidden(uint8_t networkItem)
+{
+  return (_scanDone && networkItem < s_numNetworks) ? s_networks[networkItem].hidden : false;
+}
+
+int ESP8266WiFiClass::hostByName(const char *aHostname, IPAddress &aResult, uint32_t timeout_ms)
+{
+  (void)timeout_ms; // the host resolver has no timeout of its own
+  if (aResult.fromString(aHostname)) {
+    return 1;
+  }
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = nullptr;
+  if (getaddrinfo(aHostname, nullptr, &hints, &result) != 0 || !result) {
+    return 0;
+  }
+  aResult = IPAddress(reinterpret_cast<struct sockaddr_in *>(result->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(result);
+  return 1;
+}
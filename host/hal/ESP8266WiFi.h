@@ -0,0 +1,75 @@
+#pragma once
+
+// WiFi stand-in. The soft AP "starts", the station never finds its network.
+// Scans find a fixed set of networks, after a couple of seconds (of virtual time) when asynchronous.
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+enum wl_enc_type {
+  ENC_TYPE_WEP = 5,
+  ENC_TYPE_TKIP = 2,
+  ENC_TYPE_CCMP = 4,
+  ENC_TYPE_NONE = 7,
+  ENC_TYPE_AUTO = 8
+};
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+class ESP8266WiFiClass
+{
+public:
+  void persistent(bool persistent) { (void)persistent; }
+  bool disconnect(bool wifioff = false) { (void)wifioff; return true; }
+  bool softAPdisconnect(bool wifioff = false) { (void)wifioff; return true; }
+  bool setAutoConnect(bool autoConnect) { (void)autoConnect; return true; }
+  bool setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+  bool hostname(const char *name) { (void)name; return true; }
+
+  bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet) { (void)local_ip; (void)gateway; (void)subnet; return true; }
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr) { (void)ssid; (void)passphrase; return WL_DISCONNECTED; }
+  int8_t waitForConnectResult() { return WL_NO_SSID_AVAIL; }
+  wl_status_t status() { return WL_DISCONNECTED; }
+  IPAddress localIP() { return IPAddress(); }
+
+  bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) { _softAPIP = local_ip; (void)gateway; (void)subnet; return true; }
+  bool softAP(const char *ssid, const char *passphrase = nullptr, int channel = 1, int ssid_hidden = 0, int max_connection = 4)
+  {
+    (void)ssid; (void)passphrase; (void)channel; (void)ssid_hidden; (void)max_connection;
+    return true;
+  }
+  IPAddress softAPIP() { return _softAPIP; }
+  uint8_t softAPgetStationNum() { return 0; }
+
+  int hostByName(const char *aHostname, IPAddress &aResult, uint32_t timeout_ms = 10000);
+
+  int8_t scanNetworks(bool async = false, bool show_hidden = false);
+  int8_t scanComplete();
+  void scanDelete();
+  String SSID(uint8_t networkItem);
+  int32_t RSSI(uint8_t networkItem);
+  int32_t channel(uint8_t networkItem);
+  uint8_t encryptionType(uint8_t networkItem);
+  bool isHidden(uint8_t networkItem);
+
+private:
+  IPAddress _softAPIP;
+  bool _scanRunning = false;
+  bool _scanDone = false;
+  unsigned long _scanStartMillis = 0;
+};
+
+extern ESP8266WiFiClass WiFi;
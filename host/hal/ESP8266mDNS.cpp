@@ -0,0 +1,232 @@
+#include "ESP8266mDNS.h"
+#include "Sim.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+MDNSResponder MDNS;
+
+namespace {
+
+const uint16_t MDNS_PORT = 5353;
+const char MDNS_GROUP[] = "224.0.0.251";
+
+const uint16_t TYPE_A = 1;
+const uint16_t TYPE_PTR = 12;
+const uint16_t TYPE_TXT = 16;
+const uint16_t TYPE_SRV = 33;
+const uint16_t TYPE_ANY = 255;
+
+/** Reads a (possibly compressed) name at pos as "label.label.label", @return false if malformed */
+bool readName(const uint8_t *msg, size_t length, size_t &pos, std::string &name)
+{
+  name.clear();
+  size_t p = pos;
+  bool jumped = false;
+  for (int hops = 0; hops < 16; ) {
+    if (p >= length) {
+      return false;
+    }
+    uint8_t n = msg[p];
+    if (n == 0) {
+      if (!jumped) {
+        pos = p + 1;
+      }
+      return true;
+    }
+    if ((n & 0xc0) == 0xc0) {
+      if (p + 1 >= length) {
+        return false;
+      }
+      if (!jumped) {
+        pos = p + 2;
+      }
+      p = ((n & 0x3f) << 8) | msg[p + 1];
+      jumped = true;
+      hops++;
+      continue;
+    }
+    if (p + 1 + n > length) {
+      return false;
+    }
+    if (!name.empty()) {
+      name += '.';
+    }
+    name.append(reinterpret_cast<const char *>(msg + p + 1), n);
+    p += 1 + n;
+  }
+  return false;
+}
+
+class Writer
+{
+public:
+  void u16(uint16_t v) { data.push_back(v >> 8); data.push_back(v & 0xff); }
+  void u32(uint32_t v) { u16(v >> 16); u16(v & 0xffff); }
+
+  void name(std::string const &dotted)
+  {
+    size_t start = 0;
+    while (start < dotted.size()) {
+      size_t end = dotted.find('.', start);
+      if (end == std::string::npos) {
+        end = dotted.size();
+      }
+      data.push_back(uint8_t(end - start));
+      data.insert(data.end(), dotted.begin() + start, dotted.begin() + end);
+      start = end + 1;
+    }
+    data.push_back(0);
+  }
+
+  /** Record header, @return position of the data length to patch with endRecord() */
+  size_t record(std::string const &owner, uint16_t type, uint32_t ttl)
+  {
+    name(owner);
+    u16(type);
+    u16(1); // class IN
+    u32(ttl);
+    u16(0);
+    return data.size();
+  }
+
+  void endRecord(size_t lengthEnd)
+  {
+    size_t n = data.size() - lengthEnd;
+    data[lengthEnd - 2] = n >> 8;
+    data[lengthEnd - 1] = n & 0xff;
+  }
+
+  std::vector<uint8_t> data;
+};
+
+} // namespace
+
+bool MDNSResponder::begin(const char *hostName)
+{
+  _hostName = hostName;
+  _fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(MDNS_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  struct ip_mreq group = {};
+  inet_aton(MDNS_GROUP, &group.imr_multiaddr);
+  group.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (bind(_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      setsockopt(_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) != 0) {
+    perror("sim: mDNS responder disabled");
+    ::close(_fd);
+    _fd = -1;
+    return true; // the sketch carries on either way
+  }
+  return true;
+}
+
+bool MDNSResponder::addService(const char *service, const char *proto, uint16_t port)
+{
+  _services.push_back({std::string("_") + service + "._" + proto + ".local", port == 80 ? sim::httpPort() : port});
+  return true;
+}
+
+bool MDNSResponder::update()
+{
+  if (_fd < 0) {
+    return true;
+  }
+  uint8_t buf[1500];
+  struct sockaddr_in from = {};
+  socklen_t fromLength = sizeof(from);
+  ssize_t n;
+  while ((n = recvfrom(_fd, buf, sizeof(buf), 0, reinterpret_cast<struct sockaddr *>(&from), &fromLength)) > 0) {
+    answer(buf, size_t(n), from);
+    fromLength = sizeof(from);
+  }
+  return true;
+}
+
+void MDNSResponder::answer(const uint8_t *query, size_t length, struct sockaddr_in const &from)
+{
+  if (length < 12 || (query[2] & 0x80)) {
+    return; // not a query
+  }
+  bool legacyUnicast = ntohs(from.sin_port) != MDNS_PORT;
+  uint16_t numQuestions = (query[4] << 8) | query[5];
+  std::string hostFqdn = _hostName + ".local";
+
+  // Answers: the PTR of a matching service type, with its SRV, TXT and A as additional records
+  Writer answers, additional;
+  int numAnswers = 0, numAdditional = 0;
+  uint32_t ttl = legacyUnicast ? 10 : 120;
+  size_t pos = 12;
+  std::string name;
+  std::vector<uint8_t> questions;
+  for (int q = 0; q < numQuestions; q++) {
+    size_t start = pos;
+    if (!readName(query, length, pos, name) || pos + 4 > length) {
+      return;
+    }
+    uint16_t type = (query[pos] << 8) | query[pos + 1];
+    pos += 4;
+
+    if ((type == TYPE_A || type == TYPE_ANY) && strcasecmp(name.c_str(), hostFqdn.c_str()) == 0) {
+      size_t l = answers.record(hostFqdn, TYPE_A, ttl);
+      answers.u32(ntohl(inet_addr("127.0.0.1")));
+      answers.endRecord(l);
+      numAnswers++;
+    }
+    for (Service const &s : _services) {
+      if ((type != TYPE_PTR && type != TYPE_ANY) || strcasecmp(name.c_str(), s.type.c_str()) != 0) {
+        continue;
+      }
+      std::string instance = _hostName + "." + s.type;
+      size_t l = answers.record(s.type, TYPE_PTR, ttl);
+      answers.name(instance);
+      answers.endRecord(l);
+      numAnswers++;
+
+      l = additional.record(instance, TYPE_SRV, ttl);
+      additional.u16(0); // priority
+      additional.u16(0); // weight
+      additional.u16(s.port);
+      additional.name(hostFqdn);
+      additional.endRecord(l);
+      l = additional.record(instance, TYPE_TXT, ttl);
+      additional.data.push_back(0);
+      additional.endRecord(l);
+      l = additional.record(hostFqdn, TYPE_A, ttl);
+      additional.u32(ntohl(inet_addr("127.0.0.1")));
+      additional.endRecord(l);
+      numAdditional += 3;
+    }
+    if (legacyUnicast) {
+      questions.insert(questions.end(), query + start, query + pos);
+    }
+  }
+  if (numAnswers == 0) {
+    return;
+  }
+
+  Writer response;
+  response.u16(legacyUnicast ? ((query[0] << 8) | query[1]) : 0); // id, echoed for legacy queries
+  response.u16(0x8400);                                            // response, authoritative
+  response.u16(legacyUnicast ? numQuestions : 0);
+  response.u16(numAnswers);
+  response.u16(0);
+  response.u16(numAdditional);
+  response.data.insert(response.data.end(), questions.begin(), questions.end());
+  response.data.insert(response.data.end(), answers.data.begin(), answers.data.end());
+  response.data.insert(response.data.end(), additional.data.begin(), additional.data.end());
+
+  struct sockaddr_in to = from;
+  if (!legacyUnicast) {
+    inet_aton(MDNS_GROUP, &to.sin_addr);
+  }
+  sendto(_fd, response.data.data(), response.data.size(), 0, reinterpret_cast<struct sockaddr *>(&to), sizeof(to));
+}
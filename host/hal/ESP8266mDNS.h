@@ -0,0 +1,33 @@
+#pragma once
+
+// mDNS responder stand-in. Answers queries for the added services (and the host name)
+// on the local machine, pointing at the simulated web server on 127.0.0.1, so that
+// clients doing service discovery can find the simulation. Queries from a port other
+// than 5353 get a unicast answer ("legacy unicast", RFC 6762 section 6.7), others a
+// multicast one.
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+class MDNSResponder
+{
+public:
+  bool begin(const char *hostName);
+  bool update();
+  bool addService(const char *service, const char *proto, uint16_t port);
+
+private:
+  struct Service {
+    std::string type; ///< e.g. "_http._tcp.local"
+    uint16_t port;
+  };
+
+  void answer(const uint8_t *query, size_t length, struct sockaddr_in const &from);
+
+  int _fd = -1;
+  std::string _hostName;
+  std::vector<Service> _services;
+};
+
+extern MDNSResponder MDNS;
@@ -0,0 +1,17 @@
+#include "Arduino.h"
+#include "Sim.hpp"
+
+EspClass ESP;
+
+uint32_t EspClass::getFreeHeap()
+{
+  // roughly what the sketch has left on a D1 mini, minus what it has allocated since
+  int64_t freeHeap = 40 * 1024 - (sim::heapStats().bytesInUse - sim::heapInUseAtBoot());
+  return freeHeap > 0 ? uint32_t(freeHeap) : 0;
+}
+
+void EspClass::restart()
+{
+  Serial.println("sim: ESP.restart()");
+  sim::restart();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+/** The parts of the ESP8266 system API used by the sketch. */
+class EspClass
+{
+public:
+  uint32_t getFreeHeap();
+  uint32_t getChipId() { return 0x00c0ffee; }
+  uint32_t getFreeSketchSpace() { return 0x100000 - 0x64000; }
+  void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,159 @@
+#include "FS.h"
+#include "Sim.hpp"
+
+#include <sys/stat.h>
+#include <filesystem>
+
+fs::FS SPIFFS;
+
+namespace fs {
+
+struct File::Impl {
+  FILE *f;
+  std::string name;
+  ~Impl() { fclose(f); }
+};
+
+static std::string hostPath(const char *path)
+{
+  std::string p = sim::fsRoot();
+  if (path[0] != '/') {
+    p += '/';
+  }
+  return p + path;
+}
+
+size_t File::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+  return _impl ? fwrite(buf, 1, size, _impl->f) : 0;
+}
+
+int File::available()
+{
+  return _impl ? int(size() - position()) : 0;
+}
+
+int File::read()
+{
+  return _impl ? fgetc(_impl->f) : -1;
+}
+
+int File::peek()
+{
+  if (!_impl) {
+    return -1;
+  }
+  int c = fgetc(_impl->f);
+  if (c != EOF) {
+    ungetc(c, _impl->f);
+  }
+  return c;
+}
+
+void File::flush()
+{
+  if (_impl) {
+    fflush(_impl->f);
+  }
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+  return _impl ? fread(buf, 1, size, _impl->f) : 0;
+}
+
+String File::readString()
+{
+  String ret;
+  if (!_impl) {
+    return ret;
+  }
+  ret.reserve(available());
+  char buf[256];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), _impl->f)) > 0) {
+    ret.concat(buf, n);
+  }
+  return ret;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  return _impl && fseek(_impl->f, long(pos), mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+}
+
+size_t File::position() const
+{
+  return _impl ? size_t(ftell(_impl->f)) : 0;
+}
+
+size_t File::size() const
+{
+  if (!_impl) {
+    return 0;
+  }
+  fflush(_impl->f);
+  struct stat st;
+  return fstat(fileno(_impl->f), &st) == 0 ? size_t(st.st_size) : 0;
+}
+
+void File::close()
+{
+  _impl.reset();
+}
+
+const char *File::name() const
+{
+  return _impl ? _impl->name.c_str() : "";
+}
+
+bool FS::format()
+{
+  std::error_code ec;
+  for (auto const &entry : std::filesystem::directory_iterator(sim::fsRoot(), ec)) {
+    std::filesystem::remove_all(entry.path(), ec);
+  }
+  return !ec;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+  if (!_mounted) {
+    return File();
+  }
+  std::string p = hostPath(path);
+  if (mode[0] != 'r') {
+    // SPIFFS has a flat name space, so "directories" never need to be created
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(p).parent_path(), ec);
+  } else if (std::filesystem::is_directory(p)) {
+    return File();
+  }
+  FILE *f = fopen(p.c_str(), mode);
+  if (!f) {
+    return File();
+  }
+  return File(std::shared_ptr<File::Impl>(new File::Impl{f, path}));
+}
+
+bool FS::exists(const char *path)
+{
+  return _mounted && std::filesystem::is_regular_file(hostPath(path));
+}
+
+bool FS::remove(const char *path)
+{
+  return _mounted && ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *pathFrom, const char *pathTo)
+{
+  return _mounted && ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0;
+}
+
+} // namespace fs
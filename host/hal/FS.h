@@ -0,0 +1,75 @@
+#pragma once
+
+// SPIFFS stand-in backed by a directory on the host (see sim::fsRoot()).
+
+#include <Arduino.h>
+#include <memory>
+
+namespace fs {
+
+enum SeekMode {
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+class File : public Stream
+{
+public:
+  File() {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override;
+  size_t read(uint8_t *buf, size_t size);
+  size_t readBytes(char *buffer, size_t length) override { return read(reinterpret_cast<uint8_t *>(buffer), length); }
+  String readString() override;
+
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const { return !!_impl; }
+  const char *name() const;
+
+private:
+  friend class FS;
+  struct Impl;
+  explicit File(std::shared_ptr<Impl> impl) : _impl(impl) {}
+  std::shared_ptr<Impl> _impl;
+};
+
+class FS
+{
+public:
+  /** Mounts it; until then, and after end(), nothing can be opened (as while an image is written over it) */
+  bool begin() { _mounted = true; return true; }
+  void end() { _mounted = false; }
+  bool format();
+
+  File open(const char *path, const char *mode);
+  File open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *pathFrom, const char *pathTo);
+
+private:
+  bool _mounted = false;
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+extern fs::FS SPIFFS;
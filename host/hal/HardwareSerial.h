@@ -0,0 +1,22 @@
+#pragma once
+
+/** Serial port of the simulated board. Everything written ends up on stdout. */
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void end() {}
+  operator bool() const { return true; }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  int availableForWrite() override { return 128; }
+  void flush() override;
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
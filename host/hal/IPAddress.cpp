@@ -0,0 +1,49 @@
+#include "Arduino.h"
+
+bool IPAddress::fromString(const char *address)
+{
+  uint16_t acc = 0;
+  uint8_t dots = 0;
+  uint8_t parsed[4] = {};
+  bool digitSeen = false;
+
+  while (*address) {
+    char c = *address++;
+    if (c >= '0' && c <= '9') {
+      acc = acc * 10 + (c - '0');
+      if (acc > 255) {
+        return false;
+      }
+      digitSeen = true;
+    } else if (c == '.') {
+      if (dots == 3 || !digitSeen) {
+        return false;
+      }
+      parsed[dots++] = acc;
+      acc = 0;
+      digitSeen = false;
+    } else {
+      return false;
+    }
+  }
+  if (dots != 3 || !digitSeen) {
+    return false;
+  }
+  parsed[3] = acc;
+  memcpy(_bytes, parsed, sizeof(_bytes));
+  return true;
+}
+
+String IPAddress::toString() const
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+  return String(buf);
+}
+
+size_t IPAddress::printTo(Print &p) const
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+  return p.print(buf);
+}
@@ -0,0 +1,40 @@
+#include "OneWire.h"
+#include "SimTrace.hpp"
+
+static void idToAddress(std::string const &id, uint8_t *address)
+{
+  for (int i = 0; i < 8; i++) {
+    char hex[3] = {id[2 * i], id[2 * i + 1], 0};
+    address[i] = uint8_t(strtoul(hex, nullptr, 16));
+  }
+}
+
+bool OneWire::search(uint8_t *newAddr, bool search_mode)
+{
+  (void)search_mode;
+  std::vector<std::string> ids = sim::trace().oneWireIds(millis());
+  delayMicroseconds(64 * 3 * 70); // 64 ROM bits, 3 time slots each
+  if (_searchIndex >= ids.size()) {
+    _searchIndex = 0;
+    return false;
+  }
+  idToAddress(ids[_searchIndex++], newAddr);
+  return true;
+}
+
+uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len)
+{
+  uint8_t crc = 0;
+  while (len--) {
+    uint8_t inbyte = *addr++;
+    for (uint8_t i = 8; i; i--) {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
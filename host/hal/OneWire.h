@@ -0,0 +1,23 @@
+#pragma once
+
+// 1-Wire bus stand-in. The DS18B20s on the bus are the ones present in the trace (see SimTrace.hpp).
+
+#include <Arduino.h>
+
+class OneWire
+{
+public:
+  OneWire(uint8_t pin) : _pin(pin), _searchIndex(0) {}
+
+  uint8_t reset() { return 1; }
+  void reset_search() { _searchIndex = 0; }
+
+  /** Each call reports the next device on the bus (in trace order), like the ROM search does */
+  bool search(uint8_t *newAddr, bool search_mode = true);
+
+  static uint8_t crc8(const uint8_t *addr, uint8_t len);
+
+private:
+  uint8_t _pin;
+  size_t _searchIndex;
+};
@@ -0,0 +1,69 @@
+#include "Arduino.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buffer++)) {
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char buf[256];
+  va_list arg;
+  va_start(arg, format);
+  int len = vsnprintf(buf, sizeof(buf), format, arg);
+  va_end(arg);
+  if (len < 0) {
+    return 0;
+  }
+  if (size_t(len) < sizeof(buf)) {
+    return write(buf, len);
+  }
+  char *big = static_cast<char *>(malloc(len + 1));
+  if (!big) {
+    return 0;
+  }
+  va_start(arg, format);
+  vsnprintf(big, len + 1, format, arg);
+  va_end(arg);
+  size_t n = write(big, len);
+  free(big);
+  return n;
+}
+
+size_t Print::print(long n, int base)
+{
+  if (base == DEC && n < 0) {
+    return print('-') + print((unsigned long)-n, base);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned long digit = n % base;
+    *--str = digit < 10 ? char('0' + digit) : char('A' + digit - 10);
+    n /= base;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::print(double number, int digits)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, number);
+  return write(buf);
+}
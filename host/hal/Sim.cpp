@@ -0,0 +1,108 @@
+#include "Arduino.h"
+#include "Sim.hpp"
+#include "SimTrace.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+#include <filesystem>
+
+namespace sim {
+
+static std::string s_fsRoot;
+static bool s_removeFsRootAtExit = false;
+static uint16_t s_httpPort = 8080;
+static int64_t s_heapInUseAtBoot = 0;
+
+static void removeTemporaryFs()
+{
+  if (s_removeFsRootAtExit) {
+    std::error_code ec;
+    std::filesystem::remove_all(s_fsRoot, ec);
+  }
+}
+
+static void exitOnSignal(int)
+{
+  exit(0); // run the atexit handlers
+}
+
+void begin()
+{
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, exitOnSignal);
+  signal(SIGTERM, exitOnSignal);
+
+  if (const char *scale = getenv("SIM_TIME_SCALE")) {
+    setTimeScale(atof(scale));
+  }
+
+  if (const char *port = getenv("SIM_HTTP_PORT")) {
+    s_httpPort = uint16_t(atoi(port));
+  }
+
+  if (const char *dir = getenv("SIM_FS_DIR")) {
+    // Persistent flash, survives restarts of the simulation
+    s_fsRoot = dir;
+    std::filesystem::create_directories(s_fsRoot);
+    // Temporary flash handed over by restart()
+    s_removeFsRootAtExit = getenv("SIM_FS_DIR_TEMPORARY") != nullptr;
+    if (s_removeFsRootAtExit) {
+      atexit(removeTemporaryFs);
+    }
+  } else {
+    // Fresh flash, initialized with the data/ folder (as uploaded by the SPIFFS plugin)
+    char tmpl[] = "/tmp/esp8266_sim_fs.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+      perror("sim: mkdtemp");
+      exit(1);
+    }
+    s_fsRoot = tmpl;
+    s_removeFsRootAtExit = true;
+    atexit(removeTemporaryFs);
+    std::filesystem::copy(SIM_DATA_DIR, s_fsRoot, std::filesystem::copy_options::recursive);
+  }
+
+  const char *tracePath = getenv("SIM_TRACE");
+  if (!trace().load(tracePath ? tracePath : SIM_DEFAULT_TRACE)) {
+    exit(1);
+  }
+
+  s_heapInUseAtBoot = heapStats().bytesInUse;
+  fprintf(stderr, "sim: flash in %s, http on 127.0.0.1:%u\n", s_fsRoot.c_str(), s_httpPort);
+}
+
+void restart()
+{
+  fflush(stdout);
+  fflush(stderr);
+  // The flash survives, also when it is a temporary copy (removed when the last run exits)
+  setenv("SIM_FS_DIR", s_fsRoot.c_str(), 1);
+  if (s_removeFsRootAtExit) {
+    setenv("SIM_FS_DIR_TEMPORARY", "1", 1);
+  }
+  // Sockets must not outlive the run (the listening one would keep the port)
+  for (int fd = 3; fd < 1024; fd++) {
+    close(fd);
+  }
+  char *const argv[] = {const_cast<char *>("esp8266_temperature_iot_sim"), nullptr};
+  execv("/proc/self/exe", argv);
+  perror("sim: restart");
+  _exit(1);
+}
+
+std::string const &fsRoot()
+{
+  return s_fsRoot;
+}
+
+int64_t heapInUseAtBoot()
+{
+  return s_heapInUseAtBoot;
+}
+
+uint16_t httpPort()
+{
+  return s_httpPort;
+}
+
+} // namespace sim
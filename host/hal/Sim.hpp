@@ -0,0 +1,44 @@
+#pragma once
+
+// Control interface of the host simulation (not available when building for the board).
+
+#include <stdint.h>
+#include <string>
+
+namespace sim {
+
+/** Parse the environment (SIM_* variables), set up the flash file system and the trace. */
+void begin();
+
+/** Start the simulation over (same binary, environment and flash), as the board does on a reset */
+[[noreturn]] void restart();
+
+/** Virtual time since boot. Only advances through delay() / delayMicroseconds(). */
+uint64_t virtualMicros();
+
+/** Advance virtual time, sleeping the scaled amount of real time. */
+void advance(uint64_t us);
+
+/** Virtual seconds per real second. 0 runs as fast as possible. */
+void setTimeScale(double scale);
+
+/** Directory backing SPIFFS. */
+std::string const &fsRoot();
+
+/** TCP port the simulated web server listens on (the sketch's port number is ignored). */
+uint16_t httpPort();
+
+/** Counters maintained by the malloc/free hooks in SimHeap.cpp */
+struct HeapStats {
+  uint64_t allocations;    ///< malloc, calloc and realloc calls
+  uint64_t frees;
+  uint64_t bytesAllocated; ///< requested by the calls above
+  int64_t bytesInUse;
+};
+
+HeapStats heapStats();
+
+/** Heap in use when begin() was called (the host runtime's, not the sketch's) */
+int64_t heapInUseAtBoot();
+
+} // namespace sim
@@ -0,0 +1,90 @@
+// malloc/free hooks counting heap operations, so heap usage of the sketch can be
+// measured on the host (operator new ends up in malloc as well).
+
+#include "Sim.hpp"
+
+#include <malloc.h>
+#include <atomic>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+static std::atomic<uint64_t> s_allocations;
+static std::atomic<uint64_t> s_frees;
+static std::atomic<uint64_t> s_bytesAllocated;
+static std::atomic<int64_t> s_bytesInUse;
+
+static void *countAllocation(void *ptr, size_t size)
+{
+  if (ptr) {
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    s_bytesInUse.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+  return ptr;
+}
+
+static void countFree(void *ptr)
+{
+  if (ptr) {
+    s_frees.fetch_add(1, std::memory_order_relaxed);
+    s_bytesInUse.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+}
+
+extern "C" {
+
+void *malloc(size_t size)
+{
+  return countAllocation(__libc_malloc(size), size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+  return countAllocation(__libc_calloc(nmemb, size), nmemb * size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  if (ptr) {
+    s_bytesInUse.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+  void *result = __libc_realloc(ptr, size);
+  if (result) {
+    return countAllocation(result, size);
+  }
+  if (ptr) {
+    if (size == 0) {
+      s_frees.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      s_bytesInUse.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed); // failed, ptr still valid
+    }
+  }
+  return result;
+}
+
+void free(void *ptr)
+{
+  countFree(ptr);
+  __libc_free(ptr);
+}
+
+} // extern "C"
+
+namespace sim {
+
+HeapStats heapStats()
+{
+  return HeapStats{
+    s_allocations.load(std::memory_order_relaxed),
+    s_frees.load(std::memory_order_relaxed),
+    s_bytesAllocated.load(std::memory_order_relaxed),
+    s_bytesInUse.load(std::memory_order_relaxed),
+  };
+}
+
+} // namespace sim
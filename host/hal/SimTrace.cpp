@@ -0,0 +1,100 @@
+#include "SimTrace.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace sim {
+
+Trace &trace()
+{
+  static Trace instance;
+  return instance;
+}
+
+static bool isOneWireId(std::string const &channel)
+{
+  return channel.size() == 16 && channel.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos;
+}
+
+bool Trace::load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "sim: could not open trace '%s'\n", path);
+    return false;
+  }
+
+  char line[256];
+  int lineNo = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineNo++;
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0') {
+      continue;
+    }
+    unsigned long long ms;
+    char channel[32];
+    char value[32];
+    if (sscanf(p, "%llu %31s %31s", &ms, channel, value) != 3) {
+      fprintf(stderr, "sim: %s:%d: malformed line\n", path, lineNo);
+      continue;
+    }
+    std::string name(channel);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    Point point{ms, 0.0f, strcmp(value, "-") != 0};
+    if (point.present) {
+      point.value = strtof(value, nullptr);
+    }
+    std::vector<Point> &points = _channels[name];
+    if (!points.empty() && points.back().ms > ms) {
+      fprintf(stderr, "sim: %s:%d: samples for %s not in time order\n", path, lineNo, channel);
+      continue;
+    }
+    points.push_back(point);
+    if (isOneWireId(name) && std::find(_oneWireOrder.begin(), _oneWireOrder.end(), name) == _oneWireOrder.end()) {
+      _oneWireOrder.push_back(name);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+bool Trace::value(std::string_view channel, uint64_t ms, float &out) const
+{
+  auto it = _channels.find(channel);
+  if (it == _channels.end()) {
+    return false;
+  }
+  std::vector<Point> const &points = it->second;
+  auto next = std::upper_bound(points.begin(), points.end(), ms,
+                               [](uint64_t t, Point const &p) { return t < p.ms; });
+  if (next == points.begin()) {
+    return false; // not yet attached
+  }
+  Point const &prev = *(next - 1);
+  if (!prev.present) {
+    return false;
+  }
+  out = prev.value;
+  if (next != points.end() && next->present && next->ms != prev.ms) {
+    float fraction = float(ms - prev.ms) / float(next->ms - prev.ms);
+    out += fraction * (next->value - prev.value);
+  }
+  return true;
+}
+
+std::vector<std::string> Trace::oneWireIds(uint64_t ms) const
+{
+  std::vector<std::string> ids;
+  float dummy;
+  for (std::string const &id : _oneWireOrder) {
+    if (value(id, ms, dummy)) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+} // namespace sim
@@ -0,0 +1,43 @@
+#pragma once
+
+// Recorded (or hand written) sensor signals replayed by the simulated hardware.
+//
+// One sample per line: <virtual time ms> <channel> <value>
+//   channel adc0 .. adc7  raw MCP3208 code (0 - 4095)
+//   channel <16 hex digits> DS18B20 with that ROM address, value in degrees Celsius,
+//                           or '-' while the probe is disconnected
+// Values are linearly interpolated between samples of the same channel, and held
+// after the last one. Lines starting with '#' are comments.
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sim {
+
+class Trace
+{
+public:
+  bool load(const char *path);
+
+  /** @return false if the channel is unknown or not present at time ms */
+  bool value(std::string_view channel, uint64_t ms, float &out) const;
+
+  /** ROM addresses (as 16 hex digit strings) of the DS18B20s attached at time ms, in trace order */
+  std::vector<std::string> oneWireIds(uint64_t ms) const;
+
+private:
+  struct Point {
+    uint64_t ms;
+    float value;
+    bool present;
+  };
+  std::map<std::string, std::vector<Point>, std::less<>> _channels; // lookups without a temporary std::string
+  std::vector<std::string> _oneWireOrder;
+};
+
+Trace &trace();
+
+} // namespace sim
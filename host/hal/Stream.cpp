@@ -0,0 +1,55 @@
+#include "Arduino.h"
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0) {
+      break;
+    }
+    *buffer++ = char(c);
+    count++;
+  }
+  return count;
+}
+
+String Stream::readString()
+{
+  String ret;
+  int c;
+  while ((c = read()) >= 0) {
+    ret += char(c);
+  }
+  return ret;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  String ret;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) {
+    ret += char(c);
+  }
+  return ret;
+}
+
+bool Stream::findUntil(const char *target, const char *terminator)
+{
+  size_t matched = 0;
+  size_t terminated = 0;
+  int c;
+  while ((c = read()) >= 0) {
+    matched = c == target[matched] ? matched + 1 : c == target[0] ? 1 : 0;
+    if (!target[matched]) {
+      return true;
+    }
+    if (terminator[0]) {
+      terminated = c == terminator[terminated] ? terminated + 1 : c == terminator[0] ? 1 : 0;
+      if (!terminator[terminated]) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
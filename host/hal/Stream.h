@@ -0,0 +1,25 @@
+#pragma once
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() const { return _timeout; }
+
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes(reinterpret_cast<char *>(buffer), length); }
+  virtual String readString();
+  String readStringUntil(char terminator);
+
+  /** Reads until target has been read (true) or the stream ends (false) */
+  bool find(const char *target) { return findUntil(target, ""); }
+  /** As find(), but also stops after terminator (false) */
+  bool findUntil(const char *target, const char *terminator);
+
+protected:
+  unsigned long _timeout = 1000;
+};
@@ -0,0 +1,197 @@
+#include "Arduino.h"
+#include "Updater.h"
+#include "Sim.hpp"
+
+UpdaterClass Update;
+
+// What the simulated board has room for: a D1 mini pro with 16M flash (14M SPIFFS), running a sketch of about 400K
+static const size_t FREE_SKETCH_SPACE = 0x100000 - 0x64000;
+static const size_t SPIFFS_SIZE = 14 * 1024 * 1024;
+
+bool UpdaterClass::begin(size_t size, int command)
+{
+  if (_size > 0) {
+    Serial.println("sim: Update already running");
+    return false;
+  }
+  reset();
+  _error = UPDATE_ERROR_OK;
+  if (size == 0) {
+    _error = UPDATE_ERROR_SIZE;
+    return false;
+  }
+  if (size > (command == U_SPIFFS ? SPIFFS_SIZE : FREE_SKETCH_SPACE)) {
+    _error = UPDATE_ERROR_SPACE;
+    return false;
+  }
+  _command = command;
+  _size = size;
+  md5Begin(_md5State);
+  return true;
+}
+
+bool UpdaterClass::setMD5(const char* expected_md5)
+{
+  if (strlen(expected_md5) != 32) {
+    return false;
+  }
+  for (int i = 0; i < 32; i++) {
+    _expectedMd5[i] = tolower(expected_md5[i]);
+  }
+  _expectedMd5[32] = '\0';
+  return true;
+}
+
+size_t UpdaterClass::write(uint8_t* data, size_t len)
+{
+  if (hasError() || !isRunning()) {
+    return 0;
+  }
+  if (len > remaining()) {
+    _error = UPDATE_ERROR_SPACE;
+    return 0;
+  }
+  // The core checks the header of a sketch image before writing it
+  if (_command == U_FLASH && _progress == 0 && len > 0 && data[0] != 0xE9) {
+    _error = UPDATE_ERROR_MAGIC_BYTE;
+    reset();
+    return 0;
+  }
+  md5Add(_md5State, data, len);
+  _progress += len;
+  return len;
+}
+
+bool UpdaterClass::end(bool evenIfRemaining)
+{
+  if (hasError() || (!isFinished() && !evenIfRemaining)) {
+    reset();
+    return false;
+  }
+  uint8_t digest[16];
+  md5End(_md5State, digest);
+  for (int i = 0; i < 16; i++) {
+    snprintf(_md5 + 2 * i, 3, "%02x", digest[i]);
+  }
+  if (_expectedMd5[0] && strcmp(_md5, _expectedMd5) != 0) {
+    _error = UPDATE_ERROR_MD5;
+    reset();
+    return false;
+  }
+  fprintf(stderr, "sim: Update of %s with %zu bytes (md5 %s) done\n",
+          _command == U_SPIFFS ? "SPIFFS" : "sketch", _progress, _md5);
+  reset();
+  return true;
+}
+
+void UpdaterClass::printError(Print& out)
+{
+  out.printf("ERROR[%u]\n", _error);
+}
+
+String UpdaterClass::md5String()
+{
+  return String(_md5);
+}
+
+void UpdaterClass::reset()
+{
+  _size = 0;
+  _progress = 0;
+  _expectedMd5[0] = '\0';
+}
+
+// MD5 (RFC 1321)
+
+void UpdaterClass::md5Begin(Md5& md5)
+{
+  md5.state[0] = 0x67452301;
+  md5.state[1] = 0xefcdab89;
+  md5.state[2] = 0x98badcfe;
+  md5.state[3] = 0x10325476;
+  md5.length = 0;
+}
+
+void UpdaterClass::md5Add(Md5& md5, const uint8_t* data, size_t len)
+{
+  size_t used = md5.length % 64;
+  md5.length += len;
+  while (len > 0) {
+    size_t n = std::min(len, 64 - used);
+    memcpy(md5.block + used, data, n);
+    used += n;
+    data += n;
+    len -= n;
+    if (used == 64) {
+      md5Transform(md5.state, md5.block);
+      used = 0;
+    }
+  }
+}
+
+void UpdaterClass::md5End(Md5& md5, uint8_t (&digest)[16])
+{
+  uint64_t bits = md5.length * 8;
+  uint8_t padding[72] = {0x80};
+  size_t used = md5.length % 64;
+  size_t padLength = (used < 56 ? 56 : 120) - used;
+  for (int i = 0; i < 8; i++) {
+    padding[padLength + i] = uint8_t(bits >> (8 * i));
+  }
+  md5Add(md5, padding, padLength + 8);
+  for (int i = 0; i < 16; i++) {
+    digest[i] = uint8_t(md5.state[i / 4] >> (8 * (i % 4)));
+  }
+}
+
+void UpdaterClass::md5Transform(uint32_t (&state)[4], const uint8_t* block)
+{
+  static const uint32_t K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+  };
+  static const uint8_t R[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+  };
+  uint32_t m[16];
+  for (int i = 0; i < 16; i++) {
+    m[i] = uint32_t(block[4 * i]) | uint32_t(block[4 * i + 1]) << 8 |
+           uint32_t(block[4 * i + 2]) << 16 | uint32_t(block[4 * i + 3]) << 24;
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  for (int i = 0; i < 64; i++) {
+    uint32_t f;
+    int g;
+    if (i < 16) {
+      f = (b & c) | (~b & d);
+      g = i;
+    } else if (i < 32) {
+      f = (d & b) | (~d & c);
+      g = (5 * i + 1) % 16;
+    } else if (i < 48) {
+      f = b ^ c ^ d;
+      g = (3 * i + 5) % 16;
+    } else {
+      f = c ^ (b | ~d);
+      g = (7 * i) % 16;
+    }
+    uint32_t rotated = a + f + K[i] + m[g];
+    a = d;
+    d = c;
+    c = b;
+    b += (rotated << R[i]) | (rotated >> (32 - R[i]));
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+}
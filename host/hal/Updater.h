@@ -0,0 +1,78 @@
+#pragma once
+
+// Stand-in for the ESP8266 core's Updater: checks and hashes the image, but keeps nothing
+// (the simulation runs the firmware it was built from, and its flash is a directory).
+
+#include "Print.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define U_FLASH   0
+#define U_SPIFFS  100
+
+#define UPDATE_ERROR_OK                 (0)
+#define UPDATE_ERROR_WRITE              (1)
+#define UPDATE_ERROR_ERASE              (2)
+#define UPDATE_ERROR_READ               (3)
+#define UPDATE_ERROR_SPACE              (4)
+#define UPDATE_ERROR_SIZE               (5)
+#define UPDATE_ERROR_STREAM             (6)
+#define UPDATE_ERROR_MD5                (7)
+#define UPDATE_ERROR_FLASH_CONFIG       (8)
+#define UPDATE_ERROR_NEW_FLASH_CONFIG   (9)
+#define UPDATE_ERROR_MAGIC_BYTE         (10)
+#define UPDATE_ERROR_BOOTSTRAP          (11)
+
+class String;
+
+class UpdaterClass
+{
+public:
+  /** Prepares for an image of size bytes, for the sketch (U_FLASH) or the file system (U_SPIFFS) */
+  bool begin(size_t size, int command = U_FLASH);
+
+  /** Expected MD5 of the image (32 hex digits), checked by end() */
+  bool setMD5(const char* expected_md5);
+
+  size_t write(uint8_t* data, size_t len);
+
+  /** @return true if the whole image arrived intact; the new image is used after a restart */
+  bool end(bool evenIfRemaining = false);
+
+  void printError(Print& out);
+  bool hasError() const { return _error != UPDATE_ERROR_OK; }
+  uint8_t getError() const { return _error; }
+  void clearError() { _error = UPDATE_ERROR_OK; }
+
+  String md5String();
+
+  bool isRunning() const { return _size > 0; }
+  bool isFinished() const { return _size > 0 && _progress == _size; }
+  size_t size() const { return _size; }
+  size_t progress() const { return _progress; }
+  size_t remaining() const { return _size - _progress; }
+
+private:
+  struct Md5 {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t block[64];
+  };
+  static void md5Begin(Md5& md5);
+  static void md5Add(Md5& md5, const uint8_t* data, size_t len);
+  static void md5End(Md5& md5, uint8_t (&digest)[16]);
+  static void md5Transform(uint32_t (&state)[4], const uint8_t* block);
+
+  void reset();
+
+  uint8_t _error = UPDATE_ERROR_OK;
+  int _command = U_FLASH;
+  size_t _size = 0;
+  size_t _progress = 0;
+  char _expectedMd5[33] = {};
+  char _md5[33] = {};
+  Md5 _md5State;
+};
+
+extern UpdaterClass Update;
@@ -0,0 +1,496 @@
+#include "Arduino.h"
+
+#include <ctype.h>
+#include <utility>
+
+static void formatUnsigned(char *buf, size_t size, unsigned long value, unsigned char base)
+{
+  if (base == 10) {
+    snprintf(buf, size, "%lu", value);
+  } else if (base == 16) {
+    snprintf(buf, size, "%lx", value);
+  } else if (base == 8) {
+    snprintf(buf, size, "%lo", value);
+  } else {
+    char tmp[8 * sizeof(value) + 1];
+    int pos = sizeof(tmp) - 1;
+    tmp[pos] = '\0';
+    do {
+      unsigned long digit = value % base;
+      tmp[--pos] = digit < 10 ? char('0' + digit) : char('a' + digit - 10);
+      value /= base;
+    } while (value && pos > 0);
+    snprintf(buf, size, "%s", &tmp[pos]);
+  }
+}
+
+static void formatSigned(char *buf, size_t size, long value, unsigned char base)
+{
+  if (base == 10) {
+    snprintf(buf, size, "%ld", value);
+  } else {
+    formatUnsigned(buf, size, (unsigned long)value, base);
+  }
+}
+
+String::String(const char *cstr)
+{
+  init();
+  if (cstr) {
+    copy(cstr, strlen(cstr));
+  }
+}
+
+String::String(const String &value)
+{
+  init();
+  *this = value;
+}
+
+String::String(String &&rval) noexcept
+{
+  init();
+  move(rval);
+}
+
+String::String(const __FlashStringHelper *str) : String(reinterpret_cast<const char *>(str))
+{
+}
+
+String::String(char c)
+{
+  init();
+  char buf[2] = {c, 0};
+  *this = buf;
+}
+
+String::String(unsigned char value, unsigned char base)
+{
+  init();
+  char buf[1 + 8 * sizeof(unsigned char)];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  *this = buf;
+}
+
+String::String(int value, unsigned char base)
+{
+  init();
+  char buf[2 + 8 * sizeof(int)];
+  formatSigned(buf, sizeof(buf), value, base);
+  *this = buf;
+}
+
+String::String(unsigned int value, unsigned char base)
+{
+  init();
+  char buf[1 + 8 * sizeof(unsigned int)];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  *this = buf;
+}
+
+String::String(long value, unsigned char base)
+{
+  init();
+  char buf[2 + 8 * sizeof(long)];
+  formatSigned(buf, sizeof(buf), value, base);
+  *this = buf;
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+  init();
+  char buf[1 + 8 * sizeof(unsigned long)];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  *this = buf;
+}
+
+String::String(float value, unsigned char decimalPlaces) : String(double(value), decimalPlaces)
+{
+}
+
+String::String(double value, unsigned char decimalPlaces)
+{
+  init();
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  *this = buf;
+}
+
+String::~String()
+{
+  invalidate();
+}
+
+void String::init()
+{
+  _sso[0] = '\0';
+  _buf = _sso;
+  _len = 0;
+  _capacity = SSO_CAPACITY;
+}
+
+void String::invalidate()
+{
+  if (!isSSO()) {
+    free(_buf);
+  }
+  init();
+}
+
+unsigned char String::reserve(unsigned int size)
+{
+  if (size <= _capacity) {
+    return 1;
+  }
+  return changeBuffer(size);
+}
+
+unsigned char String::changeBuffer(unsigned int maxStrLen)
+{
+  if (maxStrLen <= SSO_CAPACITY) {
+    return 1;
+  }
+  char *newbuffer = static_cast<char *>(realloc(isSSO() ? nullptr : _buf, maxStrLen + 1));
+  if (!newbuffer) {
+    return 0;
+  }
+  if (isSSO()) {
+    memcpy(newbuffer, _sso, _len + 1);
+  }
+  _buf = newbuffer;
+  _capacity = maxStrLen;
+  return 1;
+}
+
+String &String::copy(const char *cstr, unsigned int length)
+{
+  if (!reserve(length)) {
+    invalidate();
+    return *this;
+  }
+  memmove(_buf, cstr, length);
+  _len = length;
+  _buf[_len] = '\0';
+  return *this;
+}
+
+void String::move(String &rhs) noexcept
+{
+  invalidate();
+  if (rhs.isSSO()) {
+    memcpy(_sso, rhs._sso, sizeof(_sso));
+    _len = rhs._len;
+  } else {
+    _buf = rhs._buf;
+    _len = rhs._len;
+    _capacity = rhs._capacity;
+  }
+  rhs.init();
+}
+
+String &String::operator=(const String &rhs)
+{
+  if (this != &rhs) {
+    copy(rhs._buf, rhs._len);
+  }
+  return *this;
+}
+
+String &String::operator=(String &&rval) noexcept
+{
+  if (this != &rval) {
+    move(rval);
+  }
+  return *this;
+}
+
+String &String::operator=(const char *cstr)
+{
+  if (cstr) {
+    copy(cstr, strlen(cstr));
+  } else {
+    invalidate();
+  }
+  return *this;
+}
+
+String &String::operator=(const __FlashStringHelper *str)
+{
+  return *this = reinterpret_cast<const char *>(str);
+}
+
+unsigned char String::concat(const char *cstr, unsigned int length)
+{
+  if (!cstr) {
+    return 0;
+  }
+  if (length == 0) {
+    return 1;
+  }
+  unsigned int newlen = _len + length;
+  if (newlen > _capacity) {
+    // Same growth strategy as the ESP8266 core: never grow by less than the current size
+    if (!changeBuffer(std::max(newlen, _len + (_len >> 1)))) {
+      return 0;
+    }
+  }
+  memmove(_buf + _len, cstr, length);
+  _len = newlen;
+  _buf[_len] = '\0';
+  return 1;
+}
+
+unsigned char String::concat(const String &s)
+{
+  if (&s == this) {
+    String tmp(s);
+    return concat(tmp._buf, tmp._len);
+  }
+  return concat(s._buf, s._len);
+}
+
+unsigned char String::concat(const char *cstr)
+{
+  return cstr ? concat(cstr, strlen(cstr)) : 0;
+}
+
+unsigned char String::concat(char c)
+{
+  return concat(&c, 1);
+}
+
+unsigned char String::concat(unsigned char num)
+{
+  char buf[4];
+  snprintf(buf, sizeof(buf), "%u", num);
+  return concat(buf);
+}
+
+unsigned char String::concat(int num)
+{
+  char buf[12];
+  snprintf(buf, sizeof(buf), "%d", num);
+  return concat(buf);
+}
+
+unsigned char String::concat(unsigned int num)
+{
+  char buf[11];
+  snprintf(buf, sizeof(buf), "%u", num);
+  return concat(buf);
+}
+
+unsigned char String::concat(long num)
+{
+  char buf[21];
+  snprintf(buf, sizeof(buf), "%ld", num);
+  return concat(buf);
+}
+
+unsigned char String::concat(unsigned long num)
+{
+  char buf[21];
+  snprintf(buf, sizeof(buf), "%lu", num);
+  return concat(buf);
+}
+
+unsigned char String::concat(float num)
+{
+  return concat(double(num));
+}
+
+unsigned char String::concat(double num)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.2f", num);
+  return concat(buf);
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+String operator+(const char *lhs, const String &rhs)
+{
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+String operator+(const String &lhs, char rhs)
+{
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+int String::compareTo(const String &s) const
+{
+  return strcmp(_buf, s._buf);
+}
+
+unsigned char String::equals(const String &s) const
+{
+  return _len == s._len && compareTo(s) == 0;
+}
+
+unsigned char String::equals(const char *cstr) const
+{
+  return strcmp(_buf, cstr ? cstr : "") == 0;
+}
+
+unsigned char String::equalsIgnoreCase(const String &s) const
+{
+  return _len == s._len && strcasecmp(_buf, s._buf) == 0;
+}
+
+unsigned char String::startsWith(const String &prefix) const
+{
+  return prefix._len <= _len && startsWith(prefix, 0);
+}
+
+unsigned char String::startsWith(const String &prefix, unsigned int offset) const
+{
+  if (offset > _len || prefix._len > _len - offset) {
+    return 0;
+  }
+  return strncmp(&_buf[offset], prefix._buf, prefix._len) == 0;
+}
+
+unsigned char String::endsWith(const String &suffix) const
+{
+  if (suffix._len > _len) {
+    return 0;
+  }
+  return strcmp(&_buf[_len - suffix._len], suffix._buf) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+  return operator[](index);
+}
+
+void String::setCharAt(unsigned int index, char c)
+{
+  if (index < _len) {
+    _buf[index] = c;
+  }
+}
+
+char String::operator[](unsigned int index) const
+{
+  return index < _len ? _buf[index] : '\0';
+}
+
+char &String::operator[](unsigned int index)
+{
+  static char dummy_writable_char;
+  if (index >= _len) {
+    dummy_writable_char = 0;
+    return dummy_writable_char;
+  }
+  return _buf[index];
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+  if (fromIndex >= _len) {
+    return -1;
+  }
+  const char *temp = strchr(_buf + fromIndex, ch);
+  return temp ? int(temp - _buf) : -1;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const
+{
+  if (fromIndex >= _len) {
+    return -1;
+  }
+  const char *found = strstr(_buf + fromIndex, str._buf);
+  return found ? int(found - _buf) : -1;
+}
+
+int String::lastIndexOf(char ch) const
+{
+  const char *temp = strrchr(_buf, ch);
+  return temp ? int(temp - _buf) : -1;
+}
+
+String String::substring(unsigned int left, unsigned int right) const
+{
+  if (left > right) {
+    std::swap(left, right);
+  }
+  String out;
+  if (left >= _len) {
+    return out;
+  }
+  if (right > _len) {
+    right = _len;
+  }
+  out.copy(_buf + left, right - left);
+  return out;
+}
+
+void String::replace(char find, char replace)
+{
+  for (char *p = _buf; *p; p++) {
+    if (*p == find) {
+      *p = replace;
+    }
+  }
+}
+
+void String::toLowerCase()
+{
+  for (char *p = _buf; *p; p++) {
+    *p = tolower(*p);
+  }
+}
+
+void String::toUpperCase()
+{
+  for (char *p = _buf; *p; p++) {
+    *p = toupper(*p);
+  }
+}
+
+void String::trim()
+{
+  if (_len == 0) {
+    return;
+  }
+  char *begin = _buf;
+  while (isspace(*begin)) {
+    begin++;
+  }
+  char *end = _buf + _len - 1;
+  while (isspace(*end) && end >= begin) {
+    end--;
+  }
+  _len = end + 1 - begin;
+  if (begin > _buf) {
+    memmove(_buf, begin, _len);
+  }
+  _buf[_len] = '\0';
+}
+
+long String::toInt() const
+{
+  return atol(_buf);
+}
+
+float String::toFloat() const
+{
+  return atof(_buf);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class __FlashStringHelper;
+
+/**
+ * Host version of the Arduino String class.
+ *
+ * Mirrors the ESP8266 core (2.5+) implementation closely enough for the heap behaviour
+ * to be representative: short strings live in an internal buffer, longer ones are
+ * malloc/realloc'ed and grown on demand.
+ */
+class String
+{
+public:
+  String(const char *cstr = "");
+  String(const String &str);
+  String(String &&rval) noexcept;
+  String(const __FlashStringHelper *str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+  ~String();
+
+  unsigned char reserve(unsigned int size);
+  unsigned int length() const { return _len; }
+  const char *c_str() const { return _buf; }
+  char *begin() { return _buf; }
+  char *end() { return _buf + _len; }
+  const char *begin() const { return _buf; }
+  const char *end() const { return _buf + _len; }
+
+  String &operator=(const String &rhs);
+  String &operator=(String &&rval) noexcept;
+  String &operator=(const char *cstr);
+  String &operator=(const __FlashStringHelper *str);
+
+  unsigned char concat(const String &str);
+  unsigned char concat(const char *cstr);
+  unsigned char concat(const char *cstr, unsigned int length);
+  unsigned char concat(char c);
+  unsigned char concat(unsigned char num);
+  unsigned char concat(int num);
+  unsigned char concat(unsigned int num);
+  unsigned char concat(long num);
+  unsigned char concat(unsigned long num);
+  unsigned char concat(float num);
+  unsigned char concat(double num);
+
+  String &operator+=(const String &rhs) { concat(rhs); return *this; }
+  String &operator+=(const char *cstr) { concat(cstr); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+  String &operator+=(unsigned char num) { concat(num); return *this; }
+  String &operator+=(int num) { concat(num); return *this; }
+  String &operator+=(unsigned int num) { concat(num); return *this; }
+  String &operator+=(long num) { concat(num); return *this; }
+  String &operator+=(unsigned long num) { concat(num); return *this; }
+  String &operator+=(float num) { concat(num); return *this; }
+  String &operator+=(double num) { concat(num); return *this; }
+
+  int compareTo(const String &s) const;
+  unsigned char equals(const String &s) const;
+  unsigned char equals(const char *cstr) const;
+  unsigned char equalsIgnoreCase(const String &s) const;
+  unsigned char operator==(const String &rhs) const { return equals(rhs); }
+  unsigned char operator==(const char *cstr) const { return equals(cstr); }
+  unsigned char operator!=(const String &rhs) const { return !equals(rhs); }
+  unsigned char operator!=(const char *cstr) const { return !equals(cstr); }
+  unsigned char operator<(const String &rhs) const { return compareTo(rhs) < 0; }
+
+  unsigned char startsWith(const String &prefix) const;
+  unsigned char startsWith(const String &prefix, unsigned int offset) const;
+  unsigned char endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const;
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const;
+  char &operator[](unsigned int index);
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String &str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, _len); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+
+private:
+  enum { SSO_CAPACITY = 11 };
+
+  void init();
+  void invalidate();
+  bool isSSO() const { return _buf == _sso; }
+  unsigned char changeBuffer(unsigned int maxStrLen);
+  String &copy(const char *cstr, unsigned int length);
+  void move(String &rhs) noexcept;
+
+  char *_buf;
+  unsigned int _len;
+  unsigned int _capacity;
+  char _sso[SSO_CAPACITY + 1];
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
@@ -0,0 +1,196 @@
+#include "WiFiClient.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/sockios.h>
+
+// TCP_SND_BUF of the lwIP build used by the ESP8266 core (2 * TCP_MSS)
+static const int LWIP_SEND_BUFFER = 2 * 1460;
+
+struct WiFiClient::Socket {
+  int fd;
+  explicit Socket(int fd) : fd(fd) {}
+  ~Socket() { close(); }
+  void close()
+  {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+};
+
+WiFiClient::WiFiClient(int fd)
+{
+  // A small kernel send buffer, so that a slow reader pushes back like it would on the board
+  int sendBuffer = LWIP_SEND_BUFFER;
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+  _socket = std::make_shared<Socket>(fd);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+    return 0;
+  }
+  IPAddress ip(reinterpret_cast<struct sockaddr_in *>(result->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(result);
+  return connect(ip, port);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+  stop();
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = uint32_t(ip);
+  // Waits for the connection at most the stream timeout, as the core does
+  int flags = 1;
+  ioctl(fd, FIONBIO, &flags);
+  if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (errno != EINPROGRESS || poll(&pfd, 1, int(_timeout)) != 1 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+      ::close(fd);
+      return 0;
+    }
+  }
+  _socket = std::make_shared<Socket>(fd);
+  return 1;
+}
+
+uint8_t WiFiClient::connected()
+{
+  if (!_socket || _socket->fd < 0) {
+    return 0;
+  }
+  if (available() > 0) {
+    return 1; // like the core: still "connected" while there is unread data
+  }
+  char c;
+  ssize_t n = recv(_socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    _socket->close();
+    return 0;
+  }
+  return 1;
+}
+
+int WiFiClient::available()
+{
+  if (!_socket || _socket->fd < 0) {
+    return 0;
+  }
+  int n = 0;
+  if (ioctl(_socket->fd, FIONREAD, &n) != 0) {
+    return 0;
+  }
+  return n;
+}
+
+int WiFiClient::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+  if (!_socket || _socket->fd < 0) {
+    return -1;
+  }
+  ssize_t n = recv(_socket->fd, buf, size, MSG_DONTWAIT);
+  return n > 0 ? int(n) : (n == 0 ? 0 : -1);
+}
+
+int WiFiClient::peek()
+{
+  if (!_socket || _socket->fd < 0) {
+    return -1;
+  }
+  uint8_t c;
+  return recv(_socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+  if (!_socket || _socket->fd < 0) {
+    return 0;
+  }
+  size_t written = 0;
+  unsigned long start = millis();
+  while (written < size) {
+    ssize_t n = send(_socket->fd, buf + written, size - written, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n > 0) {
+      written += n;
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      _socket->close();
+      break;
+    }
+    if (millis() - start >= _timeout) {
+      break;
+    }
+    struct pollfd p = {_socket->fd, POLLOUT, 0};
+    poll(&p, 1, 10);
+    delay(1); // the core yields to the network stack while waiting
+  }
+  return written;
+}
+
+int WiFiClient::availableForWrite()
+{
+  if (!_socket || _socket->fd < 0) {
+    return 0;
+  }
+  int queued = 0;
+  if (ioctl(_socket->fd, SIOCOUTQ, &queued) != 0) {
+    return 0;
+  }
+  return queued < LWIP_SEND_BUFFER ? LWIP_SEND_BUFFER - queued : 0;
+}
+
+void WiFiClient::stop()
+{
+  if (_socket) {
+    _socket->close();
+    _socket.reset();
+  }
+}
+
+void WiFiClient::setNoDelay(bool nodelay)
+{
+  if (_socket && _socket->fd >= 0) {
+    int one = nodelay ? 1 : 0;
+    setsockopt(_socket->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+}
+
+IPAddress WiFiClient::remoteIP()
+{
+  struct sockaddr_in addr = {};
+  socklen_t len = sizeof(addr);
+  if (!_socket || _socket->fd < 0 || getpeername(_socket->fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0) {
+    return IPAddress();
+  }
+  return IPAddress(addr.sin_addr.s_addr);
+}
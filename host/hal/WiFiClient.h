@@ -0,0 +1,40 @@
+#pragma once
+
+// WiFiClient stand-in on a non-blocking TCP socket.
+// Copies share the connection, as in the ESP8266 core. connect() and write() block (up to the
+// timeout) until everything is handed to the socket, availableForWrite() reports what
+// lwIP would take without blocking.
+
+#include <Arduino.h>
+#include <memory>
+
+class WiFiClient : public Stream
+{
+public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd); ///< sim: takes over an accepted socket
+
+  int connect(const char *host, uint16_t port);
+  int connect(IPAddress ip, uint16_t port);
+  uint8_t connected();
+  operator bool() { return connected(); }
+
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size);
+  int peek() override;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  int availableForWrite() override;
+  void flush() override {}
+
+  void stop();
+  void setNoDelay(bool nodelay);
+  IPAddress remoteIP();
+
+private:
+  struct Socket;
+  std::shared_ptr<Socket> _socket;
+};
@@ -0,0 +1,57 @@
+#include "WiFiServer.h"
+#include "Sim.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void WiFiServer::begin()
+{
+  close();
+  uint16_t port = _port == 80 ? sim::httpPort() : _port;
+  _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(_fd, 8) != 0) {
+    perror("sim: WiFiServer bind/listen");
+    exit(1);
+  }
+}
+
+bool WiFiServer::hasClient()
+{
+  if (_fd < 0) {
+    return false;
+  }
+  struct pollfd p = {_fd, POLLIN, 0};
+  return poll(&p, 1, 0) == 1 && (p.revents & POLLIN);
+}
+
+WiFiClient WiFiServer::available()
+{
+  if (_fd < 0) {
+    return WiFiClient();
+  }
+  int fd = accept4(_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) {
+    return WiFiClient();
+  }
+  WiFiClient client(fd);
+  client.setNoDelay(_noDelay);
+  return client;
+}
+
+void WiFiServer::close()
+{
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+}
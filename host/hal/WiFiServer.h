@@ -0,0 +1,26 @@
+#pragma once
+
+// WiFiServer stand-in listening on 127.0.0.1. Port 80 (the sketch's web server) is
+// replaced by sim::httpPort().
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+class WiFiServer
+{
+public:
+  explicit WiFiServer(uint16_t port) : _port(port), _fd(-1) {}
+  ~WiFiServer() { close(); }
+
+  void begin();
+  bool hasClient();
+  WiFiClient available(); ///< the next pending connection, or a client that is not connected
+  void setNoDelay(bool nodelay) { _noDelay = nodelay; }
+  void close();
+  void stop() { close(); }
+
+private:
+  uint16_t _port;
+  int _fd;
+  bool _noDelay = false;
+};
@@ -0,0 +1,124 @@
+#include "WiFiUdp.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+  stop();
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  int flags = 1;
+  ioctl(fd, FIONBIO, &flags);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return 0;
+  }
+  _fd = fd;
+  return 1;
+}
+
+void WiFiUDP::stop()
+{
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+  _txSize = 0;
+  _rxSize = 0;
+  _rxPos = 0;
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port)
+{
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo *result = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+    return 0;
+  }
+  IPAddress ip(reinterpret_cast<struct sockaddr_in *>(result->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(result);
+  return beginPacket(ip, port);
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+  if (_fd < 0 && !begin(0)) {
+    return 0;
+  }
+  _txIP = ip;
+  _txPort = port;
+  _txSize = 0;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buf, size_t size)
+{
+  size_t n = min(size, sizeof(_tx) - _txSize);
+  memcpy(_tx + _txSize, buf, n);
+  _txSize += n;
+  return n;
+}
+
+int WiFiUDP::endPacket()
+{
+  if (_fd < 0) {
+    return 0;
+  }
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_txPort);
+  addr.sin_addr.s_addr = uint32_t(_txIP);
+  ssize_t n = sendto(_fd, _tx, _txSize, MSG_DONTWAIT, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+  _txSize = 0;
+  return n >= 0 ? 1 : 0;
+}
+
+int WiFiUDP::parsePacket()
+{
+  _rxSize = 0;
+  _rxPos = 0;
+  if (_fd < 0) {
+    return 0;
+  }
+  struct sockaddr_in addr = {};
+  socklen_t len = sizeof(addr);
+  ssize_t n = recvfrom(_fd, _rx, sizeof(_rx), MSG_DONTWAIT, reinterpret_cast<struct sockaddr *>(&addr), &len);
+  if (n <= 0) {
+    return 0;
+  }
+  _rxSize = size_t(n);
+  _remoteIP = IPAddress(addr.sin_addr.s_addr);
+  _remotePort = ntohs(addr.sin_port);
+  return int(n);
+}
+
+int WiFiUDP::read()
+{
+  return _rxPos < _rxSize ? _rx[_rxPos++] : -1;
+}
+
+int WiFiUDP::read(uint8_t *buf, size_t size)
+{
+  size_t n = min(size, _rxSize - _rxPos);
+  memcpy(buf, _rx + _rxPos, n);
+  _rxPos += n;
+  return int(n);
+}
+
+int WiFiUDP::peek()
+{
+  return _rxPos < _rxSize ? _rx[_rxPos] : -1;
+}
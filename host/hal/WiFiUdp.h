@@ -0,0 +1,49 @@
+#pragma once
+
+// WiFiUDP stand-in on a non-blocking UDP socket (IPv4). Received datagrams are read one at a
+// time, as in the core: parsePacket() takes the next one, read() and available() work on it.
+
+#include <Arduino.h>
+
+class WiFiUDP : public Stream
+{
+public:
+  WiFiUDP() {}
+  ~WiFiUDP() { stop(); }
+  WiFiUDP(WiFiUDP const &) = delete;
+  WiFiUDP &operator=(WiFiUDP const &) = delete;
+
+  uint8_t begin(uint16_t port); ///< 0 binds to any free port
+  void stop();
+
+  int beginPacket(const char *host, uint16_t port);
+  int beginPacket(IPAddress ip, uint16_t port);
+  int endPacket();
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+
+  int parsePacket(); ///< size of the next datagram received, 0 if none
+  int available() override { return int(_rxSize - _rxPos); }
+  int read() override;
+  int read(uint8_t *buf, size_t size);
+  int peek() override;
+  void flush() override { _rxPos = _rxSize; }
+
+  IPAddress remoteIP() const { return _remoteIP; }
+  uint16_t remotePort() const { return _remotePort; }
+
+private:
+  enum { MAX_DATAGRAM = 1472 }; // one Ethernet frame
+
+  int _fd = -1;
+  uint8_t _tx[MAX_DATAGRAM];
+  size_t _txSize = 0;
+  IPAddress _txIP;
+  uint16_t _txPort = 0;
+  uint8_t _rx[MAX_DATAGRAM];
+  size_t _rxSize = 0;
+  size_t _rxPos = 0;
+  IPAddress _remoteIP;
+  uint16_t _remotePort = 0;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Arduino.h>
+
+class TwoWire
+{
+public:
+  void begin() {}
+  void begin(int sda, int scl) { (void)sda; (void)scl; }
+};
+
+extern TwoWire Wire;
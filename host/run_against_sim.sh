@@ -0,0 +1,29 @@
+#!/bin/bash
+#
+# Usage: run_against_sim.sh <simulation binary> <command> [args...]
+#
+# Starts the simulation in the background, waits for its web server to come up,
+# runs the command with TARGET_IP pointing at it, and stops the simulation again.
+#
+
+SIM=$1
+shift
+
+SIM_HTTP_PORT=${SIM_HTTP_PORT:-8080}
+LOG=$(mktemp /tmp/esp8266_sim_log.XXXXXX)
+
+SIM_HTTP_PORT=$SIM_HTTP_PORT "$SIM" > "$LOG" 2>&1 &
+SIM_PID=$!
+trap 'kill $SIM_PID 2>/dev/null; wait $SIM_PID 2>/dev/null; rm -f "$LOG"' EXIT
+
+for i in $(seq 50); do
+  if (echo > /dev/tcp/127.0.0.1/$SIM_HTTP_PORT) 2>/dev/null; then
+    break
+  fi
+  if ! kill -0 $SIM_PID 2>/dev/null; then
+    echo "simulation exited:"; cat "$LOG"; exit 1
+  fi
+  sleep 0.1
+done
+
+TARGET_IP=127.0.0.1:$SIM_HTTP_PORT "$@"
@@ -0,0 +1,14 @@
+// Host simulation of the firmware: the sketch compiled against the stand-ins in hal/.
+
+#include "hal/Sim.hpp"
+
+#include "../esp8266_temperature_iot.ino"
+
+int main()
+{
+  sim::begin();
+  setup();
+  while (true) {
+    loop();
+  }
+}
@@ -1,7 +1,8 @@
 #!/bin/bash
 #
-# NOTE: You can only run system tests against a live unit.
+# NOTE: You can only run system tests against a live unit, or the host simulation.
 #       Change the TARGET_IP to reach the temperature plotter.
+#       (make -C host system_tests runs them against the simulation)
 #
 
-TARGET_IP=192.168.0.1 python3 -m unittest discover -s system_tests -p 'test_*.py' -v
+TARGET_IP=${TARGET_IP:-192.168.0.1} python3 -m unittest discover -s system_tests -p 'test_*.py' -v
@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+#
+# Load and latency test: a number of simulated browsers polling the temperature
+# plotter concurrently, the way main.html and settings.html do.
+#
+# Runs against a live unit, or a local stand-in such as the host simulation
+# (make -C host run) or serve_html.sh:
+#
+#   TARGET_IP=192.168.0.1 ./load_test.py --clients 9 --duration 120
+#   ./load_test.py --target 127.0.0.1:8080 --time-scale 100 --duration 30
+#
+# Reports latency percentiles, error and timeout rates per request type, and how
+# well the unit keeps its sample cadence (from "samples_since_boot") under load,
+# along with the sample timer's own jitter and latency from /api/diagnostics.
+#
+# --slow-clients adds clients on a poor link (small receive window, reading at
+# --slow-rate bytes/s) downloading the 24h readings over and over. With a server
+# that handles one connection at a time, they hold up everybody else.
+#
+
+import argparse
+import json
+import os
+import random
+import socket
+import sys
+import threading
+import time
+
+import requests
+
+
+# time_between_1h_readings_ms and time_between_24h_readings_ms in the firmware
+SAMPLE_PERIOD_S = {"1h": 10.0, "24h": 60.0}
+
+STATIC_PAGES = ("/", "/settings.html", "/favicon.ico")
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return float("nan")
+    k = (len(sorted_values) - 1) * p / 100.0
+    lower = int(k)
+    upper = min(lower + 1, len(sorted_values) - 1)
+    return sorted_values[lower] + (sorted_values[upper] - sorted_values[lower]) * (k - lower)
+
+
+class Stats:
+    """Results for one request type, shared by all clients"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = []
+        self.errors = 0
+        self.timeouts = 0
+        self.bytes = 0
+
+    def add(self, latency, num_bytes):
+        with self.lock:
+            self.latencies.append(latency)
+            self.bytes += num_bytes
+
+    def add_error(self):
+        with self.lock:
+            self.errors += 1
+
+    def add_timeout(self):
+        with self.lock:
+            self.timeouts += 1
+
+    def summary(self, duration):
+        lat = sorted(self.latencies)
+        total = len(lat) + self.errors + self.timeouts
+        return {
+            "requests": total,
+            "ok": len(lat),
+            "errors": self.errors,
+            "timeouts": self.timeouts,
+            "error_rate": (self.errors + self.timeouts) / total if total else 0.0,
+            "p50_ms": percentile(lat, 50) * 1000,
+            "p90_ms": percentile(lat, 90) * 1000,
+            "p99_ms": percentile(lat, 99) * 1000,
+            "max_ms": (lat[-1] if lat else float("nan")) * 1000,
+            "kbytes_per_s": self.bytes / 1024.0 / duration,
+        }
+
+
+class Cadence:
+    """(wall time, samples_since_boot) pairs seen in the readings responses of one duration"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.observations = []
+
+    def add(self, t, samples):
+        with self.lock:
+            self.observations.append((t, samples))
+
+    def summary(self, expected_period):
+        obs = sorted(self.observations)
+        if len(obs) < 2 or obs[-1][1] == obs[0][1]:
+            return {"samples": 0, "note": "samples_since_boot did not advance"}
+
+        # Least squares fit of samples against time gives the achieved sample rate
+        n = len(obs)
+        mean_t = sum(t for t, _ in obs) / n
+        mean_s = sum(s for _, s in obs) / n
+        var_t = sum((t - mean_t) ** 2 for t, _ in obs)
+        cov = sum((t - mean_t) * (s - mean_s) for t, s in obs)
+        rate = cov / var_t if var_t > 0 else 0.0
+
+        # Longest wall time during which samples_since_boot did not move, as seen by any client.
+        # Positive drift means the unit samples slower than it should.
+        longest_stall = 0.0
+        last_change_t, last_s = obs[0]
+        for t, s in obs[1:]:
+            if s != last_s:
+                last_change_t, last_s = t, s
+            longest_stall = max(longest_stall, t - last_change_t)
+
+        return {
+            "samples": obs[-1][1] - obs[0][1],
+            "expected_period_s": expected_period,
+            "measured_period_s": 1.0 / rate if rate > 0 else float("inf"),
+            "drift_percent": (1.0 / (rate * expected_period) - 1.0) * 100.0 if rate > 0 else float("inf"),
+            "longest_stall_s": longest_stall,
+        }
+
+
+class Browser(threading.Thread):
+    """One client: loads the pages once, then polls readings (and the sensor list) periodically"""
+
+    def __init__(self, index, args, stats, cadence, stop):
+        super().__init__(daemon=True)
+        self.index = index
+        self.args = args
+        self.stats = stats
+        self.cadence = cadence
+        self.stop = stop
+        self.session = requests.Session()
+        self.base = "http://%s" % args.target
+        # Each simulated browser shows either the 1h or the 24h plot
+        self.readings = "/api/readings/24h" if random.random() < args.fraction_24h else "/api/readings/1h"
+
+    def get(self, kind, path):
+        start = time.monotonic()
+        try:
+            r = self.session.get(self.base + path, timeout=self.args.timeout)
+        except requests.exceptions.Timeout:
+            self.stats[kind].add_timeout()
+            return None
+        except requests.exceptions.RequestException:
+            self.stats[kind].add_error()
+            return None
+        latency = time.monotonic() - start
+        if r.status_code != 200:
+            self.stats[kind].add_error()
+            return None
+        self.stats[kind].add(latency, len(r.content))
+        return r
+
+    def poll_readings(self):
+        duration = "24h" if self.readings.endswith("24h") else "1h"
+        kind = "readings/" + duration
+        r = self.get(kind, self.readings)
+        if r is None:
+            return
+        try:
+            samples = r.json()["samples_since_boot"]
+        except (ValueError, KeyError):
+            self.stats[kind].add_error()
+            return
+        self.cadence[duration].add(time.monotonic(), samples)
+
+    def run(self):
+        # Spread the clients out, as real browsers would not start in lock step
+        if self.stop.wait(random.uniform(0, self.args.readings_interval)):
+            return
+
+        for page in STATIC_PAGES:
+            self.get("static", page)
+        self.get("presentation", "/api/presentation")
+        self.get("sensors", "/api/sensors")
+
+        now = time.monotonic()
+        next_readings = now
+        next_sensors = now + self.args.sensors_interval
+        next_static = now + self.args.static_interval
+        while not self.stop.is_set():
+            now = time.monotonic()
+            if now >= next_readings:
+                self.poll_readings()
+                next_readings += self.args.readings_interval
+            if now >= next_sensors:
+                self.get("sensors", "/api/sensors")
+                next_sensors += self.args.sensors_interval
+            if now >= next_static:
+                self.get("static", random.choice(STATIC_PAGES))
+                next_static += self.args.static_interval
+            due = min(next_readings, next_sensors, next_static)
+            self.stop.wait(max(0.0, due - time.monotonic()))
+        self.session.close()
+
+
+class SlowClient(threading.Thread):
+    """Downloads /api/readings/24h over and over, taking the response in slowly"""
+
+    def __init__(self, args, stats, stop):
+        super().__init__(daemon=True)
+        self.args = args
+        self.stats = stats
+        self.stop = stop
+        host, _, port = args.target.partition(":")
+        self.address = (host, int(port) if port else 80)
+
+    def download(self):
+        start = time.monotonic()
+        received = 0
+        try:
+            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as sock:
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 2048)
+                sock.settimeout(self.args.timeout)
+                sock.connect(self.address)
+                sock.sendall(b"GET /api/readings/24h HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n"
+                             % self.args.target.encode())
+                while not self.stop.is_set():
+                    data = sock.recv(256)
+                    if not data:
+                        break
+                    received += len(data)
+                    time.sleep(len(data) / self.args.slow_rate)
+        except socket.timeout:
+            self.stats.add_timeout()
+            return
+        except OSError:
+            self.stats.add_error()
+            return
+        if not self.stop.is_set():
+            self.stats.add(time.monotonic() - start, received)
+
+    def run(self):
+        while not self.stop.is_set():
+            self.download()
+
+
+def print_report(results):
+    print()
+    print("%-14s %8s %7s %8s %8s %9s %9s %9s %9s %9s" % (
+        "request", "count", "errors", "timeouts", "err %", "p50 ms", "p90 ms", "p99 ms", "max ms", "KiB/s"))
+    for kind, s in results["requests"].items():
+        if s["requests"] == 0:
+            continue
+        print("%-14s %8d %7d %8d %8.2f %9.1f %9.1f %9.1f %9.1f %9.1f" % (
+            kind, s["requests"], s["errors"], s["timeouts"], s["error_rate"] * 100,
+            s["p50_ms"], s["p90_ms"], s["p99_ms"], s["max_ms"], s["kbytes_per_s"]))
+
+    print()
+    for duration, c in results["cadence"].items():
+        if c["samples"] == 0:
+            print("sample cadence %-3s: %s" % (duration, c["note"]))
+        else:
+            print("sample cadence %-3s: %d samples, period %.3f s (expected %.3f s), drift %+.2f %%, longest stall %.2f s" % (
+                duration, c["samples"], c["measured_period_s"], c["expected_period_s"], c["drift_percent"],
+                c["longest_stall_s"]))
+    t = results.get("sample_timer")
+    if t:
+        print("sample timer     : %d ticks, %d dropped, jitter mean %d us / max %d us, capture to store at most %d ms" % (
+            t["ticks"], t["dropped"], t["jitter_us"]["mean"], t["jitter_us"]["max"], t["max_latency_ms"]))
+
+
+def fetch_sample_timer(args):
+    """Timing of the sample timer as measured by the unit (None if it does not report it)"""
+    try:
+        return requests.get("http://%s/api/diagnostics" % args.target, timeout=args.timeout).json().get("sampling")
+    except (requests.RequestException, ValueError):
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--target", default=os.getenv("TARGET_IP"),
+                        help="host[:port] of the unit (default: $TARGET_IP)")
+    parser.add_argument("--clients", type=int, default=9,
+                        help="simulated browsers (default 9: 8 on the soft AP, one on the station network)")
+    parser.add_argument("--duration", type=float, default=60.0, help="seconds to run")
+    parser.add_argument("--time-scale", type=float, default=1.0,
+                        help="virtual seconds per real second of the target (SIM_TIME_SCALE for the simulation)")
+    parser.add_argument("--readings-interval", type=float, default=None,
+                        help="seconds between readings polls per client (default: the 1h sample period, as main.html)")
+    parser.add_argument("--sensors-interval", type=float, default=60.0, help="seconds between /api/sensors polls")
+    parser.add_argument("--static-interval", type=float, default=300.0, help="seconds between static page loads")
+    parser.add_argument("--fraction-24h", type=float, default=0.5, help="share of clients plotting the last 24h")
+    parser.add_argument("--slow-clients", type=int, default=0,
+                        help="additional clients on a poor link, downloading the 24h readings continuously")
+    parser.add_argument("--slow-rate", type=float, default=4096.0, help="bytes/s the slow clients read")
+    parser.add_argument("--timeout", type=float, default=10.0, help="request timeout in seconds")
+    parser.add_argument("--json", metavar="FILE", help="also write the results to FILE as json")
+    args = parser.parse_args()
+
+    if not args.target:
+        parser.error("no target, use --target or set TARGET_IP")
+    expected_period = {d: period / args.time_scale for d, period in SAMPLE_PERIOD_S.items()}
+    if args.readings_interval is None:
+        args.readings_interval = expected_period["1h"]
+
+    kinds = ("readings/1h", "readings/24h", "sensors", "presentation", "static", "slow/24h")
+    stats = {kind: Stats() for kind in kinds}
+    cadence = {duration: Cadence() for duration in SAMPLE_PERIOD_S}
+    stop = threading.Event()
+
+    browsers = [Browser(i, args, stats, cadence, stop) for i in range(args.clients)]
+    browsers += [SlowClient(args, stats["slow/24h"], stop) for _ in range(args.slow_clients)]
+    start = time.monotonic()
+    for b in browsers:
+        b.start()
+    try:
+        stop.wait(args.duration)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    for b in browsers:
+        b.join(args.timeout + 1)
+    duration = time.monotonic() - start
+
+    results = {
+        "target": args.target,
+        "clients": args.clients,
+        "duration_s": duration,
+        "requests": {kind: stats[kind].summary(duration) for kind in kinds},
+        "cadence": {d: cadence[d].summary(expected_period[d]) for d in SAMPLE_PERIOD_S},
+        "sample_timer": fetch_sample_timer(args),
+    }
+    print_report(results)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2)
+
+    failed = sum(s["errors"] + s["timeouts"] for s in results["requests"].values())
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,12 @@
+#!/usr/bin/env python3
+"""Helpers for the tests that have the unit connect back to a server on this machine"""
+
+import socket
+
+
+def local_address_towards(target):
+    """Address of this machine as seen from the unit"""
+    host = target.partition(":")[0]
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.connect((host, 80))
+        return s.getsockname()[0]
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+
+import unittest
+import requests
+import os
+import time
+
+from network import local_address_towards
+from test_mqtt import Broker, TOPIC
+
+ip = os.getenv("TARGET_IP")
+
+
+def get_alerts():
+    r = requests.get("http://%s/api/alerts" % ip)
+    assert r.status_code == 200
+    return r.json()
+
+
+def set_rules(rules):
+    return requests.patch("http://%s/api/alerts" % ip, json={"rules": rules})
+
+
+class Alerts(unittest.TestCase):
+    def setUp(self):
+        self.original = [{k: rule[k] for k in ("sensor", "kind", "limit", "hysteresis", "window_s")}
+                         for rule in get_alerts()["rules"]]
+        sensors = requests.get("http://%s/api/sensors" % ip).json()["sensors"]
+        ntc = [s for s in sensors if s["type"] == "NTC"]
+        if not ntc:
+            self.skipTest("no NTC sensor")
+        self.sensor_id = ntc[0]["id"]  # sampled every second (by default), without a conversion to wait for
+
+    def tearDown(self):
+        set_rules(self.original)
+
+    def wait_for_active(self, expected, timeout=30):
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            j = get_alerts()
+            if [r["active"] for r in j["rules"]] == expected:
+                return j
+            time.sleep(0.05)
+        self.fail("alerts not %s: %s" % (expected, j))
+
+    def test_required_fields_present(self):
+        r = requests.get("http://%s/api/alerts" % ip)
+        self.assertEqual("application/javascript", r.headers['content-type'])
+        j = r.json()
+        self.assertTrue(all([x in j for x in ("rules", "num_active", "max_rules")]))
+        self.assertEqual(sum(rule["active"] for rule in j["rules"]), j["num_active"])
+
+    def test_invalid_rules_rejected(self):
+        rule = {"sensor": self.sensor_id, "kind": "above", "limit": 80}
+        self.assertEqual(200, set_rules([rule]).status_code)
+        for rules in ([dict(rule, kind="sideways")], [dict(rule, sensor="short")], [dict(rule, limit="80")],
+                      [{"sensor": self.sensor_id, "kind": "above"}], [dict(rule, hysteresis=-1)],
+                      [dict(rule, kind="rising", window_s=30)], [dict(rule, kind="rising", limit=-1)],
+                      [dict(rule, kind="stale", limit=0)], [rule] * 9):
+            self.assertEqual(400, set_rules(rules).status_code, rules)
+            # The rules are left as they were
+            self.assertEqual([(self.sensor_id, "above", 80)],
+                             [(r["sensor"], r["kind"], r["limit"]) for r in get_alerts()["rules"]], rules)
+        self.assertEqual(400, requests.patch("http://%s/api/alerts" % ip, json=[rule]).status_code)
+
+    def test_thresholds_and_stale(self):
+        rules = [{"sensor": self.sensor_id, "kind": "above", "limit": -50, "hysteresis": 1},
+                 {"sensor": self.sensor_id, "kind": "below", "limit": 150},
+                 {"sensor": self.sensor_id, "kind": "above", "limit": 150},
+                 {"sensor": self.sensor_id, "kind": "rising", "limit": 1000},
+                 {"sensor": self.sensor_id, "kind": "stale", "limit": 60},
+                 {"sensor": "0123456789abcdef", "kind": "stale", "limit": 2}]
+        self.assertEqual(200, set_rules(rules).status_code)
+        j = self.wait_for_active([1, 1, 0, 0, 0, 1])
+        self.assertEqual(3, j["num_active"])
+        self.assertEqual(1, j["rules"][0]["triggered"])
+        self.assertEqual(600, j["rules"][3]["window_s"])  # the default
+        self.assertIsNone(j["rules"][3]["value"])  # no complete window yet
+        self.assertLess(j["rules"][4]["value"], 60)
+        self.assertGreater(j["rules"][5]["value"], 2)
+
+        # Replacing the rules starts over
+        self.assertEqual(200, set_rules(rules[2:3]).status_code)
+        j = get_alerts()
+        self.assertEqual(0, j["num_active"])
+        self.assertEqual([0], [r["triggered"] for r in j["rules"]])
+
+    def test_published_over_mqtt(self):
+        original = requests.get("http://%s/api/mqtt" % ip).json()
+        broker = Broker()
+        broker.start()
+        try:
+            self.assertEqual(200, set_rules([{"sensor": self.sensor_id, "kind": "above", "limit": -50}]).status_code)
+            r = requests.patch("http://%s/api/mqtt" % ip, json={
+                "enabled": 1, "host": local_address_towards(ip), "port": broker.port, "topic": TOPIC})
+            self.assertEqual(200, r.status_code)
+
+            def published(topic):
+                return [(p, retain) for t, p, retain in broker.published if t == topic]
+            self.assertTrue(broker.wait_for(lambda: any('"active":1' in p for p, _ in published(TOPIC + "/alerts/0"))))
+            self.assertTrue(all(retain for _, retain in published(TOPIC + "/alerts/0")))
+            # The rules not there are cleared
+            self.assertTrue(broker.wait_for(lambda: published(TOPIC + "/alerts/7") == [("", True)]))
+
+            self.assertEqual(200, set_rules([]).status_code)
+            self.assertTrue(broker.wait_for(lambda: published(TOPIC + "/alerts/0")[-1] == ("", True)))
+        finally:
+            requests.patch("http://%s/api/mqtt" % ip, json={
+                k: original[k] for k in ("enabled", "host", "port", "topic")})
+
+
+if __name__ == "__main__":
+    unittest.main()
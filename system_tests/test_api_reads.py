@@ -4,6 +4,8 @@ import unittest
 import requests
 import os
 import json
+import socket
+import time
 
 ip = os.getenv("TARGET_IP")
 
@@ -21,6 +23,7 @@ class Sensors(unittest.TestCase):
         j = r.json()
 
         self.assertTrue("max_num_active" in j)
+        self.assertEqual(0, j["table_full"])
         self.assertTrue("sensors" in j)
         self.assertTrue(len(j["sensors"]) >= 6)
 
@@ -225,5 +228,83 @@ class Network(unittest.TestCase):
         self.assertEqual(str, type(j["static"]["subnet"]))
 
 
+class WifiScan(unittest.TestCase):
+    def test_scan_result(self):
+        # The first request may start the scan and return 202 until it is done
+        deadline = time.monotonic() + 30
+        while True:
+            r = requests.get("http://%s/api/wifi/scan" % ip)
+            self.assertEqual("application/javascript", r.headers['content-type'])
+            j = r.json()
+            self.assertTrue(all([x in j for x in ("state", "networks")]))
+            if r.status_code == 200:
+                break
+            self.assertEqual(202, r.status_code)
+            self.assertEqual("scanning", j["state"])
+            self.assertEqual([], j["networks"])
+            self.assertTrue(time.monotonic() < deadline)
+            time.sleep(0.5)
+
+        self.assertTrue(j["state"] in ("scanning", "done"))
+        self.assertEqual(int, type(j["age_s"]))
+
+        ssids = set()
+        for n in j["networks"]:
+            required_fields = ("ssid", "rssi", "channel", "encryption")
+            self.assertTrue(all([x in n for x in required_fields]))
+            self.assertEqual(str, type(n["ssid"]))
+            self.assertTrue(len(n["ssid"]) >= 1)
+            self.assertFalse(n["ssid"] in ssids)
+            ssids.add(n["ssid"])
+            self.assertEqual(int, type(n["rssi"]))
+            self.assertTrue(n["rssi"] <= 0)
+            self.assertTrue(1 <= n["channel"] <= 14)
+            self.assertTrue(n["encryption"] in ("open", "wep", "wpa", "wpa2", "wpa/wpa2", "unknown"))
+
+        # strongest first
+        rssis = [n["rssi"] for n in j["networks"]]
+        self.assertEqual(sorted(rssis, reverse=True), rssis)
+
+    def test_rescans_are_rate_limited(self):
+        def wait_for_state(state, query):
+            deadline = time.monotonic() + 30
+            while True:
+                j = requests.get("http://%s/api/wifi/scan%s" % (ip, query)).json()
+                if j["state"] == state:
+                    return j
+                self.assertTrue(time.monotonic() < deadline, "no %s state" % state)
+                time.sleep(0.01)
+
+        # A scan started now (rescans are taken again once the last one is old enough), and finished
+        wait_for_state("scanning", "?rescan=1")
+        done = wait_for_state("done", "")
+
+        # Asking again right away serves that result instead of scanning
+        r = requests.get("http://%s/api/wifi/scan?rescan=1" % ip)
+        self.assertEqual(200, r.status_code)
+        j = r.json()
+        self.assertEqual("done", j["state"])
+        self.assertEqual(done["networks"], j["networks"])
+        self.assertTrue(done["age_s"] <= j["age_s"] <= done["age_s"] + 1, (done["age_s"], j["age_s"]))
+        self.assertEqual("done", requests.get("http://%s/api/wifi/scan" % ip).json()["state"])
+
+
+class Server(unittest.TestCase):
+    def test_body_arriving_after_headers(self):
+        # The request is only parsed once its body is in, however it arrives
+        host, _, port = ip.partition(":")
+        with socket.create_connection((host, int(port or 80)), timeout=10) as s:
+            s.sendall(b"PATCH /api/presentation HTTP/1.1\r\nHost: x\r\nContent-Length: 2\r\nConnection: close\r\n\r\n")
+            time.sleep(0.01)  # long enough for the unit to see the headers alone, within its request timeout
+            s.sendall(b"{}")
+            response = b""
+            while True:
+                data = s.recv(4096)
+                if not data:
+                    break
+                response += data
+        self.assertTrue(response.startswith(b"HTTP/1.1 200"), response)
+
+
 if __name__ == "__main__":
     unittest.main()
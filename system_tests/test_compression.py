@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+import unittest
+import http.client
+import gzip
+import json
+import os
+
+ip = os.getenv("TARGET_IP")
+
+
+def host_and_port():
+    host, _, port = ip.partition(":")
+    return host, int(port or 80)
+
+
+def get(path, accept_encoding=None):
+    """The response as sent: (status, headers, body), not decoded"""
+    conn = http.client.HTTPConnection(*host_and_port(), timeout=10)
+    headers = {"Accept-Encoding": accept_encoding} if accept_encoding else {}
+    conn.request("GET", path, headers=headers)
+    r = conn.getresponse()
+    body = r.read()
+    result = (r.status, {k.lower(): v for k, v in r.getheaders()}, body)
+    conn.close()
+    return result
+
+
+class Compression(unittest.TestCase):
+    def assert_readings(self, body):
+        j = json.loads(body)
+        self.assertTrue("sensors" in j)
+        self.assertTrue("samples_since_boot" in j)
+
+    def test_readings_gzip_when_accepted(self):
+        for path in ("/api/readings/1h", "/api/readings/24h"):
+            status, headers, body = get(path, "gzip, deflate")
+            self.assertEqual(200, status)
+            self.assertEqual("gzip", headers.get("content-encoding"))
+            self.assertEqual("Accept-Encoding", headers.get("vary"))
+            plain = gzip.decompress(body)
+            self.assert_readings(plain)
+            self.assertLess(len(body), len(plain) / 3)
+
+    def test_readings_plain_otherwise(self):
+        for accept_encoding in (None, "identity", "deflate", "gzip;q=0"):
+            status, headers, body = get("/api/readings/1h", accept_encoding)
+            self.assertEqual(200, status)
+            self.assertFalse("content-encoding" in headers)
+            self.assert_readings(body)
+
+    def test_sensor_list_gzip_when_accepted(self):
+        status, headers, body = get("/api/sensors", "gzip")
+        self.assertEqual(200, status)
+        self.assertEqual("gzip", headers.get("content-encoding"))
+        self.assertTrue(len(json.loads(gzip.decompress(body))["sensors"]) >= 6)
+
+    def test_more_downloads_than_encoders(self):
+        # The ones without an encoder go out uncompressed, all of them complete
+        host, port = host_and_port()
+        conns = [http.client.HTTPConnection(host, port, timeout=10) for _ in range(4)]
+        for conn in conns:
+            conn.request("GET", "/api/readings/24h", headers={"Accept-Encoding": "gzip"})
+        for conn in conns:
+            r = conn.getresponse()
+            self.assertEqual(200, r.status)
+            body = r.read()
+            if r.getheader("Content-Encoding") == "gzip":
+                body = gzip.decompress(body)
+            self.assert_readings(body)
+            conn.close()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+import unittest
+import requests
+import os
+import threading
+import time
+
+ip = os.getenv("TARGET_IP")
+
+# Requests that must not allocate from the heap once the unit is warmed up
+STEADY_STATE_REQUESTS = {
+    "sensors": "/api/sensors",
+    "readings_1h": "/api/readings/1h",
+    "readings_24h": "/api/readings/24h",
+    "not_found": "/api/no/such/thing",
+}
+
+
+class Diagnostics(unittest.TestCase):
+    def get_diagnostics(self):
+        r = requests.get("http://%s/api/diagnostics" % ip)
+        self.assertEqual(200, r.status_code)
+        self.assertEqual("application/javascript", r.headers['content-type'])
+        return r.json()
+
+    def test_required_fields_present(self):
+        j = self.get_diagnostics()
+
+        self.assertTrue(all([x in j for x in ("free_heap", "allocation_counting", "requests")]))
+        required_fields = ("count", "allocations", "last_allocations", "bytes_allocated", "last_heap_change", "min_free_heap")
+        for name in list(STEADY_STATE_REQUESTS) + ["sensor", "sample_tick"]:
+            self.assertTrue(name in j["requests"])
+            self.assertTrue(all([x in j["requests"][name] for x in required_fields]))
+
+    def test_no_allocations_in_steady_state(self):
+        if not self.get_diagnostics()["allocation_counting"]:
+            self.skipTest("target does not count heap allocations (only the host simulation does)")
+
+        r = requests.get("http://%s/api/sensors" % ip)
+        sensor_url = "/api/sensors/%s" % r.json()["sensors"][0]["id"]
+        urls = dict(STEADY_STATE_REQUESTS, sensor=sensor_url)
+
+        # Warm up: buffers grow to their final size the first time round
+        for _ in range(2):
+            for url in urls.values():
+                requests.get("http://%s%s" % (ip, url))
+        before = self.get_diagnostics()["requests"]
+
+        for _ in range(5):
+            for url in urls.values():
+                requests.get("http://%s%s" % (ip, url))
+        # Give the sampling a chance to run a few times as well (runs every 10 s, in virtual time)
+        deadline = time.time() + 30
+        while time.time() < deadline:
+            after = self.get_diagnostics()["requests"]
+            if after["sample_tick"]["count"] >= before["sample_tick"]["count"] + 2:
+                break
+            time.sleep(0.1)
+
+        for name in list(urls) + ["sample_tick"]:
+            self.assertGreater(after[name]["count"], before[name]["count"], name)
+            self.assertEqual(before[name]["allocations"], after[name]["allocations"],
+                             "%s allocated from the heap in steady state" % name)
+
+    def test_sampling_on_time_under_load(self):
+        j = self.get_diagnostics()["sampling"]
+        required_fields = ("period_ms", "ticks", "dropped", "queued", "max_queued", "max_latency_ms", "jitter_us")
+        self.assertTrue(all([x in j for x in required_fields]))
+        self.assertTrue(all([x in j["jitter_us"] for x in ("last", "mean", "max")]))
+
+        # Keep the web server busy with large responses while a few samples are taken
+        stop = threading.Event()
+        def load():
+            while not stop.is_set():
+                requests.get("http://%s/api/readings/24h" % ip)
+        workers = [threading.Thread(target=load) for _ in range(2)]
+        for w in workers:
+            w.start()
+        try:
+            deadline = time.time() + 30
+            while time.time() < deadline:
+                after = self.get_diagnostics()["sampling"]
+                if after["ticks"] >= j["ticks"] + 3:
+                    break
+                time.sleep(0.1)
+        finally:
+            stop.set()
+            for w in workers:
+                w.join()
+
+        self.assertGreaterEqual(after["ticks"], j["ticks"] + 3)
+        self.assertEqual(0, after["dropped"])
+        # Taken by the timer interrupt: web load may delay storing a sample, not taking it
+        self.assertLess(after["jitter_us"]["max"], 1000)
+        self.assertLess(after["max_latency_ms"], after["period_ms"] * after["max_queued"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+
+import unittest
+import requests
+import os
+import socket
+import struct
+import threading
+import time
+
+from network import local_address_towards
+
+ip = os.getenv("TARGET_IP")
+
+TOPIC = "systemtest/unit"
+
+
+class Broker(threading.Thread):
+    """Just enough of an MQTT broker to accept one client and record what it publishes"""
+
+    def __init__(self):
+        super().__init__(daemon=True)
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("0.0.0.0", 0))
+        self.listener.listen(1)
+        self.port = self.listener.getsockname()[1]
+        self.lock = threading.Lock()
+        self.connect = None      # (client id, will topic, will message, will retain)
+        self.published = []      # (topic, payload, retain)
+        self.disconnected = False
+
+    def run(self):
+        conn, _ = self.listener.accept()
+        with conn:
+            f = conn.makefile("rb")
+            while True:
+                header = f.read(1)
+                if not header:
+                    break
+                length, shift = 0, 0
+                while True:
+                    b = f.read(1)[0]
+                    length |= (b & 0x7f) << shift
+                    shift += 7
+                    if not b & 0x80:
+                        break
+                body = f.read(length)
+                kind = header[0] >> 4
+                if kind == 1:  # CONNECT
+                    self.on_connect(body)
+                    conn.sendall(b"\x20\x02\x00\x00")
+                elif kind == 3:  # PUBLISH, QoS 0
+                    (topic_length,) = struct.unpack(">H", body[:2])
+                    with self.lock:
+                        self.published.append((body[2:2 + topic_length].decode(),
+                                               body[2 + topic_length:].decode(), bool(header[0] & 1)))
+                elif kind == 12:  # PINGREQ
+                    conn.sendall(b"\xd0\x00")
+                elif kind == 14:  # DISCONNECT
+                    break
+        with self.lock:
+            self.disconnected = True
+        self.listener.close()
+
+    def on_connect(self, body):
+        def string(pos):
+            (n,) = struct.unpack(">H", body[pos:pos + 2])
+            return body[pos + 2:pos + 2 + n].decode(), pos + 2 + n
+
+        protocol, pos = string(0)
+        assert protocol == "MQTT" and body[pos] == 4
+        flags = body[pos + 1]
+        client_id, pos = string(pos + 4)
+        will_topic, will_message = None, None
+        if flags & 0x04:
+            will_topic, pos = string(pos)
+            will_message, pos = string(pos)
+        with self.lock:
+            self.connect = (client_id, will_topic, will_message, bool(flags & 0x20))
+
+    def wait_for(self, condition, timeout=30):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            with self.lock:
+                if condition():
+                    return True
+            time.sleep(0.05)
+        return False
+
+
+class Mqtt(unittest.TestCase):
+    def test_required_fields_present(self):
+        r = requests.get("http://%s/api/mqtt" % ip)
+        self.assertEqual(200, r.status_code)
+        self.assertEqual("application/javascript", r.headers['content-type'])
+
+        j = r.json()
+        required_fields = ("enabled", "host", "port", "topic", "username", "password")
+        self.assertTrue(all([x in j for x in required_fields]))
+        self.assertEqual("********", j["password"])
+
+    def test_invalid_settings_rejected(self):
+        for patch in ({"port": 0}, {"port": 70000}, {"topic": "a/#"}, {"topic": "a/"},
+                      {"host": ""}, {"unknown": 1}, {"enabled": "yes"}):
+            r = requests.patch("http://%s/api/mqtt" % ip, json=patch)
+            self.assertEqual(400, r.status_code, patch)
+
+    def test_publishes_state_and_samples(self):
+        original = requests.get("http://%s/api/mqtt" % ip).json()
+        sensors = requests.get("http://%s/api/sensors" % ip).json()["sensors"]
+        ids = [s["id"] for s in sensors]
+        active_ids = [s["id"] for s in sensors if s["active"]]
+
+        broker = Broker()
+        broker.start()
+        try:
+            r = requests.patch("http://%s/api/mqtt" % ip, json={
+                "enabled": 1, "host": local_address_towards(ip), "port": broker.port, "topic": TOPIC})
+            self.assertEqual(200, r.status_code)
+
+            self.assertTrue(broker.wait_for(lambda: broker.connect is not None))
+            client_id, will_topic, will_message, will_retain = broker.connect
+            self.assertTrue(client_id.startswith("tempviewer-"))
+            self.assertEqual((TOPIC + "/status", "offline", True), (will_topic, will_message, will_retain))
+
+            # Retained state of each sensor, then the samples of the active ones
+            def all_published(suffix, of):
+                topics = set(t for t, _, _ in broker.published)
+                return all(("%s/sensors/%s/%s" % (TOPIC, i, suffix)) in topics for i in of)
+            self.assertTrue(broker.wait_for(lambda: all_published("state", ids) and all_published("temperature", active_ids)))
+
+            with broker.lock:
+                published = list(broker.published)
+            self.assertTrue((TOPIC + "/status", "online", True) in published)
+            for topic, payload, retain in published:
+                if topic.endswith("/state"):
+                    self.assertTrue(retain)
+                    self.assertTrue(all(x in payload for x in ("name", "type", "active")))
+                elif topic.endswith("/temperature"):
+                    self.assertFalse(retain)
+                    self.assertTrue(topic.split("/")[-2] in active_ids, topic)
+                    float(payload)
+
+            j = requests.get("http://%s/api/diagnostics" % ip).json()
+            self.assertEqual("connected", j["mqtt"]["state"])
+            self.assertTrue(j["mqtt"]["published"] >= len(ids))
+
+            # Disabling disconnects cleanly
+            r = requests.patch("http://%s/api/mqtt" % ip, json={"enabled": 0})
+            self.assertEqual(200, r.status_code)
+            self.assertTrue(broker.wait_for(lambda: broker.disconnected))
+        finally:
+            requests.patch("http://%s/api/mqtt" % ip, json={
+                k: original[k] for k in ("enabled", "host", "port", "topic")})
+
+    def test_publishes_each_sample(self):
+        original = requests.get("http://%s/api/mqtt" % ip).json()
+        sensors = requests.get("http://%s/api/sensors" % ip).json()["sensors"]
+        active = [s for s in sensors if s["active"]]
+        if not active:
+            self.skipTest("no active sensor")
+        fast = active[0]
+        broker = Broker()
+        broker.start()
+        try:
+            r = requests.patch("http://%s/api/sensors/%s" % (ip, fast["id"]), json={"period_ms": 1000})
+            self.assertEqual(200, r.status_code)
+            r = requests.patch("http://%s/api/mqtt" % ip, json={
+                "enabled": 1, "host": local_address_towards(ip), "port": broker.port, "topic": TOPIC})
+            self.assertEqual(200, r.status_code)
+
+            # A sample a second, not one with each 1h reading (every 10 s)
+            def published(sensor_id):
+                topic = "%s/sensors/%s/temperature" % (TOPIC, sensor_id)
+                return sum(1 for t, _, _ in broker.published if t == topic)
+            self.assertTrue(broker.wait_for(lambda: published(fast["id"]) >= 25))
+            with broker.lock:
+                slowest = max([published(s["id"]) for s in active[1:]], default=0)
+            self.assertLessEqual(slowest, 5)
+        finally:
+            requests.patch("http://%s/api/sensors/%s" % (ip, fast["id"]), json={"period_ms": fast["period_ms"]})
+            requests.patch("http://%s/api/mqtt" % ip, json={
+                k: original[k] for k in ("enabled", "host", "port", "topic")})
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+
+import unittest
+import requests
+import os
+import time
+
+ip = os.getenv("TARGET_IP")
+
+
+def get_sensor(sensor_id):
+    r = requests.get("http://%s/api/sensors/%s" % (ip, sensor_id))
+    assert r.status_code == 200
+    return r.json()
+
+
+def patch_sensor(sensor_id, data):
+    return requests.patch("http://%s/api/sensors/%s" % (ip, sensor_id), json=data)
+
+
+def samples_since_boot():
+    return requests.get("http://%s/api/readings/1h" % ip).json()["samples_since_boot"]
+
+
+class SensorSettings(unittest.TestCase):
+    def setUp(self):
+        self.sensors = requests.get("http://%s/api/sensors" % ip).json()["sensors"]
+
+    def first_of_type(self, sensor_type):
+        for s in self.sensors:
+            if s["type"] == sensor_type:
+                return s
+        self.skipTest("no %s sensor" % sensor_type)
+
+    def test_period_and_resolution_present(self):
+        for s in self.sensors:
+            self.assertEqual(int, type(s["period_ms"]))
+            self.assertTrue(1000 <= s["period_ms"] <= 3600000)
+            self.assertEqual(int, type(s["resolution"]))
+            self.assertIn(s["present"], (0, 1))
+            if s["type"] == "NTC":
+                self.assertEqual(12, s["resolution"])
+                self.assertEqual(1, s["present"])
+            else:
+                self.assertTrue(9 <= s["resolution"] <= 12)
+
+    def test_invalid_settings_rejected(self):
+        ntc = self.first_of_type("NTC")
+        onewire = self.first_of_type("OneWire")
+        for sensor, patch in ((onewire, {"period_ms": 0}), (onewire, {"period_ms": 1500}),
+                              (onewire, {"period_ms": 3601000}), (onewire, {"period_ms": "10000"}),
+                              (onewire, {"resolution": 8}), (onewire, {"resolution": 13}),
+                              (ntc, {"resolution": 10}),
+                              (onewire, {"name": "changed", "period_ms": 1500})):
+            r = patch_sensor(sensor["id"], patch)
+            self.assertEqual(400, r.status_code, patch)
+            # Nothing of a rejected patch is applied
+            after = get_sensor(sensor["id"])
+            for key in ("name", "period_ms", "resolution"):
+                self.assertEqual(sensor[key], after[key], patch)
+
+    def test_onewire_resolution(self):
+        onewire = self.first_of_type("OneWire")
+        try:
+            r = patch_sensor(onewire["id"], {"resolution": 9})
+            self.assertEqual(200, r.status_code)
+            self.assertEqual(9, get_sensor(onewire["id"])["resolution"])
+
+            # 9 bits are steps of 0.5 degrees, once the next sample is in
+            deadline = time.time() + 30
+            while time.time() < deadline:
+                value = get_sensor(onewire["id"])["lastValue"]
+                if value * 2 == round(value * 2):
+                    break
+                time.sleep(0.05)
+            self.assertEqual(value * 2, round(value * 2))
+        finally:
+            patch_sensor(onewire["id"], {"resolution": onewire["resolution"]})
+
+    def test_sampling_goes_on_with_different_periods(self):
+        changed = [s for s in self.sensors if s["active"]] or self.sensors[:2]
+        try:
+            for s, period in zip(changed, (1000, 30000, 7000)):
+                r = patch_sensor(s["id"], {"period_ms": period})
+                self.assertEqual(200, r.status_code)
+                self.assertEqual(period, get_sensor(s["id"])["period_ms"])
+
+            # The 1h readings are made every 10 s regardless
+            before = samples_since_boot()
+            deadline = time.time() + 30
+            while time.time() < deadline and samples_since_boot() < before + 3:
+                time.sleep(0.05)
+            self.assertGreaterEqual(samples_since_boot(), before + 3)
+            self.assertEqual(0, requests.get("http://%s/api/diagnostics" % ip).json()["sampling"]["dropped"])
+        finally:
+            for s in changed:
+                patch_sensor(s["id"], {"period_ms": s["period_ms"]})
+
+    def test_batch_patch(self):
+        changed = self.sensors[:3]
+        patch = {"sensors": [{"id": s["id"].upper(), "name": "batch%d" % n, "active": 1 - s["active"]}
+                             for n, s in enumerate(changed)]}
+        try:
+            r = requests.patch("http://%s/api/sensors" % ip, json=patch)
+            self.assertEqual(200, r.status_code)
+            for n, s in enumerate(changed):
+                after = get_sensor(s["id"])
+                self.assertEqual("batch%d" % n, after["name"])
+                self.assertEqual(1 - s["active"], after["active"])
+            served = [s["id"] for s in requests.get("http://%s/api/readings/1h" % ip).json()["sensors"]]
+            expected = [s["id"] for s in requests.get("http://%s/api/sensors" % ip).json()["sensors"] if s["active"]]
+            self.assertEqual(expected, served)
+        finally:
+            requests.patch("http://%s/api/sensors" % ip, json={"sensors": [
+                {"id": s["id"], "name": s["name"], "active": s["active"]} for s in changed]})
+        for s in changed:
+            self.assertEqual(s["name"], get_sensor(s["id"])["name"])
+
+    def test_batch_patch_is_all_or_nothing(self):
+        first = self.sensors[0]
+        for patch in ({"sensors": [{"id": first["id"], "name": "changed"}, {"id": "0123456789abcdef", "name": "x"}]},
+                      {"sensors": [{"id": first["id"], "name": "changed"}, {"id": first["id"], "period_ms": 1500}]},
+                      {"sensors": [{"name": "changed"}]},
+                      {"sensors": {"id": first["id"], "name": "changed"}},
+                      {"sensors": [{"id": first["id"], "name": "changed"}, 5]},
+                      [{"id": first["id"], "name": "changed"}]):
+            r = requests.patch("http://%s/api/sensors" % ip, json=patch)
+            self.assertEqual(400, r.status_code, patch)
+            self.assertEqual(first["name"], get_sensor(first["id"])["name"], patch)
+
+    def test_unknown_sensor(self):
+        for sensor_id in ("0123456789abcdef", "short", self.sensors[0]["id"] + "0"):
+            r = requests.get("http://%s/api/sensors/%s" % (ip, sensor_id))
+            self.assertEqual(404, r.status_code, sensor_id)
+            self.assertEqual(404, patch_sensor(sensor_id, {"name": "x"}).status_code, sensor_id)
+
+    def check_stats(self, sensor_id):
+        """Compares the rolling statistics of a served sensor with ones worked out from its 1h readings"""
+        for attempt in range(10):
+            before = samples_since_boot()
+            stats = get_sensor(sensor_id)["stats"]
+            j = requests.get("http://%s/api/readings/1h" % ip).json()
+            if j["samples_since_boot"] == before:
+                break
+        self.assertIsNotNone(stats)
+        readings = [s for s in j["sensors"] if s["id"] == sensor_id][0]["readings"][-stats["count"]:]
+        n = len(readings)
+        mean = sum(readings) / n
+        self.assertAlmostEqual(min(readings), stats["min"], places=2)
+        self.assertAlmostEqual(max(readings), stats["max"], places=2)
+        self.assertAlmostEqual(mean, stats["mean"], delta=0.006)
+        self.assertAlmostEqual((sum((x - mean) ** 2 for x in readings) / n) ** 0.5, stats["stddev"], delta=0.006)
+        slope = 0 if n < 2 else (sum(k * x for k, x in enumerate(readings)) - (n - 1) / 2 * sum(readings)) / (n * (n * n - 1) / 12)
+        self.assertAlmostEqual(slope * 360, stats["rate_per_h"], delta=0.006)
+        return stats
+
+    def test_rolling_stats(self):
+        for s in self.sensors:
+            self.assertEqual(3600, s["stats_window_s"])
+            if not s["active"]:
+                self.assertIsNone(s["stats"])
+        served = [s for s in self.sensors if s["active"]]
+        if not served:
+            self.skipTest("no active sensor")
+        deadline = time.time() + 30
+        while time.time() < deadline and samples_since_boot() < 3:
+            time.sleep(0.05)
+        sensor_id = served[0]["id"]
+        try:
+            self.assertLessEqual(3, self.check_stats(sensor_id)["count"])
+            for bad in (0, 5, 15, 3610, "60"):
+                self.assertEqual(400, patch_sensor(sensor_id, {"stats_window_s": bad}).status_code, bad)
+            self.assertEqual(200, patch_sensor(sensor_id, {"stats_window_s": 30}).status_code)
+            self.assertEqual(30, get_sensor(sensor_id)["stats_window_s"])
+            before = samples_since_boot()
+            while time.time() < deadline and samples_since_boot() < before + 4:
+                time.sleep(0.05)
+            self.assertEqual(3, self.check_stats(sensor_id)["count"])
+        finally:
+            patch_sensor(sensor_id, {"stats_window_s": 3600})
+
+    def test_compressed_24h_readings(self):
+        served = [s for s in self.sensors if s["active"]]
+        if not served:
+            self.skipTest("no active sensor")
+        sensor_id = served[0]["id"]
+        self.assertEqual(0, served[0]["compression_24h"])
+        self.assertEqual(1440, served[0]["retained_24h"])
+
+        def readings(duration):
+            j = requests.get("http://%s/api/readings/%s" % (ip, duration)).json()
+            return j["samples_since_boot"], [s for s in j["sensors"] if s["id"] == sensor_id][0]["readings"]
+
+        try:
+            for bad in (-0.01, 10.5, "1"):
+                self.assertEqual(400, patch_sensor(sensor_id, {"compression_24h": bad}).status_code, bad)
+            self.assertEqual(200, patch_sensor(sensor_id, {"compression_24h": 0.25}).status_code)
+            self.assertEqual(0.25, get_sensor(sensor_id)["compression_24h"])
+            count_before, _ = readings("24h")
+            deadline = time.time() + 30
+            while time.time() < deadline and readings("24h")[0] < count_before + 5:
+                time.sleep(0.05)
+
+            # Served as before, each 24h reading within 0.25 degrees of the average of the 1h readings it is made of
+            for attempt in range(10):
+                count_1h, readings_1h = readings("1h")
+                count_24h, readings_24h = readings("24h")
+                if readings("1h")[0] == count_1h:
+                    break
+            self.assertEqual(1440, len(readings_24h))
+            self.assertGreaterEqual(get_sensor(sensor_id)["retained_24h"], 1440)
+            last_slot = (count_1h - 1) // 6 * 6  # the 1h reading the last 24h one was made with
+            for k in range(4):
+                end = len(readings_1h) - (count_1h - last_slot) + 1 - 6 * k
+                averaged = [round(x * 100) for x in readings_1h[end - 6:end]]
+                self.assertAlmostEqual(sum(averaged) // 6 / 100, readings_24h[-1 - k], delta=0.2601)
+        finally:
+            patch_sensor(sensor_id, {"compression_24h": 0})
+        self.assertEqual(1440, get_sensor(sensor_id)["retained_24h"])
+
+    def test_toggling_one_sensor_keeps_the_others(self):
+        active = [s for s in self.sensors if s["active"]]
+        inactive = [s for s in self.sensors if not s["active"]]
+        if not active or not inactive:
+            self.skipTest("needs an active and an inactive sensor")
+        toggled = inactive[0]
+
+        def readings():
+            j = requests.get("http://%s/api/readings/1h" % ip).json()
+            return j["samples_since_boot"], {s["id"]: s["readings"] for s in j["sensors"]}
+
+        # Let the series fill in a bit
+        deadline = time.time() + 30
+        while time.time() < deadline and samples_since_boot() < 5:
+            time.sleep(0.05)
+        try:
+            for value in (1, 0):
+                count_before, before = readings()
+                self.assertEqual(200, patch_sensor(toggled["id"], {"active": value}).status_code)
+                count_after, after = readings()
+                self.assertGreaterEqual(count_after, count_before)
+                self.assertEqual(value == 1, toggled["id"] in after)
+                shift = count_after - count_before
+                for s in active:
+                    if s["id"] in before:
+                        self.assertEqual(before[s["id"]][shift:], after[s["id"]][:len(after[s["id"]]) - shift])
+        finally:
+            patch_sensor(toggled["id"], {"active": toggled["active"]})
+
+    def test_probe_plugged_in_and_out(self):
+        # The default trace of the simulation has a spare probe attached from 5 to 10 minutes after boot
+        spare = "28ff010203040562"
+        ids = [s["id"] for s in self.sensors]
+        if spare not in ids and samples_since_boot() > 60:
+            self.skipTest("no spare probe plugged in on this target")
+        series_before = requests.get("http://%s/api/readings/1h" % ip).json()["sensors"]
+
+        def wait_for(present):
+            deadline = time.time() + 30
+            while time.time() < deadline:
+                sensors = requests.get("http://%s/api/sensors" % ip).json()["sensors"]
+                found = [s for s in sensors if s["id"] == spare]
+                if found and found[0]["present"] == present:
+                    return found[0], sensors
+                time.sleep(0.05)
+            self.fail("spare probe not %s" % ("present" if present else "gone"))
+
+        if samples_since_boot() <= 60:
+            probe, sensors = wait_for(1)
+            self.assertEqual("OneWire", probe["type"])
+            self.assertEqual(0, probe["active"])
+        probe, sensors = wait_for(0)
+        self.assertTrue(21.5 <= probe["lastValue"] <= 21.75)  # the last sample before it was pulled out
+        self.assertEqual(1, len([s for s in sensors if s["id"] == spare]))
+        # The others are left as they were, their series still served
+        self.assertEqual([i for i in ids if i != spare], [s["id"] for s in sensors if s["id"] != spare])
+        series_after = requests.get("http://%s/api/readings/1h" % ip).json()["sensors"]
+        self.assertEqual([s["id"] for s in series_before], [s["id"] for s in series_after])
+
+
+if __name__ == "__main__":
+    unittest.main()
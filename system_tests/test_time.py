@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+
+import unittest
+import requests
+import os
+import socket
+import struct
+import threading
+import time
+
+from network import local_address_towards
+
+ip = os.getenv("TARGET_IP")
+
+NTP_TO_UNIX_S = 2208988800
+SERVER_TIME = 1700000000   # what the stand-in SNTP server answers (Unix seconds)
+BROWSER_TIME = 1800000000  # later than that: SNTP sets the clock back
+
+
+class SntpServer(threading.Thread):
+    """Just enough of an SNTP server to answer requests with SERVER_TIME"""
+
+    def __init__(self):
+        super().__init__(daemon=True)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("0.0.0.0", 0))
+        self.sock.settimeout(0.1)
+        self.port = self.sock.getsockname()[1]
+        self.requests = 0
+        self.stopped = False
+
+    def run(self):
+        while not self.stopped:
+            try:
+                data, addr = self.sock.recvfrom(512)
+            except socket.timeout:
+                continue
+            if len(data) < 48 or data[0] & 0x07 != 3:
+                continue
+            self.requests += 1
+            reply = bytearray(48)
+            reply[0] = (4 << 3) | 4  # version 4, mode 4 (server)
+            reply[1] = 1             # stratum
+            reply[24:32] = data[40:48]  # originate: the client's transmit timestamp
+            reply[32:40] = struct.pack(">II", SERVER_TIME + NTP_TO_UNIX_S, 0)
+            reply[40:48] = struct.pack(">II", SERVER_TIME + NTP_TO_UNIX_S, 0)
+            self.sock.sendto(bytes(reply), addr)
+        self.sock.close()
+
+
+def wait_for(condition, timeout=30):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if condition():
+            return True
+        time.sleep(0.05)
+    return False
+
+
+def get_time():
+    r = requests.get("http://%s/api/time" % ip)
+    return r.json()
+
+
+def readings(query):
+    return requests.get("http://%s/api/readings%s" % (ip, query))
+
+
+class Time(unittest.TestCase):
+    def test_required_fields_present(self):
+        r = requests.get("http://%s/api/time" % ip)
+        self.assertEqual(200, r.status_code)
+        self.assertEqual("application/javascript", r.headers['content-type'])
+        j = r.json()
+        required_fields = ("enabled", "server", "now", "source", "since_set_s", "syncs", "failures")
+        self.assertTrue(all([x in j for x in required_fields]))
+
+    def test_invalid_settings_rejected(self):
+        for patch in ({"server": ""}, {"server": "a:0"}, {"server": "a:70000"}, {"server": ":123"},
+                      {"server": "a b"}, {"enabled": "yes"}, {"unknown": 1}):
+            r = requests.patch("http://%s/api/time" % ip, json=patch)
+            self.assertEqual(400, r.status_code, patch)
+        for post in ({"now": 5}, {"now": "1800000000"}, {"now": BROWSER_TIME, "x": 1}, {}):
+            r = requests.post("http://%s/api/time" % ip, json=post)
+            self.assertEqual(400, r.status_code, post)
+
+    def test_invalid_queries_rejected(self):
+        for query in ("?from=x", "?to=-1", "?from=20&to=10", "?tier=2h", "?from="):
+            self.assertEqual(400, readings(query).status_code, query)
+
+    def test_browser_then_sntp_then_range_queries(self):
+        original = get_time()
+        if original["source"] != "sntp":
+            # The browser's time is taken while SNTP does not keep the clock
+            r = requests.post("http://%s/api/time" % ip, json={"now": BROWSER_TIME})
+            self.assertEqual(200, r.status_code)
+            j = get_time()
+            self.assertEqual("browser", j["source"])
+            self.assertTrue(BROWSER_TIME <= j["now"] < BROWSER_TIME + 3600)
+
+        server = SntpServer()
+        server.start()
+        try:
+            r = requests.patch("http://%s/api/time" % ip, json={
+                "enabled": 1, "server": "%s:%d" % (local_address_towards(ip), server.port)})
+            self.assertEqual(200, r.status_code)
+            self.assertTrue(wait_for(lambda: get_time()["source"] == "sntp"))
+            j = get_time()
+            self.assertTrue(SERVER_TIME <= j["now"] < SERVER_TIME + 3600)
+            self.assertTrue(j["syncs"] >= 1)
+
+            r = requests.post("http://%s/api/time" % ip, json={"now": BROWSER_TIME})
+            self.assertEqual(409, r.status_code)
+
+            # Once a reading is made, all readings kept are dated (set back: none at the browser's time)
+            self.assertTrue(wait_for(lambda: readings("?tier=1h").status_code == 200))
+            j = readings("?tier=1h").json()
+            self.assertEqual(10, j["period_s"])
+            anchors = j["time_anchors"]
+            self.assertEqual(0, anchors[0][0])
+            self.assertTrue(all(SERVER_TIME - 3600 <= t < SERVER_TIME + 3600 for _, t in anchors))
+            j = requests.get("http://%s/api/readings/1h" % ip).json()
+            self.assertEqual(0, j["time_anchors"][0][0])
+            self.assertEqual(360, len(j["sensors"][0]["readings"]))
+
+            # The last five minutes: 1h readings, those made in it (once there are that many)
+            self.assertTrue(wait_for(lambda: readings("?tier=1h").json()["samples_since_boot"] > 31))
+            now = get_time()["now"]
+            j = readings("?from=%d&to=%d" % (now - 299, now)).json()
+            self.assertEqual(10, j["period_s"])
+            for s in j["sensors"]:
+                self.assertTrue(27 <= len(s["readings"]) <= 31, len(s["readings"]))
+            position, first_time = j["time_anchors"][0]
+            self.assertEqual(0, position)
+            self.assertTrue(now - 299 <= first_time <= now - 299 + 20)
+
+            # Further back than the 1h readings go: 24h ones (once one of them is dated)
+            self.assertTrue(wait_for(lambda: readings("?tier=24h").status_code == 200))
+            j = readings("?from=%d" % (now - 7200)).json()
+            self.assertEqual(60, j["period_s"])
+            self.assertTrue(len(j["sensors"][0]["readings"]) <= 121)
+
+            # Before anything kept
+            j = readings("?from=1000000000&to=1000000100").json()
+            self.assertTrue(all(len(s["readings"]) == 0 for s in j["sensors"]))
+            self.assertEqual([], j["time_anchors"])
+        finally:
+            requests.patch("http://%s/api/time" % ip, json={"enabled": original["enabled"], "server": original["server"]})
+            server.stopped = True
+
+
+if __name__ == "__main__":
+    unittest.main()
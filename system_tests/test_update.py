@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+
+import base64
+import hashlib
+import http.client
+import json
+import os
+import time
+import unittest
+import requests
+
+ip = os.getenv("TARGET_IP")
+
+# Updates are authenticated as "admin" with the soft AP password (the default one unless given)
+PASSWORD = os.getenv("TARGET_SOFTAP_PASSWORD", "testtest")
+
+
+def fake_firmware(size):
+    # Starts like a sketch image (magic byte 0xE9); the simulation does not run it
+    return bytes([0xE9]) + (bytes(range(256)) * (size // 256 + 1))[:size - 1]
+
+
+def upload(image, md5=None, target="firmware", password=PASSWORD, pieces=1, pause=0.0, on_piece=None):
+    """POST image to /api/update in pieces, @return (status, parsed JSON body or text)"""
+    host, _, port = ip.partition(":")
+    conn = http.client.HTTPConnection(host, int(port or 80), timeout=30)
+    md5 = md5 or hashlib.md5(image).hexdigest()
+    conn.putrequest("POST", "/api/update?target=%s&md5=%s" % (target, md5))
+    conn.putheader("Content-Type", "application/octet-stream")
+    conn.putheader("Content-Length", str(len(image)))
+    if password is not None:
+        conn.putheader("Authorization", "Basic " + base64.b64encode(("admin:" + password).encode()).decode())
+    conn.endheaders()
+    step = (len(image) + pieces - 1) // pieces
+    for i in range(0, len(image), step):
+        conn.send(image[i:i + step])
+        if on_piece:
+            on_piece()
+        time.sleep(pause)
+    r = conn.getresponse()
+    body = r.read().decode()
+    conn.close()
+    try:
+        return r.status, json.loads(body)
+    except ValueError:
+        return r.status, body
+
+
+def samples_since_boot():
+    return requests.get("http://%s/api/readings/1h" % ip).json()["samples_since_boot"]
+
+
+class Update(unittest.TestCase):
+    def test_required_fields_present(self):
+        r = requests.get("http://%s/api/update" % ip)
+        self.assertEqual(200, r.status_code)
+        self.assertEqual("application/javascript", r.headers['content-type'])
+        required_fields = ("state", "target", "size", "written", "elapsed_ms", "bytes_per_s", "error", "restarting")
+        self.assertTrue(all([x in r.json() for x in required_fields]))
+
+    def test_authentication_required(self):
+        image = fake_firmware(20000)
+        for password in (None, "wrong"):
+            status, _ = upload(image, password=password)
+            self.assertEqual(401, status)
+
+    def test_bad_images_rejected(self):
+        image = fake_firmware(50000)
+        status, j = upload(image, md5="0" * 32, pieces=3)
+        self.assertEqual(400, status)
+        self.assertEqual(("failed", "md5 mismatch"), (j["state"], j["error"]))
+        self.assertEqual(len(image), j["written"])
+
+        status, j = upload(b"\x00" + image[1:])
+        self.assertEqual(400, status)
+        self.assertEqual("not a firmware image", j["error"])
+
+        status, j = upload(image, md5="not-an-md5")
+        self.assertEqual(400, status)
+
+        status, j = upload(fake_firmware(2 * 1024 * 1024))  # more than the free sketch space
+        self.assertEqual(400, status)
+        self.assertEqual(0, j["written"])
+
+        status, _ = upload(image, target="bootloader")
+        self.assertEqual(400, status)
+
+        self.assertEqual("failed", requests.get("http://%s/api/update" % ip).json()["state"])
+
+    def test_failed_spiffs_image_leaves_file_system_mounted(self):
+        image = bytes(range(256)) * 200
+        status, j = upload(image, md5="0" * 32, target="spiffs", pieces=3)
+        self.assertEqual(400, status)
+        self.assertEqual(("failed", "spiffs", "md5 mismatch"), (j["state"], j["target"], j["error"]))
+
+        r = requests.get("http://%s/main.html" % ip)
+        self.assertEqual(200, r.status_code)
+        self.assertIn("<html", r.text.lower())
+
+    def test_update_while_sampling_then_restart(self):
+        image = fake_firmware(200000)
+        progress = []
+        samples = []
+
+        def on_piece():
+            progress.append(requests.get("http://%s/api/update" % ip).json())
+            samples.append(samples_since_boot())
+
+        # Slowly, so that the unit goes on sampling and serving meanwhile (one sample each 0.1 s with SIM_TIME_SCALE=100)
+        status, j = upload(image, pieces=20, pause=0.05, on_piece=on_piece)
+        self.assertEqual(200, status, j)
+        self.assertEqual(("done", len(image), 1), (j["state"], j["written"], j["restarting"]))
+        self.assertGreater(j["bytes_per_s"], 0)
+        self.assertTrue(any(p["state"] == "receiving" and 0 < p["written"] < len(image) for p in progress))
+        self.assertGreater(samples[-1], samples[0])
+
+        # The unit restarts with the new image (the sample count starts over)
+        deadline = time.time() + 30
+        restarted = False
+        while time.time() < deadline and not restarted:
+            try:
+                restarted = samples_since_boot() < samples[-1]
+            except requests.exceptions.ConnectionError:
+                pass
+            time.sleep(0.1)
+        self.assertTrue(restarted)
+        self.assertEqual("idle", requests.get("http://%s/api/update" % ip).json()["state"])
+
+
+if __name__ == "__main__":
+    unittest.main()